@@ -0,0 +1,85 @@
+#version 330 core
+
+// NOTE: for one level of a geometry clipmap (see clipmap.h). gl_VertexID is the vertex's index into the
+//       level's (quads + 1) x (quads + 1) vertices, row by row, and the height is its sample in the level's
+//       layer of the toroidal heights texture.
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+uniform mat4 normal_transform;
+uniform float max_height;
+// NOTE: vertices per row and per column of the whole grid
+uniform ivec2 grid_size;
+uniform int quads;
+uniform int level;
+uniform int num_levels;
+// NOTE: in cells
+uniform int spacing;
+// NOTE: (column, row) of the window's first sample, in cells and in this level's samples, and in the next
+//       level's samples (which is half of it, since it's snapped to them)
+uniform ivec2 origin;
+uniform ivec2 origin_sample;
+uniform ivec2 coarse_origin_sample;
+uniform sampler2DArray heights;
+
+out vec3 frag_pos;
+out vec4 frag_color;
+out vec3 normal;
+out float scaled_max_height;
+out vec2 uv;
+
+// NOTE: like wrap_clipmap_index(), without % since it's undefined for negative numbers in GLSL
+float get_sample_height(ivec2 sample, int sample_level) {
+    int texture_size = quads + 1;
+    ivec2 texel = sample - texture_size*ivec2(floor(vec2(sample) / float(texture_size)));
+    return texelFetch(heights, ivec3(texel, sample_level), 0).r;
+}
+
+void main() {
+    int vertices_per_side = quads + 1;
+    ivec2 local = ivec2(gl_VertexID % vertices_per_side, gl_VertexID / vertices_per_side);
+    ivec2 sample = origin_sample + local;
+    float height = get_sample_height(sample, level);
+
+    // NOTE: near the outer edge, the height goes to what the next level's triangles have there, so the
+    //       edges of the two levels meet. a vertex between two of its samples is halfway between them, and
+    //       one in the middle of its quad is halfway along the diagonal generate_grid_indices() splits it
+    //       with.
+    if (level < num_levels - 1) {
+        float half_quads = 0.5*float(quads);
+        float blend_width = float(quads) / 10.0;
+        vec2 distance_from_center = abs(vec2(local) - half_quads);
+        float alpha = clamp((max(distance_from_center.x, distance_from_center.y) - (half_quads - blend_width)) /
+                            blend_width, 0.0, 1.0);
+        if (alpha > 0.0) {
+            ivec2 coarse_sample = coarse_origin_sample + local / 2;
+            float coarse_height = 0.5*(get_sample_height(coarse_sample, level + 1) +
+                                       get_sample_height(coarse_sample + (local & 1), level + 1));
+            height = mix(height, coarse_height, alpha);
+        }
+    }
+
+    // NOTE: the parts of the window past the edge of the grid collapse onto the edge
+    ivec2 cell = clamp(origin + local*spacing, ivec2(0), grid_size - 1);
+    vec3 vertex_position = vec3(float(cell.x), height, float(cell.y - grid_size.y + 1));
+
+    frag_pos = vec3(model * vec4(vertex_position, 1.0));
+    gl_Position = projection * view * model * vec4(vertex_position, 1.0);
+    scaled_max_height = (model * vec4(0.0f, max_height, 0.0f, 1.0f)).y;
+
+    // NOTE: like get_grid_vertex_normal() with this level's samples, one-sided on the window's edges, where
+    //       the texels past it are the other side of the window
+    ivec2 low = max(local - 1, ivec2(0)) - local;
+    ivec2 high = min(local + 1, ivec2(quads)) - local;
+    float left = get_sample_height(sample + ivec2(low.x, 0), level);
+    float right = get_sample_height(sample + ivec2(high.x, 0), level);
+    float top = get_sample_height(sample + ivec2(0, low.y), level);
+    float bottom = get_sample_height(sample + ivec2(0, high.y), level);
+    vec3 grid_normal = vec3((left - right) / float(high.x - low.x), float(spacing),
+                            (top - bottom) / float(high.y - low.y));
+    // NOTE: w of vec4 is 0 to ignore the translation of the model matrix
+    normal = vec3(normal_transform * vec4(grid_normal, 0.0));
+    uv = vec2(float(cell.x) / float(grid_size.x - 1),
+              float((grid_size.y - 1) - cell.y) / float(grid_size.y - 1));
+}
@@ -0,0 +1,46 @@
+#version 330 core
+
+// NOTE: for VERTEX_FORMAT_COMPRESSED (see Compressed_Vertex in vertex_formats.h). decodes the same way as
+//       decode_terrain_vertex().
+
+in vec2 vertex_grid_position;
+in float vertex_height;
+in vec2 vertex_octahedral_normal;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+uniform mat4 normal_transform;
+uniform float max_height;
+// NOTE: vertices per row and per column
+uniform ivec2 grid_size;
+
+out vec3 frag_pos;
+out vec4 frag_color;
+out vec3 normal;
+out float scaled_max_height;
+out vec2 uv;
+
+// NOTE: the inverse of encode_octahedral_normal()
+vec3 decode_octahedral_normal(vec2 encoded_normal) {
+    vec2 xz = clamp(encoded_normal, -1.0, 1.0);
+    float y = 1.0 - abs(xz.x) - abs(xz.y);
+    if (y < 0.0) {
+        xz = (1.0 - abs(xz.yx)) * vec2(xz.x >= 0.0 ? 1.0 : -1.0, xz.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(vec3(xz.x, y, xz.y));
+}
+
+void main() {
+    vec3 vertex_position = vec3(vertex_grid_position.x, vertex_height,
+                                vertex_grid_position.y - float(grid_size.y - 1));
+
+    frag_pos = vec3(model * vec4(vertex_position, 1.0));
+    gl_Position = projection * view * model * vec4(vertex_position, 1.0);
+    scaled_max_height = (model * vec4(0.0f, max_height, 0.0f, 1.0f)).y;
+
+    // NOTE: w of vec4 is 0 to ignore the translation of the model matrix
+    normal = vec3(normal_transform * vec4(decode_octahedral_normal(vertex_octahedral_normal), 0.0));
+    uv = vec2(vertex_grid_position.x / float(grid_size.x - 1),
+              (float(grid_size.y - 1) - vertex_grid_position.y) / float(grid_size.y - 1));
+}
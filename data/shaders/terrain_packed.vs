@@ -0,0 +1,81 @@
+#version 330 core
+
+// NOTE: for VERTEX_FORMAT_HEIGHT and VERTEX_FORMAT_HEIGHT_NORMAL (see vertex_formats.h). gl_VertexID is the
+//       vertex's index into the chunk-major vertex buffer (the base vertex is included), so its row and
+//       column are worked out like get_mesh_chunk_grid_position(), and then x, z and the UV the same way as
+//       get_grid_vertex_position() and get_grid_vertex_uv().
+
+in float vertex_height;
+in vec3 vertex_normal;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+uniform mat4 normal_transform;
+uniform float max_height;
+// NOTE: vertices per row and per column
+uniform ivec2 grid_size;
+// NOTE: see Mesh_Chunk_Layout
+uniform int chunk_cells;
+uniform int chunks_per_row;
+// NOTE: if the vertices have no normals, they're worked out from the neighbouring heights like
+//       get_grid_vertex_normal() does. heights is the vertex buffer as a texture buffer.
+uniform bool normals_from_heights;
+uniform samplerBuffer heights;
+
+out vec3 frag_pos;
+out vec4 frag_color;
+out vec3 normal;
+out float scaled_max_height;
+out vec2 uv;
+
+// NOTE: a vertex on an edge between chunks is in both, this reads the one in the chunk above or to the left
+//       unless it's on the top or left edge of the grid
+float get_height(int row_index, int column_index) {
+    int chunk_row_index = max(row_index - 1, 0) / chunk_cells;
+    int chunk_column_index = max(column_index - 1, 0) / chunk_cells;
+    int vertices_per_chunk_side = chunk_cells + 1;
+    int chunk_index = chunk_row_index*chunks_per_row + chunk_column_index;
+    return texelFetch(heights, chunk_index*vertices_per_chunk_side*vertices_per_chunk_side +
+                               (row_index - chunk_row_index*chunk_cells)*vertices_per_chunk_side +
+                               (column_index - chunk_column_index*chunk_cells)).r;
+}
+
+// NOTE: the height at offset steps from the vertex, or past the edge of the grid, the height extrapolated
+//       from the vertex and the one on the other side of it
+float get_neighbour_height(int row_index, int column_index, ivec2 offset) {
+    ivec2 neighbour = ivec2(column_index, row_index) + offset;
+    if (any(lessThan(neighbour, ivec2(0))) || any(greaterThanEqual(neighbour, grid_size))) {
+        return 2.0*vertex_height - get_height(row_index - offset.y, column_index - offset.x);
+    }
+    return get_height(neighbour.y, neighbour.x);
+}
+
+void main() {
+    int vertices_per_chunk_side = chunk_cells + 1;
+    int vertices_per_chunk = vertices_per_chunk_side*vertices_per_chunk_side;
+    int chunk_index = gl_VertexID / vertices_per_chunk;
+    int index_in_chunk = gl_VertexID - chunk_index*vertices_per_chunk;
+    int chunk_row_in_grid = chunk_index / chunks_per_row;
+    int chunk_column_in_grid = chunk_index - chunk_row_in_grid*chunks_per_row;
+    int row_index = chunk_row_in_grid*chunk_cells + index_in_chunk / vertices_per_chunk_side;
+    int column_index = chunk_column_in_grid*chunk_cells + index_in_chunk % vertices_per_chunk_side;
+    vec3 vertex_position = vec3(float(column_index), vertex_height, float(row_index - grid_size.y + 1));
+
+    frag_pos = vec3(model * vec4(vertex_position, 1.0));
+    gl_Position = projection * view * model * vec4(vertex_position, 1.0);
+    scaled_max_height = (model * vec4(0.0f, max_height, 0.0f, 1.0f)).y;
+
+    vec3 grid_normal = vertex_normal;
+    if (normals_from_heights) {
+        float left = get_neighbour_height(row_index, column_index, ivec2(-1, 0));
+        float right = get_neighbour_height(row_index, column_index, ivec2(1, 0));
+        float top = get_neighbour_height(row_index, column_index, ivec2(0, -1));
+        float bottom = get_neighbour_height(row_index, column_index, ivec2(0, 1));
+        grid_normal = vec3(left - right, 2.0, top - bottom);
+    }
+    // NOTE: w of vec4 is 0 to ignore the translation of the model matrix
+    normal = vec3(normal_transform * vec4(grid_normal, 0.0));
+    uv = vec2(float(column_index) / float(grid_size.x - 1),
+              float((grid_size.y - 1) - row_index) / float(grid_size.y - 1));
+}
@@ -0,0 +1,242 @@
+#include "main.h"
+#include "terrain.h"
+#include "work_queue.h"
+
+// NOTE: generates every terrain in a manifest and writes each one's heights to a PFM as soon as it's done.
+//       each job runs start to finish on a single thread, and the threads pull jobs until there are none
+//       left, which keeps every core busy with lots of small terrains (parallel_for() inside a single
+//       small terrain mostly waits on the other threads). every worker generates into the same Terrain
+//       over and over, so its height buffer is only allocated again when a job needs a bigger one.
+//
+//       a manifest has one job per line:
+//           <initial heights file> <seed> <h> <max random height> <exponent>
+//       blank lines and lines starting with # are skipped. initial heights files are only read once, no
+//       matter how many jobs use them.
+
+#define MAX_BATCH_INITIAL_HEIGHTS_FILES 256
+
+struct Batch_Job {
+    // NOTE: into Batch::initial_terrains
+    int32 initial_terrain_index;
+    uint64 seed;
+    real32 h;
+    real32 max_random_height;
+    int32 resolution_exponent;
+
+    // NOTE: filled in by the worker that did the job
+    int32 worker_index;
+    bool32 succeeded;
+    real32 max_height;
+    real64 generate_seconds;
+    real64 write_seconds;
+};
+
+struct Batch {
+    char *output_directory;
+    Batch_Job *jobs;
+    int32 num_jobs;
+    std::atomic<int32> next_job_index;
+
+    char *initial_heights_files[MAX_BATCH_INITIAL_HEIGHTS_FILES];
+    Terrain initial_terrains[MAX_BATCH_INITIAL_HEIGHTS_FILES];
+    int32 num_initial_terrains;
+};
+
+static int32 get_batch_initial_terrain(Batch *batch, char *initial_heights_file) {
+    for (int32 index = 0; index < batch->num_initial_terrains; index++) {
+        if (strcmp(batch->initial_heights_files[index], initial_heights_file) == 0) {
+            return index;
+        }
+    }
+
+    if (batch->num_initial_terrains == MAX_BATCH_INITIAL_HEIGHTS_FILES) {
+        printf("More than %d different initial heights files.\n", MAX_BATCH_INITIAL_HEIGHTS_FILES);
+        return -1;
+    }
+    FILE *file = open_file(initial_heights_file, "rb");
+    if (!file) {
+        printf("Couldn't open initial heights file %s.\n", initial_heights_file);
+        return -1;
+    }
+    fclose(file);
+
+    int32 index = batch->num_initial_terrains++;
+    batch->initial_heights_files[index] = initial_heights_file;
+    batch->initial_terrains[index] = {};
+    load_initial_heights(&batch->initial_terrains[index], initial_heights_file);
+    return index;
+}
+
+// NOTE: the words in the manifest point into manifest_contents, which has to outlive the batch
+static bool32 parse_batch_manifest(Batch *batch, char *manifest_contents) {
+    int32 max_jobs = 0;
+    for (char *c = manifest_contents; *c; c++) {
+        if (*c == '\n') {
+            max_jobs++;
+        }
+    }
+    max_jobs++;
+    batch->jobs = (Batch_Job *) malloc(max_jobs * sizeof(Batch_Job));
+    batch->num_jobs = 0;
+
+    char *line = manifest_contents;
+    int32 line_number = 0;
+    while (*line) {
+        line_number++;
+        char *line_end = strchr(line, '\n');
+        char *next_line = line_end ? (line_end + 1) : (line + strlen(line));
+        if (line_end) {
+            *line_end = '\0';
+        }
+
+        char *words[6];
+        int32 num_words = 0;
+        char *buffer = line;
+        while (num_words < 6) {
+            char *word = get_next_word(&buffer);
+            if (!*word) {
+                break;
+            }
+            words[num_words++] = word;
+        }
+
+        if (num_words > 0 && words[0][0] != '#') {
+            if (num_words != 5) {
+                printf("Line %d of the manifest has %d words, expected 5 "
+                       "(<initial heights file> <seed> <h> <max random height> <exponent>).\n",
+                       line_number, num_words);
+                return false;
+            }
+
+            Batch_Job *job = &batch->jobs[batch->num_jobs];
+            *job = {};
+            job->initial_terrain_index = get_batch_initial_terrain(batch, words[0]);
+            job->seed = strtoull(words[1], NULL, 10);
+            job->h = (real32) atof(words[2]);
+            job->max_random_height = (real32) atof(words[3]);
+            job->resolution_exponent = atoi(words[4]);
+            if (job->initial_terrain_index < 0) {
+                return false;
+            }
+            Terrain *initial_terrain = &batch->initial_terrains[job->initial_terrain_index];
+            if (job->resolution_exponent < initial_terrain->low_res_grid_size_exponent) {
+                printf("Line %d of the manifest has exponent %d, which is less than the low-res grid's (%d).\n",
+                       line_number, job->resolution_exponent, initial_terrain->low_res_grid_size_exponent);
+                return false;
+            }
+            batch->num_jobs++;
+        }
+
+        line = next_line;
+    }
+    return true;
+}
+
+static void do_batch_jobs(Batch *batch, int32 worker_index) {
+    // NOTE: reused for every job this worker does
+    Terrain terrain = {};
+    char *file_path = (char *) malloc(strlen(batch->output_directory) + 32);
+
+    while (true) {
+        int32 job_index = batch->next_job_index.fetch_add(1);
+        if (job_index >= batch->num_jobs) {
+            break;
+        }
+        Batch_Job *job = &batch->jobs[job_index];
+        Terrain *initial_terrain = &batch->initial_terrains[job->initial_terrain_index];
+
+        real64 start_time = get_seconds();
+        terrain.max_x = initial_terrain->max_x;
+        terrain.max_y = initial_terrain->max_y;
+        terrain.low_res_grid_size_exponent = initial_terrain->low_res_grid_size_exponent;
+        terrain.low_res_height_data = initial_terrain->low_res_height_data;
+        terrain.height_layout = HEIGHT_LAYOUT_ROW_MAJOR;
+        set_terrain_resolution_exponent(&terrain, job->resolution_exponent);
+        generate_height_data(&terrain, job->h, job->max_random_height, job->seed, NULL);
+        real64 generated_time = get_seconds();
+
+        sprintf(file_path, "%s/terrain_%06d.pfm", batch->output_directory, job_index);
+        job->succeeded = write_heightmap_pfm(&terrain, file_path);
+        if (!job->succeeded) {
+            printf("Couldn't write %s.\n", file_path);
+        }
+
+        job->worker_index = worker_index;
+        job->max_height = terrain.max_height;
+        job->generate_seconds = generated_time - start_time;
+        job->write_seconds = get_seconds() - generated_time;
+    }
+
+    free(file_path);
+    free(terrain.height_data);
+}
+
+static void do_batch_workers(void *data, int32 first, int32 last) {
+    for (int32 worker_index = first; worker_index < last; worker_index++) {
+        do_batch_jobs((Batch *) data, worker_index);
+    }
+}
+
+// NOTE: runs every job in manifest_path on work_queue's threads and the calling thread, writing
+//       <output_directory>/terrain_<job>.pfm for each (jobs are numbered from 0, skipping comments and blank
+//       lines). output_directory has to exist. prints every job's timings and the terrains per second, and
+//       returns false if the manifest is bad or any file couldn't be written.
+bool32 run_terrain_batch(char *manifest_path, char *output_directory, Work_Queue *work_queue) {
+    FILE *manifest_file = open_file(manifest_path, "rb");
+    if (!manifest_file) {
+        printf("Couldn't open manifest %s.\n", manifest_path);
+        return false;
+    }
+    fclose(manifest_file);
+
+    Batch *batch = new Batch;
+    batch->output_directory = output_directory;
+    batch->num_initial_terrains = 0;
+    batch->next_job_index = 0;
+
+    char *manifest_contents = read_file(manifest_path);
+    bool32 succeeded = parse_batch_manifest(batch, manifest_contents);
+    int32 num_workers = (work_queue ? work_queue->num_threads : 0) + 1;
+
+    if (succeeded) {
+        printf("Generating %d terrains on %d threads.\n", batch->num_jobs, num_workers);
+        bool32 saved_print_terrain_timings = print_terrain_timings;
+        print_terrain_timings = false;
+
+        real64 start_time = get_seconds();
+        parallel_for(work_queue, num_workers, do_batch_workers, batch);
+        real64 total_seconds = get_seconds() - start_time;
+
+        print_terrain_timings = saved_print_terrain_timings;
+
+        printf("\n%-7s %-6s %-20s %-9s %-12s %-12s %-12s\n", "job", "worker", "seed", "size", "max height",
+               "generate", "write");
+        real64 total_generate_seconds = 0;
+        real64 total_write_seconds = 0;
+        for (int32 job_index = 0; job_index < batch->num_jobs; job_index++) {
+            Batch_Job *job = &batch->jobs[job_index];
+            int32 resolution = (1 << job->resolution_exponent) + 1;
+            printf("%-7d %-6d %-20llu %5dx%-5d %-12f %-12f %-12f%s\n", job_index, job->worker_index,
+                   (unsigned long long) job->seed, resolution, resolution, job->max_height,
+                   job->generate_seconds, job->write_seconds, job->succeeded ? "" : " FAILED");
+            total_generate_seconds += job->generate_seconds;
+            total_write_seconds += job->write_seconds;
+            succeeded = succeeded && job->succeeded;
+        }
+
+        if (batch->num_jobs > 0) {
+            printf("\nGenerated %d terrains in %f seconds (%.2f terrains/second). Per job: %f seconds generating, "
+                   "%f seconds writing on average.\n", batch->num_jobs, total_seconds,
+                   batch->num_jobs / total_seconds, total_generate_seconds / batch->num_jobs,
+                   total_write_seconds / batch->num_jobs);
+        }
+    }
+
+    for (int32 index = 0; index < batch->num_initial_terrains; index++) {
+        free(batch->initial_terrains[index].low_res_height_data);
+    }
+    free(batch->jobs);
+    delete[] manifest_contents;
+    delete batch;
+    return succeeded;
+}
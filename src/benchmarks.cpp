@@ -0,0 +1,1411 @@
+#include "main.h"
+#include "terrain.h"
+#include "rng.h"
+#include "terrain_kernels.h"
+#include "vertex_cache.h"
+#include <random>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// NOTE: hardware cache miss counts for the calling thread. these come from perf_event_open() on linux;
+//       everywhere else (or when perf events aren't allowed) is_available is false and the counts are 0.
+struct Cache_Miss_Counter {
+    bool32 is_available;
+    int32 l1d_read_misses_fd;
+    int32 llc_misses_fd;
+};
+
+struct Cache_Misses {
+    uint64 l1d_read_misses;
+    uint64 llc_misses;
+};
+
+#if defined(__linux__)
+static int32 open_perf_counter(uint32 type, uint64 config) {
+    perf_event_attr attributes = {};
+    attributes.type = type;
+    attributes.size = sizeof(attributes);
+    attributes.config = config;
+    attributes.disabled = 1;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    return (int32) syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0);
+}
+#endif
+
+void start_cache_miss_counter(Cache_Miss_Counter *counter) {
+    *counter = {};
+#if defined(__linux__)
+    uint64 l1d_read_miss_config = (PERF_COUNT_HW_CACHE_L1D |
+                                   (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                   (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    counter->l1d_read_misses_fd = open_perf_counter(PERF_TYPE_HW_CACHE, l1d_read_miss_config);
+    counter->llc_misses_fd = open_perf_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    counter->is_available = (counter->l1d_read_misses_fd >= 0 && counter->llc_misses_fd >= 0);
+    if (counter->is_available) {
+        ioctl(counter->l1d_read_misses_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(counter->llc_misses_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(counter->l1d_read_misses_fd, PERF_EVENT_IOC_ENABLE, 0);
+        ioctl(counter->llc_misses_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+Cache_Misses stop_cache_miss_counter(Cache_Miss_Counter *counter) {
+    Cache_Misses misses = {};
+#if defined(__linux__)
+    if (counter->is_available) {
+        ioctl(counter->l1d_read_misses_fd, PERF_EVENT_IOC_DISABLE, 0);
+        ioctl(counter->llc_misses_fd, PERF_EVENT_IOC_DISABLE, 0);
+        read(counter->l1d_read_misses_fd, &misses.l1d_read_misses, sizeof(uint64));
+        read(counter->llc_misses_fd, &misses.llc_misses, sizeof(uint64));
+    }
+    if (counter->l1d_read_misses_fd >= 0) close(counter->l1d_read_misses_fd);
+    if (counter->llc_misses_fd >= 0) close(counter->llc_misses_fd);
+#endif
+    return misses;
+}
+
+struct Height_Layout_Benchmark_Result {
+    char *name;
+    real64 seconds;
+    Cache_Misses misses;
+    bool32 has_cache_misses;
+};
+
+static Height_Layout_Benchmark_Result run_height_layout_benchmark(Terrain *initial_terrain, int32 resolution_exponent,
+                                                                 Height_Layout height_layout, Simd_Level simd_level,
+                                                                 char *name) {
+    Terrain terrain = *initial_terrain;
+    terrain.height_data = NULL;
+    terrain.height_layout = height_layout;
+    set_terrain_resolution_exponent(&terrain, resolution_exponent);
+
+    Terrain_Kernels saved_kernels = terrain_kernels;
+    init_terrain_kernels(simd_level);
+
+    // NOTE: single-threaded, since the counters only count the calling thread
+    Cache_Miss_Counter counter;
+    start_cache_miss_counter(&counter);
+    real64 start_time = get_seconds();
+    generate_height_data(&terrain, 0.5f, 1.0f, 1, NULL);
+
+    Height_Layout_Benchmark_Result result = {};
+    result.name = name;
+    result.seconds = get_seconds() - start_time;
+    result.has_cache_misses = counter.is_available;
+    result.misses = stop_cache_miss_counter(&counter);
+
+    terrain_kernels = saved_kernels;
+    free(terrain.height_data);
+    return result;
+}
+
+// NOTE: diamond-square into row-major and tiled height_data at exponents 11 to 14. the tiled layout can
+//       only use the scalar code, so row-major is run with both the scalar and the best SIMD kernels to
+//       separate the layout from the vectorization.
+void benchmark_height_layouts(char *initial_heights_file) {
+    Terrain initial_terrain = {};
+    load_initial_heights(&initial_terrain, initial_heights_file);
+
+    Height_Layout_Benchmark_Result results[4][3];
+    for (int32 exponent_index = 0; exponent_index < 4; exponent_index++) {
+        int32 resolution_exponent = 11 + exponent_index;
+        if (resolution_exponent < initial_terrain.low_res_grid_size_exponent) {
+            continue;
+        }
+        results[exponent_index][0] = run_height_layout_benchmark(&initial_terrain, resolution_exponent,
+                                                                 HEIGHT_LAYOUT_ROW_MAJOR, get_cpu_simd_level(),
+                                                                 "row-major");
+        results[exponent_index][1] = run_height_layout_benchmark(&initial_terrain, resolution_exponent,
+                                                                 HEIGHT_LAYOUT_ROW_MAJOR, SIMD_LEVEL_SCALAR,
+                                                                 "row-major scalar");
+        results[exponent_index][2] = run_height_layout_benchmark(&initial_terrain, resolution_exponent,
+                                                                 HEIGHT_LAYOUT_TILED, SIMD_LEVEL_SCALAR,
+                                                                 "tiled");
+    }
+
+    printf("\n%-9s %-17s %12s %18s %18s\n", "exponent", "layout", "seconds", "L1D read misses", "LLC misses");
+    for (int32 exponent_index = 0; exponent_index < 4; exponent_index++) {
+        int32 resolution_exponent = 11 + exponent_index;
+        if (resolution_exponent < initial_terrain.low_res_grid_size_exponent) {
+            continue;
+        }
+        for (int32 result_index = 0; result_index < 3; result_index++) {
+            Height_Layout_Benchmark_Result *result = &results[exponent_index][result_index];
+            if (result->has_cache_misses) {
+                printf("%-9d %-17s %12.4f %18llu %18llu\n", resolution_exponent, result->name, result->seconds,
+                       (unsigned long long) result->misses.l1d_read_misses,
+                       (unsigned long long) result->misses.llc_misses);
+            } else {
+                printf("%-9d %-17s %12.4f %18s %18s\n", resolution_exponent, result->name, result->seconds,
+                       "n/a", "n/a");
+            }
+        }
+    }
+    printf("\n");
+
+    free(initial_terrain.low_res_height_data);
+}
+
+// NOTE: a small LCG for the random reads, so the benchmark doesn't time the RNG more than the reads
+inline uint32 get_next_benchmark_random(uint32 *state) {
+    *state = *state*1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+static void print_height_read_benchmark(char *name, real64 seconds, int64 num_heights, int64 num_bytes_read) {
+    printf("%-24s %12.4f %16.1f %12.2f\n", name, seconds, num_heights / seconds / 1e6,
+           num_bytes_read / seconds / (1024.0*1024.0*1024.0));
+}
+
+// NOTE: quantizes the terrain's (row-major) heights and compares them to the float grid: how much memory
+//       they take, how fast whole rows are read (the mesh is built row by row), and how fast random heights
+//       are read. the decoded rows are also checked against get_quantized_height() and the scalar kernels.
+void benchmark_quantized_heights(Terrain *terrain, real32 max_error, Work_Queue *work_queue) {
+    assert(terrain->height_data && terrain->height_layout == HEIGHT_LAYOUT_ROW_MAJOR);
+    int32 width = terrain->x_resolution;
+    int32 height = terrain->y_resolution;
+    int64 num_heights = ((int64) width)*height;
+    int64 float_size = num_heights*sizeof(real32);
+
+    real64 start_time = get_seconds();
+    Quantized_Heights quantized_heights;
+    quantize_heights(&quantized_heights, terrain->height_data, width, height, max_error, work_queue);
+    real64 quantize_seconds = get_seconds() - start_time;
+    int64 quantized_size = get_quantized_heights_size(&quantized_heights);
+
+    // NOTE: check that every path decodes the same heights
+    Terrain_Kernels saved_kernels = terrain_kernels;
+    Terrain_Kernels scalar_kernels = get_terrain_kernels(SIMD_LEVEL_SCALAR);
+    real32 *row = (real32 *) malloc(width * sizeof(real32));
+    real32 *scalar_row = (real32 *) malloc(width * sizeof(real32));
+    int64 num_mismatches = 0;
+    for (int32 row_index = 0; row_index < height; row_index++) {
+        decode_quantized_height_row(&quantized_heights, row_index, row);
+        terrain_kernels = scalar_kernels;
+        decode_quantized_height_row(&quantized_heights, row_index, scalar_row);
+        terrain_kernels = saved_kernels;
+        for (int32 column_index = 0; column_index < width; column_index++) {
+            if (row[column_index] != scalar_row[column_index] ||
+                row[column_index] != get_quantized_height(&quantized_heights, row_index, column_index)) {
+                num_mismatches++;
+            }
+        }
+    }
+
+    // NOTE: enough passes over the grid to read about 256M heights
+    int32 num_passes = (int32) ((256ll << 20) / num_heights);
+    if (num_passes < 1) {
+        num_passes = 1;
+    }
+    int64 num_heights_read = num_heights*num_passes;
+    real32 checksum = 0;
+
+    printf("\n%-24s %12s %16s %12s\n", "rows", "seconds", "Mheights/s", "GB/s read");
+    start_time = get_seconds();
+    for (int32 pass_index = 0; pass_index < num_passes; pass_index++) {
+        for (int32 row_index = 0; row_index < height; row_index++) {
+            memcpy(row, terrain->height_data + ((int64) row_index)*width, width * sizeof(real32));
+            checksum += row[row_index % width];
+        }
+    }
+    print_height_read_benchmark("float", get_seconds() - start_time, num_heights_read, float_size*num_passes);
+
+    for (int32 kernels_index = 0; kernels_index < 2; kernels_index++) {
+        terrain_kernels = (kernels_index == 0) ? scalar_kernels : saved_kernels;
+        start_time = get_seconds();
+        for (int32 pass_index = 0; pass_index < num_passes; pass_index++) {
+            for (int32 row_index = 0; row_index < height; row_index++) {
+                decode_quantized_height_row(&quantized_heights, row_index, row);
+                checksum += row[row_index % width];
+            }
+        }
+        char name[64];
+        sprintf(name, "quantized (%s)", get_simd_level_name(terrain_kernels.simd_level));
+        print_height_read_benchmark(name, get_seconds() - start_time, num_heights_read,
+                                    quantized_size*num_passes);
+    }
+    terrain_kernels = saved_kernels;
+
+    int64 num_random_reads = 1 << 24;
+    printf("\n%-24s %12s %16s\n", "random reads", "seconds", "Mheights/s");
+    uint32 random_state = 1;
+    start_time = get_seconds();
+    for (int64 read_index = 0; read_index < num_random_reads; read_index++) {
+        int32 row_index = (int32) (get_next_benchmark_random(&random_state) % (uint32) height);
+        int32 column_index = (int32) (get_next_benchmark_random(&random_state) % (uint32) width);
+        checksum += terrain->height_data[((int64) row_index)*width + column_index];
+    }
+    real64 seconds = get_seconds() - start_time;
+    printf("%-24s %12.4f %16.1f\n", "float", seconds, num_random_reads / seconds / 1e6);
+
+    random_state = 1;
+    start_time = get_seconds();
+    for (int64 read_index = 0; read_index < num_random_reads; read_index++) {
+        int32 row_index = (int32) (get_next_benchmark_random(&random_state) % (uint32) height);
+        int32 column_index = (int32) (get_next_benchmark_random(&random_state) % (uint32) width);
+        checksum += get_quantized_height(&quantized_heights, row_index, column_index);
+    }
+    seconds = get_seconds() - start_time;
+    printf("%-24s %12.4f %16.1f\n", "quantized", seconds, num_random_reads / seconds / 1e6);
+
+    printf("\n%dx%d heights quantized to within %f in %f seconds: %.1f MB instead of %.1f MB (%.1f%% saved), "
+           "%d of %d tiles 16-bit, max error %f, %lld decode mismatches (checksum %f).\n\n",
+           width, height, max_error, quantize_seconds, quantized_size / (1024.0*1024.0),
+           float_size / (1024.0*1024.0), 100.0*(1.0 - (real64) quantized_size / float_size),
+           quantized_heights.num_16_bit_tiles, quantized_heights.tiles_per_row*quantized_heights.tiles_per_column,
+           quantized_heights.measured_max_error, (long long) num_mismatches, checksum);
+
+    free(row);
+    free(scalar_row);
+    free_quantized_heights(&quantized_heights);
+}
+
+// NOTE: what get_cell_gaussian() did before it had its own log and cos, to compare against
+static real32 get_cell_gaussian_libm(Philox_Key key, int32 level, int32 row_index, int32 column_index) {
+    Philox_Block random_bits = get_cell_random_bits(key, level, row_index, column_index);
+    real32 u1 = get_uniform_real32(random_bits.v[0]);
+    real32 u2 = get_uniform_real32(random_bits.v[1]);
+    real32 r = sqrtf(-2.0f*logf(u1));
+    real32 theta = 2.0f*3.14159265358979f*u2;
+    return r*cosf(theta);
+}
+
+struct Gaussian_Benchmark_Result {
+    real64 seconds;
+    real64 mean;
+    real64 standard_deviation;
+};
+
+static Gaussian_Benchmark_Result get_gaussian_benchmark_result(real32 *samples, int64 num_samples, real64 seconds) {
+    real64 sum = 0;
+    real64 sum_of_squares = 0;
+    for (int64 index = 0; index < num_samples; index++) {
+        sum += samples[index];
+        sum_of_squares += (real64) samples[index]*samples[index];
+    }
+
+    Gaussian_Benchmark_Result result;
+    result.seconds = seconds;
+    result.mean = sum / num_samples;
+    result.standard_deviation = sqrt(sum_of_squares / num_samples - result.mean*result.mean);
+    return result;
+}
+
+static void print_gaussian_benchmark_result(char *name, Gaussian_Benchmark_Result result, int64 num_samples) {
+    printf("%-30s %10.4f %14.1f %12.6f %12.6f\n", name, result.seconds, num_samples / result.seconds / 1e6,
+           result.mean, result.standard_deviation);
+}
+
+// NOTE: times filling rows of noise the way the diamond-square passes do, with std::normal_distribution,
+//       with Philox and libm's log and cos, and with get_cell_gaussian() and the row kernels. the kernels
+//       have to give exactly what get_cell_gaussian() gives, and the mean and standard deviation should
+//       come out at 0 and 1 for all of them.
+void benchmark_gaussian_sampler() {
+    int32 row_length = 4096;
+    int32 num_rows = 4096;
+    int64 num_samples = ((int64) row_length)*num_rows;
+    real32 *samples = (real32 *) malloc(num_samples * sizeof(real32));
+    real32 *reference_samples = (real32 *) malloc(num_samples * sizeof(real32));
+    Philox_Key key = make_philox_key(1);
+    int32 level = 3;
+    int32 column_step = 8;
+
+    printf("\n%-30s %10s %14s %12s %12s\n", "sampler", "seconds", "Msamples/s", "mean", "std dev");
+
+    std::mt19937 generator(1);
+    std::normal_distribution<real32> distribution(0.0f, 1.0f);
+    real64 start_time = get_seconds();
+    for (int64 index = 0; index < num_samples; index++) {
+        samples[index] = distribution(generator);
+    }
+    print_gaussian_benchmark_result("std::normal_distribution",
+                                    get_gaussian_benchmark_result(samples, num_samples, get_seconds() - start_time),
+                                    num_samples);
+
+    start_time = get_seconds();
+    for (int32 row_index = 0; row_index < num_rows; row_index++) {
+        real32 *row = reference_samples + ((int64) row_index)*row_length;
+        for (int32 k = 0; k < row_length; k++) {
+            row[k] = get_cell_gaussian_libm(key, level, row_index, k*column_step);
+        }
+    }
+    print_gaussian_benchmark_result("Philox, libm log/cos",
+                                    get_gaussian_benchmark_result(reference_samples, num_samples,
+                                                                  get_seconds() - start_time),
+                                    num_samples);
+
+    start_time = get_seconds();
+    for (int32 row_index = 0; row_index < num_rows; row_index++) {
+        real32 *row = samples + ((int64) row_index)*row_length;
+        for (int32 k = 0; k < row_length; k++) {
+            row[k] = get_cell_gaussian(key, level, row_index, k*column_step);
+        }
+    }
+    print_gaussian_benchmark_result("get_cell_gaussian()",
+                                    get_gaussian_benchmark_result(samples, num_samples, get_seconds() - start_time),
+                                    num_samples);
+
+    real32 max_difference = 0;
+    for (int64 index = 0; index < num_samples; index++) {
+        max_difference = fmaxf(max_difference, fabsf(samples[index] - reference_samples[index]));
+    }
+    // NOTE: the per-cell samples are the reference for the kernels from here on
+    memcpy(reference_samples, samples, num_samples * sizeof(real32));
+
+    int64 num_mismatches = 0;
+    Simd_Level cpu_simd_level = get_cpu_simd_level();
+    for (int32 simd_level = SIMD_LEVEL_SCALAR; simd_level <= (int32) cpu_simd_level; simd_level++) {
+        Terrain_Kernels kernels = get_terrain_kernels((Simd_Level) simd_level);
+        start_time = get_seconds();
+        for (int32 row_index = 0; row_index < num_rows; row_index++) {
+            kernels.gaussian_row(samples + ((int64) row_index)*row_length, key, level, row_index, 0, column_step,
+                                 row_length);
+        }
+        real64 seconds = get_seconds() - start_time;
+
+        char name[64];
+        sprintf(name, "row kernel (%s)", get_simd_level_name(kernels.simd_level));
+        print_gaussian_benchmark_result(name, get_gaussian_benchmark_result(samples, num_samples, seconds),
+                                        num_samples);
+        for (int64 index = 0; index < num_samples; index++) {
+            if (samples[index] != reference_samples[index]) {
+                num_mismatches++;
+            }
+        }
+    }
+
+    printf("\n%lld samples. Max difference from libm log/cos %g, %lld row kernel mismatches.\n\n",
+           (long long) num_samples, max_difference, (long long) num_mismatches);
+    free(samples);
+    free(reference_samples);
+}
+
+// NOTE: generates the same heights (seed, grid and exponent) with the square and diamond kernels of every
+//       SIMD level the CPU has, and counts the heights that differ from the scalar ones, which should be none
+void benchmark_terrain_kernels(char *initial_heights_file, int32 resolution_exponent) {
+    Terrain initial_terrain = {};
+    load_initial_heights(&initial_terrain, initial_heights_file);
+    if (resolution_exponent < initial_terrain.low_res_grid_size_exponent) {
+        resolution_exponent = initial_terrain.low_res_grid_size_exponent;
+    }
+    bool32 saved_print_terrain_timings = print_terrain_timings;
+    print_terrain_timings = false;
+    Terrain_Kernels saved_kernels = terrain_kernels;
+
+    Terrain terrain = initial_terrain;
+    terrain.height_data = NULL;
+    terrain.height_data_capacity = 0;
+    set_terrain_resolution_exponent(&terrain, resolution_exponent);
+    int64 num_heights = get_height_data_length(&terrain);
+    real32 *scalar_heights = (real32 *) malloc(num_heights * sizeof(real32));
+    assert(scalar_heights);
+    real32 scalar_max_height = 0;
+
+    printf("\n%-8s %12s %14s %14s\n", "kernels", "seconds", "max height", "mismatches");
+    int64 num_mismatches = 0;
+    Simd_Level cpu_simd_level = get_cpu_simd_level();
+    for (int32 simd_level = SIMD_LEVEL_SCALAR; simd_level <= (int32) cpu_simd_level; simd_level++) {
+        init_terrain_kernels((Simd_Level) simd_level);
+        real64 start_time = get_seconds();
+        generate_height_data(&terrain, 0.5f, 1.0f, 1, NULL);
+        real64 seconds = get_seconds() - start_time;
+
+        int64 level_mismatches = 0;
+        if (simd_level == SIMD_LEVEL_SCALAR) {
+            memcpy(scalar_heights, terrain.height_data, num_heights * sizeof(real32));
+            scalar_max_height = terrain.max_height;
+        } else {
+            for (int64 index = 0; index < num_heights; index++) {
+                if (terrain.height_data[index] != scalar_heights[index]) {
+                    level_mismatches++;
+                }
+            }
+            if (terrain.max_height != scalar_max_height) {
+                level_mismatches++;
+            }
+        }
+        num_mismatches += level_mismatches;
+        printf("%-8s %12.4f %14g %14lld\n", get_simd_level_name((Simd_Level) simd_level), seconds,
+               terrain.max_height, (long long) level_mismatches);
+    }
+
+    printf("\n%lld heights at exponent %d. %lld heights differ from the scalar kernels.\n\n",
+           (long long) num_heights, resolution_exponent, (long long) num_mismatches);
+
+    terrain_kernels = saved_kernels;
+    print_terrain_timings = saved_print_terrain_timings;
+    free(scalar_heights);
+    free(terrain.height_data);
+    free(initial_terrain.low_res_height_data);
+}
+
+// NOTE: how the normals used to be made: a buffer of face normals from the vertices (the first triangle
+//       of every quad), then the average of the 4 faces around every vertex, wrapping around the borders
+static void generate_normals_from_face_normals(real32 *normals, real32 *vertices, glm::vec3 *face_normal_data,
+                                               int32 width, int32 height) {
+    int32 num_faces_x = width - 1;
+    int32 num_faces_y = height - 1;
+    Grid_View<glm::vec3, Unchecked_Boundary> vertex_view =
+        make_grid_view<Unchecked_Boundary>((glm::vec3 *) vertices, width, height);
+    Grid_View<glm::vec3, Wrap_Boundary> face_normals =
+        make_grid_view<Wrap_Boundary>(face_normal_data, num_faces_x, num_faces_y);
+    for (int32 row_index = 0; row_index < num_faces_y; row_index++) {
+        for (int32 column_index = 0; column_index < num_faces_x; column_index++) {
+            glm::vec3 p1 = vertex_view.at(row_index + 1, column_index + 1);
+            glm::vec3 p2 = vertex_view.at(row_index, column_index + 1);
+            glm::vec3 p3 = vertex_view.at(row_index, column_index);
+            face_normals.at(row_index, column_index) = glm::cross(p2 - p1, p3 - p2);
+        }
+    }
+
+    glm::vec3 *normal = (glm::vec3 *) normals;
+    for (int32 row_index = 0; row_index < height; row_index++) {
+        for (int32 column_index = 0; column_index < width; column_index++) {
+            glm::vec3 n1 = face_normals.at(row_index - 1, column_index - 1);
+            glm::vec3 n2 = face_normals.at(row_index - 1, column_index);
+            glm::vec3 n3 = face_normals.at(row_index,     column_index - 1);
+            glm::vec3 n4 = face_normals.at(row_index,     column_index);
+            *normal++ = (n1 + n2 + n3 + n4) / 4.0f;
+        }
+    }
+}
+
+// NOTE: the old face normal pass against the fused finite-difference normals (scalar and SIMD, one
+//       thread) from exponent 10 up to max_resolution_exponent, with the memory the face normal buffer
+//       took. needs about 40 bytes per vertex (2.7GB at exponent 13).
+void benchmark_normals(char *initial_heights_file, int32 max_resolution_exponent) {
+    Terrain initial_terrain = {};
+    load_initial_heights(&initial_terrain, initial_heights_file);
+    bool32 saved_print_terrain_timings = print_terrain_timings;
+    print_terrain_timings = false;
+    if (!terrain_kernels.normal_row) {
+        init_terrain_kernels(get_cpu_simd_level());
+    }
+    Terrain_Kernels saved_kernels = terrain_kernels;
+
+    printf("\n%-9s %14s %14s %14s %10s %16s %18s\n", "exponent", "face normals", "fused scalar",
+           get_simd_level_name(saved_kernels.simd_level), "speedup", "MB saved", "mean angle (deg)");
+    for (int32 resolution_exponent = 10; resolution_exponent <= max_resolution_exponent; resolution_exponent++) {
+        if (resolution_exponent < initial_terrain.low_res_grid_size_exponent) {
+            continue;
+        }
+        Terrain terrain = initial_terrain;
+        terrain.height_data = NULL;
+        terrain.height_data_capacity = 0;
+        set_terrain_resolution_exponent(&terrain, resolution_exponent);
+        int32 width = terrain.x_resolution;
+        int32 height = terrain.y_resolution;
+        int64 num_vertices = ((int64) width)*height;
+        int64 face_normals_size = ((int64) (width - 1))*(height - 1)*sizeof(glm::vec3);
+
+        // NOTE: the new normals go where the vertices were, the fused pass only needs the heights
+        real32 *vertices = (real32 *) malloc(num_vertices * 3 * sizeof(real32));
+        real32 *old_normals = (real32 *) malloc(num_vertices * 3 * sizeof(real32));
+        glm::vec3 *face_normals = (glm::vec3 *) malloc(face_normals_size);
+        terrain.height_data = (real32 *) malloc(num_vertices * sizeof(real32));
+        terrain.height_data_capacity = num_vertices;
+        if (!vertices || !old_normals || !face_normals || !terrain.height_data) {
+            printf("%-9d skipped, not enough memory\n", resolution_exponent);
+            free(vertices);
+            free(old_normals);
+            free(face_normals);
+            free(terrain.height_data);
+            continue;
+        }
+        generate_height_data(&terrain, 0.5f, 1.0f, 1, NULL);
+        for (int32 row_index = 0; row_index < height; row_index++) {
+            generate_vertex_row(vertices + 3*((int64) row_index)*width,
+                                terrain.height_data + ((int64) row_index)*width, width, height, row_index);
+        }
+
+        real64 start_time = get_seconds();
+        generate_normals_from_face_normals(old_normals, vertices, face_normals, width, height);
+        real64 face_normal_seconds = get_seconds() - start_time;
+        terrain.normals = vertices;
+
+        Grid_Rect all_vertices = make_grid_rect(0, height - 1, 0, width - 1);
+        terrain_kernels = get_terrain_kernels(SIMD_LEVEL_SCALAR);
+        start_time = get_seconds();
+        generate_normal_rect(&terrain, all_vertices);
+        real64 scalar_seconds = get_seconds() - start_time;
+
+        terrain_kernels = saved_kernels;
+        start_time = get_seconds();
+        generate_normal_rect(&terrain, all_vertices);
+        real64 simd_seconds = get_seconds() - start_time;
+
+        // NOTE: how far the new normals are from the old ones, which only differ in how the slope is
+        //       estimated (and on the borders, which no longer wrap)
+        real64 total_angle = 0;
+        for (int64 vertex_index = 0; vertex_index < num_vertices; vertex_index++) {
+            glm::vec3 old_normal = glm::normalize(((glm::vec3 *) old_normals)[vertex_index]);
+            glm::vec3 new_normal = glm::normalize(((glm::vec3 *) terrain.normals)[vertex_index]);
+            real32 cos_angle = fminf(1.0f, glm::dot(old_normal, new_normal));
+            total_angle += acos(cos_angle);
+        }
+
+        printf("%-9d %14.4f %14.4f %14.4f %9.1fx %16.1f %18.4f\n", resolution_exponent, face_normal_seconds,
+               scalar_seconds, simd_seconds, face_normal_seconds / simd_seconds,
+               face_normals_size / (1024.0*1024.0), total_angle / num_vertices * 180.0 / 3.14159265358979);
+
+        free(vertices);
+        free(old_normals);
+        free(face_normals);
+        free(terrain.height_data);
+    }
+    printf("\n");
+
+    terrain_kernels = saved_kernels;
+    print_terrain_timings = saved_print_terrain_timings;
+    free(initial_terrain.low_res_height_data);
+}
+
+// NOTE: atan2 instead of acos of the dot product, which can't tell apart angles below about 0.05 degrees
+static real32 get_degrees_between(glm::vec3 a, glm::vec3 b) {
+    return atan2f(glm::length(glm::cross(a, b)), glm::dot(a, b)) * 180.0f / 3.14159265f;
+}
+
+// NOTE: how big the terrain's vertex buffer is in each vertex format and how long packing it takes, and how
+//       far what the vertex shaders decode (done here with the same math on the CPU) is from what
+//       build_terrain_mesh() made. also how accurate octahedral normals are over the whole sphere.
+void benchmark_vertex_formats(Terrain *terrain) {
+    int32 width = terrain->x_resolution;
+    int32 height = terrain->y_resolution;
+    int64 num_vertices = terrain->num_vertices;
+    Grid_Rect all_vertices = make_grid_rect(0, height - 1, 0, width - 1);
+    int64 full_size = num_vertices*get_vertex_format_size(VERTEX_FORMAT_FULL);
+
+    printf("\n%-14s %6s %9s %8s %13s %14s %14s %13s\n", "format", "bytes", "MB", "vs full", "pack seconds",
+           "position error", "UV error", "normal degrees");
+    for (int32 format_index = 0; format_index < VERTEX_FORMAT_COUNT; format_index++) {
+        Vertex_Format vertex_format = (Vertex_Format) format_index;
+        int64 size = num_vertices*get_vertex_format_size(vertex_format);
+        uint8 *vertices = (uint8 *) malloc(size);
+        real64 start_time = get_seconds();
+        if (vertex_format == VERTEX_FORMAT_FULL) {
+            memcpy(vertices, terrain->vertices, num_vertices * 3 * sizeof(real32));
+            memcpy(vertices + num_vertices * 3 * sizeof(real32), terrain->normals, num_vertices * 3 * sizeof(real32));
+            memcpy(vertices + num_vertices * 6 * sizeof(real32), terrain->uvs, num_vertices * 2 * sizeof(real32));
+        } else {
+            pack_terrain_vertex_rect(terrain, vertex_format, all_vertices, vertices);
+        }
+        real64 pack_seconds = get_seconds() - start_time;
+
+        real32 max_position_error = 0;
+        real32 max_uv_error = 0;
+        real32 max_normal_degrees = 0;
+        for (int32 vertex_index = 0; vertex_index < num_vertices; vertex_index++) {
+            glm::vec3 position, normal;
+            glm::vec2 uv;
+            decode_terrain_vertex(vertex_format, vertices, vertex_index, width, height, &position, &normal, &uv);
+            glm::vec3 position_error = glm::abs(position - ((glm::vec3 *) terrain->vertices)[vertex_index]);
+            glm::vec2 uv_error = glm::abs(uv - ((glm::vec2 *) terrain->uvs)[vertex_index]);
+            max_position_error = fmaxf(max_position_error,
+                                       fmaxf(position_error.x, fmaxf(position_error.y, position_error.z)));
+            max_uv_error = fmaxf(max_uv_error, fmaxf(uv_error.x, uv_error.y));
+            max_normal_degrees = fmaxf(max_normal_degrees,
+                                       get_degrees_between(normal, ((glm::vec3 *) terrain->normals)[vertex_index]));
+        }
+
+        printf("%-14s %6d %9.1f %7.1fx %13f %14g %14g %13f\n", get_vertex_format_name(vertex_format),
+               get_vertex_format_size(vertex_format), size / (1024.0*1024.0), (real64) full_size / size,
+               pack_seconds, max_position_error, max_uv_error, max_normal_degrees);
+        free(vertices);
+    }
+
+    // NOTE: normals spread evenly over the sphere (a Fibonacci spiral), including the lower half that terrain
+    //       normals hardly ever point into
+    int32 num_sphere_normals = 1 << 20;
+    real32 max_octahedral_degrees = 0;
+    real64 total_octahedral_degrees = 0;
+    for (int32 normal_index = 0; normal_index < num_sphere_normals; normal_index++) {
+        real32 y = 1.0f - 2.0f*(normal_index + 0.5f)/num_sphere_normals;
+        real32 radius = sqrtf(fmaxf(0.0f, 1.0f - y*y));
+        real32 angle = 2.39996323f*normal_index;
+        glm::vec3 normal = glm::vec3(radius*cosf(angle), y, radius*sinf(angle));
+        int16 encoded_normal[2];
+        encode_octahedral_normal(normal, encoded_normal);
+        real32 degrees = get_degrees_between(decode_octahedral_normal(encoded_normal), normal);
+        max_octahedral_degrees = fmaxf(max_octahedral_degrees, degrees);
+        total_octahedral_degrees += degrees;
+    }
+    printf("\nOctahedral normals over the sphere (%d normals): %f degrees off at most, %f on average.\n",
+           num_sphere_normals, max_octahedral_degrees, total_octahedral_degrees / num_sphere_normals);
+}
+
+static void print_vertex_cache_benchmark_row(char *name, int32 strip_quads, uint32 *indices, int64 num_indices,
+                                             int64 num_vertices, int32 cache_size, real64 seconds) {
+    Vertex_Cache_Stats fifo = simulate_vertex_cache(indices, num_indices, num_vertices, cache_size,
+                                                    VERTEX_CACHE_FIFO);
+    Vertex_Cache_Stats lru = simulate_vertex_cache(indices, num_indices, num_vertices, cache_size, VERTEX_CACHE_LRU);
+    char strip_text[16] = "-";
+    if (strip_quads > 0) {
+        sprintf(strip_text, "%d", strip_quads);
+    }
+    printf("%6d %-10s %6s %10f %10f %10f %10f %10f\n", cache_size, name, strip_text, fifo.acmr, fifo.atvr, lru.acmr,
+           lru.atvr, seconds);
+}
+
+// NOTE: how well the index orders use post-transform vertex caches of a few sizes, for one mesh chunk (every
+//       chunk draws with the same indices, see mesh_chunks.h). row order is what generate_grid_indices()
+//       makes, strips is what get_mesh_chunk_indices() uses, and tipsify is the general-purpose reordering
+//       for comparison. a grid can't do better than an ACMR of about 0.5 and an ATVR of 1.
+void benchmark_vertex_cache(int32 cells_per_chunk) {
+    int32 side = cells_per_chunk + 1;
+    int64 num_vertices = ((int64) side)*side;
+    int64 num_indices = ((int64) cells_per_chunk)*cells_per_chunk*6;
+    uint32 *row_indices = (uint32 *) malloc(num_indices * sizeof(uint32));
+    uint32 *indices = (uint32 *) malloc(num_indices * sizeof(uint32));
+    generate_grid_indices(row_indices, side, side);
+
+    printf("\n%dx%d quads, %lld triangles, %lld vertices\n", cells_per_chunk, cells_per_chunk,
+           (long long) (num_indices / 3), (long long) num_vertices);
+    printf("%6s %-10s %6s %10s %10s %10s %10s %10s\n", "cache", "order", "strip", "FIFO ACMR", "FIFO ATVR",
+           "LRU ACMR", "LRU ATVR", "seconds");
+    int32 num_cache_sizes = 5;
+    int32 cache_sizes[] = {8, 16, 24, 32, 64};
+    for (int32 cache_size_index = 0; cache_size_index < num_cache_sizes; cache_size_index++) {
+        int32 cache_size = cache_sizes[cache_size_index];
+        print_vertex_cache_benchmark_row((char *) "row", 0, row_indices, num_indices, num_vertices, cache_size, 0);
+
+        real64 start_time = get_seconds();
+        int32 strip_quads = optimize_grid_indices_for_vertex_cache(indices, side, side, cache_size);
+        real64 seconds = get_seconds() - start_time;
+        print_vertex_cache_benchmark_row((char *) "strips", strip_quads, indices, num_indices, num_vertices,
+                                         cache_size, seconds);
+
+        start_time = get_seconds();
+        tipsify_indices(row_indices, num_indices, num_vertices, cache_size, indices);
+        seconds = get_seconds() - start_time;
+        print_vertex_cache_benchmark_row((char *) "tipsify", 0, indices, num_indices, num_vertices, cache_size,
+                                         seconds);
+    }
+
+    free(row_indices);
+    free(indices);
+}
+
+// NOTE: how long building the RTIN error map (see rtin.h) takes, all of it and for a small edit, and how many
+//       triangles the meshes for a few error thresholds have and how long extracting them takes. the
+//       thresholds are fractions of the terrain's max height.
+void benchmark_rtin(Terrain *terrain) {
+    if (!can_use_rtin(terrain)) {
+        printf("RTIN needs a square (2^n+1)x(2^n+1) grid.\n");
+        return;
+    }
+    int32 size = terrain->x_resolution;
+    real32 *errors = (real32 *) malloc(terrain->num_vertices * sizeof(real32));
+    real64 start_time = get_seconds();
+    build_rtin_errors(errors, terrain->vertices + 1, 3, size);
+    real64 build_seconds = get_seconds() - start_time;
+
+    Grid_Rect edit_rect = clip_grid_rect(make_grid_rect(size/2 - 32, size/2 + 32, size/2 - 32, size/2 + 32),
+                                         size, size);
+    start_time = get_seconds();
+    build_rtin_error_rect(errors, terrain->vertices + 1, 3, size, edit_rect);
+    real64 edit_seconds = get_seconds() - start_time;
+    printf("\nBuilt the %dx%d RTIN error map in %f seconds, and rebuilt it for a 65x65 edit in %f seconds.\n",
+           size, size, build_seconds, edit_seconds);
+
+    // NOTE: small edits all over the grid, with the errors rebuilt for just the edit, against rebuilding all of
+    //       them. a rebuilt error that's too small would let the mesh crack.
+    real32 *vertices = (real32 *) malloc(terrain->num_vertices * 3 * sizeof(real32));
+    memcpy(vertices, terrain->vertices, terrain->num_vertices * 3 * sizeof(real32));
+    real32 *full_errors = (real32 *) malloc(terrain->num_vertices * sizeof(real32));
+    uint32 random_state = 1;
+    // NOTE: every edit is checked with a full rebuild, so there's fewer of them on big grids
+    int32 num_edits = (size <= 1025) ? 100 : 10;
+    int64 num_mismatches = 0;
+    for (int32 edit_index = 0; edit_index < num_edits; edit_index++) {
+        int32 edit_size = 1 + get_next_benchmark_random(&random_state) % 8;
+        int32 row_index = get_next_benchmark_random(&random_state) % size;
+        int32 column_index = get_next_benchmark_random(&random_state) % size;
+        Grid_Rect rect = clip_grid_rect(make_grid_rect(row_index, row_index + edit_size - 1, column_index,
+                                                       column_index + edit_size - 1), size, size);
+        for (int32 r = rect.min_row_index; r <= rect.max_row_index; r++) {
+            for (int32 c = rect.min_column_index; c <= rect.max_column_index; c++) {
+                real32 random = (get_next_benchmark_random(&random_state) % 1000) / 1000.0f - 0.5f;
+                vertices[3*(((int64) r)*size + c) + 1] += random*0.1f*terrain->max_height;
+            }
+        }
+        build_rtin_error_rect(errors, vertices + 1, 3, size, rect);
+        build_rtin_errors(full_errors, vertices + 1, 3, size);
+        for (int64 index = 0; index < terrain->num_vertices; index++) {
+            num_mismatches += (errors[index] != full_errors[index]);
+        }
+        memcpy(errors, full_errors, terrain->num_vertices * sizeof(real32));
+    }
+    printf("%lld errors differ from a full rebuild after %d random edits of up to 8x8 heights.\n",
+           (long long) num_mismatches, num_edits);
+    free(full_errors);
+    free(vertices);
+    build_rtin_errors(errors, terrain->vertices + 1, 3, size);
+
+    int64 num_grid_indices = get_max_rtin_indices(size);
+    uint32 *indices = (uint32 *) malloc(num_grid_indices * sizeof(uint32));
+    printf("%14s %12s %12s %10s %16s\n", "max error", "of height", "triangles", "of grid", "extract seconds");
+    int32 num_fractions = 7;
+    real32 fractions[] = {0.0f, 0.0005f, 0.001f, 0.005f, 0.01f, 0.05f, 0.1f};
+    for (int32 fraction_index = 0; fraction_index < num_fractions; fraction_index++) {
+        real32 max_error = fractions[fraction_index]*terrain->max_height;
+        start_time = get_seconds();
+        int64 num_indices = extract_rtin_mesh(errors, size, max_error, indices);
+        real64 extract_seconds = get_seconds() - start_time;
+        printf("%14f %11.2f%% %12lld %9.2f%% %16f\n", max_error, 100.0f*fractions[fraction_index],
+               (long long) (num_indices / 3), 100.0*num_indices / num_grid_indices, extract_seconds);
+    }
+
+    free(indices);
+    free(errors);
+}
+
+// NOTE: flies a camera over the terrain, the same camera main.cpp starts with, from near one corner to near
+//       the opposite one while looking ahead, and selects the LOD nodes every frame. the terrain has to
+//       have been built with use_lod.
+void benchmark_terrain_lod(Terrain *terrain, real32 max_pixel_error) {
+    Terrain_Lod *lod = terrain->lod;
+    Camera camera = {};
+    camera.window_width = 1280;
+    camera.window_height = 720;
+    camera.fov_y_degrees = 90.0f;
+    camera.near_y = 0.01f;
+    camera.far_y = 1000.0f;
+    camera.up = glm::vec3(0.0f, 1.0f, 0.0f);
+
+    int64 num_grid_triangles = ((int64) terrain->x_resolution - 1)*(terrain->y_resolution - 1)*2;
+    glm::vec3 start = glm::vec3(0.1f*terrain->world_x_size, 0.0f, -0.9f*terrain->world_y_size);
+    glm::vec3 end = glm::vec3(0.9f*terrain->world_x_size, 0.0f, -0.1f*terrain->world_y_size);
+    real32 camera_height = 0.6f*terrain->vertical_scale_factor*terrain->max_height;
+    camera.forward = glm::normalize(end - start);
+
+    printf("\n%dx%d terrain, %lld triangles, max error %f pixels\n", terrain->x_resolution, terrain->y_resolution,
+           (long long) num_grid_triangles, max_pixel_error);
+    printf("%6s %9s %9s %7s %7s %12s %9s %14s\n", "frame", "x", "z", "nodes", "culled", "triangles", "of grid",
+           "select seconds");
+    int32 num_frames = 120;
+    real64 total_seconds = 0;
+    int64 total_triangles = 0;
+    int64 max_triangles = 0;
+    for (int32 frame_index = 0; frame_index < num_frames; frame_index++) {
+        real32 t = (real32) frame_index / (num_frames - 1);
+        camera.position = start + t*(end - start);
+        camera.position.y = camera_height;
+
+        real64 start_time = get_seconds();
+        select_terrain_lod(lod, terrain, &camera, max_pixel_error);
+        real64 seconds = get_seconds() - start_time;
+        total_seconds += seconds;
+        total_triangles += lod->num_triangles;
+        max_triangles = (lod->num_triangles > max_triangles) ? lod->num_triangles : max_triangles;
+        if (frame_index % 10 == 0 || frame_index == num_frames - 1) {
+            printf("%6d %9.2f %9.2f %7d %7d %12lld %8.2f%% %14f\n", frame_index, camera.position.x,
+                   camera.position.z, lod->num_selected_nodes, lod->num_culled_draws, (long long) lod->num_triangles,
+                   100.0*lod->num_triangles / num_grid_triangles, seconds);
+        }
+    }
+    printf("Average %lld triangles (%.2f%% of the grid's), at most %lld, selected in %f seconds on average.\n",
+           (long long) (total_triangles / num_frames), 100.0*total_triangles / num_frames / num_grid_triangles,
+           (long long) max_triangles, total_seconds / num_frames);
+}
+
+// NOTE: flies the same path as benchmark_terrain_lod() and prints what the clipmap uploads every frame. the
+//       uploads also go into a copy of the textures, which is checked against the heights every frame.
+void benchmark_terrain_clipmap(Terrain *terrain, int32 quads) {
+    Terrain_Clipmap *clipmap = make_terrain_clipmap(terrain, quads);
+    int32 texture_size = clipmap->texture_size;
+    int64 level_texels = ((int64) texture_size)*texture_size;
+    real32 *textures = (real32 *) malloc(clipmap->num_levels*level_texels * sizeof(real32));
+
+    glm::vec3 start = glm::vec3(0.1f*terrain->world_x_size, 0.0f, -0.9f*terrain->world_y_size);
+    glm::vec3 end = glm::vec3(0.9f*terrain->world_x_size, 0.0f, -0.1f*terrain->world_y_size);
+    real32 cell_x_size = terrain->world_x_size / (terrain->x_resolution - 1);
+    real32 cell_y_size = terrain->world_y_size / (terrain->y_resolution - 1);
+    int64 num_triangles = 0;
+    for (int32 level_index = 0; level_index < clipmap->num_levels; level_index++) {
+        num_triangles += clipmap->patch_counts[(level_index == 0) ? CLIPMAP_HOLE_PATCHES : 0] / 3;
+    }
+
+    printf("\n%dx%d terrain, clipmap of %d levels of %dx%d quads: %lld triangles, %.2f MB on the GPU "
+           "(the heights alone are %.2f MB)\n", terrain->x_resolution, terrain->y_resolution, clipmap->num_levels,
+           quads, quads, (long long) num_triangles, get_terrain_clipmap_gpu_size(clipmap) / (1024.0*1024.0),
+           ((int64) terrain->x_resolution)*terrain->y_resolution*sizeof(real32) / (1024.0*1024.0));
+    printf("%6s %9s %9s %8s %10s %10s %14s\n", "frame", "x", "z", "uploads", "texels", "KB", "update seconds");
+    int32 num_frames = 120;
+    real64 total_seconds = 0;
+    int64 total_texels = 0;
+    int64 num_mismatches = 0;
+    for (int32 frame_index = 0; frame_index < num_frames; frame_index++) {
+        real32 t = (real32) frame_index / (num_frames - 1);
+        glm::vec3 position = start + t*(end - start);
+
+        real64 start_time = get_seconds();
+        update_terrain_clipmap(clipmap, terrain, position.z / cell_y_size + terrain->y_resolution - 1,
+                               position.x / cell_x_size);
+        real64 seconds = get_seconds() - start_time;
+        if (frame_index > 0) {
+            total_seconds += seconds;
+            total_texels += clipmap->num_upload_heights;
+        }
+
+        for (int32 upload_index = 0; upload_index < clipmap->num_uploads; upload_index++) {
+            Clipmap_Upload *upload = &clipmap->uploads[upload_index];
+            for (int32 row_index = 0; row_index < upload->height; row_index++) {
+                memcpy(textures + upload->level*level_texels + ((int64) upload->y + row_index)*texture_size + upload->x,
+                       upload->heights + ((int64) row_index)*upload->width, upload->width * sizeof(real32));
+            }
+        }
+        for (int32 level_index = 0; level_index < clipmap->num_levels; level_index++) {
+            Clipmap_Level *level = &clipmap->levels[level_index];
+            int32 first_row_index = level->origin_row_index / level->spacing;
+            int32 first_column_index = level->origin_column_index / level->spacing;
+            for (int32 row_index = first_row_index; row_index < first_row_index + texture_size; row_index++) {
+                real32 *texture_row = textures + level_index*level_texels +
+                                      ((int64) wrap_clipmap_index(row_index, texture_size))*texture_size;
+                for (int32 column_index = first_column_index; column_index < first_column_index + texture_size;
+                     column_index++) {
+                    real32 height = get_clipmap_source_height(terrain, row_index*level->spacing,
+                                                              column_index*level->spacing);
+                    num_mismatches += (texture_row[wrap_clipmap_index(column_index, texture_size)] != height);
+                }
+            }
+        }
+
+        if (frame_index % 10 == 0 || frame_index == num_frames - 1) {
+            printf("%6d %9.2f %9.2f %8d %10lld %10.1f %14f\n", frame_index, position.x, position.z,
+                   clipmap->num_uploads, (long long) clipmap->num_upload_heights,
+                   clipmap->num_upload_heights*sizeof(real32) / 1024.0, seconds);
+        }
+    }
+    printf("After the first frame, %.0f texels (%.1f KB) uploaded in %f seconds per frame on average. "
+           "%lld texels didn't match the heights.\n", (real64) total_texels / (num_frames - 1),
+           total_texels*sizeof(real32) / 1024.0 / (num_frames - 1), total_seconds / (num_frames - 1),
+           (long long) num_mismatches);
+
+    free(textures);
+    free_terrain_clipmap(clipmap);
+}
+
+// NOTE: flies the path of benchmark_terrain_lod() while turning all the way around, looking a bit down, and
+//       prints how much of the mesh cull_terrain_chunks() culls. it checks the culling against testing every
+//       chunk's box on its own, and every 10 frames, that every culled chunk has all its vertices outside one
+//       of the frustum's planes.
+void benchmark_terrain_culling(Terrain *terrain) {
+    Terrain_Culling *culling = terrain->culling;
+    Mesh_Chunk_Layout *mesh_chunks = &terrain->mesh_chunks;
+    Camera camera = {};
+    camera.window_width = 1280;
+    camera.window_height = 720;
+    camera.fov_y_degrees = 90.0f;
+    camera.near_y = 0.01f;
+    camera.far_y = 1000.0f;
+    camera.up = glm::vec3(0.0f, 1.0f, 0.0f);
+
+    glm::vec3 start = glm::vec3(0.1f*terrain->world_x_size, 0.0f, -0.9f*terrain->world_y_size);
+    glm::vec3 end = glm::vec3(0.9f*terrain->world_x_size, 0.0f, -0.1f*terrain->world_y_size);
+    real32 camera_height = 0.6f*terrain->vertical_scale_factor*terrain->max_height;
+    real32 pitch = -0.3f;
+    glm::vec3 scale = glm::vec3(terrain->world_x_size / (terrain->x_resolution - 1), terrain->vertical_scale_factor,
+                                terrain->world_y_size / (terrain->y_resolution - 1));
+    int32 last_row_index = terrain->y_resolution - 1;
+    bool32 *is_visible = (bool32 *) malloc(mesh_chunks->num_chunks * sizeof(bool32));
+
+    printf("\n%dx%d terrain, %d chunks in a culling quadtree of %d levels\n", terrain->x_resolution,
+           terrain->y_resolution, mesh_chunks->num_chunks, culling->num_levels);
+    printf("%6s %9s %9s %8s %8s %6s %9s %14s\n", "frame", "x", "z", "heading", "visible", "tests", "culled",
+           "cull seconds");
+    int32 num_frames = 120;
+    real64 total_seconds = 0;
+    int64 total_visible_chunks = 0;
+    int64 total_box_tests = 0;
+    int64 num_mismatches = 0;
+    int64 num_wrongly_culled = 0;
+    for (int32 frame_index = 0; frame_index < num_frames; frame_index++) {
+        real32 t = (real32) frame_index / (num_frames - 1);
+        real32 heading = 2.0f*glm::pi<real32>()*t;
+        camera.position = start + t*(end - start);
+        camera.position.y = camera_height;
+        camera.forward = glm::vec3(sinf(heading)*cosf(pitch), sinf(pitch), -cosf(heading)*cosf(pitch));
+
+        real64 start_time = get_seconds();
+        cull_terrain_chunks(culling, terrain, &camera);
+        real64 seconds = get_seconds() - start_time;
+        total_seconds += seconds;
+        total_visible_chunks += culling->num_visible_chunks;
+        total_box_tests += culling->num_box_tests;
+
+        memset(is_visible, 0, mesh_chunks->num_chunks * sizeof(bool32));
+        for (int32 visible_index = 0; visible_index < culling->num_visible_chunks; visible_index++) {
+            is_visible[culling->visible_chunks[visible_index]] = true;
+        }
+        Frustum frustum = make_frustum(get_camera_projection_matrix(&camera)*get_camera_view_matrix(&camera));
+        for (int32 chunk_index = 0; chunk_index < mesh_chunks->num_chunks; chunk_index++) {
+            Grid_Rect rect = get_mesh_chunk_rect(mesh_chunks, chunk_index);
+            Culling_Node_Bounds *bounds = &culling->levels[culling->chunk_level_index].nodes[chunk_index];
+            glm::vec3 box_min = glm::vec3(rect.min_column_index, bounds->min_height,
+                                          rect.min_row_index - last_row_index) * scale;
+            glm::vec3 box_max = glm::vec3(rect.max_column_index, bounds->max_height,
+                                          rect.max_row_index - last_row_index) * scale;
+            bool32 is_box_visible = (test_frustum_box(&frustum, box_min, box_max) != FRUSTUM_OUTSIDE);
+            num_mismatches += (is_box_visible != is_visible[chunk_index]);
+
+            if (frame_index % 10 != 0 || is_visible[chunk_index]) {
+                continue;
+            }
+            bool32 is_outside_a_plane = false;
+            for (int32 plane_index = 0; plane_index < 6 && !is_outside_a_plane; plane_index++) {
+                glm::vec4 plane = frustum.planes[plane_index];
+                is_outside_a_plane = true;
+                for (int32 row_index = rect.min_row_index; row_index <= rect.max_row_index && is_outside_a_plane;
+                     row_index++) {
+                    for (int32 column_index = rect.min_column_index; column_index <= rect.max_column_index;
+                         column_index++) {
+                        real32 height = terrain->vertices[3*(((int64) row_index)*terrain->x_resolution +
+                                                             column_index) + 1];
+                        glm::vec3 position = glm::vec3(column_index, height, row_index - last_row_index) * scale;
+                        if (glm::dot(glm::vec3(plane), position) + plane.w >= 0) {
+                            is_outside_a_plane = false;
+                            break;
+                        }
+                    }
+                }
+            }
+            num_wrongly_culled += !is_outside_a_plane;
+        }
+
+        if (frame_index % 10 == 0 || frame_index == num_frames - 1) {
+            printf("%6d %9.2f %9.2f %8.1f %8d %6d %8.2f%% %14f\n", frame_index, camera.position.x, camera.position.z,
+                   glm::degrees(heading), culling->num_visible_chunks, culling->num_box_tests,
+                   100.0 - 100.0*culling->num_visible_chunks / mesh_chunks->num_chunks, seconds);
+        }
+    }
+    printf("Culled %.2f%% of the triangles on average with %.1f box tests per frame (of %d chunks) in %f seconds.\n",
+           100.0 - 100.0*total_visible_chunks / ((real64) num_frames*mesh_chunks->num_chunks),
+           (real64) total_box_tests / num_frames, mesh_chunks->num_chunks, total_seconds / num_frames);
+    printf("%lld chunks differed from testing every chunk, %lld culled chunks weren't all outside one plane.\n",
+           (long long) num_mismatches, (long long) num_wrongly_culled);
+    free(is_visible);
+}
+
+// NOTE: walks the path of benchmark_terrain_lod() at eye height, turning all the way around, with occlusion
+//       culling, and prints how many of the chunks in the frustum it rejects. every 10 frames, it marches rays
+//       from the camera to some of the vertices in the frustum of every occluded chunk, and counts the ones that
+//       never go under the mesh. those would be visible, so there should be none.
+void benchmark_terrain_occlusion(Terrain *terrain) {
+    Terrain_Culling *culling = terrain->culling;
+    Mesh_Chunk_Layout *mesh_chunks = &terrain->mesh_chunks;
+    culling->use_occlusion = true;
+    Camera camera = {};
+    camera.window_width = 1280;
+    camera.window_height = 720;
+    camera.fov_y_degrees = 90.0f;
+    camera.near_y = 0.01f;
+    camera.far_y = 1000.0f;
+    camera.up = glm::vec3(0.0f, 1.0f, 0.0f);
+
+    glm::vec3 start = glm::vec3(0.1f*terrain->world_x_size, 0.0f, -0.9f*terrain->world_y_size);
+    glm::vec3 end = glm::vec3(0.9f*terrain->world_x_size, 0.0f, -0.1f*terrain->world_y_size);
+    real32 eye_height = 0.02f*terrain->max_height;
+    glm::vec3 scale = glm::vec3(terrain->world_x_size / (terrain->x_resolution - 1), terrain->vertical_scale_factor,
+                                terrain->world_y_size / (terrain->y_resolution - 1));
+    int32 last_row_index = terrain->y_resolution - 1;
+    bool32 *is_visible = (bool32 *) malloc(mesh_chunks->num_chunks * sizeof(bool32));
+    int32 *frustum_visible_chunks = (int32 *) malloc(mesh_chunks->num_chunks * sizeof(int32));
+
+    printf("\n%dx%d terrain, %d chunks, %dx%d occluders of %dx%d cells\n", terrain->x_resolution,
+           terrain->y_resolution, mesh_chunks->num_chunks,
+           culling->levels[culling->occluder_level_index].nodes_per_row,
+           culling->levels[culling->occluder_level_index].nodes_per_column,
+           culling->levels[culling->occluder_level_index].node_size,
+           culling->levels[culling->occluder_level_index].node_size);
+    printf("%6s %9s %9s %8s %8s %8s %9s %10s %17s\n", "frame", "x", "z", "heading", "frustum", "visible", "rejected",
+           "occluders", "occlusion seconds");
+    int32 num_frames = 120;
+    real64 total_seconds = 0;
+    int64 total_frustum_visible_chunks = 0;
+    int64 total_visible_chunks = 0;
+    int64 num_rays = 0;
+    int64 num_visible_rays = 0;
+    for (int32 frame_index = 0; frame_index < num_frames; frame_index++) {
+        real32 t = (real32) frame_index / (num_frames - 1);
+        real32 heading = 2.0f*glm::pi<real32>()*t;
+        camera.position = start + t*(end - start);
+        real32 camera_row = camera.position.z / scale.z + last_row_index;
+        real32 camera_column = camera.position.x / scale.x;
+        camera.position.y = (get_terrain_mesh_height(terrain, camera_row, camera_column) + eye_height) * scale.y;
+        camera.forward = glm::vec3(sinf(heading), 0.0f, -cosf(heading));
+
+        // NOTE: the chunks in the frustum, for checking the occluded ones
+        culling->use_occlusion = false;
+        cull_terrain_chunks(culling, terrain, &camera);
+        int32 num_frustum_visible_chunks = culling->num_visible_chunks;
+        memcpy(frustum_visible_chunks, culling->visible_chunks, num_frustum_visible_chunks * sizeof(int32));
+        culling->use_occlusion = true;
+        cull_terrain_chunks(culling, terrain, &camera);
+        total_seconds += culling->occlusion_seconds;
+        total_frustum_visible_chunks += culling->num_frustum_visible_chunks;
+        total_visible_chunks += culling->num_visible_chunks;
+
+        if (frame_index % 10 == 0) {
+            Frustum frustum = make_frustum(get_camera_projection_matrix(&camera)*get_camera_view_matrix(&camera));
+            memset(is_visible, 0, mesh_chunks->num_chunks * sizeof(bool32));
+            for (int32 visible_index = 0; visible_index < culling->num_visible_chunks; visible_index++) {
+                is_visible[culling->visible_chunks[visible_index]] = true;
+            }
+            int32 vertex_step = (mesh_chunks->cells_per_chunk >= 16) ? mesh_chunks->cells_per_chunk / 8 : 1;
+            for (int32 visible_index = 0; visible_index < num_frustum_visible_chunks; visible_index++) {
+                int32 chunk_index = frustum_visible_chunks[visible_index];
+                if (is_visible[chunk_index]) {
+                    continue;
+                }
+                Grid_Rect rect = get_mesh_chunk_rect(mesh_chunks, chunk_index);
+                for (int32 row_index = rect.min_row_index; row_index <= rect.max_row_index; row_index += vertex_step) {
+                    for (int32 column_index = rect.min_column_index; column_index <= rect.max_column_index;
+                         column_index += vertex_step) {
+                        // NOTE: only the vertices in the frustum can be seen
+                        real32 target_height = terrain->vertices[3*(((int64) row_index)*terrain->x_resolution +
+                                                                    column_index) + 1];
+                        glm::vec3 target = glm::vec3(column_index, target_height, row_index - last_row_index) * scale;
+                        if (test_frustum_box(&frustum, target, target) == FRUSTUM_OUTSIDE) {
+                            continue;
+                        }
+
+                        // NOTE: in cells and heights. the last half cell before the vertex is skipped, where the
+                        //       ray is about as high as the mesh anyway.
+                        real32 camera_height = camera.position.y / scale.y;
+                        real32 row_distance = row_index - camera_row;
+                        real32 column_distance = column_index - camera_column;
+                        int32 num_steps = 4*(int32) ceilf(fmaxf(fabsf(row_distance), fabsf(column_distance))) + 2;
+                        bool32 is_hidden = false;
+                        for (int32 step_index = 1; step_index < num_steps - 2 && !is_hidden; step_index++) {
+                            real32 s = (real32) step_index / num_steps;
+                            real32 ray_height = camera_height + s*(target_height - camera_height);
+                            real32 mesh_height = get_terrain_mesh_height(terrain, camera_row + s*row_distance,
+                                                                 camera_column + s*column_distance);
+                            is_hidden = (ray_height < mesh_height - 1e-4f*terrain->max_height);
+                        }
+                        num_rays++;
+                        num_visible_rays += !is_hidden;
+                    }
+                }
+            }
+        }
+
+        if (frame_index % 10 == 0 || frame_index == num_frames - 1) {
+            printf("%6d %9.2f %9.2f %8.1f %8d %8d %8.2f%% %10d %17f\n", frame_index, camera.position.x,
+                   camera.position.z, glm::degrees(heading), culling->num_frustum_visible_chunks,
+                   culling->num_visible_chunks,
+                   100.0 - 100.0*culling->num_visible_chunks / fmax(culling->num_frustum_visible_chunks, 1),
+                   culling->num_occluder_triangles, culling->occlusion_seconds);
+        }
+    }
+    printf("Rejected %.2f%% of the chunks in the frustum on average (%.1f of %.1f), in %f seconds per frame.\n",
+           100.0 - 100.0*total_visible_chunks / fmax((real64) total_frustum_visible_chunks, 1),
+           (real64) (total_frustum_visible_chunks - total_visible_chunks) / num_frames,
+           (real64) total_frustum_visible_chunks / num_frames, total_seconds / num_frames);
+    printf("%lld of %lld rays to vertices of occluded chunks didn't go under the mesh.\n", (long long) num_visible_rays,
+           (long long) num_rays);
+    culling->use_occlusion = false;
+    free(is_visible);
+    free(frustum_visible_chunks);
+}
+
+static void free_benchmark_terrain_mesh(Terrain *terrain) {
+    free(terrain->vertices);
+    free(terrain->normals);
+    free(terrain->uvs);
+    free(terrain->low_res_vertices);
+    free(terrain->low_res_indices);
+    free_terrain_culling(terrain->culling);
+}
+
+// NOTE: builds the mesh in every vertex format twice, the way the viewer used to fill its vertex buffer, with
+//       a staging copy in chunk order that glBufferData() then copies again, and with a vertex writer that
+//       build_terrain_mesh() writes the chunk-major buffer into as it goes. here the writer writes into plain
+//       memory, which stands in for the mapped GL buffer, and the two buffers have to be the same. the MB are
+//       of what's allocated on the CPU besides the buffer itself. the terrain's heights have to have been
+//       generated, and are only read.
+void benchmark_vertex_writer(Terrain *terrain, Work_Queue *work_queue) {
+    bool32 saved_print_terrain_timings = print_terrain_timings;
+    print_terrain_timings = false;
+
+    printf("\n%-14s %10s %15s %15s %10s %10s %10s\n", "format", "buffer MB", "staged seconds", "direct seconds",
+           "staged MB", "direct MB", "identical");
+    for (int32 format_index = 0; format_index < VERTEX_FORMAT_COUNT; format_index++) {
+        Vertex_Format vertex_format = (Vertex_Format) format_index;
+        Terrain staged_terrain = *terrain;
+        staged_terrain.vertex_format = vertex_format;
+        staged_terrain.use_rtin = false;
+        staged_terrain.use_lod = false;
+        staged_terrain.vertex_writer = NULL;
+        Terrain direct_terrain = staged_terrain;
+
+        real64 start_time = get_seconds();
+        build_terrain_mesh(&staged_terrain, work_queue);
+        Mesh_Chunk_Layout *mesh_chunks = &staged_terrain.mesh_chunks;
+        int64 buffer_size = get_terrain_vertex_buffer_size(&staged_terrain);
+        uint8 *staged_vertices = (uint8 *) malloc(buffer_size);
+        if (vertex_format == VERTEX_FORMAT_FULL) {
+            uint8 *normals = staged_vertices + mesh_chunks->num_vertices * 3 * sizeof(real32);
+            uint8 *uvs = normals + mesh_chunks->num_vertices * 3 * sizeof(real32);
+            gather_mesh_chunk_vertices(mesh_chunks, staged_terrain.vertices, 3 * sizeof(real32), staged_vertices);
+            gather_mesh_chunk_vertices(mesh_chunks, staged_terrain.normals, 3 * sizeof(real32), normals);
+            gather_mesh_chunk_vertices(mesh_chunks, staged_terrain.uvs, 2 * sizeof(real32), uvs);
+        } else {
+            void *packed_vertices = malloc(staged_terrain.num_vertices*get_vertex_format_size(vertex_format));
+            pack_terrain_vertex_rect(&staged_terrain, vertex_format,
+                                     make_grid_rect(0, staged_terrain.y_resolution - 1,
+                                                    0, staged_terrain.x_resolution - 1), packed_vertices);
+            gather_mesh_chunk_vertices(mesh_chunks, packed_vertices, get_vertex_format_size(vertex_format),
+                                       staged_vertices);
+            free(packed_vertices);
+        }
+        real64 staged_seconds = get_seconds() - start_time;
+        int64 num_vertices = staged_terrain.num_vertices;
+        free_benchmark_terrain_mesh(&staged_terrain);
+
+        Mesh_Vertex_Writer writer = make_memory_mesh_vertex_writer();
+        direct_terrain.vertex_writer = &writer;
+        start_time = get_seconds();
+        build_terrain_mesh(&direct_terrain, work_queue);
+        real64 direct_seconds = get_seconds() - start_time;
+
+        // NOTE: the CPU-side positions, normals and UVs (which the direct build doesn't keep), and for the
+        //       staged build the packed vertices and the staging copy. the direct build packs into the buffer.
+        int64 packed_size = (vertex_format == VERTEX_FORMAT_FULL) ? 0 :
+                            num_vertices*get_vertex_format_size(vertex_format);
+        int64 staged_size = num_vertices * 8 * sizeof(real32) + packed_size + buffer_size;
+        int64 direct_size = num_vertices * 6 * sizeof(real32);
+        bool32 identical = memcmp(staged_vertices, writer.data, buffer_size) == 0;
+        printf("%-14s %10.1f %15f %15f %10.1f %10.1f %10s\n", get_vertex_format_name(vertex_format),
+               buffer_size / (1024.0*1024.0), staged_seconds, direct_seconds, staged_size / (1024.0*1024.0),
+               direct_size / (1024.0*1024.0), identical ? "yes" : "NO");
+
+        free(staged_vertices);
+        free(writer.data);
+        free_benchmark_terrain_mesh(&direct_terrain);
+    }
+    print_terrain_timings = saved_print_terrain_timings;
+}
+
+static void copy_grid_rect(real32 *grid_values, int32 width, int32 values_per_vertex, Grid_Rect rect, real32 *out) {
+    int32 rect_width = rect.max_column_index - rect.min_column_index + 1;
+    for (int32 row_index = rect.min_row_index; row_index <= rect.max_row_index; row_index++) {
+        memcpy(out, grid_values + values_per_vertex*(((int64) row_index)*width + rect.min_column_index),
+               rect_width*values_per_vertex*sizeof(real32));
+        out += rect_width*values_per_vertex;
+    }
+}
+
+static int64 count_grid_rect_differences(real32 *grid_values, int32 width, int32 values_per_vertex, Grid_Rect rect,
+                                         real32 *values) {
+    int64 rect_size = ((int64) rect.max_row_index - rect.min_row_index + 1)*
+                      (rect.max_column_index - rect.min_column_index + 1)*values_per_vertex;
+    real32 *rect_values = (real32 *) malloc(rect_size*sizeof(real32));
+    copy_grid_rect(grid_values, width, values_per_vertex, rect, rect_values);
+    int64 num_differences = 0;
+    for (int64 index = 0; index < rect_size; index++) {
+        num_differences += (rect_values[index] != values[index]);
+    }
+    free(rect_values);
+    return num_differences;
+}
+
+// NOTE: a stroke of every brush mode across the middle of the terrain, a dab per 60 Hz frame, and prints how long
+//       the dabs take, including regenerating the vertices and normals around them. then it checks that
+//         - nothing changed outside the strokes' rects
+//         - the normals updated a dab at a time are the same as generating them again over the whole area
+//         - undoing every stroke gives back exactly the heights, vertices and normals from before
+//         - redoing them gives back exactly the sculpted heights
+//       the terrain has to have been through build_terrain_mesh().
+void benchmark_terrain_sculpt(Terrain *terrain) {
+    int32 width = terrain->x_resolution;
+    int32 height = terrain->y_resolution;
+    int64 num_heights = ((int64) width)*height;
+    real32 frame_seconds = 1.0f / 60.0f;
+    int32 num_dabs = 60;
+    real32 dab_spacing = 2.0f;
+    real32 stroke_spacing = 40.0f;
+    Terrain_Brush brush = {};
+    brush.radius = 48.0f;
+    real32 center_row = 0.5f*(height - 1);
+    real32 center_column = 0.5f*(width - 1);
+    real32 stroke_length = dab_spacing*(num_dabs - 1);
+
+    // NOTE: everything the strokes can change, and the normals around that
+    int32 reach = (int32) ceilf(fmaxf(1.5f*stroke_spacing, 0.5f*stroke_length) + brush.radius) + 1;
+    Grid_Rect area = clip_grid_rect(make_grid_rect((int32) center_row - reach, (int32) center_row + reach,
+                                                   (int32) center_column - reach, (int32) center_column + reach),
+                                    width, height);
+    int64 area_size = ((int64) area.max_row_index - area.min_row_index + 1)*
+                      (area.max_column_index - area.min_column_index + 1);
+    real32 *original_heights = (real32 *) malloc(num_heights*sizeof(real32));
+    memcpy(original_heights, terrain->height_data, num_heights*sizeof(real32));
+    real32 *original_vertices = (real32 *) malloc(area_size*3*sizeof(real32));
+    real32 *original_normals = (real32 *) malloc(area_size*3*sizeof(real32));
+    copy_grid_rect(terrain->vertices, width, 3, area, original_vertices);
+    copy_grid_rect(terrain->normals, width, 3, area, original_normals);
+
+    Terrain_Sculpt *sculpt = make_terrain_sculpt(terrain);
+    char *mode_names[] = {"raise", "lower", "smooth", "flatten"};
+    brush.strength = 0.05f*terrain->max_height;
+    printf("\n%dx%d grid, brush radius %.0f cells, a dab every %.1f ms\n", width, height, brush.radius,
+           1000.0f*frame_seconds);
+    printf("%-8s %6s %12s %12s %14s %14s %12s\n", "mode", "dabs", "mean ms", "max ms", "heights/dab",
+           "uploaded KB", "history MB");
+    real64 max_dab_seconds = 0;
+    for (int32 mode_index = 0; mode_index < BRUSH_MODE_COUNT; mode_index++) {
+        brush.mode = (Brush_Mode) mode_index;
+        if (brush.mode == BRUSH_SMOOTH || brush.mode == BRUSH_FLATTEN) {
+            brush.strength = 20.0f;
+        }
+        real32 row = center_row + (mode_index - 1.5f)*stroke_spacing;
+        real32 column = center_column - 0.5f*stroke_length;
+        begin_sculpt_stroke(sculpt, terrain, row, column);
+        real64 total_seconds = 0;
+        real64 stroke_max_seconds = 0;
+        int64 num_changed_heights = 0;
+        int64 num_uploaded_bytes = 0;
+        for (int32 dab_index = 0; dab_index < num_dabs; dab_index++) {
+            Terrain_Update update;
+            real64 start_time = get_seconds();
+            bool32 changed = apply_terrain_brush(sculpt, terrain, &brush, row, column + dab_index*dab_spacing,
+                                                 frame_seconds, &update);
+            real64 seconds = get_seconds() - start_time;
+            total_seconds += seconds;
+            stroke_max_seconds = fmax(stroke_max_seconds, seconds);
+            if (changed) {
+                int64 num_rect_heights = ((int64) update.heights.max_row_index - update.heights.min_row_index + 1)*
+                                         (update.heights.max_column_index - update.heights.min_column_index + 1);
+                int64 num_rect_normals = ((int64) update.normals.max_row_index - update.normals.min_row_index + 1)*
+                                         (update.normals.max_column_index - update.normals.min_column_index + 1);
+                num_changed_heights += num_rect_heights;
+                // NOTE: the positions and normals of VERTEX_FORMAT_FULL
+                num_uploaded_bytes += (num_rect_heights + num_rect_normals)*3*sizeof(real32);
+            }
+        }
+        end_sculpt_stroke(sculpt);
+        max_dab_seconds = fmax(max_dab_seconds, stroke_max_seconds);
+        printf("%-8s %6d %12.3f %12.3f %14lld %14.1f %12.2f\n", mode_names[mode_index], num_dabs,
+               1000.0*total_seconds / num_dabs, 1000.0*stroke_max_seconds, (long long) (num_changed_heights / num_dabs),
+               num_uploaded_bytes / 1024.0 / num_dabs, get_terrain_sculpt_history_size(sculpt) / (1024.0*1024.0));
+    }
+    printf("The slowest dab took %.2f ms, %.0f%% of a frame.\n", 1000.0*max_dab_seconds,
+           100.0*max_dab_seconds / frame_seconds);
+
+    // NOTE: outside the strokes' rects, nothing should have changed
+    int64 num_changed_outside = 0;
+    for (int32 row_index = 0; row_index < height; row_index++) {
+        for (int32 column_index = 0; column_index < width; column_index++) {
+            int64 index = ((int64) row_index)*width + column_index;
+            if (terrain->height_data[index] == original_heights[index]) {
+                continue;
+            }
+            bool32 is_in_stroke = false;
+            for (int32 stroke_index = 0; stroke_index < sculpt->num_strokes; stroke_index++) {
+                Grid_Rect rect = sculpt->strokes[stroke_index].rect;
+                is_in_stroke = is_in_stroke || (row_index >= rect.min_row_index && row_index <= rect.max_row_index &&
+                                                column_index >= rect.min_column_index &&
+                                                column_index <= rect.max_column_index);
+            }
+            num_changed_outside += !is_in_stroke;
+        }
+    }
+
+    // NOTE: the normals from the dabs, against generating them all again
+    real32 *sculpted_heights = (real32 *) malloc(area_size*sizeof(real32));
+    real32 *sculpted_normals = (real32 *) malloc(area_size*3*sizeof(real32));
+    copy_grid_rect(terrain->height_data, width, 1, area, sculpted_heights);
+    copy_grid_rect(terrain->normals, width, 3, area, sculpted_normals);
+    generate_normal_rect(terrain, area);
+    int64 num_normal_differences = count_grid_rect_differences(terrain->normals, width, 3, area, sculpted_normals);
+
+    int32 num_strokes = sculpt->num_strokes;
+    Terrain_Update update;
+    real64 start_time = get_seconds();
+    while (undo_sculpt_stroke(sculpt, terrain, &update)) {
+    }
+    real64 undo_seconds = get_seconds() - start_time;
+    int64 num_undo_height_differences = 0;
+    for (int64 index = 0; index < num_heights; index++) {
+        num_undo_height_differences += (terrain->height_data[index] != original_heights[index]);
+    }
+    int64 num_undo_vertex_differences = count_grid_rect_differences(terrain->vertices, width, 3, area,
+                                                                    original_vertices);
+    int64 num_undo_normal_differences = count_grid_rect_differences(terrain->normals, width, 3, area,
+                                                                    original_normals);
+
+    start_time = get_seconds();
+    while (redo_sculpt_stroke(sculpt, terrain, &update)) {
+    }
+    real64 redo_seconds = get_seconds() - start_time;
+    int64 num_redo_height_differences = count_grid_rect_differences(terrain->height_data, width, 1, area,
+                                                                    sculpted_heights);
+
+    printf("Heights changed outside the strokes' rects: %lld. Normals that differ from generating them again: "
+           "%lld.\n", (long long) num_changed_outside, (long long) num_normal_differences);
+    printf("Undid %d strokes in %f seconds: %lld heights, %lld vertex and %lld normal floats differ from before.\n",
+           num_strokes, undo_seconds, (long long) num_undo_height_differences, (long long) num_undo_vertex_differences,
+           (long long) num_undo_normal_differences);
+    printf("Redid them in %f seconds: %lld heights differ from the sculpted ones.\n", redo_seconds,
+           (long long) num_redo_height_differences);
+
+    // NOTE: a control height edit next to the strokes, which isn't in the history, and then undoing them. the
+    //       edit should stay outside the strokes' rects, and the vertices and normals should still match the
+    //       heights everywhere.
+    int32 low_res_row_index = (terrain->max_y - 1) / 2;
+    int32 low_res_column_index = (terrain->max_x - 1) / 2;
+    int64 low_res_height_index = ((int64) low_res_row_index)*terrain->max_x + low_res_column_index;
+    real32 old_control_height = terrain->low_res_height_data[low_res_height_index];
+    update_control_height(terrain, low_res_row_index, low_res_column_index,
+                          old_control_height + 0.25f*terrain->max_height, NULL);
+    real32 *edited_heights = (real32 *) malloc(num_heights*sizeof(real32));
+    memcpy(edited_heights, terrain->height_data, num_heights*sizeof(real32));
+    Grid_Rect stroke_rects[MAX_SCULPT_STROKES];
+    for (int32 stroke_index = 0; stroke_index < sculpt->num_strokes; stroke_index++) {
+        stroke_rects[stroke_index] = sculpt->strokes[stroke_index].rect;
+    }
+    while (undo_sculpt_stroke(sculpt, terrain, &update)) {
+    }
+    int64 num_control_edit_differences = 0;
+    int64 num_vertex_height_differences = 0;
+    for (int32 row_index = 0; row_index < height; row_index++) {
+        for (int32 column_index = 0; column_index < width; column_index++) {
+            int64 index = ((int64) row_index)*width + column_index;
+            num_vertex_height_differences += (terrain->vertices[3*index + 1] != terrain->height_data[index]);
+            bool32 is_in_stroke = false;
+            for (int32 stroke_index = 0; stroke_index < num_strokes; stroke_index++) {
+                Grid_Rect rect = stroke_rects[stroke_index];
+                is_in_stroke = is_in_stroke || (row_index >= rect.min_row_index && row_index <= rect.max_row_index &&
+                                                column_index >= rect.min_column_index &&
+                                                column_index <= rect.max_column_index);
+            }
+            num_control_edit_differences += (!is_in_stroke && terrain->height_data[index] != edited_heights[index]);
+        }
+    }
+    Grid_Rect all_vertices = make_grid_rect(0, height - 1, 0, width - 1);
+    real32 *undone_normals = (real32 *) malloc(num_heights*3*sizeof(real32));
+    memcpy(undone_normals, terrain->normals, num_heights*3*sizeof(real32));
+    generate_normal_rect(terrain, all_vertices);
+    int64 num_undone_normal_differences = count_grid_rect_differences(terrain->normals, width, 3, all_vertices,
+                                                                      undone_normals);
+    printf("Undid them after a control height edit: %lld heights outside the strokes' rects lost the edit, %lld "
+           "vertices and %lld normal floats don't match the heights.\n\n", (long long) num_control_edit_differences,
+           (long long) num_vertex_height_differences, (long long) num_undone_normal_differences);
+    update_control_height(terrain, low_res_row_index, low_res_column_index, old_control_height, NULL);
+    free(undone_normals);
+    free(edited_heights);
+
+    free_terrain_sculpt(sculpt);
+    free(sculpted_normals);
+    free(sculpted_heights);
+    free(original_normals);
+    free(original_vertices);
+    free(original_heights);
+}
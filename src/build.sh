@@ -0,0 +1,8 @@
+#!/bin/sh
+# NOTE: builds the command-line terrain generator. the viewer (main.cpp) needs Windows, see build.bat.
+
+CommonCompilerFlags="-std=c++11 -O2 -g -Wall -Wno-write-strings -Wno-unused-variable -Wno-unused-but-set-variable"
+
+mkdir -p ../build
+cd ../build
+c++ $CommonCompilerFlags ../src/terrain_gen.cpp -o terrain_gen -lpthread
@@ -0,0 +1,201 @@
+#include "main.h"
+#include "grid.h"
+#include "terrain.h"
+#include "clipmap.h"
+
+// NOTE: (quads + 1)^2 vertices have to fit in 16-bit indices, and the next level's window is quads/2 of
+//       this level's quads, a quarter of the way in or one more, so quads has to be a multiple of 4
+Terrain_Clipmap *make_terrain_clipmap(Terrain *terrain, int32 quads) {
+    assert(quads >= 4 && quads <= MAX_CLIPMAP_QUADS && quads % 4 == 0);
+    Terrain_Clipmap *clipmap = (Terrain_Clipmap *) calloc(1, sizeof(Terrain_Clipmap));
+    clipmap->quads = quads;
+    clipmap->texture_size = quads + 1;
+
+    // NOTE: enough levels for the coarsest to cover the whole grid from anywhere on it
+    int32 grid_cells = terrain->x_resolution - 1;
+    if (grid_cells < terrain->y_resolution - 1) {
+        grid_cells = terrain->y_resolution - 1;
+    }
+    clipmap->num_levels = 1;
+    while (((int64) quads << (clipmap->num_levels - 1)) < 2*grid_cells && clipmap->num_levels < MAX_CLIPMAP_LEVELS) {
+        clipmap->num_levels++;
+    }
+    for (int32 level_index = 0; level_index < clipmap->num_levels; level_index++) {
+        clipmap->levels[level_index].spacing = 1 << level_index;
+    }
+
+    // NOTE: the ring meshes, split the same way as generate_grid_indices()
+    int32 vertices_per_side = clipmap->texture_size;
+    clipmap->indices = (uint16 *) malloc(CLIPMAP_PATCHES*quads*quads*6 * sizeof(uint16));
+    for (int32 patch_index = 0; patch_index < CLIPMAP_PATCHES; patch_index++) {
+        int32 hole_size = (patch_index < CLIPMAP_HOLE_PATCHES) ? quads / 2 : 0;
+        int32 hole_row_offset = quads/4 + (patch_index >> 1);
+        int32 hole_column_offset = quads/4 + (patch_index & 1);
+        clipmap->patch_offsets[patch_index] = clipmap->num_indices;
+        uint16 *indices = clipmap->indices + clipmap->num_indices;
+        int32 num_indices = 0;
+        for (int32 row_index = 0; row_index < quads; row_index++) {
+            for (int32 column_index = 0; column_index < quads; column_index++) {
+                if (row_index >= hole_row_offset && row_index < hole_row_offset + hole_size &&
+                    column_index >= hole_column_offset && column_index < hole_column_offset + hole_size) {
+                    continue;
+                }
+                uint16 top_left = (uint16) (row_index*vertices_per_side + column_index);
+                uint16 bottom_left = (uint16) (top_left + vertices_per_side);
+                indices[num_indices++] = bottom_left + 1;
+                indices[num_indices++] = top_left + 1;
+                indices[num_indices++] = top_left;
+                indices[num_indices++] = bottom_left + 1;
+                indices[num_indices++] = top_left;
+                indices[num_indices++] = bottom_left;
+            }
+        }
+        clipmap->patch_counts[patch_index] = num_indices;
+        clipmap->num_indices += num_indices;
+    }
+
+    // NOTE: a moved window uploads at most two strips, and each can wrap around both edges of the texture
+    clipmap->uploads = (Clipmap_Upload *) malloc(clipmap->num_levels*8 * sizeof(Clipmap_Upload));
+    clipmap->upload_heights = (real32 *) malloc(((int64) clipmap->num_levels)*clipmap->texture_size*
+                                                clipmap->texture_size * sizeof(real32));
+    return clipmap;
+}
+
+void free_terrain_clipmap(Terrain_Clipmap *clipmap) {
+    free(clipmap->indices);
+    free(clipmap->uploads);
+    free(clipmap->upload_heights);
+    free(clipmap);
+}
+
+// NOTE: the height textures and the ring meshes
+int64 get_terrain_clipmap_gpu_size(Terrain_Clipmap *clipmap) {
+    return ((int64) clipmap->num_levels)*clipmap->texture_size*clipmap->texture_size*sizeof(real32) +
+           clipmap->num_indices*sizeof(uint16);
+}
+
+// NOTE: outside the grid, the height at the closest edge
+inline real32 get_clipmap_source_height(Terrain *terrain, int32 row_index, int32 column_index) {
+    row_index = Clamp_Boundary::resolve(row_index, terrain->y_resolution);
+    column_index = Clamp_Boundary::resolve(column_index, terrain->x_resolution);
+    if (terrain->quantized_heights) {
+        return get_quantized_height(terrain->quantized_heights, row_index, column_index);
+    }
+    return get_height(terrain, row_index, column_index);
+}
+
+inline int32 wrap_clipmap_index(int32 sample_index, int32 texture_size) {
+    int32 texel_index = sample_index % texture_size;
+    return (texel_index < 0) ? texel_index + texture_size : texel_index;
+}
+
+// NOTE: queues the samples [first_row_index, first_row_index + num_rows) x [first_column_index, ...) of a
+//       level, in samples, as up to four uploads that don't wrap around the texture
+static void add_clipmap_uploads(Terrain_Clipmap *clipmap, Terrain *terrain, int32 level_index,
+                                int32 first_row_index, int32 num_rows, int32 first_column_index, int32 num_columns) {
+    int32 texture_size = clipmap->texture_size;
+    int32 spacing = clipmap->levels[level_index].spacing;
+    int32 row_index = first_row_index;
+    while (row_index < first_row_index + num_rows) {
+        int32 y = wrap_clipmap_index(row_index, texture_size);
+        int32 height = first_row_index + num_rows - row_index;
+        if (height > texture_size - y) {
+            height = texture_size - y;
+        }
+        int32 column_index = first_column_index;
+        while (column_index < first_column_index + num_columns) {
+            int32 x = wrap_clipmap_index(column_index, texture_size);
+            int32 width = first_column_index + num_columns - column_index;
+            if (width > texture_size - x) {
+                width = texture_size - x;
+            }
+
+            Clipmap_Upload *upload = &clipmap->uploads[clipmap->num_uploads++];
+            upload->level = level_index;
+            upload->x = x;
+            upload->y = y;
+            upload->width = width;
+            upload->height = height;
+            upload->heights = clipmap->upload_heights + clipmap->num_upload_heights;
+            real32 *heights = upload->heights;
+            for (int32 upload_row_index = 0; upload_row_index < height; upload_row_index++) {
+                for (int32 upload_column_index = 0; upload_column_index < width; upload_column_index++) {
+                    *heights++ = get_clipmap_source_height(terrain, (row_index + upload_row_index)*spacing,
+                                                           (column_index + upload_column_index)*spacing);
+                }
+            }
+            clipmap->num_upload_heights += ((int64) width)*height;
+            column_index += width;
+        }
+        row_index += height;
+    }
+}
+
+// NOTE: moves the windows to the camera (in cells, like the vertices' x and row_index) and fills in uploads
+//       with the samples that came into them. a window only moves when the camera has moved a whole sample
+//       of the next level, so most frames upload nothing.
+void update_terrain_clipmap(Terrain_Clipmap *clipmap, Terrain *terrain, real32 camera_row, real32 camera_column) {
+    clipmap->num_uploads = 0;
+    clipmap->num_upload_heights = 0;
+    int32 quads = clipmap->quads;
+    int32 texture_size = clipmap->texture_size;
+    for (int32 level_index = 0; level_index < clipmap->num_levels; level_index++) {
+        Clipmap_Level *level = &clipmap->levels[level_index];
+        int32 spacing = level->spacing;
+        int32 snap = 2*spacing;
+        int32 origin_row_index = (int32) floorf((camera_row - 0.5f*quads*spacing) / snap)*snap;
+        int32 origin_column_index = (int32) floorf((camera_column - 0.5f*quads*spacing) / snap)*snap;
+
+        // NOTE: in samples
+        int32 first_row_index = origin_row_index / spacing;
+        int32 first_column_index = origin_column_index / spacing;
+        int32 row_shift = first_row_index - level->origin_row_index / spacing;
+        int32 column_shift = first_column_index - level->origin_column_index / spacing;
+        if (!level->is_resident || abs(row_shift) >= texture_size || abs(column_shift) >= texture_size) {
+            add_clipmap_uploads(clipmap, terrain, level_index, first_row_index, texture_size,
+                                first_column_index, texture_size);
+        } else if (row_shift != 0 || column_shift != 0) {
+            // NOTE: the rows that came in, all the way across, then the columns that came in, in the rest
+            //       of the rows
+            int32 num_new_rows = abs(row_shift);
+            int32 first_old_row_index = first_row_index;
+            if (row_shift > 0) {
+                add_clipmap_uploads(clipmap, terrain, level_index, first_row_index + texture_size - num_new_rows,
+                                    num_new_rows, first_column_index, texture_size);
+            } else if (row_shift < 0) {
+                add_clipmap_uploads(clipmap, terrain, level_index, first_row_index, num_new_rows,
+                                    first_column_index, texture_size);
+                first_old_row_index += num_new_rows;
+            }
+            int32 num_new_columns = abs(column_shift);
+            if (num_new_columns > 0) {
+                int32 new_column_index = (column_shift > 0) ? first_column_index + texture_size - num_new_columns :
+                                                              first_column_index;
+                add_clipmap_uploads(clipmap, terrain, level_index, first_old_row_index, texture_size - num_new_rows,
+                                    new_column_index, num_new_columns);
+            }
+        }
+        level->origin_row_index = origin_row_index;
+        level->origin_column_index = origin_column_index;
+        level->is_resident = true;
+    }
+
+    // NOTE: where the holes go
+    for (int32 level_index = 0; level_index < clipmap->num_levels; level_index++) {
+        Clipmap_Level *level = &clipmap->levels[level_index];
+        if (level_index == 0) {
+            level->hole_row_offset = 0;
+            level->hole_column_offset = 0;
+            level->patch_index = CLIPMAP_HOLE_PATCHES;
+        } else {
+            Clipmap_Level *finer_level = &clipmap->levels[level_index - 1];
+            level->hole_row_offset = (finer_level->origin_row_index - level->origin_row_index) / level->spacing;
+            level->hole_column_offset = (finer_level->origin_column_index - level->origin_column_index) /
+                                        level->spacing;
+            int32 row_parity = level->hole_row_offset - quads/4;
+            int32 column_parity = level->hole_column_offset - quads/4;
+            assert(row_parity >= 0 && row_parity <= 1 && column_parity >= 0 && column_parity <= 1);
+            level->patch_index = row_parity*2 + column_parity;
+        }
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef CLIPMAP_H
+
+// NOTE: geometry clipmaps (Losasso and Hoppe, 2004). instead of a mesh of the whole grid, the GPU keeps
+//       a stack of nested square windows of heights centered on the camera, where level l has a sample
+//       every 2^l cells, and draws every level with the same small ring mesh, fetching the heights in the
+//       vertex shader (terrain_clipmap.vs). so what's on the GPU and what's drawn doesn't depend on how big
+//       the grid is.
+//
+//       every level is quads x quads quads, (quads + 1)^2 samples, in one layer of a texture array. the
+//       textures are toroidal: sample (row, column) of level l is at texel (row mod size, column mod size),
+//       whatever the window's origin, so when the camera moves, only the L-shaped strip of samples that
+//       came into the window has to be uploaded.
+//
+//       a level's origin is snapped to the next level's sample spacing, so its edges are on the coarser
+//       level's vertices, and then it's in one of 2x2 places inside the coarser level. the coarser level
+//       is drawn with a hole there, which is one of CLIPMAP_HOLE_PATCHES index buffers. the finest level
+//       has no hole. near its outer edge, each level's heights blend into the coarser level's, which
+//       closes the cracks between them.
+
+#define MAX_CLIPMAP_LEVELS 16
+#define MAX_CLIPMAP_QUADS 252
+// NOTE: 2x2 hole positions, and the finest level without one
+#define CLIPMAP_HOLE_PATCHES 4
+#define CLIPMAP_PATCHES 5
+
+struct Clipmap_Level {
+    // NOTE: in cells
+    int32 spacing;
+    // NOTE: of the window's first sample, in cells
+    int32 origin_row_index;
+    int32 origin_column_index;
+    // NOTE: whether the texture has the window's samples, which it doesn't until the first update
+    bool32 is_resident;
+    // NOTE: where the next level's window starts in this one, in this level's quads, and which hole patch
+    //       that is
+    int32 hole_row_offset;
+    int32 hole_column_offset;
+    int32 patch_index;
+};
+
+// NOTE: texels of one level to upload, row-major, first texel (x, y)
+struct Clipmap_Upload {
+    int32 level;
+    int32 x;
+    int32 y;
+    int32 width;
+    int32 height;
+    real32 *heights;
+};
+
+struct Terrain_Clipmap {
+    int32 quads;
+    int32 texture_size;
+    int32 num_levels;
+    Clipmap_Level levels[MAX_CLIPMAP_LEVELS];
+
+    // NOTE: the ring meshes, as 16-bit indices into the (quads + 1)^2 vertices of a level (the vertex shader
+    //       works out which from gl_VertexID)
+    uint16 *indices;
+    int32 num_indices;
+    int32 patch_offsets[CLIPMAP_PATCHES];
+    int32 patch_counts[CLIPMAP_PATCHES];
+
+    // NOTE: what update_terrain_clipmap() found needs uploading. upload_heights has room for every texel of
+    //       every level, which is what the first update uploads.
+    Clipmap_Upload *uploads;
+    int32 num_uploads;
+    real32 *upload_heights;
+    int64 num_upload_heights;
+};
+
+struct Terrain;
+
+Terrain_Clipmap *make_terrain_clipmap(Terrain *terrain, int32 quads);
+void update_terrain_clipmap(Terrain_Clipmap *clipmap, Terrain *terrain, real32 camera_row, real32 camera_column);
+int64 get_terrain_clipmap_gpu_size(Terrain_Clipmap *clipmap);
+void free_terrain_clipmap(Terrain_Clipmap *clipmap);
+
+#define CLIPMAP_H
+#endif
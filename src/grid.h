@@ -0,0 +1,165 @@
+#ifndef GRID_H
+
+// NOTE: row-major grids whose boundary behaviour is picked at compile time, so that the loops that
+//       only touch the interior of a grid don't pay for the wrap-around checks that the borders need.
+//       the usual pattern is to run the interior with Unchecked_Boundary and only the border rows and
+//       columns with Wrap_Boundary or Clamp_Boundary.
+
+// NOTE: indices past either end wrap around to the other side
+struct Wrap_Boundary {
+    static inline int32 resolve(int32 index, int32 size) {
+        if (index < 0) {
+            index = size + index;
+        } else if (index >= size) {
+            index %= size;
+        }
+        assert(index >= 0 && index < size);
+        return index;
+    }
+};
+
+// NOTE: indices past either end stick to the nearest edge
+struct Clamp_Boundary {
+    static inline int32 resolve(int32 index, int32 size) {
+        if (index < 0) {
+            return 0;
+        } else if (index >= size) {
+            return size - 1;
+        }
+        return index;
+    }
+};
+
+// NOTE: for when the caller already knows the index is inside the grid
+struct Unchecked_Boundary {
+    static inline int32 resolve(int32 index, int32 size) {
+        return index;
+    }
+};
+
+// NOTE: layouts map a (resolved) row and column to an offset into the grid's storage
+
+struct Row_Major_Layout {
+    static const bool32 is_row_major = true;
+
+    static inline int64 get_offset(int32 row_index, int32 column_index, int32 width, int32 height) {
+        return ((int64) row_index)*width + column_index;
+    }
+
+    static inline int64 get_storage_size(int32 width, int32 height) {
+        return ((int64) width)*height;
+    }
+};
+
+#define HEIGHT_TILE_SHIFT 5
+#define HEIGHT_TILE_SIZE (1 << HEIGHT_TILE_SHIFT)
+#define HEIGHT_TILE_MASK (HEIGHT_TILE_SIZE - 1)
+
+// NOTE: spreads the low 16 bits of x out to the even bits
+inline uint32 spread_bits(uint32 x) {
+    x &= 0x0000FFFF;
+    x = (x | (x << 8)) & 0x00FF00FF;
+    x = (x | (x << 4)) & 0x0F0F0F0F;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555;
+    return x;
+}
+
+inline uint32 compact_bits(uint32 x) {
+    x &= 0x55555555;
+    x = (x | (x >> 1)) & 0x33333333;
+    x = (x | (x >> 2)) & 0x0F0F0F0F;
+    x = (x | (x >> 4)) & 0x00FF00FF;
+    x = (x | (x >> 8)) & 0x0000FFFF;
+    return x;
+}
+
+inline uint32 get_morton_index(int32 row_index, int32 column_index) {
+    return spread_bits((uint32) column_index) | (spread_bits((uint32) row_index) << 1);
+}
+
+// NOTE: square tiles in row-major order, with the values inside each tile in Morton order. the grid is
+//       padded out to a whole number of tiles. a tile is 4KB of real32s, so the neighbours of a cell at
+//       any stride up to the tile size are usually on the same page, and often the same cache line.
+struct Tiled_Layout {
+    static const bool32 is_row_major = false;
+
+    static inline int32 get_tiles_per_side(int32 size) {
+        return (size + HEIGHT_TILE_MASK) >> HEIGHT_TILE_SHIFT;
+    }
+
+    static inline int64 get_offset(int32 row_index, int32 column_index, int32 width, int32 height) {
+        int64 tile_index = ((int64) (row_index >> HEIGHT_TILE_SHIFT))*get_tiles_per_side(width) +
+                           (column_index >> HEIGHT_TILE_SHIFT);
+        uint32 index_in_tile = get_morton_index(row_index & HEIGHT_TILE_MASK, column_index & HEIGHT_TILE_MASK);
+        return (tile_index << (2*HEIGHT_TILE_SHIFT)) + index_in_tile;
+    }
+
+    static inline int64 get_storage_size(int32 width, int32 height) {
+        return (((int64) get_tiles_per_side(width))*get_tiles_per_side(height)) << (2*HEIGHT_TILE_SHIFT);
+    }
+};
+
+// NOTE: rows and columns are inclusive
+struct Grid_Rect {
+    int32 min_row_index;
+    int32 max_row_index;
+    int32 min_column_index;
+    int32 max_column_index;
+};
+
+inline Grid_Rect make_grid_rect(int32 min_row_index, int32 max_row_index, int32 min_column_index, int32 max_column_index) {
+    Grid_Rect rect;
+    rect.min_row_index = min_row_index;
+    rect.max_row_index = max_row_index;
+    rect.min_column_index = min_column_index;
+    rect.max_column_index = max_column_index;
+    return rect;
+}
+
+inline Grid_Rect clip_grid_rect(Grid_Rect rect, int32 width, int32 height) {
+    if (rect.min_row_index < 0) rect.min_row_index = 0;
+    if (rect.min_column_index < 0) rect.min_column_index = 0;
+    if (rect.max_row_index > height - 1) rect.max_row_index = height - 1;
+    if (rect.max_column_index > width - 1) rect.max_column_index = width - 1;
+    return rect;
+}
+
+template <typename Boundary, typename Layout = Row_Major_Layout>
+inline int64 get_grid_index(int32 row_index, int32 column_index, int32 width, int32 height) {
+    return Layout::get_offset(Boundary::resolve(row_index, height), Boundary::resolve(column_index, width),
+                              width, height);
+}
+
+template <typename Value, typename Boundary, typename Layout = Row_Major_Layout>
+struct Grid_View {
+    Value *data;
+    int32 width;
+    int32 height;
+
+    inline int64 get_index(int32 row_index, int32 column_index) {
+        return get_grid_index<Boundary, Layout>(row_index, column_index, width, height);
+    }
+
+    inline Value &at(int32 row_index, int32 column_index) {
+        return data[get_index(row_index, column_index)];
+    }
+
+    // NOTE: rows are only contiguous in row-major grids
+    inline Value *get_row(int32 row_index) {
+        static_assert(Layout::is_row_major, "get_row() needs a row-major layout");
+        return data + ((int64) Boundary::resolve(row_index, height))*width;
+    }
+};
+
+template <typename Boundary, typename Layout = Row_Major_Layout, typename Value>
+inline Grid_View<Value, Boundary, Layout> make_grid_view(Value *data, int32 width, int32 height) {
+    Grid_View<Value, Boundary, Layout> view;
+    view.data = data;
+    view.width = width;
+    view.height = height;
+    return view;
+}
+
+#define GRID_H
+#endif
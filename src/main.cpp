@@ -15,23 +15,14 @@
 #include "include/stb_image.h"
 #include "shaders.cpp"
 #include "main.h"
-#include "terrain.cpp"
+#include "terrain_lib.cpp"
 
 Camera camera = {};
 real64 last_frame_time_seconds;
 Controller_State controller_state = {};
-
-double get_seconds() {
-#if defined(_WIN32)
-    LARGE_INTEGER frequency, count_value;
-    QueryPerformanceFrequency(&frequency);
-    QueryPerformanceCounter(&count_value);
-    return (real64) count_value.QuadPart / (real64) frequency.QuadPart;
-#else
-    // TODO: linux support..
-    return 0.0;
-#endif
-}
+Work_Queue work_queue;
+Terrain_Chunk_Manager terrain_chunk_manager;
+Terrain_Brush terrain_brush = {};
 
 uint32 gl_read_and_load_texture(char *filename) {
     int32 width, height, num_channels;
@@ -64,26 +55,6 @@ uint32 gl_read_and_load_texture(char *filename) {
     return texture_id;
 }
 
-char *read_file(char *filename) {
-    FILE *fid;
-    char *buffer;
-
-    fopen_s(&fid, filename, "rb");
-    assert(fid);
-
-    fseek(fid, 0, SEEK_END);
-    int32 length = ftell(fid);
-    fseek(fid, 0, SEEK_SET);
-
-    buffer = new char[length + 1];
-    fread(buffer, sizeof(char), length, fid);
-    buffer[length] = 0;
-
-    fclose(fid);
-    
-    return buffer;
-}
-
 enum Shader_Type {
     SHADER_TYPE_VERTEX,
     SHADER_TYPE_FRAGMENT
@@ -145,58 +116,11 @@ void gl_init() {
     glViewport(0, 0, camera.window_width, camera.window_height);
 }
 
-void gl_init_terrain(Terrain *terrain, char *vertex_shader_name, char *fragment_shader_name) {
-    uint32 vbo, ebo;
-    glGenVertexArrays(1, &terrain->vao);
-    glGenBuffers(1, &vbo);
-    glGenBuffers(1, &ebo);
-
-    glBindVertexArray(terrain->vao);
-    
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER,
-                 (3*terrain->num_vertices + 3*terrain->num_normals + 2*terrain->num_uvs) * sizeof(real32),
-                 NULL, GL_STATIC_DRAW);
-    int32 offset = 0;
-    uint32 vertices_data_size = terrain->num_vertices * 3 * sizeof(real32);
-    glBufferSubData(GL_ARRAY_BUFFER, offset,
-                    vertices_data_size, terrain->vertices);
-    offset += vertices_data_size;
-
-    uint32 normals_data_size = terrain->num_normals * 3 * sizeof(real32);
-    glBufferSubData(GL_ARRAY_BUFFER, offset,
-                    normals_data_size, terrain->normals);
-    offset += normals_data_size;
-
-    uint32 uvs_data_size = terrain->num_uvs * 2 * sizeof(real32);
-    glBufferSubData(GL_ARRAY_BUFFER, offset,
-                    uvs_data_size, terrain->uvs);
-    offset += uvs_data_size;
-    
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, terrain->num_indices * sizeof(uint32),
-                 terrain->indices, GL_STATIC_DRAW);
-    
+// NOTE: builds the terrain's shader and loads its textures
+void gl_init_terrain_shader(Terrain *terrain, char *vertex_shader_name, char *fragment_shader_name) {
     uint32 vertex_shader_id = buildShader(GL_VERTEX_SHADER, vertex_shader_name);
     uint32 fragment_shader_id = buildShader(GL_FRAGMENT_SHADER, fragment_shader_name);
     terrain->shader_id = buildProgram(vertex_shader_id, fragment_shader_id, 0);
-    
-    // vertex positions
-    int32 position_attrib = glGetAttribLocation(terrain->shader_id, "vertex_position");
-    glVertexAttribPointer(position_attrib, 3, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(position_attrib);
-    
-    // vertex normals
-    int32 normal_attrib = glGetAttribLocation(terrain->shader_id, "vertex_normal");
-    glVertexAttribPointer(normal_attrib, 3, GL_FLOAT, GL_FALSE, 0,
-                          (void *) (terrain->num_vertices * 3 * sizeof(real32)));
-    glEnableVertexAttribArray(normal_attrib);
-
-    // vertex UVs
-    int32 uv_attrib = glGetAttribLocation(terrain->shader_id, "vertex_uv");
-    glVertexAttribPointer(uv_attrib, 2, GL_FLOAT, GL_FALSE, 0,
-                          (void *) ((terrain->num_vertices + terrain->num_normals) * 3 * sizeof(real32)));
-    glEnableVertexAttribArray(uv_attrib);
 
     real64 start_time = get_seconds();
     terrain->grass_texture_id = gl_read_and_load_texture("../data/textures/mountains2_grass.png");
@@ -211,6 +135,8 @@ void gl_init_terrain(Terrain *terrain, char *vertex_shader_name, char *fragment_
     int32 snow_sampler_uniform = glGetUniformLocation(terrain->shader_id, "snow_texture");
     int32 transition_sampler_uniform = glGetUniformLocation(terrain->shader_id, "transition_texture");
     int32 clouds_uniform = glGetUniformLocation(terrain->shader_id, "clouds_texture");
+    // NOTE: only in terrain_packed.vs
+    int32 heights_sampler_uniform = glGetUniformLocation(terrain->shader_id, "heights");
 
     glUseProgram(terrain->shader_id);
     glUniform1i(grass_sampler_uniform, 0);
@@ -218,39 +144,424 @@ void gl_init_terrain(Terrain *terrain, char *vertex_shader_name, char *fragment_
     glUniform1i(snow_sampler_uniform, 2);
     glUniform1i(transition_sampler_uniform, 3);
     glUniform1i(clouds_uniform, 4);
+    glUniform1i(heights_sampler_uniform, 5);
+}
+
+// NOTE: for a vertex buffer that has all the positions, then all the normals, then all the UVs
+void gl_set_terrain_vertex_attributes(uint32 shader_id, int64 num_vertices) {
+    // vertex positions
+    int32 position_attrib = glGetAttribLocation(shader_id, "vertex_position");
+    glVertexAttribPointer(position_attrib, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(position_attrib);
+    
+    // vertex normals
+    int32 normal_attrib = glGetAttribLocation(shader_id, "vertex_normal");
+    glVertexAttribPointer(normal_attrib, 3, GL_FLOAT, GL_FALSE, 0,
+                          (void *) (num_vertices * 3 * sizeof(real32)));
+    glEnableVertexAttribArray(normal_attrib);
+
+    // vertex UVs
+    int32 uv_attrib = glGetAttribLocation(shader_id, "vertex_uv");
+    glVertexAttribPointer(uv_attrib, 2, GL_FLOAT, GL_FALSE, 0,
+                          (void *) (num_vertices * 6 * sizeof(real32)));
+    glEnableVertexAttribArray(uv_attrib);
+}
+
+// NOTE: for a vertex buffer in terrain->vertex_format (not VERTEX_FORMAT_FULL), drawn with
+//       terrain_packed.vs, or terrain_compressed.vs for VERTEX_FORMAT_COMPRESSED
+void gl_set_packed_terrain_vertex_attributes(Terrain *terrain) {
+    int32 vertex_size = get_vertex_format_size(terrain->vertex_format);
+    if (terrain->vertex_format == VERTEX_FORMAT_COMPRESSED) {
+        // NOTE: the column and row are converted to floats as they are, the normal is normalized
+        int32 grid_position_attrib = glGetAttribLocation(terrain->shader_id, "vertex_grid_position");
+        glVertexAttribPointer(grid_position_attrib, 2, GL_UNSIGNED_SHORT, GL_FALSE, vertex_size,
+                              (void *) offsetof(Compressed_Vertex, column_index));
+        glEnableVertexAttribArray(grid_position_attrib);
+
+        int32 height_attrib = glGetAttribLocation(terrain->shader_id, "vertex_height");
+        glVertexAttribPointer(height_attrib, 1, GL_FLOAT, GL_FALSE, vertex_size,
+                              (void *) offsetof(Compressed_Vertex, height));
+        glEnableVertexAttribArray(height_attrib);
+
+        int32 normal_attrib = glGetAttribLocation(terrain->shader_id, "vertex_octahedral_normal");
+        glVertexAttribPointer(normal_attrib, 2, GL_SHORT, GL_TRUE, vertex_size,
+                              (void *) offsetof(Compressed_Vertex, normal));
+        glEnableVertexAttribArray(normal_attrib);
+        return;
+    }
+
+    int32 height_attrib = glGetAttribLocation(terrain->shader_id, "vertex_height");
+    glVertexAttribPointer(height_attrib, 1, GL_FLOAT, GL_FALSE, vertex_size, 0);
+    glEnableVertexAttribArray(height_attrib);
+
+    int32 normal_attrib = glGetAttribLocation(terrain->shader_id, "vertex_normal");
+    if (terrain->vertex_format == VERTEX_FORMAT_HEIGHT_NORMAL) {
+        glVertexAttribPointer(normal_attrib, 4, GL_INT_2_10_10_10_REV, GL_TRUE, vertex_size,
+                              (void *) offsetof(Packed_Height_Normal, normal));
+        glEnableVertexAttribArray(normal_attrib);
+    } else if (normal_attrib >= 0) {
+        glDisableVertexAttribArray(normal_attrib);
+    }
+
+    // NOTE: the shader works out the normals from the heights around each vertex, which it reads from the
+    //       vertex buffer itself
+    if (terrain->vertex_format == VERTEX_FORMAT_HEIGHT) {
+        glGenTextures(1, &terrain->heights_texture_id);
+        glBindTexture(GL_TEXTURE_BUFFER, terrain->heights_texture_id);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, terrain->vbo);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+}
+
+static void *begin_gl_vertex_buffer(Mesh_Vertex_Writer *writer, int64 size) {
+    glBindBuffer(GL_ARRAY_BUFFER, *(uint32 *) writer->data);
+    // NOTE: storage without data, so there's nothing to copy, and mapped with GL_MAP_INVALIDATE_BUFFER_BIT,
+    //       so the driver doesn't have to keep (or read back) what was in it
+    glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STATIC_DRAW);
+    return glMapBufferRange(GL_ARRAY_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+}
+
+static bool32 end_gl_vertex_buffer(Mesh_Vertex_Writer *writer) {
+    glBindBuffer(GL_ARRAY_BUFFER, *(uint32 *) writer->data);
+    return glUnmapBuffer(GL_ARRAY_BUFFER) == GL_TRUE;
+}
+
+// NOTE: a writer for build_terrain_mesh() into the terrain's vbo, which it creates. the workers write the rows
+//       into the mapped buffer, only begin() and end() make GL calls, and build_terrain_mesh() calls those on
+//       this thread.
+Mesh_Vertex_Writer gl_make_vertex_writer(Terrain *terrain) {
+    glGenBuffers(1, &terrain->vbo);
+    Mesh_Vertex_Writer writer = {};
+    writer.begin = begin_gl_vertex_buffer;
+    writer.end = end_gl_vertex_buffer;
+    writer.data = &terrain->vbo;
+    return writer;
+}
+
+void gl_init_terrain(Terrain *terrain, char *vertex_shader_name, char *fragment_shader_name) {
+    gl_init_terrain_shader(terrain, vertex_shader_name, fragment_shader_name);
+
+    uint32 ebo;
+    glGenVertexArrays(1, &terrain->vao);
+    glGenBuffers(1, &ebo);
+
+    glBindVertexArray(terrain->vao);
+    
+    // NOTE: build_terrain_mesh() already wrote the vertices into vbo, in chunk order (see mesh_chunks.h and
+    //       gl_make_vertex_writer())
+    Mesh_Chunk_Layout *mesh_chunks = &terrain->mesh_chunks;
+    assert(terrain->vbo && terrain->vertex_writer);
+    glBindBuffer(GL_ARRAY_BUFFER, terrain->vbo);
+    printf("Wrote %d chunks of %s vertices (%d bytes per vertex, %.1f MB) straight into the GL buffer, and "
+           "uploaded %d 16-bit indices.\n", mesh_chunks->num_chunks, get_vertex_format_name(terrain->vertex_format),
+           get_vertex_format_size(terrain->vertex_format), get_terrain_vertex_buffer_size(terrain) / (1024.0*1024.0),
+           terrain->num_chunk_indices);
+    
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, terrain->num_chunk_indices * sizeof(uint16),
+                 terrain->chunk_indices, GL_STATIC_DRAW);
 
+    if (terrain->vertex_format == VERTEX_FORMAT_FULL) {
+        gl_set_terrain_vertex_attributes(terrain->shader_id, mesh_chunks->num_vertices);
+    } else {
+        gl_set_packed_terrain_vertex_attributes(terrain);
+    }
 
+    // NOTE: every chunk draws all of the indices, from its own first vertex. these fit in an int32, since
+    //       make_mesh_chunk_layout() asserts that every vertex index does.
+    terrain->chunk_draw_counts = (int32 *) malloc(mesh_chunks->num_chunks * sizeof(int32));
+    terrain->chunk_draw_base_vertices = (int32 *) malloc(mesh_chunks->num_chunks * sizeof(int32));
+    terrain->chunk_draw_index_offsets = (void **) malloc(mesh_chunks->num_chunks * sizeof(void *));
+    for (int32 chunk_index = 0; chunk_index < mesh_chunks->num_chunks; chunk_index++) {
+        terrain->chunk_draw_counts[chunk_index] = terrain->num_chunk_indices;
+        terrain->chunk_draw_base_vertices[chunk_index] = chunk_index*mesh_chunks->vertices_per_chunk;
+        terrain->chunk_draw_index_offsets[chunk_index] = NULL;
+    }
+    terrain->num_chunk_draws = mesh_chunks->num_chunks;
+
+    // NOTE: the LOD patches replace the chunk indices in the VAO
+    if (terrain->lod) {
+        glGenBuffers(1, &terrain->lod_ebo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, terrain->lod_ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, terrain->lod->num_indices * sizeof(uint16), terrain->lod->indices,
+                     GL_STATIC_DRAW);
+    }
+
+    // NOTE: the RTIN mesh gets its indices in gl_update_terrain_rtin_mesh()
+    if (terrain->rtin_errors) {
+        glGenBuffers(1, &terrain->rtin_ebo);
+        terrain->rtin_indices = (uint32 *) malloc(get_max_rtin_indices(terrain->x_resolution) * sizeof(uint32));
+    }
 
     // NOTE: wireframe opengl setup
     glGenVertexArrays(1, &terrain->low_res_wireframe_vao);
-    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &terrain->low_res_wireframe_vbo);
     glGenBuffers(1, &ebo);
 
     glBindVertexArray(terrain->low_res_wireframe_vao);
     
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, terrain->low_res_wireframe_vbo);
     glBufferData(GL_ARRAY_BUFFER,
                  (3*terrain->num_low_res_vertices) * sizeof(real32),
                  NULL, GL_STATIC_DRAW);
-    vertices_data_size = terrain->num_low_res_vertices * 3 * sizeof(real32);
     glBufferSubData(GL_ARRAY_BUFFER, 0,
-                    vertices_data_size, terrain->low_res_vertices);
+                    terrain->num_low_res_vertices * 3 * sizeof(real32), terrain->low_res_vertices);
     
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, terrain->num_low_res_indices * sizeof(uint32),
                  terrain->low_res_indices, GL_STATIC_DRAW);
     
-    vertex_shader_id = buildShader(GL_VERTEX_SHADER, "../data/shaders/wireframe.vs");
-    fragment_shader_id = buildShader(GL_FRAGMENT_SHADER, "../data/shaders/wireframe.fs");
+    uint32 vertex_shader_id = buildShader(GL_VERTEX_SHADER, "../data/shaders/wireframe.vs");
+    uint32 fragment_shader_id = buildShader(GL_FRAGMENT_SHADER, "../data/shaders/wireframe.fs");
     terrain->low_res_wireframe_shader_id = buildProgram(vertex_shader_id, fragment_shader_id, 0);
 
-    position_attrib = glGetAttribLocation(terrain->low_res_wireframe_shader_id, "vertex_position");
+    int32 position_attrib = glGetAttribLocation(terrain->low_res_wireframe_shader_id, "vertex_position");
     glVertexAttribPointer(position_attrib, 3, GL_FLOAT, GL_FALSE, 0, 0);
     glEnableVertexAttribArray(position_attrib);
 
 }
 
-void gl_draw_terrain(Render_State *render_state, Terrain terrain, float t) {
+// NOTE: uploads the values in rect of a row-major grid of values, value_size bytes each, to the chunk-major
+//       array of them that starts at buffer_offset in the bound vertex buffer. a row of the rect is only
+//       contiguous within a chunk, so every row of every chunk it touches is its own upload.
+void gl_upload_mesh_chunk_rect(Mesh_Chunk_Layout *mesh_chunks, Grid_Rect rect, void *grid_values, int32 value_size,
+                               int64 buffer_offset) {
+    Grid_Rect chunks;
+    get_mesh_chunks_in_rect(mesh_chunks, rect, &chunks);
+    for (int32 chunk_row_index = chunks.min_row_index; chunk_row_index <= chunks.max_row_index; chunk_row_index++) {
+        for (int32 chunk_column_index = chunks.min_column_index; chunk_column_index <= chunks.max_column_index;
+             chunk_column_index++) {
+            int32 chunk_index = chunk_row_index*mesh_chunks->chunks_per_row + chunk_column_index;
+            Grid_Rect chunk_rect = get_mesh_chunk_rect(mesh_chunks, chunk_index);
+            int32 min_row_index = (rect.min_row_index > chunk_rect.min_row_index) ? rect.min_row_index :
+                                                                                     chunk_rect.min_row_index;
+            int32 max_row_index = (rect.max_row_index < chunk_rect.max_row_index) ? rect.max_row_index :
+                                                                                     chunk_rect.max_row_index;
+            int32 min_column_index = (rect.min_column_index > chunk_rect.min_column_index) ?
+                                     rect.min_column_index : chunk_rect.min_column_index;
+            int32 max_column_index = (rect.max_column_index < chunk_rect.max_column_index) ?
+                                     rect.max_column_index : chunk_rect.max_column_index;
+            int32 row_width = max_column_index - min_column_index + 1;
+            for (int32 row_index = min_row_index; row_index <= max_row_index; row_index++) {
+                int64 chunk_vertex_index = get_mesh_chunk_vertex_index(mesh_chunks, chunk_index, row_index,
+                                                                       min_column_index);
+                int64 grid_index = ((int64) row_index)*mesh_chunks->width + min_column_index;
+                glBufferSubData(GL_ARRAY_BUFFER, buffer_offset + chunk_vertex_index*value_size, row_width*value_size,
+                                (uint8 *) grid_values + grid_index*value_size);
+            }
+        }
+    }
+}
+
+// NOTE: packs the vertices in rect into terrain->vertex_format (not VERTEX_FORMAT_FULL) a row of a chunk at a
+//       time and uploads them to where they go in the bound chunk-major vertex buffer. there's no packed copy
+//       of the grid to upload from, so only what changed is packed.
+void gl_upload_packed_mesh_chunk_rect(Terrain *terrain, Grid_Rect rect) {
+    Mesh_Chunk_Layout *mesh_chunks = &terrain->mesh_chunks;
+    int32 value_size = get_vertex_format_size(terrain->vertex_format);
+    uint8 *packed_row = (uint8 *) malloc(mesh_chunks->vertices_per_chunk_side*value_size);
+    real32 *decoded_height_row = NULL;
+    if (terrain->quantized_heights) {
+        decoded_height_row = (real32 *) malloc(terrain->x_resolution * sizeof(real32));
+    }
+    Grid_Rect chunks;
+    get_mesh_chunks_in_rect(mesh_chunks, rect, &chunks);
+    for (int32 row_index = rect.min_row_index; row_index <= rect.max_row_index; row_index++) {
+        real32 *height_row = get_height_row(terrain, row_index, decoded_height_row);
+        for (int32 chunk_row_index = chunks.min_row_index; chunk_row_index <= chunks.max_row_index;
+             chunk_row_index++) {
+            for (int32 chunk_column_index = chunks.min_column_index; chunk_column_index <= chunks.max_column_index;
+                 chunk_column_index++) {
+                int32 chunk_index = chunk_row_index*mesh_chunks->chunks_per_row + chunk_column_index;
+                Grid_Rect chunk_rect = get_mesh_chunk_rect(mesh_chunks, chunk_index);
+                if (row_index < chunk_rect.min_row_index || row_index > chunk_rect.max_row_index) {
+                    continue;
+                }
+                int32 min_column_index = (rect.min_column_index > chunk_rect.min_column_index) ?
+                                         rect.min_column_index : chunk_rect.min_column_index;
+                int32 max_column_index = (rect.max_column_index < chunk_rect.max_column_index) ?
+                                         rect.max_column_index : chunk_rect.max_column_index;
+                int32 row_width = max_column_index - min_column_index + 1;
+                pack_terrain_vertex_row(terrain, terrain->vertex_format, height_row + min_column_index, row_index,
+                                        min_column_index, row_width, packed_row);
+                int64 chunk_vertex_index = get_mesh_chunk_vertex_index(mesh_chunks, chunk_index, row_index,
+                                                                       min_column_index);
+                glBufferSubData(GL_ARRAY_BUFFER, chunk_vertex_index*value_size, row_width*value_size, packed_row);
+            }
+        }
+    }
+    free(decoded_height_row);
+    free(packed_row);
+}
+
+// NOTE: uploads what update_control_height() changed
+void gl_update_terrain(Terrain *terrain, Terrain_Update *update) {
+    glBindBuffer(GL_ARRAY_BUFFER, terrain->vbo);
+
+    Mesh_Chunk_Layout *mesh_chunks = &terrain->mesh_chunks;
+    if (terrain->vertex_format == VERTEX_FORMAT_FULL) {
+        gl_upload_mesh_chunk_rect(mesh_chunks, update->heights, terrain->vertices, 3 * sizeof(real32), 0);
+        gl_upload_mesh_chunk_rect(mesh_chunks, update->normals, terrain->normals, 3 * sizeof(real32),
+                                  mesh_chunks->num_vertices * 3 * sizeof(real32));
+    } else {
+        // NOTE: with only heights in the buffer, the normals around the edit get worked out again by the shader
+        Grid_Rect rect = (terrain->vertex_format == VERTEX_FORMAT_HEIGHT) ? update->heights : update->normals;
+        gl_upload_packed_mesh_chunk_rect(terrain, rect);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, terrain->low_res_wireframe_vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, terrain->num_low_res_vertices * 3 * sizeof(real32), terrain->low_res_vertices);
+}
+
+// NOTE: E raises and Q lowers the control height closest to the camera
+void do_control_height_edits(Terrain *terrain, Work_Queue *work_queue) {
+    real32 delta = 0.0f;
+    if (!controller_state.e.is_down && controller_state.e.was_down) {
+        delta = 1.0f;
+    } else if (!controller_state.q.is_down && controller_state.q.was_down) {
+        delta = -1.0f;
+    }
+    if (delta == 0.0f) {
+        return;
+    }
+
+    // NOTE: the inverse of the vertex positions in build_terrain_mesh() and the model matrix in gl_draw_terrain()
+    real32 column = camera.position.x / (terrain->world_x_size / (terrain->x_resolution - 1));
+    real32 row = camera.position.z / (terrain->world_y_size / (terrain->y_resolution - 1)) + terrain->y_resolution - 1;
+    int32 dx = (terrain->x_resolution - 1) / (terrain->max_x - 1);
+    int32 dy = (terrain->y_resolution - 1) / (terrain->max_y - 1);
+    int32 low_res_row_index = Clamp_Boundary::resolve((int32) floorf(row / dy + 0.5f), terrain->max_y);
+    int32 low_res_column_index = Clamp_Boundary::resolve((int32) floorf(column / dx + 0.5f), terrain->max_x);
+
+    real32 height = terrain->low_res_height_data[get_grid_index<Unchecked_Boundary>(low_res_row_index,
+                                                                                    low_res_column_index,
+                                                                                    terrain->max_x,
+                                                                                    terrain->max_y)];
+    Terrain_Update update = update_control_height(terrain, low_res_row_index, low_res_column_index,
+                                                  height + delta, work_queue);
+    gl_update_terrain(terrain, &update);
+}
+
+// NOTE: raising and lowering go a quarter of the max height per second, smoothing and flattening most of the way
+//       in a second
+void set_terrain_brush_strength(Terrain *terrain) {
+    if (terrain_brush.mode == BRUSH_RAISE || terrain_brush.mode == BRUSH_LOWER) {
+        terrain_brush.strength = 0.25f*terrain->max_height;
+    } else {
+        terrain_brush.strength = 5.0f;
+    }
+}
+
+// NOTE: holding B sculpts the point the camera is looking at, in one stroke until it's let go. N picks the next
+//       brush, U undoes the last stroke and Y redoes it.
+void do_sculpt_edits(Terrain *terrain) {
+    Terrain_Sculpt *sculpt = terrain->sculpt;
+    if (!sculpt) {
+        return;
+    }
+    char *brush_names[] = {"raise", "lower", "smooth", "flatten"};
+    if (!controller_state.n.is_down && controller_state.n.was_down) {
+        terrain_brush.mode = (Brush_Mode) ((terrain_brush.mode + 1) % BRUSH_MODE_COUNT);
+        set_terrain_brush_strength(terrain);
+        printf("Brush: %s.\n", brush_names[terrain_brush.mode]);
+    }
+
+    Terrain_Update update;
+    if (!sculpt->is_stroking) {
+        if (!controller_state.u.is_down && controller_state.u.was_down) {
+            if (undo_sculpt_stroke(sculpt, terrain, &update)) {
+                gl_update_terrain(terrain, &update);
+                printf("Undid a stroke, %d more to undo.\n", sculpt->num_strokes);
+            }
+        } else if (!controller_state.y.is_down && controller_state.y.was_down) {
+            if (redo_sculpt_stroke(sculpt, terrain, &update)) {
+                gl_update_terrain(terrain, &update);
+                printf("Redid a stroke, %d more to redo.\n", sculpt->num_redo_strokes);
+            }
+        }
+    }
+
+    if (controller_state.b.is_down) {
+        real32 row, column;
+        if (pick_terrain_point(terrain, camera.position, camera.forward, &row, &column)) {
+            if (!sculpt->is_stroking) {
+                begin_sculpt_stroke(sculpt, terrain, row, column);
+            }
+            real32 dt = (real32) (glfwGetTime() - last_frame_time_seconds);
+            if (apply_terrain_brush(sculpt, terrain, &terrain_brush, row, column, dt, &update)) {
+                gl_update_terrain(terrain, &update);
+            }
+        }
+    } else if (sculpt->is_stroking) {
+        end_sculpt_stroke(sculpt);
+        printf("Sculpted with the %s brush, the undo history is %.1f MB.\n", brush_names[terrain_brush.mode],
+               get_terrain_sculpt_history_size(sculpt) / (1024.0*1024.0));
+    }
+}
+
+// NOTE: R doubles and F halves the RTIN mesh's max error
+void do_rtin_error_edits(Terrain *terrain) {
+    if (!terrain->rtin_errors) {
+        return;
+    }
+    if (!controller_state.r.is_down && controller_state.r.was_down) {
+        terrain->rtin_max_error = (terrain->rtin_max_error > 0.0f) ? 2.0f*terrain->rtin_max_error : 0.01f;
+        terrain->rtin_mesh_needs_update = true;
+    } else if (!controller_state.f.is_down && controller_state.f.was_down) {
+        terrain->rtin_max_error *= 0.5f;
+        terrain->rtin_mesh_needs_update = true;
+    }
+}
+
+// NOTE: O turns occlusion culling on and off, and prints what it did in the last frame
+void do_occlusion_culling_toggle(Terrain *terrain) {
+    if (!controller_state.o.is_down && controller_state.o.was_down) {
+        Terrain_Culling *culling = terrain->culling;
+        if (culling->use_occlusion) {
+            printf("Occlusion culling off. In the last frame, %d of the %d chunks in view were occluded (%d "
+                   "occluder triangles in %f seconds).\n",
+                   culling->num_frustum_visible_chunks - culling->num_visible_chunks,
+                   culling->num_frustum_visible_chunks, culling->num_occluder_triangles, culling->occlusion_seconds);
+        } else {
+            printf("Occlusion culling on.\n");
+        }
+        culling->use_occlusion = !culling->use_occlusion;
+    }
+}
+
+// NOTE: extracts the RTIN mesh again if the heights or the max error changed. the indices point into the
+//       chunk-major vbo, so they go into rtin_ebo, which replaces the chunk indices in the VAO.
+void gl_update_terrain_rtin_mesh(Terrain *terrain) {
+    if (!terrain->rtin_errors || !terrain->rtin_mesh_needs_update) {
+        return;
+    }
+    real64 start_time = get_seconds();
+    int32 size = terrain->x_resolution;
+    terrain->num_rtin_indices = extract_rtin_mesh(terrain->rtin_errors, size, terrain->rtin_max_error,
+                                                  terrain->rtin_indices);
+    for (int64 index = 0; index < terrain->num_rtin_indices; index++) {
+        uint32 grid_index = terrain->rtin_indices[index];
+        terrain->rtin_indices[index] = (uint32) get_mesh_grid_vertex_index(&terrain->mesh_chunks, grid_index / size,
+                                                                           grid_index % size);
+    }
+
+    glBindVertexArray(terrain->vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, terrain->rtin_ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, terrain->num_rtin_indices * sizeof(uint32), terrain->rtin_indices,
+                 GL_STREAM_DRAW);
+    terrain->rtin_mesh_needs_update = false;
+    // NOTE: sculpting extracts the mesh again every frame of a stroke, so only the first extraction and the
+    //       ones for a new max error (R/F) are printed
+    static real32 printed_rtin_max_error = -1.0f;
+    if (terrain->rtin_max_error != printed_rtin_max_error) {
+        printf("Extracted RTIN mesh within %f of the heights: %lld triangles (%.2f%% of the grid's) in %f seconds.\n",
+               terrain->rtin_max_error, (long long) (terrain->num_rtin_indices / 3),
+               100.0*terrain->num_rtin_indices / get_max_rtin_indices(size), get_seconds() - start_time);
+        printed_rtin_max_error = terrain->rtin_max_error;
+    }
+}
+
+void update_render_state(Render_State *render_state) {
     if (!controller_state.t.is_down && controller_state.t.was_down) {
         render_state->hide_textures = !render_state->hide_textures;
     }
@@ -258,67 +569,121 @@ void gl_draw_terrain(Render_State *render_state, Terrain terrain, float t) {
     if (!controller_state.z.is_down && controller_state.z.was_down) {
         render_state->show_low_res_wireframe = !render_state->show_low_res_wireframe;
     }
-    
-    glm::vec3 scale_vector = glm::vec3(terrain.world_x_size / (terrain.x_resolution - 1),
-                                       terrain.vertical_scale_factor,
-                                       terrain.world_y_size / (terrain.y_resolution - 1));
-    glm::mat4 model_matrix = glm::scale(glm::mat4(1), scale_vector);
-    glm::mat4 view_matrix = glm::lookAt(camera.position,
-                                        camera.position + camera.forward,
-                                        camera.up);
-        
-    real32 aspect_ratio = (real32) camera.window_width / camera.window_height;
-    glm::mat4 projection_matrix = glm::perspective(glm::radians(camera.fov_y_degrees),
-                                                   aspect_ratio,
-                                                   camera.near_y, camera.far_y);
-
-    glm::mat4 normal_transform_matrix = glm::transpose(glm::inverse(model_matrix));
-
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
 
-    glUseProgram(terrain.shader_id);
+// NOTE: sets everything but the model and normal_transform uniforms
+void gl_use_terrain_shader(Render_State *render_state, Terrain *terrain, glm::mat4 view_matrix,
+                           glm::mat4 projection_matrix, float t) {
+    glUseProgram(terrain->shader_id);
 
-    int32 model_uniform = glGetUniformLocation(terrain.shader_id, "model");
-    glUniformMatrix4fv(model_uniform, 1, 0, glm::value_ptr(model_matrix));
-    
-    int32 view_uniform = glGetUniformLocation(terrain.shader_id, "view");
+    int32 view_uniform = glGetUniformLocation(terrain->shader_id, "view");
     glUniformMatrix4fv(view_uniform, 1, 0, glm::value_ptr(view_matrix));
     
-    int32 projection_uniform = glGetUniformLocation(terrain.shader_id, "projection");
+    int32 projection_uniform = glGetUniformLocation(terrain->shader_id, "projection");
     glUniformMatrix4fv(projection_uniform, 1, 0, glm::value_ptr(projection_matrix));
     
-    int32 normal_transform_uniform = glGetUniformLocation(terrain.shader_id, "normal_transform");
-    glUniformMatrix4fv(normal_transform_uniform, 1, 0, glm::value_ptr(normal_transform_matrix));
-    
-    int32 max_height_uniform = glGetUniformLocation(terrain.shader_id, "max_height");
-    glUniform1f(max_height_uniform, terrain.max_height);
+    int32 max_height_uniform = glGetUniformLocation(terrain->shader_id, "max_height");
+    glUniform1f(max_height_uniform, terrain->max_height);
 
-    int32 t_uniform = glGetUniformLocation(terrain.shader_id, "t");
+    int32 t_uniform = glGetUniformLocation(terrain->shader_id, "t");
     glUniform1f(t_uniform, t);
 
-    int32 hide_textures_uniform = glGetUniformLocation(terrain.shader_id, "hide_textures");
+    int32 hide_textures_uniform = glGetUniformLocation(terrain->shader_id, "hide_textures");
     glUniform1i(hide_textures_uniform, render_state->hide_textures);
 
-    int32 camera_position_uniform = glGetUniformLocation(terrain.shader_id, "camera_position");
+    int32 camera_position_uniform = glGetUniformLocation(terrain->shader_id, "camera_position");
     glUniform3f(camera_position_uniform, camera.position.x, camera.position.y, camera.position.z);
     
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, terrain.grass_texture_id);
+    glBindTexture(GL_TEXTURE_2D, terrain->grass_texture_id);
 
     glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, terrain.stone_texture_id);
+    glBindTexture(GL_TEXTURE_2D, terrain->stone_texture_id);
 
     glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, terrain.snow_texture_id);
+    glBindTexture(GL_TEXTURE_2D, terrain->snow_texture_id);
 
     glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, terrain.transition_texture_id);
+    glBindTexture(GL_TEXTURE_2D, terrain->transition_texture_id);
 
     glActiveTexture(GL_TEXTURE4);
-    glBindTexture(GL_TEXTURE_2D, terrain.clouds_texture_id);
+    glBindTexture(GL_TEXTURE_2D, terrain->clouds_texture_id);
+
+    if (terrain->vertex_format != VERTEX_FORMAT_FULL) {
+        int32 grid_size_uniform = glGetUniformLocation(terrain->shader_id, "grid_size");
+        glUniform2i(grid_size_uniform, terrain->x_resolution, terrain->y_resolution);
+
+        int32 chunk_cells_uniform = glGetUniformLocation(terrain->shader_id, "chunk_cells");
+        glUniform1i(chunk_cells_uniform, terrain->mesh_chunks.cells_per_chunk);
+
+        int32 chunks_per_row_uniform = glGetUniformLocation(terrain->shader_id, "chunks_per_row");
+        glUniform1i(chunks_per_row_uniform, terrain->mesh_chunks.chunks_per_row);
+
+        int32 normals_from_heights_uniform = glGetUniformLocation(terrain->shader_id, "normals_from_heights");
+        glUniform1i(normals_from_heights_uniform, terrain->vertex_format == VERTEX_FORMAT_HEIGHT);
+
+        glActiveTexture(GL_TEXTURE5);
+        glBindTexture(GL_TEXTURE_BUFFER, terrain->heights_texture_id);
+    }
+}
+
+void gl_set_terrain_model_matrix(Terrain *terrain, glm::mat4 model_matrix) {
+    glm::mat4 normal_transform_matrix = glm::transpose(glm::inverse(model_matrix));
+
+    int32 model_uniform = glGetUniformLocation(terrain->shader_id, "model");
+    glUniformMatrix4fv(model_uniform, 1, 0, glm::value_ptr(model_matrix));
+
+    int32 normal_transform_uniform = glGetUniformLocation(terrain->shader_id, "normal_transform");
+    glUniformMatrix4fv(normal_transform_uniform, 1, 0, glm::value_ptr(normal_transform_matrix));
+}
+
+glm::mat4 get_view_matrix() {
+    return get_camera_view_matrix(&camera);
+}
+
+glm::mat4 get_projection_matrix() {
+    return get_camera_projection_matrix(&camera);
+}
+
+// NOTE: only the chunks that might be in view get drawn. every chunk draws the same indices, so only the base
+//       vertices change.
+void cull_terrain_chunk_draws(Terrain *terrain) {
+    Terrain_Culling *culling = terrain->culling;
+    cull_terrain_chunks(culling, terrain, &camera);
+    for (int32 draw_index = 0; draw_index < culling->num_visible_chunks; draw_index++) {
+        terrain->chunk_draw_base_vertices[draw_index] = culling->visible_chunks[draw_index] *
+                                                        terrain->mesh_chunks.vertices_per_chunk;
+    }
+    terrain->num_chunk_draws = culling->num_visible_chunks;
+}
+
+void gl_draw_terrain(Render_State *render_state, Terrain terrain, float t) {
+    update_render_state(render_state);
+    
+    glm::vec3 scale_vector = glm::vec3(terrain.world_x_size / (terrain.x_resolution - 1),
+                                       terrain.vertical_scale_factor,
+                                       terrain.world_y_size / (terrain.y_resolution - 1));
+    glm::mat4 model_matrix = glm::scale(glm::mat4(1), scale_vector);
+    glm::mat4 view_matrix = get_view_matrix();
+    glm::mat4 projection_matrix = get_projection_matrix();
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    gl_use_terrain_shader(render_state, &terrain, view_matrix, projection_matrix, t);
+    gl_set_terrain_model_matrix(&terrain, model_matrix);
         
     glBindVertexArray(terrain.vao);
-    glDrawElements(GL_TRIANGLES, terrain.num_indices, GL_UNSIGNED_INT, NULL);
+    if (terrain.lod) {
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, terrain.lod->draw_counts, GL_UNSIGNED_SHORT,
+                                      terrain.lod->draw_index_offsets, terrain.lod->num_draws,
+                                      terrain.lod->draw_base_vertices);
+    } else if (terrain.rtin_errors) {
+        glDrawElements(GL_TRIANGLES, (GLsizei) terrain.num_rtin_indices, GL_UNSIGNED_INT, NULL);
+    } else {
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, terrain.chunk_draw_counts, GL_UNSIGNED_SHORT,
+                                      terrain.chunk_draw_index_offsets, terrain.num_chunk_draws,
+                                      terrain.chunk_draw_base_vertices);
+    }
 
     if (render_state->show_low_res_wireframe) {
         scale_vector = glm::vec3(terrain.world_x_size / (terrain.max_x - 1),
@@ -328,13 +693,13 @@ void gl_draw_terrain(Render_State *render_state, Terrain terrain, float t) {
         
         glUseProgram(terrain.low_res_wireframe_shader_id);
         
-        model_uniform = glGetUniformLocation(terrain.low_res_wireframe_shader_id, "model");
+        int32 model_uniform = glGetUniformLocation(terrain.low_res_wireframe_shader_id, "model");
         glUniformMatrix4fv(model_uniform, 1, 0, glm::value_ptr(model_matrix));
     
-        view_uniform = glGetUniformLocation(terrain.low_res_wireframe_shader_id, "view");
+        int32 view_uniform = glGetUniformLocation(terrain.low_res_wireframe_shader_id, "view");
         glUniformMatrix4fv(view_uniform, 1, 0, glm::value_ptr(view_matrix));
     
-        projection_uniform = glGetUniformLocation(terrain.low_res_wireframe_shader_id, "projection");
+        int32 projection_uniform = glGetUniformLocation(terrain.low_res_wireframe_shader_id, "projection");
         glUniformMatrix4fv(projection_uniform, 1, 0, glm::value_ptr(projection_matrix));
 
         // glDisable(GL_DEPTH_TEST);
@@ -348,6 +713,210 @@ void gl_draw_terrain(Render_State *render_state, Terrain terrain, float t) {
     }
 }
 
+// NOTE: a clipmap has no vertex buffer, the vertex shader works the vertices out from gl_VertexID and the
+//       heights texture, which gets its texels in gl_update_terrain_clipmap()
+void gl_init_terrain_clipmap(Terrain *terrain) {
+    gl_init_terrain_shader(terrain, "../data/shaders/terrain_clipmap.vs", "../data/shaders/terrain.fs");
+    Terrain_Clipmap *clipmap = terrain->clipmap;
+
+    glGenVertexArrays(1, &terrain->vao);
+    glBindVertexArray(terrain->vao);
+    glGenBuffers(1, &terrain->clipmap_ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, terrain->clipmap_ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, clipmap->num_indices * sizeof(uint16), clipmap->indices, GL_STATIC_DRAW);
+
+    // NOTE: R32F, so the shader reads the same heights as the other vertex formats. the texels are fetched,
+    //       never filtered.
+    glGenTextures(1, &terrain->clipmap_texture_id);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, terrain->clipmap_texture_id);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R32F, clipmap->texture_size, clipmap->texture_size, clipmap->num_levels,
+                 0, GL_RED, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    printf("Clipmap of %d levels of %dx%d quads, %.2f MB on the GPU.\n", clipmap->num_levels, clipmap->quads,
+           clipmap->quads, get_terrain_clipmap_gpu_size(clipmap) / (1024.0*1024.0));
+}
+
+// NOTE: moves the clipmap's windows to the camera and uploads the samples that came into them
+void gl_update_terrain_clipmap(Terrain *terrain) {
+    Terrain_Clipmap *clipmap = terrain->clipmap;
+    real32 column = camera.position.x / (terrain->world_x_size / (terrain->x_resolution - 1));
+    real32 row = camera.position.z / (terrain->world_y_size / (terrain->y_resolution - 1)) +
+                 terrain->y_resolution - 1;
+    update_terrain_clipmap(clipmap, terrain, row, column);
+    if (clipmap->num_uploads == 0) {
+        return;
+    }
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, terrain->clipmap_texture_id);
+    for (int32 upload_index = 0; upload_index < clipmap->num_uploads; upload_index++) {
+        Clipmap_Upload *upload = &clipmap->uploads[upload_index];
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, upload->x, upload->y, upload->level, upload->width, upload->height,
+                        1, GL_RED, GL_FLOAT, upload->heights);
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+// NOTE: every level is the same ring mesh, finest first
+void gl_draw_terrain_clipmap(Render_State *render_state, Terrain *terrain, float t) {
+    update_render_state(render_state);
+    Terrain_Clipmap *clipmap = terrain->clipmap;
+
+    glm::vec3 scale_vector = glm::vec3(terrain->world_x_size / (terrain->x_resolution - 1),
+                                       terrain->vertical_scale_factor,
+                                       terrain->world_y_size / (terrain->y_resolution - 1));
+    glm::mat4 model_matrix = glm::scale(glm::mat4(1), scale_vector);
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    gl_use_terrain_shader(render_state, terrain, get_view_matrix(), get_projection_matrix(), t);
+    gl_set_terrain_model_matrix(terrain, model_matrix);
+
+    uint32 shader_id = terrain->shader_id;
+    glUniform2i(glGetUniformLocation(shader_id, "grid_size"), terrain->x_resolution, terrain->y_resolution);
+    glUniform1i(glGetUniformLocation(shader_id, "quads"), clipmap->quads);
+    glUniform1i(glGetUniformLocation(shader_id, "num_levels"), clipmap->num_levels);
+    int32 level_uniform = glGetUniformLocation(shader_id, "level");
+    int32 spacing_uniform = glGetUniformLocation(shader_id, "spacing");
+    int32 origin_uniform = glGetUniformLocation(shader_id, "origin");
+    int32 origin_sample_uniform = glGetUniformLocation(shader_id, "origin_sample");
+    int32 coarse_origin_sample_uniform = glGetUniformLocation(shader_id, "coarse_origin_sample");
+
+    glActiveTexture(GL_TEXTURE5);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, terrain->clipmap_texture_id);
+
+    glBindVertexArray(terrain->vao);
+    for (int32 level_index = 0; level_index < clipmap->num_levels; level_index++) {
+        Clipmap_Level *level = &clipmap->levels[level_index];
+        glUniform1i(level_uniform, level_index);
+        glUniform1i(spacing_uniform, level->spacing);
+        glUniform2i(origin_uniform, level->origin_column_index, level->origin_row_index);
+        // NOTE: the origin is a multiple of twice the spacing, so these divide exactly
+        glUniform2i(origin_sample_uniform, level->origin_column_index / level->spacing,
+                    level->origin_row_index / level->spacing);
+        glUniform2i(coarse_origin_sample_uniform, level->origin_column_index / (2*level->spacing),
+                    level->origin_row_index / (2*level->spacing));
+        glDrawElements(GL_TRIANGLES, clipmap->patch_counts[level->patch_index], GL_UNSIGNED_SHORT,
+                       (void *) (clipmap->patch_offsets[level->patch_index] * sizeof(uint16)));
+    }
+}
+
+void gl_init_terrain_chunks(Terrain_Chunk_Manager *manager) {
+    glGenBuffers(1, &manager->ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, manager->ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, manager->num_indices * sizeof(uint32),
+                 manager->indices, GL_STATIC_DRAW);
+}
+
+void gl_upload_terrain_chunk(Terrain_Chunk_Manager *manager, Terrain_Chunk *chunk) {
+    int32 num_vertices = manager->vertices_per_side*manager->vertices_per_side;
+
+    glGenVertexArrays(1, &chunk->vao);
+    glGenBuffers(1, &chunk->vbo);
+    glBindVertexArray(chunk->vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, chunk->vbo);
+    glBufferData(GL_ARRAY_BUFFER, num_vertices * 8 * sizeof(real32), NULL, GL_STATIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, num_vertices * 3 * sizeof(real32), chunk->vertices);
+    glBufferSubData(GL_ARRAY_BUFFER, num_vertices * 3 * sizeof(real32), num_vertices * 3 * sizeof(real32),
+                    chunk->normals);
+    glBufferSubData(GL_ARRAY_BUFFER, num_vertices * 6 * sizeof(real32), num_vertices * 2 * sizeof(real32),
+                    chunk->uvs);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, manager->ebo);
+    gl_set_terrain_vertex_attributes(manager->terrain->shader_id, num_vertices);
+    glBindVertexArray(0);
+
+    // NOTE: the heights and normals are kept for the neighbours' edges
+    free(chunk->vertices);
+    free(chunk->uvs);
+    chunk->vertices = NULL;
+    chunk->uvs = NULL;
+}
+
+void gl_upload_terrain_chunk_normals(Terrain_Chunk_Manager *manager, Terrain_Chunk *chunk) {
+    int32 num_vertices = manager->vertices_per_side*manager->vertices_per_side;
+    glBindBuffer(GL_ARRAY_BUFFER, chunk->vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, num_vertices * 3 * sizeof(real32), num_vertices * 3 * sizeof(real32),
+                    chunk->normals);
+}
+
+// NOTE: uploading is the only chunk work done on the main thread, so it's capped to keep frames even
+#define MAX_TERRAIN_CHUNK_UPLOADS_PER_FRAME 4
+
+// NOTE: evicts, requests and uploads chunks. never waits for a chunk to be generated.
+void gl_update_terrain_chunks(Terrain_Chunk_Manager *manager) {
+    for (int32 chunk_index = 0; chunk_index < MAX_TERRAIN_CHUNKS; chunk_index++) {
+        Terrain_Chunk *chunk = &manager->chunks[chunk_index];
+        if (should_evict_terrain_chunk(manager, chunk, camera.position)) {
+            if (chunk->vao) {
+                glDeleteVertexArrays(1, &chunk->vao);
+                glDeleteBuffers(1, &chunk->vbo);
+            }
+            free_terrain_chunk(manager, chunk);
+        }
+    }
+
+    request_terrain_chunks(manager, camera.position);
+
+    // NOTE: without worker threads nothing would ever get generated, so do one chunk per frame here
+    if (manager->work_queue->num_threads == 0) {
+        do_next_work_queue_entry(manager->work_queue);
+    }
+
+    int32 num_uploads = 0;
+    for (int32 chunk_index = 0;
+         chunk_index < MAX_TERRAIN_CHUNKS && num_uploads < MAX_TERRAIN_CHUNK_UPLOADS_PER_FRAME;
+         chunk_index++) {
+        Terrain_Chunk *chunk = &manager->chunks[chunk_index];
+        if (chunk->state.load(std::memory_order_acquire) != TERRAIN_CHUNK_STATE_GENERATED) {
+            continue;
+        }
+
+        update_terrain_chunk_edge_normals(chunk);
+        gl_upload_terrain_chunk(manager, chunk);
+        chunk->state.store(TERRAIN_CHUNK_STATE_READY, std::memory_order_relaxed);
+        num_uploads++;
+
+        // NOTE: the neighbours that were drawn with guessed edge normals can use this chunk's heights now
+        int32 neighbour_offsets[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+        for (int32 neighbour_index = 0; neighbour_index < 4; neighbour_index++) {
+            Terrain_Chunk *neighbour = get_terrain_chunk(manager, chunk->chunk_x + neighbour_offsets[neighbour_index][0],
+                                                         chunk->chunk_y + neighbour_offsets[neighbour_index][1]);
+            if (neighbour && neighbour->state.load(std::memory_order_relaxed) == TERRAIN_CHUNK_STATE_READY) {
+                update_terrain_chunk_edge_normals(neighbour);
+                gl_upload_terrain_chunk_normals(manager, neighbour);
+            }
+        }
+    }
+}
+
+void gl_draw_terrain_chunks(Render_State *render_state, Terrain_Chunk_Manager *manager, float t) {
+    update_render_state(render_state);
+
+    Terrain *terrain = manager->terrain;
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    gl_use_terrain_shader(render_state, terrain, get_view_matrix(), get_projection_matrix(), t);
+
+    glm::mat4 scale_matrix = glm::scale(glm::mat4(1), glm::vec3(manager->cell_size,
+                                                                 terrain->vertical_scale_factor,
+                                                                 manager->cell_size));
+    for (int32 chunk_index = 0; chunk_index < MAX_TERRAIN_CHUNKS; chunk_index++) {
+        Terrain_Chunk *chunk = &manager->chunks[chunk_index];
+        if (chunk->state.load(std::memory_order_relaxed) != TERRAIN_CHUNK_STATE_READY) {
+            continue;
+        }
+
+        glm::vec3 chunk_offset = glm::vec3((real32) chunk->chunk_x*manager->cells_per_chunk, 0.0f,
+                                           (real32) chunk->chunk_y*manager->cells_per_chunk);
+        gl_set_terrain_model_matrix(terrain, scale_matrix*glm::translate(glm::mat4(1), chunk_offset));
+
+        glBindVertexArray(chunk->vao);
+        glDrawElements(GL_TRIANGLES, manager->num_indices, GL_UNSIGNED_INT, NULL);
+    }
+}
+
 /*
  *  Executed each time the window is resized,
  *  usually once at the start of the program.
@@ -432,6 +1001,15 @@ void update_keys(GLFWwindow *window) {
     set_key_state(window, &controller_state.d, GLFW_KEY_D);
     set_key_state(window, &controller_state.t, GLFW_KEY_T);
     set_key_state(window, &controller_state.z, GLFW_KEY_Z);
+    set_key_state(window, &controller_state.e, GLFW_KEY_E);
+    set_key_state(window, &controller_state.q, GLFW_KEY_Q);
+    set_key_state(window, &controller_state.r, GLFW_KEY_R);
+    set_key_state(window, &controller_state.f, GLFW_KEY_F);
+    set_key_state(window, &controller_state.o, GLFW_KEY_O);
+    set_key_state(window, &controller_state.b, GLFW_KEY_B);
+    set_key_state(window, &controller_state.n, GLFW_KEY_N);
+    set_key_state(window, &controller_state.u, GLFW_KEY_U);
+    set_key_state(window, &controller_state.y, GLFW_KEY_Y);
     set_key_state(window, &controller_state.shift, GLFW_KEY_LEFT_SHIFT);
 }
 
@@ -492,10 +1070,119 @@ void reset_controller_state_was_down() {
     controller_state.d.was_down = false;
     controller_state.t.was_down = false;
     controller_state.z.was_down = false;
+    controller_state.e.was_down = false;
+    controller_state.q.was_down = false;
+    controller_state.r.was_down = false;
+    controller_state.f.was_down = false;
+    controller_state.o.was_down = false;
+    controller_state.b.was_down = false;
+    controller_state.n.was_down = false;
+    controller_state.u.was_down = false;
+    controller_state.y.was_down = false;
     controller_state.shift.was_down = false;
 }
 
 int main(int argc, char **argv) {
+    uint64 seed = 0;
+    Simd_Level simd_level = get_cpu_simd_level();
+    Height_Layout height_layout = HEIGHT_LAYOUT_ROW_MAJOR;
+    bool32 benchmark_layouts = false;
+    char *out_of_core_path = NULL;
+    int64 memory_budget_mb = 1024;
+    int32 resolution_exponent = -1;
+    bool32 use_chunks = false;
+    int32 view_radius = 4;
+    Vertex_Format vertex_format = VERTEX_FORMAT_FULL;
+    bool32 use_rtin = false;
+    real32 rtin_max_error = 0;
+    bool32 use_lod = false;
+    real32 lod_max_pixel_error = 2.0f;
+    bool32 use_occlusion = false;
+    bool32 use_clipmap = false;
+    int32 clipmap_quads = 128;
+    for (int32 arg_index = 1; arg_index < argc; arg_index++) {
+        if (strcmp(argv[arg_index], "--seed") == 0 && arg_index + 1 < argc) {
+            seed = strtoull(argv[++arg_index], NULL, 10);
+        } else if (strcmp(argv[arg_index], "--simd") == 0 && arg_index + 1 < argc) {
+            // NOTE: for comparing the kernels; this can only go down from what the CPU supports
+            char *simd_level_name = argv[++arg_index];
+            Simd_Level requested_simd_level = SIMD_LEVEL_SCALAR;
+            if (strcmp(simd_level_name, "avx2") == 0) {
+                requested_simd_level = SIMD_LEVEL_AVX2;
+            } else if (strcmp(simd_level_name, "sse4") == 0) {
+                requested_simd_level = SIMD_LEVEL_SSE4;
+            }
+            if (requested_simd_level < simd_level) {
+                simd_level = requested_simd_level;
+            }
+        } else if (strcmp(argv[arg_index], "--tiled") == 0) {
+            height_layout = HEIGHT_LAYOUT_TILED;
+        } else if (strcmp(argv[arg_index], "--benchmark-layouts") == 0) {
+            benchmark_layouts = true;
+        } else if (strcmp(argv[arg_index], "--out-of-core") == 0 && arg_index + 1 < argc) {
+            out_of_core_path = argv[++arg_index];
+        } else if (strcmp(argv[arg_index], "--memory-budget-mb") == 0 && arg_index + 1 < argc) {
+            memory_budget_mb = atoll(argv[++arg_index]);
+        } else if (strcmp(argv[arg_index], "--exponent") == 0 && arg_index + 1 < argc) {
+            resolution_exponent = atoi(argv[++arg_index]);
+        } else if (strcmp(argv[arg_index], "--chunks") == 0) {
+            use_chunks = true;
+        } else if (strcmp(argv[arg_index], "--view-radius") == 0 && arg_index + 1 < argc) {
+            view_radius = atoi(argv[++arg_index]);
+        } else if (strcmp(argv[arg_index], "--vertex-format") == 0 && arg_index + 1 < argc) {
+            char *vertex_format_name = argv[++arg_index];
+            for (int32 format_index = 0; format_index < VERTEX_FORMAT_COUNT; format_index++) {
+                if (strcmp(vertex_format_name, get_vertex_format_name((Vertex_Format) format_index)) == 0) {
+                    vertex_format = (Vertex_Format) format_index;
+                }
+            }
+        } else if (strcmp(argv[arg_index], "--vertex-cache-size") == 0 && arg_index + 1 < argc) {
+            mesh_chunk_vertex_cache_size = atoi(argv[++arg_index]);
+        } else if (strcmp(argv[arg_index], "--rtin") == 0 && arg_index + 1 < argc) {
+            use_rtin = true;
+            rtin_max_error = (real32) atof(argv[++arg_index]);
+        } else if (strcmp(argv[arg_index], "--lod") == 0) {
+            use_lod = true;
+            if (arg_index + 1 < argc && argv[arg_index + 1][0] != '-') {
+                lod_max_pixel_error = (real32) atof(argv[++arg_index]);
+            }
+        } else if (strcmp(argv[arg_index], "--occlusion") == 0) {
+            use_occlusion = true;
+        } else if (strcmp(argv[arg_index], "--clipmap") == 0) {
+            use_clipmap = true;
+            if (arg_index + 1 < argc && argv[arg_index + 1][0] != '-') {
+                clipmap_quads = atoi(argv[++arg_index]);
+            }
+        }
+    }
+    init_terrain_kernels(simd_level);
+    if (use_clipmap && (clipmap_quads < 4 || clipmap_quads > MAX_CLIPMAP_QUADS || clipmap_quads % 4 != 0)) {
+        printf("The clipmap's quads have to be a multiple of 4 up to %d.\n", MAX_CLIPMAP_QUADS);
+        return 1;
+    }
+
+    if (benchmark_layouts) {
+        benchmark_height_layouts("../data/initial_terrain1.txt");
+        return 0;
+    }
+
+    // NOTE: writes the heights to a file and exits without opening a window, since a grid that needs
+    //       this is too big to mesh anyway
+    if (out_of_core_path) {
+        Terrain terrain = {};
+        load_initial_heights(&terrain, "../data/initial_terrain1.txt");
+        if (resolution_exponent >= 0) {
+            set_terrain_resolution_exponent(&terrain, resolution_exponent);
+        }
+
+        init_work_queue(&work_queue, get_default_num_worker_threads());
+        bool32 generated = generate_height_file(&terrain, 0.5f, 1.0f, seed, out_of_core_path,
+                                                memory_budget_mb*1024*1024, &work_queue);
+        shutdown_work_queue(&work_queue);
+        free(terrain.low_res_height_data);
+        return generated ? 0 : 1;
+    }
+
     GLFWwindow *window;
     
     // start by setting error callback in case something goes wrong
@@ -535,11 +1222,44 @@ int main(int argc, char **argv) {
     terrain.vertical_scale_factor = 1.0f;
     terrain.world_x_size = 100.0f;
     terrain.world_y_size = 100.0f;
+    terrain.height_layout = height_layout;
+    terrain.vertex_format = vertex_format;
+    // NOTE: both replace the chunk indices, and the LOD quadtree wins
+    terrain.use_rtin = use_rtin && !use_lod;
+    terrain.rtin_max_error = rtin_max_error;
+    terrain.use_lod = use_lod;
+    terrain.lod_max_pixel_error = lod_max_pixel_error;
     
     // NOTE: higher h = smoother terrain
     real32 h = 0.5f;
     real32 max_random_height = 1.0f;
-    init_terrain(&terrain, "../data/initial_terrain1.txt", h, max_random_height);
+
+    init_work_queue(&work_queue, get_default_num_worker_threads());
+    Mesh_Vertex_Writer vertex_writer = {};
+    if (use_chunks) {
+        // NOTE: chunks are generated in the frame loop, only the low-res grid is needed up front
+        load_initial_heights(&terrain, "../data/initial_terrain1.txt");
+        init_terrain_chunk_manager(&terrain_chunk_manager, &terrain, h, max_random_height, seed, view_radius,
+                                   &work_queue);
+    } else if (use_clipmap) {
+        // NOTE: the clipmap reads the heights directly, so there's no mesh
+        load_initial_heights(&terrain, "../data/initial_terrain1.txt");
+        if (resolution_exponent >= 0) {
+            set_terrain_resolution_exponent(&terrain, resolution_exponent);
+        }
+        generate_height_data(&terrain, h, max_random_height, seed, &work_queue);
+        terrain.clipmap = make_terrain_clipmap(&terrain, clipmap_quads);
+    } else {
+        // NOTE: the mesh is written straight into the GL buffer while it's built
+        vertex_writer = gl_make_vertex_writer(&terrain);
+        terrain.vertex_writer = &vertex_writer;
+        init_terrain(&terrain, "../data/initial_terrain1.txt", h, max_random_height, seed, &work_queue);
+        terrain.culling->use_occlusion = use_occlusion;
+        terrain.sculpt = make_terrain_sculpt(&terrain);
+        terrain_brush.mode = BRUSH_RAISE;
+        terrain_brush.radius = fmaxf(4.0f, terrain.x_resolution / 40.0f);
+        set_terrain_brush_strength(&terrain);
+    }
 
     #if 1
     camera.position = glm::vec3(terrain.world_x_size / 2.0f,
@@ -559,7 +1279,18 @@ int main(int argc, char **argv) {
     camera.far_y = 1000.0f;
 
     gl_init();
-    gl_init_terrain(&terrain, "../data/shaders/terrain.vs", "../data/shaders/terrain.fs");
+    if (use_chunks) {
+        gl_init_terrain_shader(&terrain, "../data/shaders/terrain.vs", "../data/shaders/terrain.fs");
+        gl_init_terrain_chunks(&terrain_chunk_manager);
+    } else if (use_clipmap) {
+        gl_init_terrain_clipmap(&terrain);
+    } else if (terrain.vertex_format == VERTEX_FORMAT_FULL) {
+        gl_init_terrain(&terrain, "../data/shaders/terrain.vs", "../data/shaders/terrain.fs");
+    } else if (terrain.vertex_format == VERTEX_FORMAT_COMPRESSED) {
+        gl_init_terrain(&terrain, "../data/shaders/terrain_compressed.vs", "../data/shaders/terrain.fs");
+    } else {
+        gl_init_terrain(&terrain, "../data/shaders/terrain_packed.vs", "../data/shaders/terrain.fs");
+    }
     
     glfwSwapInterval(1);
 
@@ -580,10 +1311,29 @@ int main(int argc, char **argv) {
         update_keys(window);
         update_camera(window);
         do_movement();
-        gl_draw_terrain(&render_state, terrain, (real32) glfwGetTime());
+        if (use_chunks) {
+            gl_update_terrain_chunks(&terrain_chunk_manager);
+            gl_draw_terrain_chunks(&render_state, &terrain_chunk_manager, (real32) glfwGetTime());
+        } else if (use_clipmap) {
+            gl_update_terrain_clipmap(&terrain);
+            gl_draw_terrain_clipmap(&render_state, &terrain, (real32) glfwGetTime());
+        } else {
+            do_control_height_edits(&terrain, &work_queue);
+            do_sculpt_edits(&terrain);
+            do_rtin_error_edits(&terrain);
+            do_occlusion_culling_toggle(&terrain);
+            gl_update_terrain_rtin_mesh(&terrain);
+            if (terrain.lod) {
+                select_terrain_lod(terrain.lod, &terrain, &camera, terrain.lod_max_pixel_error);
+            } else if (!terrain.rtin_errors) {
+                cull_terrain_chunk_draws(&terrain);
+            }
+            gl_draw_terrain(&render_state, terrain, (real32) glfwGetTime());
+        }
         reset_controller_state_was_down();
         last_frame_time_seconds = glfwGetTime();
     }
 
+    shutdown_work_queue(&work_queue);
     glfwTerminate();
 }
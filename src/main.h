@@ -1,5 +1,6 @@
 #ifndef MAIN_H
 #include <stdint.h>
+#include <stdio.h>
 
 typedef int8_t int8;
 typedef int16_t int16;
@@ -35,6 +36,15 @@ struct Controller_State {
     Key_State d;
     Key_State t;
     Key_State z;
+    Key_State e;
+    Key_State q;
+    Key_State r;
+    Key_State f;
+    Key_State o;
+    Key_State b;
+    Key_State n;
+    Key_State u;
+    Key_State y;
     Key_State shift;
 };
 
@@ -52,6 +62,7 @@ struct Camera {
     glm::vec3 up;
 };
 
+FILE *open_file(char *filename, char *mode);
 char *read_file(char *filename);
 double get_seconds();
 
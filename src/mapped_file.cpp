@@ -0,0 +1,82 @@
+#include "main.h"
+#include "mapped_file.h"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// NOTE: creates the file (or truncates an existing one) with the given size. the contents start out as zeros.
+bool32 create_mapped_file(Mapped_File *file, char *path, int64 size) {
+    *file = {};
+    file->size = size;
+#if defined(_WIN32)
+    file->file_handle = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                                    FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file->file_handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    file->mapping_handle = CreateFileMappingA(file->file_handle, NULL, PAGE_READWRITE,
+                                              (DWORD) (size >> 32), (DWORD) size, NULL);
+    if (!file->mapping_handle) {
+        CloseHandle(file->file_handle);
+        return false;
+    }
+
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+    file->offset_granularity = system_info.dwAllocationGranularity;
+#else
+    file->file_descriptor = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (file->file_descriptor < 0) {
+        return false;
+    }
+    if (ftruncate(file->file_descriptor, (off_t) size) != 0) {
+        close(file->file_descriptor);
+        return false;
+    }
+    file->offset_granularity = sysconf(_SC_PAGESIZE);
+#endif
+    return true;
+}
+
+void close_mapped_file(Mapped_File *file) {
+#if defined(_WIN32)
+    CloseHandle(file->mapping_handle);
+    CloseHandle(file->file_handle);
+#else
+    close(file->file_descriptor);
+#endif
+    *file = {};
+}
+
+Mapped_View map_file_range(Mapped_File *file, int64 offset, int64 size) {
+    assert(offset >= 0 && offset + size <= file->size);
+    int64 aligned_offset = offset - (offset % file->offset_granularity);
+
+    Mapped_View view = {};
+    view.mapped_size = size + (offset - aligned_offset);
+#if defined(_WIN32)
+    view.base = MapViewOfFile(file->mapping_handle, FILE_MAP_ALL_ACCESS, (DWORD) (aligned_offset >> 32),
+                              (DWORD) aligned_offset, (SIZE_T) view.mapped_size);
+#else
+    view.base = mmap(NULL, (size_t) view.mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     file->file_descriptor, (off_t) aligned_offset);
+    if (view.base == MAP_FAILED) {
+        view.base = NULL;
+    }
+#endif
+    assert(view.base);
+    view.data = (uint8 *) view.base + (offset - aligned_offset);
+    return view;
+}
+
+void unmap_file_range(Mapped_View *view) {
+#if defined(_WIN32)
+    UnmapViewOfFile(view->base);
+#else
+    munmap(view->base, (size_t) view->mapped_size);
+#endif
+    *view = {};
+}
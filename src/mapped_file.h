@@ -0,0 +1,30 @@
+#ifndef MAPPED_FILE_H
+
+// NOTE: a file that's read and written through views mapped into memory. only the pages of a view that
+//       get touched use physical memory, and unmapping a view lets the OS write them back and drop them.
+struct Mapped_File {
+#if defined(_WIN32)
+    HANDLE file_handle;
+    HANDLE mapping_handle;
+#else
+    int32 file_descriptor;
+#endif
+    int64 size;
+    // NOTE: view offsets are rounded down to a multiple of this
+    int64 offset_granularity;
+};
+
+struct Mapped_View {
+    void *base;
+    int64 mapped_size;
+    // NOTE: points to the offset that was asked for, somewhere inside [base, base + mapped_size)
+    void *data;
+};
+
+bool32 create_mapped_file(Mapped_File *file, char *path, int64 size);
+void close_mapped_file(Mapped_File *file);
+Mapped_View map_file_range(Mapped_File *file, int64 offset, int64 size);
+void unmap_file_range(Mapped_View *view);
+
+#define MAPPED_FILE_H
+#endif
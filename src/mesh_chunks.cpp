@@ -0,0 +1,180 @@
+#include "main.h"
+#include "grid.h"
+#include "mesh_chunks.h"
+#include "vertex_cache.h"
+
+// NOTE: the post-transform vertex cache size the chunk indices are ordered for (see
+//       optimize_grid_indices_for_vertex_cache()), or 0 to keep them in row order. 32 is a safe guess for
+//       current GPUs, where the cache holds somewhere between 16 and a few dozen vertices, and the order
+//       that's best for 32 is close to best for the others too.
+int32 mesh_chunk_vertex_cache_size = 32;
+
+Mesh_Chunk_Layout make_mesh_chunk_layout(int32 width, int32 height) {
+    assert(width > 1 && height > 1);
+    Mesh_Chunk_Layout layout = {};
+    layout.width = width;
+    layout.height = height;
+    layout.cells_per_chunk = MESH_CHUNK_CELLS;
+    if (layout.cells_per_chunk > width - 1) {
+        layout.cells_per_chunk = width - 1;
+    }
+    if (layout.cells_per_chunk > height - 1) {
+        layout.cells_per_chunk = height - 1;
+    }
+    layout.vertices_per_chunk_side = layout.cells_per_chunk + 1;
+    layout.vertices_per_chunk = layout.vertices_per_chunk_side*layout.vertices_per_chunk_side;
+    // NOTE: the grids are (2^n + 1) x (2^n + 1), so the chunks always fit exactly
+    assert((width - 1) % layout.cells_per_chunk == 0 && (height - 1) % layout.cells_per_chunk == 0);
+    layout.chunks_per_row = (width - 1) / layout.cells_per_chunk;
+    layout.chunks_per_column = (height - 1) / layout.cells_per_chunk;
+    layout.num_chunks = layout.chunks_per_row*layout.chunks_per_column;
+    layout.num_vertices = ((int64) layout.num_chunks)*layout.vertices_per_chunk;
+    // NOTE: the chunks are drawn with int32 base vertices (which is what glDrawElementsBaseVertex() takes), so
+    //       every vertex index has to fit in one. that holds for grids up to (2^15 + 1) x (2^15 + 1).
+    assert(layout.num_vertices <= INT32_MAX);
+    return layout;
+}
+
+// NOTE: the triangles of a chunk of cells_per_chunk x cells_per_chunk quads, the same as
+//       generate_grid_indices() but ordered for mesh_chunk_vertex_cache_size. there's only one of these per
+//       chunk size, built the first time it's asked for and shared by every terrain after that, so this has
+//       to be called from one thread at a time.
+uint16 *get_mesh_chunk_indices(int32 cells_per_chunk, int32 *num_indices) {
+    static uint16 *mesh_chunk_indices[MESH_CHUNK_CELLS + 1];
+    // NOTE: what they were ordered for, so they're rebuilt if mesh_chunk_vertex_cache_size changes
+    static int32 mesh_chunk_indices_cache_size[MESH_CHUNK_CELLS + 1];
+    assert(cells_per_chunk > 0 && cells_per_chunk <= MESH_CHUNK_CELLS);
+    *num_indices = cells_per_chunk*cells_per_chunk*6;
+
+    if (mesh_chunk_indices[cells_per_chunk] &&
+        mesh_chunk_indices_cache_size[cells_per_chunk] != mesh_chunk_vertex_cache_size) {
+        free(mesh_chunk_indices[cells_per_chunk]);
+        mesh_chunk_indices[cells_per_chunk] = NULL;
+    }
+    if (!mesh_chunk_indices[cells_per_chunk]) {
+        int32 vertices_per_chunk_side = cells_per_chunk + 1;
+        uint32 *indices = (uint32 *) malloc(*num_indices * sizeof(uint32));
+        if (mesh_chunk_vertex_cache_size > 0) {
+            optimize_grid_indices_for_vertex_cache(indices, vertices_per_chunk_side, vertices_per_chunk_side,
+                                                   mesh_chunk_vertex_cache_size);
+        } else {
+            generate_grid_indices(indices, vertices_per_chunk_side, vertices_per_chunk_side);
+        }
+        uint16 *short_indices = (uint16 *) malloc(*num_indices * sizeof(uint16));
+        for (int32 index = 0; index < *num_indices; index++) {
+            short_indices[index] = (uint16) indices[index];
+        }
+        free(indices);
+        mesh_chunk_indices[cells_per_chunk] = short_indices;
+        mesh_chunk_indices_cache_size[cells_per_chunk] = mesh_chunk_vertex_cache_size;
+    }
+    return mesh_chunk_indices[cells_per_chunk];
+}
+
+// NOTE: the vertices of the grid that are in the chunk
+Grid_Rect get_mesh_chunk_rect(Mesh_Chunk_Layout *layout, int32 chunk_index) {
+    int32 first_row_index = (chunk_index / layout->chunks_per_row)*layout->cells_per_chunk;
+    int32 first_column_index = (chunk_index % layout->chunks_per_row)*layout->cells_per_chunk;
+    return make_grid_rect(first_row_index, first_row_index + layout->cells_per_chunk,
+                          first_column_index, first_column_index + layout->cells_per_chunk);
+}
+
+// NOTE: the chunk-major index of grid vertex (row_index, column_index) in the chunk, which has to contain it
+int64 get_mesh_chunk_vertex_index(Mesh_Chunk_Layout *layout, int32 chunk_index, int32 row_index, int32 column_index) {
+    Grid_Rect chunk_rect = get_mesh_chunk_rect(layout, chunk_index);
+    int32 chunk_row_index = row_index - chunk_rect.min_row_index;
+    int32 chunk_column_index = column_index - chunk_rect.min_column_index;
+    assert(chunk_row_index >= 0 && chunk_row_index < layout->vertices_per_chunk_side &&
+           chunk_column_index >= 0 && chunk_column_index < layout->vertices_per_chunk_side);
+    return ((int64) chunk_index)*layout->vertices_per_chunk + chunk_row_index*layout->vertices_per_chunk_side +
+           chunk_column_index;
+}
+
+// NOTE: the chunk-major index of grid vertex (row_index, column_index) in any chunk. a vertex on an edge
+//       between chunks is in both, this picks the one above or to the left unless it's on the top or left edge
+//       of the grid, the same as get_height() in terrain_packed.vs.
+int64 get_mesh_grid_vertex_index(Mesh_Chunk_Layout *layout, int32 row_index, int32 column_index) {
+    int32 chunk_row_index = ((row_index > 0) ? row_index - 1 : 0) / layout->cells_per_chunk;
+    int32 chunk_column_index = ((column_index > 0) ? column_index - 1 : 0) / layout->cells_per_chunk;
+    return get_mesh_chunk_vertex_index(layout, chunk_row_index*layout->chunks_per_row + chunk_column_index,
+                                       row_index, column_index);
+}
+
+// NOTE: the rows and columns of chunks with a vertex in rect. a vertex on an edge between chunks is in the
+//       chunks on both sides.
+void get_mesh_chunks_in_rect(Mesh_Chunk_Layout *layout, Grid_Rect rect, Grid_Rect *chunks) {
+    int32 cells = layout->cells_per_chunk;
+    chunks->min_row_index = (rect.min_row_index > 0) ? (rect.min_row_index - 1) / cells : 0;
+    chunks->min_column_index = (rect.min_column_index > 0) ? (rect.min_column_index - 1) / cells : 0;
+    chunks->max_row_index = rect.max_row_index / cells;
+    if (chunks->max_row_index > layout->chunks_per_column - 1) {
+        chunks->max_row_index = layout->chunks_per_column - 1;
+    }
+    chunks->max_column_index = rect.max_column_index / cells;
+    if (chunks->max_column_index > layout->chunks_per_row - 1) {
+        chunks->max_column_index = layout->chunks_per_row - 1;
+    }
+}
+
+// NOTE: the inverse of get_mesh_chunk_vertex_index(), which is what terrain_packed.vs does with gl_VertexID
+void get_mesh_chunk_grid_position(Mesh_Chunk_Layout *layout, int64 chunk_vertex_index, int32 *row_index,
+                                  int32 *column_index) {
+    int32 chunk_index = (int32) (chunk_vertex_index / layout->vertices_per_chunk);
+    int32 index_in_chunk = (int32) (chunk_vertex_index - ((int64) chunk_index)*layout->vertices_per_chunk);
+    Grid_Rect chunk_rect = get_mesh_chunk_rect(layout, chunk_index);
+    *row_index = chunk_rect.min_row_index + index_in_chunk / layout->vertices_per_chunk_side;
+    *column_index = chunk_rect.min_column_index + index_in_chunk % layout->vertices_per_chunk_side;
+}
+
+// NOTE: copies a row-major grid of values (vertices, normals, ...), value_size bytes each, into out in
+//       chunk-major order. out has to have room for layout->num_vertices values.
+void gather_mesh_chunk_vertices(Mesh_Chunk_Layout *layout, void *grid_values, int32 value_size, void *out) {
+    gather_mesh_chunk_rows(layout, grid_values, value_size, 0, layout->height, out);
+}
+
+// NOTE: gather_mesh_chunk_vertices() for only rows [first_row_index, last_row_index) of the grid, for filling
+//       out as the rows are built. a row on the edge between two rows of chunks goes into both. it goes a
+//       chunk at a time, so the writes are one run per chunk.
+void gather_mesh_chunk_rows(Mesh_Chunk_Layout *layout, void *grid_values, int32 value_size, int32 first_row_index,
+                            int32 last_row_index, void *out) {
+    int64 chunk_row_size = ((int64) layout->vertices_per_chunk_side)*value_size;
+    Grid_Rect chunks;
+    get_mesh_chunks_in_rect(layout, make_grid_rect(first_row_index, last_row_index - 1, 0, layout->width - 1),
+                            &chunks);
+    for (int32 chunk_row_index = chunks.min_row_index; chunk_row_index <= chunks.max_row_index; chunk_row_index++) {
+        for (int32 chunk_column_index = 0; chunk_column_index < layout->chunks_per_row; chunk_column_index++) {
+            int32 chunk_index = chunk_row_index*layout->chunks_per_row + chunk_column_index;
+            Grid_Rect chunk_rect = get_mesh_chunk_rect(layout, chunk_index);
+            int32 min_row_index = (first_row_index > chunk_rect.min_row_index) ? first_row_index :
+                                                                                 chunk_rect.min_row_index;
+            int32 max_row_index = (last_row_index - 1 < chunk_rect.max_row_index) ? last_row_index - 1 :
+                                                                                    chunk_rect.max_row_index;
+            uint8 *out_row = (uint8 *) out + get_mesh_chunk_vertex_index(layout, chunk_index, min_row_index,
+                                                                         chunk_rect.min_column_index)*value_size;
+            for (int32 row_index = min_row_index; row_index <= max_row_index; row_index++) {
+                int64 grid_index = ((int64) row_index)*layout->width + chunk_rect.min_column_index;
+                memcpy(out_row, (uint8 *) grid_values + grid_index*value_size, chunk_row_size);
+                out_row += chunk_row_size;
+            }
+        }
+    }
+}
+
+static void *begin_memory_mesh_vertex_writer(Mesh_Vertex_Writer *writer, int64 size) {
+    free(writer->data);
+    writer->data = malloc(size);
+    return writer->data;
+}
+
+static bool32 end_memory_mesh_vertex_writer(Mesh_Vertex_Writer *writer) {
+    return true;
+}
+
+// NOTE: a writer into plain memory, for using the vertex buffer without GL. the buffer is left in data, which the
+//       caller frees.
+Mesh_Vertex_Writer make_memory_mesh_vertex_writer() {
+    Mesh_Vertex_Writer writer = {};
+    writer.begin = begin_memory_mesh_vertex_writer;
+    writer.end = end_memory_mesh_vertex_writer;
+    return writer;
+}
@@ -0,0 +1,56 @@
+#ifndef MESH_CHUNKS_H
+
+// NOTE: how a terrain's mesh is cut up for drawing. the grid is split into square chunks of
+//       cells_per_chunk x cells_per_chunk quads, and every chunk's vertices are stored one chunk after
+//       another (chunk-major), each chunk row-major, with the vertices on an edge between chunks in both.
+//       a chunk's vertices are then always numbered the same way, so every chunk draws with the same 16-bit
+//       index buffer and only a different base vertex (chunk_index*vertices_per_chunk).
+//
+//       MESH_CHUNK_CELLS is as big as a power of two can go: (128 + 1)^2 = 16641 vertices fit in 16 bits,
+//       (256 + 1)^2 don't. grids smaller than that are one chunk.
+
+#define MESH_CHUNK_CELLS 128
+
+struct Mesh_Chunk_Layout {
+    int32 cells_per_chunk;
+    int32 vertices_per_chunk_side;
+    int32 vertices_per_chunk;
+    int32 chunks_per_row;
+    int32 chunks_per_column;
+    int32 num_chunks;
+    // NOTE: with the edges counted in every chunk they're in
+    int64 num_vertices;
+
+    // NOTE: of the grid
+    int32 width;
+    int32 height;
+};
+
+// NOTE: where build_terrain_mesh() puts the chunk-major vertex buffer, if it's given one (see
+//       Terrain::vertex_writer). begin() returns size bytes to write the whole buffer into, which have to stay
+//       valid until end(). in the viewer that's the GL buffer mapped with glMapBufferRange(), so the vertices
+//       are written where the GPU reads them from, with no copy in between. end() returns false if what was
+//       written got lost (glUnmapBuffer() can do that, if the screen mode changes), and then it has to be
+//       written again.
+struct Mesh_Vertex_Writer {
+    void *(*begin)(Mesh_Vertex_Writer *writer, int64 size);
+    bool32 (*end)(Mesh_Vertex_Writer *writer);
+    // NOTE: whatever begin() and end() need
+    void *data;
+};
+
+Mesh_Chunk_Layout make_mesh_chunk_layout(int32 width, int32 height);
+uint16 *get_mesh_chunk_indices(int32 cells_per_chunk, int32 *num_indices);
+Grid_Rect get_mesh_chunk_rect(Mesh_Chunk_Layout *layout, int32 chunk_index);
+int64 get_mesh_chunk_vertex_index(Mesh_Chunk_Layout *layout, int32 chunk_index, int32 row_index, int32 column_index);
+int64 get_mesh_grid_vertex_index(Mesh_Chunk_Layout *layout, int32 row_index, int32 column_index);
+void get_mesh_chunks_in_rect(Mesh_Chunk_Layout *layout, Grid_Rect rect, Grid_Rect *chunks);
+void get_mesh_chunk_grid_position(Mesh_Chunk_Layout *layout, int64 chunk_vertex_index, int32 *row_index,
+                                  int32 *column_index);
+void gather_mesh_chunk_vertices(Mesh_Chunk_Layout *layout, void *grid_values, int32 value_size, void *out);
+void gather_mesh_chunk_rows(Mesh_Chunk_Layout *layout, void *grid_values, int32 value_size, int32 first_row_index,
+                            int32 last_row_index, void *out);
+Mesh_Vertex_Writer make_memory_mesh_vertex_writer();
+
+#define MESH_CHUNKS_H
+#endif
@@ -0,0 +1,163 @@
+#include "main.h"
+#include "terrain.h"
+#include "mapped_file.h"
+
+#if defined(_WIN32)
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// NOTE: diamond-square straight into a file of row-major real32 heights, for grids that don't fit in memory.
+//       the passes are the same as generate_height_data(), but each one is run over bands of rows, and only
+//       the rows of the current band are mapped. a band also maps the rows around it that it reads from
+//       (the halo), so that the cells on its edges see the same neighbours as they would in memory, and the
+//       file ends up bit-identical to height_data.
+//
+//       a band of n square rows touches the n rows it writes plus the n + 1 rows of corners between them,
+//       and a band of n diamond rows touches those n rows plus one row above and one below. only these rows
+//       are counted against the memory budget; the rows in between are mapped but never touched, so they
+//       never become resident.
+
+static int64 get_peak_resident_bytes() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS memory_counters = {};
+    GetProcessMemoryInfo(GetCurrentProcess(), &memory_counters, sizeof(memory_counters));
+    return (int64) memory_counters.PeakWorkingSetSize;
+#elif defined(__APPLE__)
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (int64) usage.ru_maxrss;
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return ((int64) usage.ru_maxrss)*1024;
+#endif
+}
+
+// NOTE: maps the rows [first_row_index, last_row_index] of the height file
+static Mapped_View map_height_rows(Mapped_File *file, Terrain *terrain, int32 first_row_index, int32 last_row_index) {
+    int64 row_size = ((int64) terrain->x_resolution)*sizeof(real32);
+    return map_file_range(file, first_row_index*row_size, (last_row_index - first_row_index + 1)*row_size);
+}
+
+static void overlay_low_res_heights_in_file(Terrain *terrain, Mapped_File *file) {
+    int32 dx = (terrain->x_resolution - 1) / (terrain->max_x - 1);
+    int32 dy = (terrain->y_resolution - 1) / (terrain->max_y - 1);
+
+    for (int32 row_index = 0; row_index < terrain->y_resolution; row_index += dy) {
+        Mapped_View view = map_height_rows(file, terrain, row_index, row_index);
+        real32 *row = (real32 *) view.data;
+        for (int32 column_index = 0; column_index < terrain->x_resolution; column_index += dx) {
+            row[column_index] = terrain->low_res_height_data[get_grid_index<Unchecked_Boundary>(row_index / dy,
+                                                                                                column_index / dx,
+                                                                                                terrain->max_x,
+                                                                                                terrain->max_y)];
+        }
+        unmap_file_range(&view);
+    }
+}
+
+// NOTE: writes the x_resolution * y_resolution heights of terrain to path, using at most about
+//       memory_budget_bytes of heights at a time. height_data isn't touched. returns false if the file
+//       couldn't be created.
+bool32 generate_height_file(Terrain *terrain, real32 h, real32 max_random_height, uint64 seed,
+                            char *path, int64 memory_budget_bytes, Work_Queue *work_queue) {
+    assert(terrain->height_layout == HEIGHT_LAYOUT_ROW_MAJOR);
+    real64 total_start_time = get_seconds();
+    int64 row_size = ((int64) terrain->x_resolution)*sizeof(real32);
+
+    Mapped_File file;
+    if (!create_mapped_file(&file, path, row_size*terrain->y_resolution)) {
+        printf("Couldn't create height file %s.\n", path);
+        return false;
+    }
+
+    // NOTE: a square row and its 2 rows of corners is the least that any band can work with
+    int64 max_rows_in_memory = memory_budget_bytes / row_size;
+    if (max_rows_in_memory < 3) {
+        printf("Memory budget is less than 3 rows of heights (%lld bytes), using 3 rows.\n",
+               (long long) (3*row_size));
+        max_rows_in_memory = 3;
+    }
+
+    real64 start_time = get_seconds();
+    overlay_low_res_heights_in_file(terrain, &file);
+    printf("Completed setting initial points in %f seconds.\n", get_seconds() - start_time);
+
+    terrain->max_height = FLT_MIN;
+    if (terrain->max_x != terrain->x_resolution ||
+        terrain->max_y != terrain->y_resolution) {
+        real32 smoothing_factor = powf(2.0f, -h);
+
+        start_time = get_seconds();
+
+        real32 *row_max_heights = (real32 *) malloc(terrain->y_resolution * sizeof(real32));
+        for (int32 row_index = 0; row_index < terrain->y_resolution; row_index++) {
+            row_max_heights[row_index] = FLT_MIN;
+        }
+
+        Diamond_Square_Pass pass = make_diamond_square_pass(terrain, row_max_heights, smoothing_factor,
+                                                            max_random_height, seed);
+        int32 num_bands = 0;
+        while (pass.dx > 1) {
+            // NOTE: square
+            int32 num_square_rows = (terrain->y_resolution - 1) / pass.dy;
+            int32 square_rows_per_band = (int32) ((max_rows_in_memory - 1) / 2);
+            for (int32 first = 0; first < num_square_rows; first += square_rows_per_band) {
+                int32 last = first + square_rows_per_band;
+                if (last > num_square_rows) {
+                    last = num_square_rows;
+                }
+
+                Mapped_View view = map_height_rows(&file, terrain, first*pass.dy, last*pass.dy);
+                pass.rows = (real32 *) view.data;
+                pass.first_row_index = first*pass.dy;
+                pass.first_pass_row = first;
+                parallel_for(work_queue, last - first, do_square_rows, &pass);
+                unmap_file_range(&view);
+                num_bands++;
+            }
+
+            // NOTE: diamond
+            int32 row_increment = pass.dy / 2;
+            int32 num_diamond_rows = (terrain->y_resolution - 1) / row_increment + 1;
+            int32 diamond_rows_per_band = (int32) (max_rows_in_memory - 2);
+            for (int32 first = 0; first < num_diamond_rows; first += diamond_rows_per_band) {
+                int32 last = first + diamond_rows_per_band;
+                if (last > num_diamond_rows) {
+                    last = num_diamond_rows;
+                }
+
+                int32 first_row_index = (first > 0) ? (first - 1)*row_increment : 0;
+                int32 last_row_index = (last < num_diamond_rows) ? last*row_increment : (last - 1)*row_increment;
+                Mapped_View view = map_height_rows(&file, terrain, first_row_index, last_row_index);
+                pass.rows = (real32 *) view.data;
+                pass.first_row_index = first_row_index;
+                pass.first_pass_row = first;
+                parallel_for(work_queue, last - first, do_diamond_rows, &pass);
+                unmap_file_range(&view);
+                num_bands++;
+            }
+
+            pass.level--;
+            pass.dx /= 2;
+            pass.dy /= 2;
+            pass.s *= smoothing_factor;
+        }
+
+        for (int32 row_index = 0; row_index < terrain->y_resolution; row_index++) {
+            terrain->max_height = fmaxf(terrain->max_height, row_max_heights[row_index]);
+        }
+        free(row_max_heights);
+
+        printf("Completed out-of-core diamond-square (%s, %d bands) in %f seconds.\n",
+               get_simd_level_name(terrain_kernels.simd_level), num_bands, get_seconds() - start_time);
+    }
+
+    close_mapped_file(&file);
+    printf("Generated %dx%d heights into %s in %f seconds. Max height %f, peak resident memory %.1f MB.\n",
+           terrain->x_resolution, terrain->y_resolution, path, get_seconds() - total_start_time,
+           terrain->max_height, get_peak_resident_bytes() / (1024.0*1024.0));
+    return true;
+}
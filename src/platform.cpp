@@ -0,0 +1,54 @@
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <time.h>
+#endif
+#include <stdio.h>
+#include <assert.h>
+#include "main.h"
+
+// NOTE: seconds since some fixed point, for timing
+double get_seconds() {
+#if defined(_WIN32)
+    LARGE_INTEGER frequency, count_value;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&count_value);
+    return (real64) count_value.QuadPart / (real64) frequency.QuadPart;
+#else
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (real64) time.tv_sec + (real64) time.tv_nsec*1e-9;
+#endif
+}
+
+// NOTE: fopen(), without MSVC's warning about it. returns NULL if the file can't be opened.
+FILE *open_file(char *filename, char *mode) {
+    FILE *fid = NULL;
+#if defined(_MSC_VER)
+    fopen_s(&fid, filename, mode);
+#else
+    fid = fopen(filename, mode);
+#endif
+    return fid;
+}
+
+// NOTE: the whole file with a 0 on the end. free it with delete[].
+char *read_file(char *filename) {
+    FILE *fid;
+    char *buffer;
+
+    fid = open_file(filename, "rb");
+    assert(fid);
+
+    fseek(fid, 0, SEEK_END);
+    int32 length = ftell(fid);
+    fseek(fid, 0, SEEK_SET);
+
+    buffer = new char[length + 1];
+    fread(buffer, sizeof(char), length, fid);
+    buffer[length] = 0;
+
+    fclose(fid);
+    
+    return buffer;
+}
@@ -0,0 +1,186 @@
+#include "main.h"
+#include "terrain.h"
+#include "terrain_kernels.h"
+#include "work_queue.h"
+#include "quantized_heights.h"
+
+#define QUANTIZED_TILE_SAMPLES (HEIGHT_TILE_SIZE*HEIGHT_TILE_SIZE)
+
+inline Quantized_Height_Tile *get_quantized_height_tile(Quantized_Heights *quantized_heights,
+                                                        int32 row_index, int32 column_index) {
+    int64 tile_index = ((int64) (row_index >> HEIGHT_TILE_SHIFT))*quantized_heights->tiles_per_row +
+                       (column_index >> HEIGHT_TILE_SHIFT);
+    return &quantized_heights->tiles[tile_index];
+}
+
+// NOTE: random access to a single height
+inline real32 get_quantized_height(Quantized_Heights *quantized_heights, int32 row_index, int32 column_index) {
+    Quantized_Height_Tile *tile = get_quantized_height_tile(quantized_heights, row_index, column_index);
+    int32 index_in_tile = ((row_index & HEIGHT_TILE_MASK) << HEIGHT_TILE_SHIFT) + (column_index & HEIGHT_TILE_MASK);
+    uint8 *samples = quantized_heights->samples + tile->offset;
+    real32 sample;
+    if (tile->bits_per_sample == 8) {
+        sample = (real32) samples[index_in_tile];
+    } else {
+        sample = (real32) ((uint16 *) samples)[index_in_tile];
+    }
+    return tile->min_height + tile->scale*sample;
+}
+
+// NOTE: decodes the width heights of a row into out, with the SIMD kernels
+void decode_quantized_height_row(Quantized_Heights *quantized_heights, int32 row_index, real32 *out) {
+    int32 first_index_in_tile = (row_index & HEIGHT_TILE_MASK) << HEIGHT_TILE_SHIFT;
+    Quantized_Height_Tile *tile = get_quantized_height_tile(quantized_heights, row_index, 0);
+    for (int32 column_index = 0; column_index < quantized_heights->width; column_index += HEIGHT_TILE_SIZE) {
+        int32 count = quantized_heights->width - column_index;
+        if (count > HEIGHT_TILE_SIZE) {
+            count = HEIGHT_TILE_SIZE;
+        }
+        uint8 *samples = quantized_heights->samples + tile->offset;
+        if (tile->bits_per_sample == 8) {
+            terrain_kernels.dequantize_8(out + column_index, samples + first_index_in_tile, count,
+                                         tile->min_height, tile->scale);
+        } else {
+            terrain_kernels.dequantize_16(out + column_index, ((uint16 *) samples) + first_index_in_tile, count,
+                                          tile->min_height, tile->scale);
+        }
+        tile++;
+    }
+}
+
+struct Quantize_Heights_Work {
+    Quantized_Heights *quantized_heights;
+    real32 *heights;
+    // NOTE: the largest error of every tile row, so threads never write to the same value
+    real32 *tile_row_max_errors;
+};
+
+// NOTE: picks min_height, scale and bits_per_sample for every tile in tile rows [first, last)
+static void do_choose_quantized_tile_scales(void *data, int32 first, int32 last) {
+    Quantize_Heights_Work *work = (Quantize_Heights_Work *) data;
+    Quantized_Heights *quantized_heights = work->quantized_heights;
+    int32 width = quantized_heights->width;
+    int32 height = quantized_heights->height;
+
+    for (int32 tile_row_index = first; tile_row_index < last; tile_row_index++) {
+        int32 first_row_index = tile_row_index << HEIGHT_TILE_SHIFT;
+        int32 end_row_index = (first_row_index + HEIGHT_TILE_SIZE < height) ? first_row_index + HEIGHT_TILE_SIZE : height;
+        for (int32 tile_column_index = 0; tile_column_index < quantized_heights->tiles_per_row; tile_column_index++) {
+            int32 first_column_index = tile_column_index << HEIGHT_TILE_SHIFT;
+            int32 end_column_index = (first_column_index + HEIGHT_TILE_SIZE < width) ? first_column_index + HEIGHT_TILE_SIZE : width;
+
+            real32 min_height = FLT_MAX;
+            real32 max_height = -FLT_MAX;
+            for (int32 row_index = first_row_index; row_index < end_row_index; row_index++) {
+                real32 *row = work->heights + ((int64) row_index)*width;
+                for (int32 column_index = first_column_index; column_index < end_column_index; column_index++) {
+                    min_height = fminf(min_height, row[column_index]);
+                    max_height = fmaxf(max_height, row[column_index]);
+                }
+            }
+
+            // NOTE: rounding to the nearest step is off by at most half a step
+            Quantized_Height_Tile *tile =
+                &quantized_heights->tiles[((int64) tile_row_index)*quantized_heights->tiles_per_row + tile_column_index];
+            tile->min_height = min_height;
+            tile->scale = (max_height - min_height) / 255.0f;
+            tile->bits_per_sample = 8;
+            if (tile->scale*0.5f > quantized_heights->max_error) {
+                tile->scale = (max_height - min_height) / 65535.0f;
+                tile->bits_per_sample = 16;
+            }
+        }
+    }
+}
+
+static void do_quantize_tiles(void *data, int32 first, int32 last) {
+    Quantize_Heights_Work *work = (Quantize_Heights_Work *) data;
+    Quantized_Heights *quantized_heights = work->quantized_heights;
+    int32 width = quantized_heights->width;
+    int32 height = quantized_heights->height;
+
+    for (int32 tile_row_index = first; tile_row_index < last; tile_row_index++) {
+        real32 max_error = 0;
+        for (int32 tile_column_index = 0; tile_column_index < quantized_heights->tiles_per_row; tile_column_index++) {
+            Quantized_Height_Tile *tile =
+                &quantized_heights->tiles[((int64) tile_row_index)*quantized_heights->tiles_per_row + tile_column_index];
+            uint8 *samples = quantized_heights->samples + tile->offset;
+            real32 max_sample = (tile->bits_per_sample == 8) ? 255.0f : 65535.0f;
+
+            for (int32 index_in_tile = 0; index_in_tile < QUANTIZED_TILE_SAMPLES; index_in_tile++) {
+                int32 row_index = (tile_row_index << HEIGHT_TILE_SHIFT) + (index_in_tile >> HEIGHT_TILE_SHIFT);
+                int32 column_index = (tile_column_index << HEIGHT_TILE_SHIFT) + (index_in_tile & HEIGHT_TILE_MASK);
+
+                // NOTE: the padding is 0
+                real32 sample = 0;
+                if (row_index < height && column_index < width && tile->scale > 0) {
+                    real32 height_value = work->heights[((int64) row_index)*width + column_index];
+                    sample = floorf((height_value - tile->min_height) / tile->scale + 0.5f);
+                    sample = fminf(fmaxf(sample, 0.0f), max_sample);
+                    real32 decoded_height = tile->min_height + tile->scale*sample;
+                    max_error = fmaxf(max_error, fabsf(decoded_height - height_value));
+                }
+
+                if (tile->bits_per_sample == 8) {
+                    samples[index_in_tile] = (uint8) sample;
+                } else {
+                    ((uint16 *) samples)[index_in_tile] = (uint16) sample;
+                }
+            }
+        }
+        work->tile_row_max_errors[tile_row_index] = max_error;
+    }
+}
+
+// NOTE: quantizes a width x height grid of row-major heights, keeping the error of every height within
+//       max_error where 16 bits allow it. work_queue can be NULL.
+void quantize_heights(Quantized_Heights *quantized_heights, real32 *heights, int32 width, int32 height,
+                      real32 max_error, Work_Queue *work_queue) {
+    *quantized_heights = {};
+    quantized_heights->width = width;
+    quantized_heights->height = height;
+    quantized_heights->tiles_per_row = Tiled_Layout::get_tiles_per_side(width);
+    quantized_heights->tiles_per_column = Tiled_Layout::get_tiles_per_side(height);
+    quantized_heights->max_error = max_error;
+
+    int64 num_tiles = ((int64) quantized_heights->tiles_per_row)*quantized_heights->tiles_per_column;
+    quantized_heights->tiles = (Quantized_Height_Tile *) malloc(num_tiles * sizeof(Quantized_Height_Tile));
+
+    Quantize_Heights_Work work = {};
+    work.quantized_heights = quantized_heights;
+    work.heights = heights;
+    work.tile_row_max_errors = (real32 *) malloc(quantized_heights->tiles_per_column * sizeof(real32));
+    parallel_for(work_queue, quantized_heights->tiles_per_column, do_choose_quantized_tile_scales, &work);
+
+    // NOTE: every tile is a multiple of 1024 bytes, so every tile's samples are aligned
+    int64 offset = 0;
+    for (int64 tile_index = 0; tile_index < num_tiles; tile_index++) {
+        Quantized_Height_Tile *tile = &quantized_heights->tiles[tile_index];
+        tile->offset = offset;
+        offset += QUANTIZED_TILE_SAMPLES*(tile->bits_per_sample / 8);
+        if (tile->bits_per_sample == 16) {
+            quantized_heights->num_16_bit_tiles++;
+        }
+    }
+    quantized_heights->samples_size = offset;
+    quantized_heights->samples = (uint8 *) malloc(offset);
+
+    parallel_for(work_queue, quantized_heights->tiles_per_column, do_quantize_tiles, &work);
+    for (int32 tile_row_index = 0; tile_row_index < quantized_heights->tiles_per_column; tile_row_index++) {
+        quantized_heights->measured_max_error = fmaxf(quantized_heights->measured_max_error,
+                                                      work.tile_row_max_errors[tile_row_index]);
+    }
+    free(work.tile_row_max_errors);
+}
+
+void free_quantized_heights(Quantized_Heights *quantized_heights) {
+    free(quantized_heights->tiles);
+    free(quantized_heights->samples);
+    *quantized_heights = {};
+}
+
+// NOTE: in bytes, including the tile headers
+int64 get_quantized_heights_size(Quantized_Heights *quantized_heights) {
+    int64 num_tiles = ((int64) quantized_heights->tiles_per_row)*quantized_heights->tiles_per_column;
+    return num_tiles*sizeof(Quantized_Height_Tile) + quantized_heights->samples_size;
+}
@@ -0,0 +1,45 @@
+#ifndef QUANTIZED_HEIGHTS_H
+
+// NOTE: a compact, read-only copy of a grid of heights. the grid is cut into HEIGHT_TILE_SIZE x
+//       HEIGHT_TILE_SIZE tiles (the tiles on the right and bottom edges are padded), and every tile stores
+//       its heights as 8 or 16-bit offsets from the tile's lowest height, so that
+//
+//           height = min_height + scale*sample
+//
+//       a tile uses 8 bits if that keeps it within the error bound it was quantized with, and 16 bits
+//       otherwise. the samples inside a tile are row-major, so a row of a tile can be decoded with SIMD.
+
+struct Quantized_Height_Tile {
+    real32 min_height;
+    real32 scale;
+    // NOTE: in bytes, into Quantized_Heights::samples
+    int64 offset;
+    int32 bits_per_sample;
+};
+
+struct Quantized_Heights {
+    int32 width;
+    int32 height;
+    int32 tiles_per_row;
+    int32 tiles_per_column;
+
+    Quantized_Height_Tile *tiles;
+    uint8 *samples;
+    int64 samples_size;
+
+    // NOTE: what quantize_heights() was asked for, and the largest error it actually made
+    real32 max_error;
+    real32 measured_max_error;
+    int32 num_16_bit_tiles;
+};
+
+struct Work_Queue;
+
+void quantize_heights(Quantized_Heights *quantized_heights, real32 *heights, int32 width, int32 height,
+                      real32 max_error, Work_Queue *work_queue);
+void free_quantized_heights(Quantized_Heights *quantized_heights);
+int64 get_quantized_heights_size(Quantized_Heights *quantized_heights);
+void decode_quantized_height_row(Quantized_Heights *quantized_heights, int32 row_index, real32 *out);
+
+#define QUANTIZED_HEIGHTS_H
+#endif
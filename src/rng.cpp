@@ -0,0 +1,117 @@
+#include "main.h"
+#include "rng.h"
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+
+Philox_Key make_philox_key(uint64 seed) {
+    Philox_Key key;
+    key.k0 = (uint32) seed;
+    key.k1 = (uint32) (seed >> 32);
+    return key;
+}
+
+inline Philox_Block philox_round(Philox_Block counter, Philox_Key key) {
+    uint64 product0 = (uint64) PHILOX_M0 * counter.v[0];
+    uint64 product1 = (uint64) PHILOX_M1 * counter.v[2];
+    uint32 hi0 = (uint32) (product0 >> 32);
+    uint32 lo0 = (uint32) product0;
+    uint32 hi1 = (uint32) (product1 >> 32);
+    uint32 lo1 = (uint32) product1;
+
+    Philox_Block result;
+    result.v[0] = hi1 ^ counter.v[1] ^ key.k0;
+    result.v[1] = lo1;
+    result.v[2] = hi0 ^ counter.v[3] ^ key.k1;
+    result.v[3] = lo0;
+    return result;
+}
+
+Philox_Block philox4x32_10(Philox_Block counter, Philox_Key key) {
+    for (int32 round_index = 0; round_index < 10; round_index++) {
+        counter = philox_round(counter, key);
+        key.k0 += PHILOX_W0;
+        key.k1 += PHILOX_W1;
+    }
+    return counter;
+}
+
+// NOTE: maps 32 random bits to (0, 1]. we only use the top 24 bits since that's all a real32 can
+//       hold, and we never return 0 so it's safe to take the log of the result.
+real32 get_uniform_real32(uint32 bits) {
+    return (real32) ((bits >> 8) + 1) * (1.0f / 16777216.0f);
+}
+
+// NOTE: log(x) for x in (0, 1], from the exponent of x and an odd polynomial in t = (m - 1) / (m + 1) for
+//       its mantissa m, which is moved into [sqrt(1/2), sqrt(2)) so that |t| < 0.172. this is used
+//       instead of logf() because every SIMD version (see terrain_kernels.cpp) can do exactly the same
+//       operations and get exactly the same result, which no libm promises, and it's the same on every
+//       compiler too. it's accurate to a few ulps.
+inline real32 get_gaussian_log(real32 x) {
+    uint32 bits;
+    memcpy(&bits, &x, sizeof(bits));
+    int32 exponent = (int32) (bits >> 23) - 127;
+    uint32 mantissa_bits = (bits & 0x007FFFFFu) | 0x3F800000u;
+    real32 mantissa;
+    memcpy(&mantissa, &mantissa_bits, sizeof(mantissa));
+    if (mantissa > 1.41421356f) {
+        mantissa = mantissa*0.5f;
+        exponent = exponent + 1;
+    }
+
+    real32 t = (mantissa - 1.0f) / (mantissa + 1.0f);
+    real32 t2 = t*t;
+    real32 polynomial = 1.0f + t2*(0.333333333f + t2*(0.2f + t2*(0.142857143f + t2*0.111111111f)));
+    return (real32) exponent*0.693147181f + (2.0f*t)*polynomial;
+}
+
+// NOTE: cos(2*pi*u) for u in (0, 1], for the same reasons as get_gaussian_log(). cos(2*pi*u) is
+//       -cos(2*pi*w) for w = |u - 1/2|, and when w > 1/4 that's cos(2*pi*(1/2 - w)), so the polynomial
+//       (cos's Taylor series up to x^12) only has to cover [0, pi/2].
+inline real32 get_gaussian_cos_2pi(real32 u) {
+    real32 w = fabsf(u - 0.5f);
+    bool32 is_flipped = (w > 0.25f);
+    if (is_flipped) {
+        w = 0.5f - w;
+    }
+
+    real32 x = w*6.28318531f;
+    real32 x2 = x*x;
+    real32 cos_x = 1.0f + x2*(-0.5f + x2*(0.0416666667f + x2*(-0.00138888889f + x2*(2.48015873e-05f +
+                   x2*(-2.75573192e-07f + x2*2.08767570e-09f)))));
+    return is_flipped ? cos_x : -cos_x;
+}
+
+// NOTE: Box-Muller on the first two 32-bit words of a Philox block
+inline real32 get_gaussian_from_bits(uint32 bits0, uint32 bits1) {
+    real32 u1 = get_uniform_real32(bits0);
+    real32 u2 = get_uniform_real32(bits1);
+    real32 r = sqrtf(-2.0f*get_gaussian_log(u1));
+    return r*get_gaussian_cos_2pi(u2);
+}
+
+inline Philox_Block get_cell_random_bits(Philox_Key key, int32 level, int32 row_index, int32 column_index) {
+    Philox_Block counter = {};
+    counter.v[0] = (uint32) column_index;
+    counter.v[1] = (uint32) row_index;
+    counter.v[2] = (uint32) level;
+    return philox4x32_10(counter, key);
+}
+
+// NOTE: standard normal sample that only depends on (key, level, row, column). level is log2 of the
+//       diamond-square step size that the cell is generated in.
+real32 get_cell_gaussian(Philox_Key key, int32 level, int32 row_index, int32 column_index) {
+    Philox_Block random_bits = get_cell_random_bits(key, level, row_index, column_index);
+    return get_gaussian_from_bits(random_bits.v[0], random_bits.v[1]);
+}
+
+// NOTE: get_cell_gaussian() for the count cells of a row at first_column_index + k*column_step. the SIMD
+//       versions of this are in terrain_kernels.cpp.
+void fill_cell_gaussians_scalar(real32 *out, Philox_Key key, int32 level, int32 row_index,
+                                int32 first_column_index, int32 column_step, int32 count) {
+    for (int32 k = 0; k < count; k++) {
+        out[k] = get_cell_gaussian(key, level, row_index, first_column_index + k*column_step);
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef RNG_H
+
+// NOTE: counter-based random numbers (Philox4x32-10, Salmon et al. 2011). there's no generator
+//       state; every output is a pure function of a key and a counter, so any value can be
+//       recomputed on its own, in any order, on any thread.
+
+struct Philox_Key {
+    uint32 k0;
+    uint32 k1;
+};
+
+struct Philox_Block {
+    uint32 v[4];
+};
+
+Philox_Key make_philox_key(uint64 seed);
+Philox_Block philox4x32_10(Philox_Block counter, Philox_Key key);
+real32 get_uniform_real32(uint32 bits);
+real32 get_cell_gaussian(Philox_Key key, int32 level, int32 row_index, int32 column_index);
+void fill_cell_gaussians_scalar(real32 *out, Philox_Key key, int32 level, int32 row_index,
+                                int32 first_column_index, int32 column_step, int32 count);
+
+#define RNG_H
+#endif
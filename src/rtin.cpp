@@ -0,0 +1,192 @@
+#include "main.h"
+#include "grid.h"
+#include "terrain.h"
+#include "rtin.h"
+
+// NOTE: every cell split into two triangles
+int64 get_max_rtin_indices(int32 size) {
+    return ((int64) size - 1)*(size - 1)*6;
+}
+
+inline real32 get_rtin_height(real32 *heights, int32 height_stride, int32 size, int32 row_index,
+                              int32 column_index) {
+    return heights[(((int64) row_index)*size + column_index)*height_stride];
+}
+
+// NOTE: the first index at or after min_index that's offset more than a multiple of step
+inline int32 get_first_rtin_index(int32 min_index, int32 offset, int32 step) {
+    if (min_index <= offset) {
+        return offset;
+    }
+    return offset + ((min_index - offset + step - 1) / step)*step;
+}
+
+// NOTE: the error of the midpoint of the edge from a to b, and of the vertices under it. those are the
+//       centers of the (up to four) quarter squares that have the midpoint as a corner, which are the
+//       midpoints of its two triangles' children.
+static real32 get_rtin_edge_error(real32 *errors, real32 *heights, int32 height_stride, int32 size,
+                                  int32 row_index, int32 column_index, int32 a_row_index, int32 a_column_index,
+                                  int32 b_row_index, int32 b_column_index, int32 half_step) {
+    real32 interpolated_height = 0.5f*(get_rtin_height(heights, height_stride, size, a_row_index, a_column_index) +
+                                       get_rtin_height(heights, height_stride, size, b_row_index, b_column_index));
+    real32 error = fabsf(interpolated_height - get_rtin_height(heights, height_stride, size, row_index,
+                                                               column_index));
+    int32 quarter_step = half_step / 2;
+    if (quarter_step > 0) {
+        for (int32 row_offset = -quarter_step; row_offset <= quarter_step; row_offset += half_step) {
+            for (int32 column_offset = -quarter_step; column_offset <= quarter_step; column_offset += half_step) {
+                int32 child_row_index = row_index + row_offset;
+                int32 child_column_index = column_index + column_offset;
+                if (child_row_index >= 0 && child_row_index < size &&
+                    child_column_index >= 0 && child_column_index < size) {
+                    error = fmaxf(error, errors[((int64) child_row_index)*size + child_column_index]);
+                }
+            }
+        }
+    }
+    return error;
+}
+
+// NOTE: the errors of the midpoints of the edges in rect at one level (step), which are the hypotenuses of
+//       the triangles that halve the squares at that level. the rows of horizontal edges are every step, their
+//       midpoints half a step in from the corners, and the other way around for the vertical ones. they
+//       need the errors of the level below.
+void build_rtin_edge_errors(real32 *errors, real32 *heights, int32 height_stride, int32 size, int32 step,
+                            Grid_Rect rect) {
+    int32 half_step = step / 2;
+    for (int32 edge_direction = 0; edge_direction < 2; edge_direction++) {
+        int32 row_offset = (edge_direction == 0) ? 0 : half_step;
+        int32 column_offset = (edge_direction == 0) ? half_step : 0;
+        for (int32 row_index = get_first_rtin_index(rect.min_row_index, row_offset, step);
+             row_index <= rect.max_row_index; row_index += step) {
+            for (int32 column_index = get_first_rtin_index(rect.min_column_index, column_offset, step);
+                 column_index <= rect.max_column_index; column_index += step) {
+                int64 index = ((int64) row_index)*size + column_index;
+                if (edge_direction == 0) {
+                    errors[index] = get_rtin_edge_error(errors, heights, height_stride, size,
+                                                        row_index, column_index, row_index,
+                                                        column_index - half_step, row_index,
+                                                        column_index + half_step, half_step);
+                } else {
+                    errors[index] = get_rtin_edge_error(errors, heights, height_stride, size,
+                                                        row_index, column_index, row_index - half_step,
+                                                        column_index, row_index + half_step, column_index,
+                                                        half_step);
+                }
+            }
+        }
+    }
+}
+
+// NOTE: the errors of the centers of the squares in rect at one level (step). their children are the edge
+//       midpoints of the same level, up to half a step away, so those have to be up to date first.
+void build_rtin_center_errors(real32 *errors, real32 *heights, int32 height_stride, int32 size, int32 step,
+                              Grid_Rect rect) {
+    int32 half_step = step / 2;
+    for (int32 row_index = get_first_rtin_index(rect.min_row_index, half_step, step);
+         row_index <= rect.max_row_index; row_index += step) {
+        for (int32 column_index = get_first_rtin_index(rect.min_column_index, half_step, step);
+             column_index <= rect.max_column_index; column_index += step) {
+            int32 top_row_index = row_index - half_step;
+            int32 bottom_row_index = row_index + half_step;
+            int32 left_column_index = column_index - half_step;
+            int32 right_column_index = column_index + half_step;
+            real32 a, b;
+            if (((top_row_index / step) & 1) == ((left_column_index / step) & 1)) {
+                a = get_rtin_height(heights, height_stride, size, top_row_index, left_column_index);
+                b = get_rtin_height(heights, height_stride, size, bottom_row_index, right_column_index);
+            } else {
+                a = get_rtin_height(heights, height_stride, size, top_row_index, right_column_index);
+                b = get_rtin_height(heights, height_stride, size, bottom_row_index, left_column_index);
+            }
+            real32 error = fabsf(0.5f*(a + b) - get_rtin_height(heights, height_stride, size, row_index,
+                                                                 column_index));
+            error = fmaxf(error, errors[((int64) top_row_index)*size + column_index]);
+            error = fmaxf(error, errors[((int64) bottom_row_index)*size + column_index]);
+            error = fmaxf(error, errors[((int64) row_index)*size + left_column_index]);
+            error = fmaxf(error, errors[((int64) row_index)*size + right_column_index]);
+            errors[((int64) row_index)*size + column_index] = error;
+        }
+    }
+}
+
+// NOTE: rebuilds the errors that depend on the heights in rect. the errors at a level depend on the heights
+//       less than step away, and on the errors at the level below that are up to step/2 away, which depend on
+//       the ones below them in turn, so an error depends on heights up to step + step/2 + step/4 + ... < 2*step
+//       away, and the rect has to grow by 2*step at each level. build_rtin_errors() does the whole grid.
+void build_rtin_error_rect(real32 *errors, real32 *heights, int32 height_stride, int32 size, Grid_Rect rect) {
+    assert(size > 1 && ((size - 1) & (size - 2)) == 0);
+    for (int32 step = 2; step < size; step *= 2) {
+        Grid_Rect level_rect = clip_grid_rect(make_grid_rect(rect.min_row_index - 2*step,
+                                                             rect.max_row_index + 2*step,
+                                                             rect.min_column_index - 2*step,
+                                                             rect.max_column_index + 2*step),
+                                              size, size);
+        build_rtin_edge_errors(errors, heights, height_stride, size, step, level_rect);
+        build_rtin_center_errors(errors, heights, height_stride, size, step, level_rect);
+    }
+}
+
+// NOTE: errors has to be size*size real32s. the corners don't get an error, since they're never split.
+void build_rtin_errors(real32 *errors, real32 *heights, int32 height_stride, int32 size) {
+    errors[0] = 0;
+    errors[size - 1] = 0;
+    errors[((int64) size - 1)*size] = 0;
+    errors[((int64) size)*size - 1] = 0;
+    build_rtin_error_rect(errors, heights, height_stride, size, make_grid_rect(0, size - 1, 0, size - 1));
+}
+
+struct Rtin_Extraction {
+    real32 *errors;
+    int32 size;
+    real32 max_error;
+    uint32 *indices;
+    int64 num_indices;
+};
+
+// NOTE: a is the corner at one end of the hypotenuse, b at the other and c at the right angle, in the same
+//       winding as generate_grid_indices()
+static void extract_rtin_triangle(Rtin_Extraction *extraction, int32 a_row_index, int32 a_column_index,
+                                  int32 b_row_index, int32 b_column_index, int32 c_row_index, int32 c_column_index) {
+    int32 middle_row_index = (a_row_index + b_row_index) / 2;
+    int32 middle_column_index = (a_column_index + b_column_index) / 2;
+    int32 size = extraction->size;
+    int32 leg_length = abs(a_row_index - c_row_index) + abs(a_column_index - c_column_index);
+    if (leg_length > 1 &&
+        extraction->errors[((int64) middle_row_index)*size + middle_column_index] > extraction->max_error) {
+        extract_rtin_triangle(extraction, c_row_index, c_column_index, a_row_index, a_column_index,
+                              middle_row_index, middle_column_index);
+        extract_rtin_triangle(extraction, b_row_index, b_column_index, c_row_index, c_column_index,
+                              middle_row_index, middle_column_index);
+    } else {
+        if (extraction->indices) {
+            uint32 *indices = extraction->indices + extraction->num_indices;
+            indices[0] = (uint32) (a_row_index*size + a_column_index);
+            indices[1] = (uint32) (b_row_index*size + b_column_index);
+            indices[2] = (uint32) (c_row_index*size + c_column_index);
+        }
+        extraction->num_indices += 3;
+    }
+}
+
+// NOTE: writes the triangles of the coarsest RTIN mesh that's within max_error of every height, as indices
+//       of grid vertices (row_index*size + column_index), to indices, which has to have room for
+//       get_max_rtin_indices(), or can be NULL to only count them. returns the number of indices.
+int64 extract_rtin_mesh(real32 *errors, int32 size, real32 max_error, uint32 *indices) {
+    Rtin_Extraction extraction = {};
+    extraction.errors = errors;
+    extraction.size = size;
+    extraction.max_error = max_error;
+    extraction.indices = indices;
+    int32 last = size - 1;
+    extract_rtin_triangle(&extraction, 0, 0, last, last, 0, last);
+    extract_rtin_triangle(&extraction, last, last, 0, 0, last, 0);
+    return extraction.num_indices;
+}
+
+// NOTE: RTIN needs a square grid with a power of two cells per side, and indices that fit in 32 bits
+bool32 can_use_rtin(Terrain *terrain) {
+    int32 size = terrain->x_resolution;
+    return size == terrain->y_resolution && size > 1 && ((size - 1) & (size - 2)) == 0 &&
+           ((int64) size)*size <= 0xFFFFFFFF;
+}
@@ -0,0 +1,28 @@
+#ifndef RTIN_H
+
+// NOTE: a right-triangulated irregular network (RTIN) over a (2^n+1)x(2^n+1) grid. the grid starts as two
+//       right triangles split along the diagonal from (0, 0) to the far corner, and every triangle can be
+//       split in two at the midpoint of its hypotenuse, down to the grid's own cells. whether a triangle
+//       needs splitting depends only on the error map: the error at each vertex is how far its height is from
+//       the height the unsplit triangle would give it, or more if any vertex under it has a bigger error, so
+//       any threshold gives a mesh without cracks.
+//
+//       the midpoints that get split at each level are the same points diamond-square generates at that
+//       level: the centers of the squares and the midpoints of their edges. a square's triangles have one of
+//       its diagonals as their hypotenuse, the one that goes through the center of the square it's a quarter
+//       of.
+
+struct Terrain;
+
+int64 get_max_rtin_indices(int32 size);
+void build_rtin_edge_errors(real32 *errors, real32 *heights, int32 height_stride, int32 size, int32 step,
+                            Grid_Rect rect);
+void build_rtin_center_errors(real32 *errors, real32 *heights, int32 height_stride, int32 size, int32 step,
+                              Grid_Rect rect);
+void build_rtin_error_rect(real32 *errors, real32 *heights, int32 height_stride, int32 size, Grid_Rect rect);
+void build_rtin_errors(real32 *errors, real32 *heights, int32 height_stride, int32 size);
+int64 extract_rtin_mesh(real32 *errors, int32 size, real32 max_error, uint32 *indices);
+bool32 can_use_rtin(Terrain *terrain);
+
+#define RTIN_H
+#endif
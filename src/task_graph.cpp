@@ -0,0 +1,199 @@
+#include "main.h"
+#include "work_queue.h"
+#include "task_graph.h"
+
+void init_task_graph(Task_Graph *graph) {
+    graph->work_queue = NULL;
+    graph->num_tasks = 0;
+    graph->num_unfinished_tasks = 0;
+    graph->start_seconds = 0;
+    graph->end_seconds = 0;
+}
+
+// NOTE: returns the task's index, for add_task_dependency()
+int32 add_task(Task_Graph *graph, char *name, Parallel_For_Callback *callback, void *data, int32 count) {
+    assert(graph->num_tasks < MAX_TASK_GRAPH_TASKS);
+    int32 task_index = graph->num_tasks++;
+    Task_Graph_Task *task = &graph->tasks[task_index];
+    task->name = name;
+    task->callback = callback;
+    task->data = data;
+    task->count = count;
+    task->num_dependents = 0;
+    task->num_dependencies = 0;
+    task->num_chunks = 0;
+    return task_index;
+}
+
+// NOTE: task_index doesn't start until depends_on_index has finished. tasks can only depend on tasks that
+//       were added before them, which keeps the graph acyclic and lets it be run in order without a queue.
+void add_task_dependency(Task_Graph *graph, int32 task_index, int32 depends_on_index) {
+    assert(depends_on_index < task_index && task_index < graph->num_tasks);
+    Task_Graph_Task *depends_on = &graph->tasks[depends_on_index];
+    assert(depends_on->num_dependents < MAX_TASK_DEPENDENTS);
+    depends_on->dependents[depends_on->num_dependents++] = task_index;
+    graph->tasks[task_index].num_dependencies++;
+}
+
+static void do_task_graph_chunk(void *data);
+
+static void queue_task_chunks(Task_Graph *graph, int32 task_index) {
+    Task_Graph_Task *task = &graph->tasks[task_index];
+    if (task->num_chunks == 0) {
+        // NOTE: nothing to do, but its dependents still have to be released
+        graph->num_unfinished_tasks.fetch_sub(1);
+        for (int32 dependent_index = 0; dependent_index < task->num_dependents; dependent_index++) {
+            int32 dependent_task_index = task->dependents[dependent_index];
+            if (graph->tasks[dependent_task_index].num_unfinished_dependencies.fetch_sub(1) == 1) {
+                queue_task_chunks(graph, dependent_task_index);
+            }
+        }
+        return;
+    }
+
+    for (int32 chunk_index = 0; chunk_index < task->num_chunks; chunk_index++) {
+        add_work_queue_entry(graph->work_queue, do_task_graph_chunk, &task->chunks[chunk_index]);
+    }
+}
+
+static void do_task_graph_chunk(void *data) {
+    Task_Graph_Chunk *chunk = (Task_Graph_Chunk *) data;
+    Task_Graph *graph = chunk->graph;
+    Task_Graph_Task *task = &graph->tasks[chunk->task_index];
+
+    chunk->start_seconds = get_seconds();
+    task->callback(task->data, chunk->first, chunk->last);
+    chunk->end_seconds = get_seconds();
+
+    if (task->num_unfinished_chunks.fetch_sub(1) == 1) {
+        // NOTE: the last chunk of the task releases its dependents
+        for (int32 dependent_index = 0; dependent_index < task->num_dependents; dependent_index++) {
+            int32 dependent_task_index = task->dependents[dependent_index];
+            if (graph->tasks[dependent_task_index].num_unfinished_dependencies.fetch_sub(1) == 1) {
+                queue_task_chunks(graph, dependent_task_index);
+            }
+        }
+        graph->num_unfinished_tasks.fetch_sub(1);
+    }
+}
+
+// NOTE: runs every task and blocks until they're all done, with the calling thread helping. work_queue can
+//       be NULL, in which case the tasks run one after another on the calling thread.
+void run_task_graph(Task_Graph *graph, Work_Queue *work_queue) {
+    graph->work_queue = work_queue;
+    int32 num_workers = (work_queue ? work_queue->num_threads : 0) + 1;
+
+    for (int32 task_index = 0; task_index < graph->num_tasks; task_index++) {
+        Task_Graph_Task *task = &graph->tasks[task_index];
+        // NOTE: a few chunks per thread so that threads that finish early can pick up the slack, like
+        //       parallel_for()
+        int32 num_chunks = (num_workers > 1) ? 4*num_workers : 1;
+        if (num_chunks > task->count) num_chunks = task->count;
+        if (num_chunks > MAX_TASK_CHUNKS) num_chunks = MAX_TASK_CHUNKS;
+        task->num_chunks = num_chunks;
+        for (int32 chunk_index = 0; chunk_index < num_chunks; chunk_index++) {
+            Task_Graph_Chunk *chunk = &task->chunks[chunk_index];
+            chunk->graph = graph;
+            chunk->task_index = task_index;
+            chunk->first = (int32) (((int64) task->count * chunk_index) / num_chunks);
+            chunk->last = (int32) (((int64) task->count * (chunk_index + 1)) / num_chunks);
+            chunk->start_seconds = 0;
+            chunk->end_seconds = 0;
+        }
+        task->num_unfinished_chunks = num_chunks;
+        task->num_unfinished_dependencies = task->num_dependencies;
+    }
+    graph->num_unfinished_tasks = graph->num_tasks;
+
+    graph->start_seconds = get_seconds();
+    if (!work_queue) {
+        // NOTE: dependencies always point backwards, so index order is a valid order
+        for (int32 task_index = 0; task_index < graph->num_tasks; task_index++) {
+            Task_Graph_Task *task = &graph->tasks[task_index];
+            for (int32 chunk_index = 0; chunk_index < task->num_chunks; chunk_index++) {
+                Task_Graph_Chunk *chunk = &task->chunks[chunk_index];
+                chunk->start_seconds = get_seconds();
+                task->callback(task->data, chunk->first, chunk->last);
+                chunk->end_seconds = get_seconds();
+            }
+        }
+        graph->num_unfinished_tasks = 0;
+    } else {
+        for (int32 task_index = 0; task_index < graph->num_tasks; task_index++) {
+            if (graph->tasks[task_index].num_dependencies == 0) {
+                queue_task_chunks(graph, task_index);
+            }
+        }
+        while (graph->num_unfinished_tasks.load() > 0) {
+            if (!do_next_work_queue_entry(work_queue)) {
+                std::this_thread::yield();
+            }
+        }
+    }
+    graph->end_seconds = get_seconds();
+}
+
+// NOTE: when each task ran (relative to the start of the graph), how much work its chunks did in total,
+//       and the critical path: the chain of dependent tasks with the longest total run time, which is as
+//       fast as the graph can go no matter how many threads there are.
+void print_task_graph_timings(Task_Graph *graph) {
+    real64 task_start_seconds[MAX_TASK_GRAPH_TASKS];
+    real64 task_seconds[MAX_TASK_GRAPH_TASKS];
+    real64 path_seconds[MAX_TASK_GRAPH_TASKS];
+    int32 path_previous[MAX_TASK_GRAPH_TASKS];
+
+    printf("%-20s %8s %10s %10s %10s %10s\n", "task", "chunks", "start", "end", "wall", "work");
+    for (int32 task_index = 0; task_index < graph->num_tasks; task_index++) {
+        Task_Graph_Task *task = &graph->tasks[task_index];
+        real64 start_seconds = graph->end_seconds;
+        real64 end_seconds = graph->start_seconds;
+        real64 work_seconds = 0;
+        for (int32 chunk_index = 0; chunk_index < task->num_chunks; chunk_index++) {
+            Task_Graph_Chunk *chunk = &task->chunks[chunk_index];
+            start_seconds = fmin(start_seconds, chunk->start_seconds);
+            end_seconds = fmax(end_seconds, chunk->end_seconds);
+            work_seconds += chunk->end_seconds - chunk->start_seconds;
+        }
+        if (task->num_chunks == 0) {
+            start_seconds = graph->start_seconds;
+            end_seconds = graph->start_seconds;
+        }
+        task_start_seconds[task_index] = start_seconds - graph->start_seconds;
+        task_seconds[task_index] = end_seconds - start_seconds;
+        path_seconds[task_index] = task_seconds[task_index];
+        path_previous[task_index] = -1;
+        printf("%-20s %8d %10.6f %10.6f %10.6f %10.6f\n", task->name, task->num_chunks, task_start_seconds[task_index],
+               end_seconds - graph->start_seconds, task_seconds[task_index], work_seconds);
+    }
+
+    // NOTE: dependencies point backwards, so the longest path to every task is known before its dependents
+    //       are looked at
+    int32 last_task_index = -1;
+    for (int32 task_index = 0; task_index < graph->num_tasks; task_index++) {
+        Task_Graph_Task *task = &graph->tasks[task_index];
+        for (int32 dependent_index = 0; dependent_index < task->num_dependents; dependent_index++) {
+            int32 dependent_task_index = task->dependents[dependent_index];
+            real64 seconds = path_seconds[task_index] + task_seconds[dependent_task_index];
+            if (seconds > path_seconds[dependent_task_index]) {
+                path_seconds[dependent_task_index] = seconds;
+                path_previous[dependent_task_index] = task_index;
+            }
+        }
+        if (last_task_index < 0 || path_seconds[task_index] > path_seconds[last_task_index]) {
+            last_task_index = task_index;
+        }
+    }
+
+    if (last_task_index >= 0) {
+        int32 path[MAX_TASK_GRAPH_TASKS];
+        int32 path_length = 0;
+        for (int32 task_index = last_task_index; task_index >= 0; task_index = path_previous[task_index]) {
+            path[path_length++] = task_index;
+        }
+        printf("Critical path: ");
+        for (int32 path_index = path_length - 1; path_index >= 0; path_index--) {
+            printf("%s%s", graph->tasks[path[path_index]].name, (path_index > 0) ? " -> " : "");
+        }
+        printf(" (%f of %f seconds).\n", path_seconds[last_task_index], graph->end_seconds - graph->start_seconds);
+    }
+}
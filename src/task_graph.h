@@ -0,0 +1,51 @@
+#ifndef TASK_GRAPH_H
+
+#include "work_queue.h"
+
+// NOTE: a small graph of tasks with dependencies between them, run on a work queue. every task is a
+//       parallel_for()-style range [0, count) that gets split into chunks, and a task's chunks are only
+//       queued once every task it depends on has finished, so independent tasks run at the same time.
+//       the graph is rebuilt every time it's run; it's meant for a handful of tasks, not thousands.
+
+#define MAX_TASK_GRAPH_TASKS 32
+#define MAX_TASK_DEPENDENTS 8
+#define MAX_TASK_CHUNKS 64
+
+struct Task_Graph;
+
+struct Task_Graph_Chunk {
+    Task_Graph *graph;
+    int32 task_index;
+    int32 first;
+    int32 last;
+    real64 start_seconds;
+    real64 end_seconds;
+};
+
+struct Task_Graph_Task {
+    char *name;
+    Parallel_For_Callback *callback;
+    void *data;
+    int32 count;
+
+    int32 dependents[MAX_TASK_DEPENDENTS];
+    int32 num_dependents;
+    int32 num_dependencies;
+    std::atomic<int32> num_unfinished_dependencies;
+
+    Task_Graph_Chunk chunks[MAX_TASK_CHUNKS];
+    int32 num_chunks;
+    std::atomic<int32> num_unfinished_chunks;
+};
+
+struct Task_Graph {
+    Work_Queue *work_queue;
+    Task_Graph_Task tasks[MAX_TASK_GRAPH_TASKS];
+    int32 num_tasks;
+    std::atomic<int32> num_unfinished_tasks;
+    real64 start_seconds;
+    real64 end_seconds;
+};
+
+#define TASK_GRAPH_H
+#endif
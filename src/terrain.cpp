@@ -1,25 +1,11 @@
 #include "main.h"
 #include "terrain.h"
-#include <random>
-
-int32 get_array_index(int32 row_index, int32 column_index, int32 max_x, int32 max_y) {
-    if (row_index < 0) {
-        row_index = max_y + row_index;
-    } else if (row_index >= max_y) {
-        row_index %= max_y;
-    }
-    
-    if (column_index < 0) {
-        column_index = max_x + column_index;
-    } else if (column_index >= max_x) {
-        column_index %= max_x;
-    }
-
-    int32 final_index = row_index*max_x + column_index;
-    assert(final_index < max_x*max_y);
-    
-    return final_index;
-}
+#include "work_queue.h"
+#include "rng.h"
+#include "terrain_kernels.h"
+#include "task_graph.h"
+#include "grid.h"
+#include "quantized_heights.h"
 
 bool32 is_whitespace(char c) {
     return (c == ' ' || c == '\t' || c == '\r' || c == '\n');
@@ -47,14 +33,445 @@ char *get_next_word(char **buffer) {
     return begin;
 }
 
-void init_terrain(Terrain *terrain, char *initial_heights_file, real32 h, real32 max_random_height) {
-    real64 terrain_start_time = get_seconds();
-    std::default_random_engine generator;
-    std::normal_distribution<real32> distribution(0.0, max_random_height);
+struct Diamond_Square_Pass {
+    Terrain *terrain;
+    real32 *row_max_heights;
+    Philox_Key key;
+    real32 max_random_height;
+    int32 level;
+    int32 dx;
+    int32 dy;
+    real32 s;
+
+    // NOTE: the row-major rows that the pass reads and writes. rows[0] is row first_row_index of the grid,
+    //       which lets a pass work on a window of the grid (see out_of_core.cpp) as well as all of
+    //       height_data.
+    real32 *rows;
+    int32 first_row_index;
+    // NOTE: added to the [first, last) ranges given to do_square_rows() and do_diamond_rows()
+    int32 first_pass_row;
+
+    // NOTE: where the grid is in a bigger grid (see terrain_chunks.cpp). the noise is picked by the
+    //       position in the bigger grid, and if has_shared_edges is set the cells on the edges are only
+    //       generated from the other cells on the same edge, so that two grids that share an edge always
+    //       agree on it.
+    int32 global_row_offset;
+    int32 global_column_offset;
+    bool32 has_shared_edges;
+
+    // NOTE: only the cells in these columns (inclusive) are generated, see update_control_height()
+    int32 min_column_index;
+    int32 max_column_index;
+};
+
+// NOTE: rounds towards negative infinity, unlike /
+inline int32 floor_divide(int32 a, int32 b) {
+    int32 result = a / b;
+    if ((a % b != 0) && ((a < 0) != (b < 0))) {
+        result--;
+    }
+    return result;
+}
+
+// NOTE: the range [*first, *end) of the k in [0, count) for which first_index + k*step is in
+//       [min_index, max_index]
+inline void clip_index_sequence(int32 first_index, int32 step, int32 count, int32 min_index, int32 max_index,
+                                int32 *first, int32 *end) {
+    *first = -floor_divide(first_index - min_index, step);
+    *end = floor_divide(max_index - first_index, step) + 1;
+    if (*first < 0) *first = 0;
+    if (*end > count) *end = count;
+}
+
+inline void clip_cells_to_pass_columns(Diamond_Square_Pass *pass, int32 first_column_index, int32 num_cells,
+                                       int32 *first_cell, int32 *end_cell) {
+    clip_index_sequence(first_column_index, pass->dx, num_cells, pass->min_column_index, pass->max_column_index,
+                        first_cell, end_cell);
+}
+
+inline real32 *get_pass_row(Diamond_Square_Pass *pass, int32 row_index) {
+    return pass->rows + ((int64) (row_index - pass->first_row_index))*pass->terrain->x_resolution;
+}
+
+Terrain_Kernels terrain_kernels;
+
+// NOTE: whether generating and writing heights prints how long it took. the batch generator (batch.cpp)
+//       turns this off, since it times every job itself.
+bool32 print_terrain_timings = true;
+
+// NOTE: picks the kernels used by the diamond-square passes. if this is never called, init_terrain() uses
+//       the best ones the CPU supports.
+void init_terrain_kernels(Simd_Level simd_level) {
+    terrain_kernels = get_terrain_kernels(simd_level);
+}
+
+// NOTE: noise for the num_cells cells of a row that start at first_column_index and are dx apart
+void fill_row_noise(Diamond_Square_Pass *pass, int32 row_index, int32 first_column_index, int32 num_cells,
+                    real32 *noise) {
+    terrain_kernels.gaussian_row(noise, pass->key, pass->level, pass->global_row_offset + row_index,
+                                 pass->global_column_offset + first_column_index, pass->dx, num_cells);
+    for (int32 k = 0; k < num_cells; k++) {
+        noise[k] = pass->s*(pass->max_random_height*noise[k]);
+    }
+}
+
+// NOTE: the diamond step for a single cell of a grid in any layout
+template <typename Layout>
+real32 generate_diamond_cell(Diamond_Square_Pass *pass, int32 row_index, int32 column_index, real32 random_number) {
+    Terrain *terrain = pass->terrain;
+    int32 x_offset = pass->dx / 2;
+    int32 y_offset = pass->dy / 2;
+
+    // NOTE: the neighbours that are off the grid are skipped, so nothing here ever needs to wrap
+    Grid_View<real32, Unchecked_Boundary, Layout> heights =
+        make_grid_view<Unchecked_Boundary, Layout>(terrain->height_data, terrain->x_resolution, terrain->y_resolution);
+    real32 sum = 0;
+    int32 count = 0;
+
+    // top
+    if (row_index > 0) {
+        sum += heights.at(row_index - y_offset, column_index);
+        count++;
+    }
+
+    // right
+    if (column_index < (terrain->x_resolution - 1)) {
+        sum += heights.at(row_index, column_index + x_offset);
+        count++;
+    }
+
+    // bottom
+    if (row_index < (terrain->y_resolution - 1)) {
+        sum += heights.at(row_index + y_offset, column_index);
+        count++;
+    }
+
+    if (column_index > 0) {
+        sum += heights.at(row_index, column_index - x_offset);
+        count++;
+    }
+
+    real32 generated_height = (sum / count) + random_number;
+    heights.at(row_index, column_index) = generated_height;
+    return generated_height;
+}
+
+// NOTE: the square and diamond steps for layouts that don't have contiguous rows, so they can't use the
+//       row kernels. the arithmetic is the same as the kernels', so the heights are the same too.
+template <typename Layout>
+void do_square_rows_scalar(Diamond_Square_Pass *pass, int32 first, int32 last) {
+    Terrain *terrain = pass->terrain;
+    int32 dx = pass->dx;
+    int32 dy = pass->dy;
+    int32 x_offset = dx / 2;
+    int32 y_offset = dy / 2;
+    int32 num_cells = (terrain->x_resolution - 1) / dx;
+    real32 *noise = (real32 *) malloc(num_cells * sizeof(real32));
+    Grid_View<real32, Unchecked_Boundary, Layout> heights =
+        make_grid_view<Unchecked_Boundary, Layout>(terrain->height_data, terrain->x_resolution, terrain->y_resolution);
+
+    for (int32 n = first; n < last; n++) {
+        int32 row_index = y_offset + n*dy;
+        fill_row_noise(pass, row_index, x_offset, num_cells, noise);
+
+        real32 row_max_height = pass->row_max_heights[row_index];
+        for (int32 k = 0; k < num_cells; k++) {
+            int32 column_index = x_offset + k*dx;
+            real32 top_left = heights.at(row_index - y_offset, column_index - x_offset);
+            real32 top_right = heights.at(row_index - y_offset, column_index + x_offset);
+            real32 bottom_right = heights.at(row_index + y_offset, column_index + x_offset);
+            real32 bottom_left = heights.at(row_index + y_offset, column_index - x_offset);
+            real32 generated_height = (top_left + top_right + bottom_right + bottom_left) / 4 + noise[k];
+            heights.at(row_index, column_index) = generated_height;
+            row_max_height = fmaxf(row_max_height, generated_height);
+        }
+        pass->row_max_heights[row_index] = row_max_height;
+    }
+
+    free(noise);
+}
+
+template <typename Layout>
+void do_diamond_rows_scalar(Diamond_Square_Pass *pass, int32 first, int32 last) {
+    Terrain *terrain = pass->terrain;
+    int32 dx = pass->dx;
+    int32 row_increment = pass->dy / 2;
+    real32 *noise = (real32 *) malloc(((terrain->x_resolution - 1) / dx + 1) * sizeof(real32));
+
+    for (int32 n = first; n < last; n++) {
+        int32 row_index = n*row_increment;
+        int32 start_column_index = ((row_index/row_increment + 1) % 2) * (dx / 2);
+        int32 num_cells = (terrain->x_resolution - 1 - start_column_index) / dx + 1;
+        fill_row_noise(pass, row_index, start_column_index, num_cells, noise);
+
+        real32 row_max_height = pass->row_max_heights[row_index];
+        for (int32 k = 0; k < num_cells; k++) {
+            real32 generated_height = generate_diamond_cell<Layout>(pass, row_index, start_column_index + k*dx, noise[k]);
+            row_max_height = fmaxf(row_max_height, generated_height);
+        }
+        pass->row_max_heights[row_index] = row_max_height;
+    }
+
+    free(noise);
+}
+
+// NOTE: the first pass of diamond-square. the caller still has to point rows at the heights.
+Diamond_Square_Pass make_diamond_square_pass(Terrain *terrain, real32 *row_max_heights, real32 smoothing_factor,
+                                             real32 max_random_height, uint64 seed) {
+    if (!terrain_kernels.square_row) {
+        init_terrain_kernels(get_cpu_simd_level());
+    }
+
+    Diamond_Square_Pass pass = {};
+    pass.terrain = terrain;
+    pass.row_max_heights = row_max_heights;
+    pass.key = make_philox_key(seed);
+    pass.max_random_height = max_random_height;
+    pass.level = terrain->resolution_exponent - terrain->low_res_grid_size_exponent;
+    pass.dx = (terrain->x_resolution - 1) / (terrain->max_x - 1);
+    pass.dy = (terrain->y_resolution - 1) / (terrain->max_y - 1);
+    pass.s = smoothing_factor;
+    pass.min_column_index = 0;
+    pass.max_column_index = terrain->x_resolution - 1;
+    return pass;
+}
+
+// NOTE: diamond step for a cell on the border of a row-major grid. top_row and bottom_row aren't read when
+//       they're off the grid.
+real32 generate_diamond_border_cell(Diamond_Square_Pass *pass, int32 row_index, int32 column_index,
+                                    real32 *top_row, real32 *row, real32 *bottom_row, real32 random_number) {
+    Terrain *terrain = pass->terrain;
+    int32 x_offset = pass->dx / 2;
+
+    real32 sum = 0;
+    int32 count = 0;
+
+    if (pass->has_shared_edges) {
+        bool32 is_on_row_edge = (row_index == 0 || row_index == terrain->y_resolution - 1);
+        if (is_on_row_edge) {
+            sum = row[column_index + x_offset] + row[column_index - x_offset];
+        } else {
+            sum = top_row[column_index] + bottom_row[column_index];
+        }
+
+        real32 generated_height = (sum / 2) + random_number;
+        row[column_index] = generated_height;
+        return generated_height;
+    }
+
+    // top
+    if (row_index > 0) {
+        sum += top_row[column_index];
+        count++;
+    }
+
+    // right
+    if (column_index < (terrain->x_resolution - 1)) {
+        sum += row[column_index + x_offset];
+        count++;
+    }
+
+    // bottom
+    if (row_index < (terrain->y_resolution - 1)) {
+        sum += bottom_row[column_index];
+        count++;
+    }
+
+    if (column_index > 0) {
+        sum += row[column_index - x_offset];
+        count++;
+    }
+
+    real32 generated_height = (sum / count) + random_number;
+    row[column_index] = generated_height;
+    return generated_height;
+}
+
+// NOTE: square step for the rows [first, last) of the current pass, where row n is at
+//       row_index = dy/2 + (first_pass_row + n)*dy. every square cell has all 4 corners, so there's no
+//       border case.
+void do_square_rows(void *data, int32 first, int32 last) {
+    Diamond_Square_Pass *pass = (Diamond_Square_Pass *) data;
+    Terrain *terrain = pass->terrain;
+    if (terrain->height_layout == HEIGHT_LAYOUT_TILED) {
+        do_square_rows_scalar<Tiled_Layout>(pass, first, last);
+        return;
+    }
+
+    int32 dx = pass->dx;
+    int32 dy = pass->dy;
+    int32 num_cells = (terrain->x_resolution - 1) / dx;
+    real32 *noise = (real32 *) malloc(num_cells * sizeof(real32));
+
+    int32 first_cell, end_cell;
+    clip_cells_to_pass_columns(pass, dx / 2, num_cells, &first_cell, &end_cell);
+    if (end_cell <= first_cell) {
+        free(noise);
+        return;
+    }
+
+    for (int32 n = pass->first_pass_row + first; n < pass->first_pass_row + last; n++) {
+        int32 row_index = dy / 2 + n*dy;
+        int32 first_column_index = dx / 2 + first_cell*dx;
+        fill_row_noise(pass, row_index, first_column_index, end_cell - first_cell, noise);
 
+        real32 *row = get_pass_row(pass, row_index);
+        real32 *top_row = get_pass_row(pass, row_index - dy / 2);
+        real32 *bottom_row = get_pass_row(pass, row_index + dy / 2);
+        pass->row_max_heights[row_index] = terrain_kernels.square_row(row + first_column_index,
+                                                                      top_row + first_cell*dx,
+                                                                      bottom_row + first_cell*dx, noise,
+                                                                      end_cell - first_cell, dx,
+                                                                      pass->row_max_heights[row_index]);
+    }
+
+    free(noise);
+}
+
+// NOTE: diamond step for the rows [first, last) of the current pass, where row n is at
+//       row_index = (first_pass_row + n)*(dy/2)
+void do_diamond_rows(void *data, int32 first, int32 last) {
+    Diamond_Square_Pass *pass = (Diamond_Square_Pass *) data;
+    Terrain *terrain = pass->terrain;
+    if (terrain->height_layout == HEIGHT_LAYOUT_TILED) {
+        do_diamond_rows_scalar<Tiled_Layout>(pass, first, last);
+        return;
+    }
+
+    int32 dx = pass->dx;
+    int32 dy = pass->dy;
+    int32 x_resolution = terrain->x_resolution;
+    int32 row_increment = dy / 2;
+    real32 *noise = (real32 *) malloc(((x_resolution - 1) / dx + 1) * sizeof(real32));
+
+    for (int32 n = pass->first_pass_row + first; n < pass->first_pass_row + last; n++) {
+        int32 row_index = n*row_increment;
+        real32 row_max_height = pass->row_max_heights[row_index];
+
+        int32 start_column_index = ((row_index/row_increment + 1) % 2) * (dx / 2);
+        int32 num_cells = (x_resolution - 1 - start_column_index) / dx + 1;
+        int32 first_cell, end_cell;
+        clip_cells_to_pass_columns(pass, start_column_index, num_cells, &first_cell, &end_cell);
+        if (end_cell <= first_cell) {
+            continue;
+        }
+        // NOTE: noise[k] is for cell first_cell + k
+        fill_row_noise(pass, row_index, start_column_index + first_cell*dx, end_cell - first_cell, noise);
+
+        real32 *row = get_pass_row(pass, row_index);
+        real32 *top_row = (row_index > 0) ? get_pass_row(pass, row_index - row_increment) : NULL;
+        real32 *bottom_row = (row_index < terrain->y_resolution - 1) ? get_pass_row(pass, row_index + row_increment) : NULL;
+
+        if (row_index == 0 || row_index == terrain->y_resolution - 1) {
+            for (int32 k = first_cell; k < end_cell; k++) {
+                real32 generated_height = generate_diamond_border_cell(pass, row_index, start_column_index + k*dx,
+                                                                       top_row, row, bottom_row,
+                                                                       noise[k - first_cell]);
+                row_max_height = fmaxf(row_max_height, generated_height);
+            }
+        } else {
+            // NOTE: rows that start at column 0 have a cell on both the left and right borders
+            int32 first_interior_cell = first_cell;
+            int32 end_interior_cell = end_cell;
+            if (start_column_index == 0 && first_cell == 0) {
+                first_interior_cell = 1;
+                real32 generated_height = generate_diamond_border_cell(pass, row_index, 0,
+                                                                       top_row, row, bottom_row, noise[0]);
+                row_max_height = fmaxf(row_max_height, generated_height);
+            }
+            if (start_column_index == 0 && end_cell == num_cells) {
+                end_interior_cell = num_cells - 1;
+                real32 generated_height = generate_diamond_border_cell(pass, row_index, x_resolution - 1,
+                                                                       top_row, row, bottom_row,
+                                                                       noise[num_cells - 1 - first_cell]);
+                row_max_height = fmaxf(row_max_height, generated_height);
+            }
+
+            if (end_interior_cell > first_interior_cell) {
+                int32 first_interior_column = start_column_index + first_interior_cell*dx;
+                row_max_height = terrain_kernels.diamond_row(row + first_interior_column,
+                                                             top_row + first_interior_column,
+                                                             bottom_row + first_interior_column,
+                                                             noise + (first_interior_cell - first_cell),
+                                                             end_interior_cell - first_interior_cell, dx, dx / 2,
+                                                             row_max_height);
+            }
+        }
+
+        pass->row_max_heights[row_index] = row_max_height;
+    }
+
+    free(noise);
+}
+
+// NOTE: runs every pass of diamond-square from the one in pass, which must already point at the heights
+void run_diamond_square_passes(Diamond_Square_Pass *pass, real32 smoothing_factor, Work_Queue *work_queue) {
+    Terrain *terrain = pass->terrain;
+    while (pass->dx > 1) {
+        // NOTE: square
+        int32 num_square_rows = (terrain->y_resolution - 1) / pass->dy;
+        parallel_for(work_queue, num_square_rows, do_square_rows, pass);
+
+        // NOTE: diamond
+        int32 num_diamond_rows = (terrain->y_resolution - 1) / (pass->dy / 2) + 1;
+        parallel_for(work_queue, num_diamond_rows, do_diamond_rows, pass);
+
+        pass->level--;
+        pass->dx /= 2;
+        pass->dy /= 2;
+        pass->s *= smoothing_factor;
+    }
+}
+
+// NOTE: generate_grid_indices() for the rows of quads [first_row_index, last_row_index)
+void generate_grid_index_rows(uint32 *indices, int32 width, int32 height,
+                              int32 first_row_index, int32 last_row_index) {
+    for (int32 row_index = first_row_index; row_index < last_row_index; row_index++) {
+        uint32 top_row_start = (uint32) get_grid_index<Unchecked_Boundary>(row_index, 0, width, height);
+        uint32 bottom_row_start = top_row_start + width;
+        uint32 *quad_indices = indices + 6*(int64) row_index*(width - 1);
+        for (int32 column_index = 0; column_index < width - 1; column_index++) {
+            // triangle 1
+            uint32 p1, p2, p3;
+            p1 = bottom_row_start + column_index + 1;
+            p2 = top_row_start + column_index + 1;
+            p3 = top_row_start + column_index;
+
+            // triangle 2
+            uint32 p4, p5, p6;
+            p4 = p1;
+            p5 = p3;
+            p6 = bottom_row_start + column_index;
+
+            quad_indices[0] = p1;
+            quad_indices[1] = p2;
+            quad_indices[2] = p3;
+            quad_indices[3] = p4;
+            quad_indices[4] = p5;
+            quad_indices[5] = p6;
+            quad_indices += 6;
+        }
+    }
+}
+
+// NOTE: two triangles per quad of a width x height grid of vertices, in row-major order
+void generate_grid_indices(uint32 *indices, int32 width, int32 height) {
+    generate_grid_index_rows(indices, width, height, 0, height - 1);
+}
+
+void set_terrain_resolution_exponent(Terrain *terrain, int32 resolution_exponent) {
+    assert(resolution_exponent >= terrain->low_res_grid_size_exponent);
+    terrain->resolution_exponent = resolution_exponent;
+    terrain->x_resolution = (1 << resolution_exponent) + 1;
+    terrain->y_resolution = terrain->x_resolution;
+}
+
+// NOTE: reads the low-res grid and the resolution exponent from an initial heights file
+void load_initial_heights(Terrain *terrain, char *initial_heights_file) {
     real64 start_time = get_seconds();
     // NOTE: get the data points for the low-res grid
     char *initial_heights_buffer = read_file(initial_heights_file);
+    char *initial_heights_file_contents = initial_heights_buffer;
 
     // NOTE: get low res grid exponent
     char *current_word = get_next_word(&initial_heights_buffer);
@@ -68,16 +485,14 @@ void init_terrain(Terrain *terrain, char *initial_heights_file, real32 h, real32
     int32 resolution_exponent = atoi(current_word);
     assert(resolution_exponent >= low_res_grid_size_exponent);
 
-    int32 grid_size = (int32) (powf(2.0f, (real32) low_res_grid_size_exponent)) + 1;
-    int32 resolution = (int32) (powf(2.0f, (real32) resolution_exponent)) + 1;
+    int32 grid_size = (1 << low_res_grid_size_exponent) + 1;
     
+    terrain->low_res_grid_size_exponent = low_res_grid_size_exponent;
     terrain->max_x = grid_size;
     terrain->max_y = grid_size;
-    terrain->x_resolution = resolution;
-    terrain->y_resolution = resolution;
+    set_terrain_resolution_exponent(terrain, resolution_exponent);
 
     terrain->low_res_height_data = (real32 *) malloc(terrain->max_x * terrain->max_y * sizeof(real32));
-    terrain->height_data = (real32 *) malloc(terrain->x_resolution * terrain->y_resolution * sizeof(real32));
         
     int32 low_res_height_data_length = terrain->max_x*terrain->max_y;
     int32 current_index = 0;
@@ -93,279 +508,765 @@ void init_terrain(Terrain *terrain, char *initial_heights_file, real32 h, real32
         }
     }
     assert(current_index == low_res_height_data_length);
+    delete[] initial_heights_file_contents;
     printf("Completed reading and parsing initial heights file in %f seconds.\n", get_seconds() - start_time);
-    
+}
+
+inline real32 get_height(Terrain *terrain, int32 row_index, int32 column_index) {
+    if (terrain->height_layout == HEIGHT_LAYOUT_TILED) {
+        return terrain->height_data[get_grid_index<Unchecked_Boundary, Tiled_Layout>(row_index, column_index,
+                                                                                      terrain->x_resolution,
+                                                                                      terrain->y_resolution)];
+    } else {
+        return terrain->height_data[get_grid_index<Unchecked_Boundary>(row_index, column_index,
+                                                                       terrain->x_resolution,
+                                                                       terrain->y_resolution)];
+    }
+}
+
+int64 get_height_data_length(Terrain *terrain) {
+    if (terrain->height_layout == HEIGHT_LAYOUT_TILED) {
+        return Tiled_Layout::get_storage_size(terrain->x_resolution, terrain->y_resolution);
+    } else {
+        return Row_Major_Layout::get_storage_size(terrain->x_resolution, terrain->y_resolution);
+    }
+}
+
+// NOTE: replaces tiled height_data with a row-major copy. the tiles are walked in storage order, so the
+//       reads are sequential and only the writes jump around.
+void convert_heights_to_row_major(Terrain *terrain) {
+    if (terrain->height_layout == HEIGHT_LAYOUT_ROW_MAJOR) {
+        return;
+    }
+
+    int32 width = terrain->x_resolution;
+    int32 height = terrain->y_resolution;
+    real32 *row_major_heights = (real32 *) malloc(Row_Major_Layout::get_storage_size(width, height) * sizeof(real32));
+    int32 tiles_per_row = Tiled_Layout::get_tiles_per_side(width);
+    int32 tiles_per_column = Tiled_Layout::get_tiles_per_side(height);
+    real32 *tile = terrain->height_data;
+    for (int32 tile_row_index = 0; tile_row_index < tiles_per_column; tile_row_index++) {
+        for (int32 tile_column_index = 0; tile_column_index < tiles_per_row; tile_column_index++) {
+            int32 first_row_index = tile_row_index << HEIGHT_TILE_SHIFT;
+            int32 first_column_index = tile_column_index << HEIGHT_TILE_SHIFT;
+            for (uint32 index_in_tile = 0; index_in_tile < HEIGHT_TILE_SIZE*HEIGHT_TILE_SIZE; index_in_tile++) {
+                int32 row_index = first_row_index + (int32) compact_bits(index_in_tile >> 1);
+                int32 column_index = first_column_index + (int32) compact_bits(index_in_tile);
+                if (row_index < height && column_index < width) {
+                    row_major_heights[((int64) row_index)*width + column_index] = tile[index_in_tile];
+                }
+            }
+            tile += HEIGHT_TILE_SIZE*HEIGHT_TILE_SIZE;
+        }
+    }
+
+    free(terrain->height_data);
+    terrain->height_data = row_major_heights;
+    terrain->height_data_capacity = Row_Major_Layout::get_storage_size(width, height);
+    terrain->height_layout = HEIGHT_LAYOUT_ROW_MAJOR;
+}
+
+template <typename Layout>
+void overlay_low_res_heights(Terrain *terrain) {
     // NOTE: yeah, having separate dx and dy is pointless since they're always the same.
     //       i tried handling non-square grids, but ran into issues with this implementation..
     int32 dx = (terrain->x_resolution - 1) / (terrain->max_x - 1);
     int32 dy = (terrain->y_resolution - 1) / (terrain->max_y - 1);
 
-    // NOTE: overlay the low-res data points onto the high-res grid
-    start_time = get_seconds();
+    Grid_View<real32, Unchecked_Boundary, Layout> heights =
+        make_grid_view<Unchecked_Boundary, Layout>(terrain->height_data, terrain->x_resolution, terrain->y_resolution);
     for (int32 row_index = 0; row_index < terrain->y_resolution; row_index += dy) {
         for (int32 column_index = 0; column_index < terrain->x_resolution; column_index += dx) {
-            int32 low_res_height_index = get_array_index(row_index / dy, column_index / dx, terrain->max_x, terrain->max_y);
-            real32 low_res_height = terrain->low_res_height_data[low_res_height_index];
-            int32 height_index = get_array_index(row_index, column_index, terrain->x_resolution, terrain->y_resolution);
-            terrain->height_data[height_index] = low_res_height;
+            int64 low_res_height_index = get_grid_index<Unchecked_Boundary>(row_index / dy, column_index / dx,
+                                                                            terrain->max_x, terrain->max_y);
+            heights.at(row_index, column_index) = terrain->low_res_height_data[low_res_height_index];
         }
     }
-    printf("Completed setting initial points in %f seconds.\n", get_seconds() - start_time);
+}
+
+// NOTE: fills height_data (in terrain->height_layout) from the low-res grid. work_queue can be NULL, in
+//       which case everything is done on the calling thread. the generated heights only depend on the
+//       initial heights, h, max_random_height and seed; they're the same no matter how many threads the
+//       queue has or which layout they're stored in. height_data is only allocated if it's NULL or smaller
+//       than height_data_capacity says, so a terrain can be generated over and over into the same memory.
+void generate_height_data(Terrain *terrain, real32 h, real32 max_random_height, uint64 seed, Work_Queue *work_queue) {
+    int64 height_data_length = get_height_data_length(terrain);
+    if (!terrain->height_data || terrain->height_data_capacity < height_data_length) {
+        free(terrain->height_data);
+        terrain->height_data = (real32 *) malloc(height_data_length * sizeof(real32));
+        terrain->height_data_capacity = height_data_length;
+    }
+    terrain->h = h;
+    terrain->max_random_height = max_random_height;
+    terrain->seed = seed;
+
+    // NOTE: overlay the low-res data points onto the high-res grid
+    real64 start_time = get_seconds();
+    if (terrain->height_layout == HEIGHT_LAYOUT_TILED) {
+        overlay_low_res_heights<Tiled_Layout>(terrain);
+    } else {
+        overlay_low_res_heights<Row_Major_Layout>(terrain);
+    }
+    if (print_terrain_timings) {
+        printf("Completed setting initial points in %f seconds.\n", get_seconds() - start_time);
+    }
     
     terrain->max_height = FLT_MIN;
     if (terrain->max_x != terrain->x_resolution ||
         terrain->max_y != terrain->y_resolution) {
         // NOTE: do diamond-square algorithm
         real32 smoothing_factor = powf(2.0f, -h);
-        real32 s = smoothing_factor;
 
         start_time = get_seconds();
-        
-        while (dx > 1) {
-            // NOTE: square
-            for (int32 row_index = dy / 2; row_index < terrain->y_resolution; row_index += dy) {
-                for (int32 column_index = dx / 2; column_index < terrain->x_resolution; column_index += dx) {
-                    int32 x_offset = dx / 2;
-                    int32 y_offset = dy / 2;
-                    real32 top_left = terrain->height_data[get_array_index(row_index - y_offset,
-                                                                          column_index - x_offset,
-                                                                          terrain->x_resolution, terrain->y_resolution)];
-                    real32 top_right = terrain->height_data[get_array_index(row_index - y_offset,
-                                                                           column_index + x_offset,
-                                                                           terrain->x_resolution, terrain->y_resolution)];
-                    real32 bottom_right = terrain->height_data[get_array_index(row_index + y_offset,
-                                                                              column_index + x_offset,
-                                                                              terrain->x_resolution, terrain->y_resolution)];
-                    real32 bottom_left = terrain->height_data[get_array_index(row_index + y_offset,
-                                                                             column_index - x_offset,
-                                                                             terrain->x_resolution, terrain->y_resolution)];
-
-                    real32 random_number = s*distribution(generator);
-                    real32 generated_height = (top_left + top_right + bottom_right + bottom_left) / 4 + random_number;
-                    int32 array_index = get_array_index(row_index, column_index, terrain->x_resolution, terrain->y_resolution);
-                    terrain->height_data[array_index] = generated_height;
-                    terrain->max_height = fmaxf(terrain->max_height, generated_height);
-                }
+
+        // NOTE: the max of every row is kept separately so that threads never write to the same value
+        real32 *row_max_heights = (real32 *) malloc(terrain->y_resolution * sizeof(real32));
+        for (int32 row_index = 0; row_index < terrain->y_resolution; row_index++) {
+            row_max_heights[row_index] = FLT_MIN;
+        }
+
+        Diamond_Square_Pass pass = make_diamond_square_pass(terrain, row_max_heights, smoothing_factor,
+                                                            max_random_height, seed);
+        pass.rows = terrain->height_data;
+
+        run_diamond_square_passes(&pass, smoothing_factor, work_queue);
+
+        for (int32 row_index = 0; row_index < terrain->y_resolution; row_index++) {
+            terrain->max_height = fmaxf(terrain->max_height, row_max_heights[row_index]);
+        }
+        free(row_max_heights);
+
+        char *kernels_name = get_simd_level_name(terrain_kernels.simd_level);
+        if (terrain->height_layout == HEIGHT_LAYOUT_TILED) {
+            kernels_name = "tiled, scalar";
+        }
+        if (print_terrain_timings) {
+            printf("Completed diamond-square (%s) in %f seconds.\n", kernels_name, get_seconds() - start_time);
+        }
+    }
+}
+
+// NOTE: replaces height_data with quantized heights, whose error is at most max_error where 16 bits are
+//       enough for that. the mesh and the heightmap can still be made from them, but nothing that changes
+//       the heights can be done afterwards.
+void quantize_terrain_heights(Terrain *terrain, real32 max_error, Work_Queue *work_queue) {
+    assert(terrain->height_data && !terrain->quantized_heights);
+    convert_heights_to_row_major(terrain);
+
+    real64 start_time = get_seconds();
+    terrain->quantized_heights = (Quantized_Heights *) malloc(sizeof(Quantized_Heights));
+    quantize_heights(terrain->quantized_heights, terrain->height_data, terrain->x_resolution, terrain->y_resolution,
+                     max_error, work_queue);
+    int64 float_size = get_height_data_length(terrain)*sizeof(real32);
+    free(terrain->height_data);
+    terrain->height_data = NULL;
+    terrain->height_data_capacity = 0;
+
+    Quantized_Heights *quantized_heights = terrain->quantized_heights;
+    int64 quantized_size = get_quantized_heights_size(quantized_heights);
+    printf("Quantized heights in %f seconds: %.1f MB instead of %.1f MB (%.1f%% saved), %d of %d tiles 16-bit, "
+           "max error %f.\n", get_seconds() - start_time, quantized_size / (1024.0*1024.0),
+           float_size / (1024.0*1024.0), 100.0*(1.0 - (real64) quantized_size / float_size),
+           quantized_heights->num_16_bit_tiles, quantized_heights->tiles_per_row*quantized_heights->tiles_per_column,
+           quantized_heights->measured_max_error);
+}
+
+// NOTE: everything the stages of build_terrain_mesh() share. each stage is a task over a range of rows.
+#define RTIN_ROW_TASK_LEVELS 3
+
+struct Build_Level_Work {
+    Terrain *terrain;
+    int32 level_index;
+};
+
+struct Build_Mesh_Work {
+    Terrain *terrain;
+    // NOTE: from terrain->vertex_writer
+    void *vertex_buffer;
+    // NOTE: each level of the LOD quadtree, and each of the finest RTIN_ROW_TASK_LEVELS levels of the RTIN
+    //       errors, is a task that needs to know its level
+    Build_Level_Work lod_levels[MAX_TASK_GRAPH_TASKS];
+    Build_Level_Work rtin_levels[RTIN_ROW_TASK_LEVELS];
+};
+
+// NOTE: vertices for a row of heights, with x = column and y = height. z is row_index - (height - 1), so the
+//       grid lies in the xz plane with its last row at z = 0. we do it in this order for the default GLM
+//       coordinate space, which is +x = right, +y = up, +z = out of the screen.
+inline void generate_vertex_row(real32 *vertex_row, real32 *height_row, int32 width, int32 height,
+                                int32 row_index) {
+    real32 z = (real32) -height + row_index + 1;
+    for (int32 column_index = 0; column_index < width; column_index++) {
+        vertex_row[3*column_index]     = (real32) column_index;
+        vertex_row[3*column_index + 1] = height_row[column_index];
+        vertex_row[3*column_index + 2] = z;
+    }
+}
+
+static void do_build_vertex_rows(void *data, int32 first, int32 last) {
+    Terrain *terrain = ((Build_Mesh_Work *) data)->terrain;
+    int32 width = terrain->x_resolution;
+    real32 *decoded_height_row = NULL;
+    if (terrain->quantized_heights) {
+        decoded_height_row = (real32 *) malloc(width * sizeof(real32));
+    }
+    for (int32 row_index = first; row_index < last; row_index++) {
+        real32 *height_row;
+        if (terrain->quantized_heights) {
+            decode_quantized_height_row(terrain->quantized_heights, row_index, decoded_height_row);
+            height_row = decoded_height_row;
+        } else {
+            height_row = terrain->height_data + ((int64) row_index)*width;
+        }
+        generate_vertex_row(terrain->vertices + 3*((int64) row_index)*width, height_row, width,
+                            terrain->y_resolution, row_index);
+    }
+    free(decoded_height_row);
+}
+
+// NOTE: row row_index of the heights, decoded into buffer if the heights are quantized
+inline real32 *get_height_row(Terrain *terrain, int32 row_index, real32 *buffer) {
+    if (terrain->quantized_heights) {
+        decode_quantized_height_row(terrain->quantized_heights, row_index, buffer);
+        return buffer;
+    }
+    return terrain->height_data + ((int64) row_index)*terrain->x_resolution;
+}
+
+// NOTE: the normals of the vertices in rect, from central differences of the heights around them:
+//       (left - right, 2, top - bottom), like the chunks' (see get_chunk_normal()). past the edges of the
+//       grid the heights are extrapolated (2*edge - next), which makes the border normals one-sided
+//       differences with the same scale. each normal only needs its 4 neighbours' heights, so there's no
+//       face normal buffer, and any rows can be done on their own.
+void generate_normal_rect(Terrain *terrain, Grid_Rect rect) {
+    if (!terrain_kernels.normal_row) {
+        init_terrain_kernels(get_cpu_simd_level());
+    }
+    int32 width = terrain->x_resolution;
+    int32 height = terrain->y_resolution;
+    // NOTE: the row, the rows above and below it if they're decoded, and the extrapolated row past the edge
+    real32 *row_buffers = (real32 *) malloc(4 * width * sizeof(real32));
+    real32 *extrapolated_row = row_buffers + 3*width;
+
+    for (int32 row_index = rect.min_row_index; row_index <= rect.max_row_index; row_index++) {
+        real32 *row = get_height_row(terrain, row_index, row_buffers);
+        real32 *top = (row_index > 0) ? get_height_row(terrain, row_index - 1, row_buffers + width) : NULL;
+        real32 *bottom = NULL;
+        if (row_index < height - 1) {
+            bottom = get_height_row(terrain, row_index + 1, row_buffers + 2*width);
+        }
+        if (!top && !bottom) {
+            top = row;
+            bottom = row;
+        } else if (!top || !bottom) {
+            real32 *inside_row = top ? top : bottom;
+            for (int32 column_index = rect.min_column_index; column_index <= rect.max_column_index; column_index++) {
+                extrapolated_row[column_index] = 2.0f*row[column_index] - inside_row[column_index];
             }
+            if (!top) {
+                top = extrapolated_row;
+            } else {
+                bottom = extrapolated_row;
+            }
+        }
 
-            // NOTE: diamond
-            int32 row_increment = dy / 2;
-            for (int32 row_index = 0; row_index < terrain->y_resolution; row_index += row_increment) {
-                int32 start_column_index = ((row_index/row_increment + 1) % 2) * (dx / 2);
-                for (int32 column_index = start_column_index; column_index < terrain->x_resolution; column_index += dx) {
-                    int32 x_offset = dx / 2;
-                    int32 y_offset = dy / 2;
-
-                    real32 sum = 0;
-                    int32 count = 0;
-                    
-                    // top
-                    if (row_index > 0) {
-                        sum += terrain->height_data[get_array_index(row_index - y_offset,
-                                                                    column_index,
-                                                                    terrain->x_resolution, terrain->y_resolution)];
-                        count++;
-                    }
-
-                    // right
-                    if (column_index < (terrain->x_resolution - 1)) {
-                        sum += terrain->height_data[get_array_index(row_index,
-                                                                    column_index + x_offset,
-                                                                    terrain->x_resolution, terrain->y_resolution)];
-                        count++;
-                    }
-
-                    // bottom
-                    if (row_index < (terrain->y_resolution - 1)) {
-                        sum += terrain->height_data[get_array_index(row_index + y_offset,
-                                                                    column_index,
-                                                                    terrain->x_resolution, terrain->y_resolution)];
-                        count++;
-                    }
-
-                    if (column_index > 0) {
-                        sum += terrain->height_data[get_array_index(row_index,
-                                                                    column_index - x_offset,
-                                                                    terrain->x_resolution, terrain->y_resolution)];
-                        count++;
-                    }
-
-                    real32 random_number = s*distribution(generator);
-                    real32 generated_height = (sum / count) + random_number;
-                    int32 array_index = get_array_index(row_index, column_index, terrain->x_resolution, terrain->y_resolution);
-                    terrain->height_data[array_index] = generated_height;
-                    terrain->max_height = fmaxf(terrain->max_height, generated_height);
+        real32 *normal_row = terrain->normals + 3*((int64) row_index)*width;
+        int32 first_column_index = (rect.min_column_index > 1) ? rect.min_column_index : 1;
+        int32 last_column_index = (rect.max_column_index < width - 2) ? rect.max_column_index : width - 2;
+        if (first_column_index <= last_column_index) {
+            terrain_kernels.normal_row(normal_row + 3*first_column_index, top + first_column_index,
+                                       row + first_column_index, bottom + first_column_index,
+                                       last_column_index - first_column_index + 1);
+        }
+
+        int32 border_column_indices[2] = {0, width - 1};
+        int32 num_border_columns = (width > 1) ? 2 : 1;
+        for (int32 border_index = 0; border_index < num_border_columns; border_index++) {
+            int32 column_index = border_column_indices[border_index];
+            if (column_index < rect.min_column_index || column_index > rect.max_column_index) {
+                continue;
+            }
+            real32 left, right;
+            if (width == 1) {
+                left = row[0];
+                right = row[0];
+            } else if (column_index == 0) {
+                left = 2.0f*row[0] - row[1];
+                right = row[1];
+            } else {
+                left = row[column_index - 1];
+                right = 2.0f*row[column_index] - row[column_index - 1];
+            }
+            normal_row[3*column_index]     = left - right;
+            normal_row[3*column_index + 1] = 2.0f;
+            normal_row[3*column_index + 2] = top[column_index] - bottom[column_index];
+        }
+    }
+    free(row_buffers);
+}
+
+static void do_build_normal_rows(void *data, int32 first, int32 last) {
+    Terrain *terrain = ((Build_Mesh_Work *) data)->terrain;
+    generate_normal_rect(terrain, make_grid_rect(first, last - 1, 0, terrain->x_resolution - 1));
+}
+
+static void do_build_uv_rows(void *data, int32 first, int32 last) {
+    Terrain *terrain = ((Build_Mesh_Work *) data)->terrain;
+    for (int32 row_index = first; row_index < last; row_index++) {
+        real32 *uv_row = terrain->uvs + 2*((int64) row_index)*terrain->x_resolution;
+        real32 v = (real32) ((terrain->y_resolution - 1) - row_index) / (terrain->y_resolution - 1);
+        for (int32 column_index = 0; column_index < terrain->x_resolution; column_index++) {
+            real32 u = (real32) column_index / (terrain->x_resolution - 1);
+            uv_row[2*column_index]     = u;
+            uv_row[2*column_index + 1] = v;
+        }
+    }
+}
+
+// NOTE: the size of the chunk-major vertex buffer build_terrain_mesh() writes with terrain->vertex_writer
+int64 get_terrain_vertex_buffer_size(Terrain *terrain) {
+    return terrain->mesh_chunks.num_vertices*get_vertex_format_size(terrain->vertex_format);
+}
+
+// NOTE: writes rows [first_row_index, last_row_index) of the grid to where they go in the chunk-major vertex
+//       buffer, from the vertices and normals (and UVs worked out here) in VERTEX_FORMAT_FULL, which has all
+//       the positions, then all the normals, then all the UVs. the other formats are packed from the heights
+//       and normals straight into the buffer. the rows of those have to have been built.
+void write_terrain_vertex_buffer_rows(Terrain *terrain, void *buffer, int32 first_row_index, int32 last_row_index) {
+    Mesh_Chunk_Layout *mesh_chunks = &terrain->mesh_chunks;
+    if (terrain->vertex_format != VERTEX_FORMAT_FULL) {
+        int32 value_size = get_vertex_format_size(terrain->vertex_format);
+        real32 *decoded_height_row = NULL;
+        if (terrain->quantized_heights) {
+            decoded_height_row = (real32 *) malloc(terrain->x_resolution * sizeof(real32));
+        }
+        for (int32 row_index = first_row_index; row_index < last_row_index; row_index++) {
+            real32 *height_row = get_height_row(terrain, row_index, decoded_height_row);
+            // NOTE: a row on the edge between two rows of chunks goes into both
+            Grid_Rect chunks;
+            get_mesh_chunks_in_rect(mesh_chunks, make_grid_rect(row_index, row_index, 0, terrain->x_resolution - 1),
+                                    &chunks);
+            for (int32 chunk_row_index = chunks.min_row_index; chunk_row_index <= chunks.max_row_index;
+                 chunk_row_index++) {
+                for (int32 chunk_column_index = 0; chunk_column_index < mesh_chunks->chunks_per_row;
+                     chunk_column_index++) {
+                    int32 chunk_index = chunk_row_index*mesh_chunks->chunks_per_row + chunk_column_index;
+                    int32 min_column_index = get_mesh_chunk_rect(mesh_chunks, chunk_index).min_column_index;
+                    int64 chunk_vertex_index = get_mesh_chunk_vertex_index(mesh_chunks, chunk_index, row_index,
+                                                                           min_column_index);
+                    pack_terrain_vertex_row(terrain, terrain->vertex_format, height_row + min_column_index,
+                                            row_index, min_column_index, mesh_chunks->vertices_per_chunk_side,
+                                            (uint8 *) buffer + chunk_vertex_index*value_size);
                 }
             }
+        }
+        free(decoded_height_row);
+        return;
+    }
+
+    uint8 *positions = (uint8 *) buffer;
+    uint8 *normals = positions + mesh_chunks->num_vertices * 3 * sizeof(real32);
+    real32 *uvs = (real32 *) (normals + mesh_chunks->num_vertices * 3 * sizeof(real32));
+    gather_mesh_chunk_rows(mesh_chunks, terrain->vertices, 3 * sizeof(real32), first_row_index, last_row_index,
+                           positions);
+    gather_mesh_chunk_rows(mesh_chunks, terrain->normals, 3 * sizeof(real32), first_row_index, last_row_index,
+                           normals);
 
-            dx /= 2;
-            dy /= 2;
-            s *= smoothing_factor;
+    // NOTE: the same as do_build_uv_rows(), a chunk row at a time like gather_mesh_chunk_rows()
+    Grid_Rect chunks;
+    get_mesh_chunks_in_rect(mesh_chunks, make_grid_rect(first_row_index, last_row_index - 1, 0,
+                                                        terrain->x_resolution - 1), &chunks);
+    for (int32 chunk_row_index = chunks.min_row_index; chunk_row_index <= chunks.max_row_index; chunk_row_index++) {
+        for (int32 chunk_column_index = 0; chunk_column_index < mesh_chunks->chunks_per_row; chunk_column_index++) {
+            int32 chunk_index = chunk_row_index*mesh_chunks->chunks_per_row + chunk_column_index;
+            Grid_Rect chunk_rect = get_mesh_chunk_rect(mesh_chunks, chunk_index);
+            int32 min_row_index = (first_row_index > chunk_rect.min_row_index) ? first_row_index :
+                                                                                 chunk_rect.min_row_index;
+            int32 max_row_index = (last_row_index - 1 < chunk_rect.max_row_index) ? last_row_index - 1 :
+                                                                                    chunk_rect.max_row_index;
+            real32 *uv = uvs + 2*get_mesh_chunk_vertex_index(mesh_chunks, chunk_index, min_row_index,
+                                                             chunk_rect.min_column_index);
+            for (int32 row_index = min_row_index; row_index <= max_row_index; row_index++) {
+                real32 v = (real32) ((terrain->y_resolution - 1) - row_index) / (terrain->y_resolution - 1);
+                for (int32 column_index = chunk_rect.min_column_index; column_index <= chunk_rect.max_column_index;
+                     column_index++) {
+                    uv[0] = (real32) column_index / (terrain->x_resolution - 1);
+                    uv[1] = v;
+                    uv += 2;
+                }
+            }
         }
+    }
+}
 
-        printf("Completed diamond-square in %f seconds.\n", get_seconds() - start_time);
+static void do_write_vertex_buffer_rows(void *data, int32 first, int32 last) {
+    Build_Mesh_Work *work = (Build_Mesh_Work *) data;
+    write_terrain_vertex_buffer_rows(work->terrain, work->vertex_buffer, first, last);
+}
+
+// NOTE: each level of the RTIN errors is a quarter of the one below and needs it. the finest
+//       RTIN_ROW_TASK_LEVELS levels are most of the work, so their edges and then their centers are split into
+//       rows, and the levels above them are one task.
+static void do_build_rtin_edge_error_rows(void *data, int32 first, int32 last) {
+    Build_Level_Work *work = (Build_Level_Work *) data;
+    Terrain *terrain = work->terrain;
+    // NOTE: the heights are read from the vertices, since height_data might have been quantized
+    build_rtin_edge_errors(terrain->rtin_errors, terrain->vertices + 1, 3, terrain->x_resolution,
+                           2 << work->level_index, make_grid_rect(first, last - 1, 0, terrain->x_resolution - 1));
+}
+
+static void do_build_rtin_center_error_rows(void *data, int32 first, int32 last) {
+    Build_Level_Work *work = (Build_Level_Work *) data;
+    Terrain *terrain = work->terrain;
+    build_rtin_center_errors(terrain->rtin_errors, terrain->vertices + 1, 3, terrain->x_resolution,
+                             2 << work->level_index, make_grid_rect(first, last - 1, 0, terrain->x_resolution - 1));
+}
+
+static void do_build_rtin_coarse_errors(void *data, int32 first, int32 last) {
+    Terrain *terrain = ((Build_Mesh_Work *) data)->terrain;
+    int32 size = terrain->x_resolution;
+    real32 *errors = terrain->rtin_errors;
+    errors[0] = 0;
+    errors[size - 1] = 0;
+    errors[((int64) size - 1)*size] = 0;
+    errors[((int64) size)*size - 1] = 0;
+    Grid_Rect all_vertices = make_grid_rect(0, size - 1, 0, size - 1);
+    for (int32 step = 2 << RTIN_ROW_TASK_LEVELS; step < size; step *= 2) {
+        build_rtin_edge_errors(errors, terrain->vertices + 1, 3, size, step, all_vertices);
+        build_rtin_center_errors(errors, terrain->vertices + 1, 3, size, step, all_vertices);
     }
-        
-    // NOTE: create vertices
-    start_time = get_seconds();
-    terrain->num_vertices = terrain->x_resolution * terrain->y_resolution;
+}
+
+// NOTE: every level of the LOD quadtree costs about as much as the leaves, since a node's error looks at as
+//       many vertices as a leaf's bounds, so each level is split into rows of nodes
+static void do_build_terrain_lod_rows(void *data, int32 first, int32 last) {
+    Build_Level_Work *work = (Build_Level_Work *) data;
+    Terrain_Lod *lod = work->terrain->lod;
+    update_terrain_lod_nodes(lod, work->terrain, work->level_index,
+                             make_grid_rect(first, last - 1, 0, lod->levels[work->level_index].nodes_per_row - 1));
+}
+
+static void do_build_terrain_culling_leaf_rows(void *data, int32 first, int32 last) {
+    Terrain *terrain = ((Build_Mesh_Work *) data)->terrain;
+    Terrain_Culling *culling = terrain->culling;
+    update_terrain_culling_leaves(culling, terrain, make_grid_rect(first, last - 1, 0,
+                                                                   culling->levels[0].nodes_per_row - 1));
+}
+
+// NOTE: the levels above the leaves only take the min and max of 4 children, which is cheap next to the leaves
+static void do_build_terrain_culling_levels(void *data, int32 first, int32 last) {
+    Terrain_Culling *culling = ((Build_Mesh_Work *) data)->terrain->culling;
+    Culling_Level *leaves = &culling->levels[0];
+    update_terrain_culling_levels(culling, make_grid_rect(0, leaves->nodes_per_column - 1,
+                                                          0, leaves->nodes_per_row - 1));
+}
+
+static void do_build_low_res_vertex_rows(void *data, int32 first, int32 last) {
+    Terrain *terrain = ((Build_Mesh_Work *) data)->terrain;
+    for (int32 row_index = first; row_index < last; row_index++) {
+        generate_vertex_row(terrain->low_res_vertices + 3*((int64) row_index)*terrain->max_x,
+                            terrain->low_res_height_data + ((int64) row_index)*terrain->max_x, terrain->max_x,
+                            terrain->max_y, row_index);
+    }
+}
+
+static void do_build_low_res_index_rows(void *data, int32 first, int32 last) {
+    Terrain *terrain = ((Build_Mesh_Work *) data)->terrain;
+    generate_grid_index_rows(terrain->low_res_indices, terrain->max_x, terrain->max_y, first, last);
+}
+
+// NOTE: builds the vertices, normals and UVs from height_data (or the quantized heights), and the low-res
+//       wireframe. there are no indices to build, every chunk of the mesh uses the same ones. the stages are
+//       run as a task graph on work_queue (which can be NULL). they all read only the heights, so none of
+//       them depend on each other and they all run at the same time, except for writing the vertices to
+//       terrain->vertex_writer (packed into terrain->vertex_format), which needs everything that goes into the
+//       buffer. the RTIN errors, culling bounds and LOD quadtree read the
+//       vertices and are built a level at a time, with each level that's big enough split into rows.
+void build_terrain_mesh(Terrain *terrain, Work_Queue *work_queue) {
+    real64 start_time = get_seconds();
+    if (terrain->height_layout != HEIGHT_LAYOUT_ROW_MAJOR) {
+        convert_heights_to_row_major(terrain);
+        if (print_terrain_timings) {
+            printf("Converted heights to row-major in %f seconds.\n", get_seconds() - start_time);
+        }
+    }
+
+    terrain->num_vertices = ((int64) terrain->x_resolution) * terrain->y_resolution;
     terrain->vertices = (real32 *) malloc(terrain->num_vertices * 3 * sizeof(real32));
-    for (int32 row_index = 0; row_index < terrain->y_resolution; row_index++) {
-        for (int32 column_index = 0; column_index < terrain->x_resolution; column_index++) {
-            int32 square_index = get_array_index(row_index, column_index,
-                                                 terrain->x_resolution, terrain->y_resolution);
-            // NOTE: we do it in this order for the default GLM coordinate space, which is
-            //       +x = right, +y = up, +z = out of the screen
-            terrain->vertices[3*square_index]     = (real32) column_index;
-            terrain->vertices[3*square_index + 1] = terrain->height_data[square_index];
-            terrain->vertices[3*square_index + 2] = (real32) -terrain->y_resolution + row_index + 1;
-        }
-    }
-    printf("Generated vertices in %f seconds.\n", get_seconds() - start_time);
-
-    // NOTE: create indices
-    start_time = get_seconds();
-    terrain->num_indices = (terrain->x_resolution - 1)*(terrain->y_resolution - 1)*6;
-    terrain->indices = (uint32 *) malloc(terrain->num_indices * sizeof(uint32));
-    for (int32 row_index = 0; row_index < terrain->y_resolution - 1; row_index++) {
-        for (int32 column_index = 0; column_index < terrain->x_resolution - 1; column_index++) {
-            // triangle 1
-            uint32 p1, p2, p3;
-            p1 = get_array_index(row_index+1, column_index+1, terrain->x_resolution, terrain->y_resolution);
-            p2 = get_array_index(row_index,   column_index+1, terrain->x_resolution, terrain->y_resolution);
-            p3 = get_array_index(row_index,   column_index,   terrain->x_resolution, terrain->y_resolution);
-                
-            // triangle 2
-            uint32 p4, p5, p6;
-            p4 = p1;
-            p5 = p3;
-            p6 = get_array_index(row_index+1, column_index,   terrain->x_resolution, terrain->y_resolution);
-
-            int32 triangle_index = 6*(row_index*(terrain->y_resolution - 1) + column_index);
-            terrain->indices[triangle_index]     = p1;
-            terrain->indices[triangle_index + 1] = p2;
-            terrain->indices[triangle_index + 2] = p3;
-            terrain->indices[triangle_index + 3] = p4;
-            terrain->indices[triangle_index + 4] = p5;
-            terrain->indices[triangle_index + 5] = p6;
-        }
-    }
-    printf("Generated indices in %f seconds.\n", get_seconds() - start_time);
-
-    // NOTE: generate face normals
-    start_time = get_seconds();
-    int32 num_faces_x = terrain->x_resolution - 1;
-    int32 num_faces_y = terrain->y_resolution - 1;
-    real32 *face_normals = (real32 *) malloc(num_faces_x * num_faces_y * 3 * sizeof(real32));
-    for (int32 row_index = 0; row_index < num_faces_y; row_index++) {
-        for (int32 column_index = 0; column_index < num_faces_x; column_index++) {
-            // NOTE: get vertex start index for the 3 points of the triangle
-            int32 p1_index = 3*get_array_index(row_index+1, column_index+1, terrain->x_resolution, terrain->y_resolution);
-            int32 p2_index = 3*get_array_index(row_index,   column_index+1, terrain->x_resolution, terrain->y_resolution);                
-            int32 p3_index = 3*get_array_index(row_index,   column_index,   terrain->x_resolution, terrain->y_resolution);
-                
-            glm::vec3 p1 = glm::vec3(terrain->vertices[p1_index], terrain->vertices[p1_index+1], terrain->vertices[p1_index+2]);
-            glm::vec3 p2 = glm::vec3(terrain->vertices[p2_index], terrain->vertices[p2_index+1], terrain->vertices[p2_index+2]);
-            glm::vec3 p3 = glm::vec3(terrain->vertices[p3_index], terrain->vertices[p3_index+1], terrain->vertices[p3_index+2]);
-
-            glm::vec3 a = p2 - p1;
-            glm::vec3 b = p3 - p2;
-            glm::vec3 face_normal = glm::cross(a, b);
-            int32 face_normal_index = 3*get_array_index(row_index, column_index, num_faces_x, num_faces_y);
-
-            face_normals[face_normal_index]     = face_normal.x;
-            face_normals[face_normal_index + 1] = face_normal.y;
-            face_normals[face_normal_index + 2] = face_normal.z;
-        }
-    }
-    printf("Generated face normals in %f seconds.\n", get_seconds() - start_time);
-
-    // NOTE: generate vertex normals from face normals
-    start_time = get_seconds();
+    terrain->mesh_chunks = make_mesh_chunk_layout(terrain->x_resolution, terrain->y_resolution);
+    terrain->chunk_indices = get_mesh_chunk_indices(terrain->mesh_chunks.cells_per_chunk,
+                                                    &terrain->num_chunk_indices);
     terrain->num_normals = terrain->num_vertices;
     terrain->normals = (real32 *) malloc(terrain->num_normals * 3 * sizeof(real32));
-    for (int32 row_index = 0; row_index < terrain->y_resolution; row_index++) {
-        for (int32 column_index = 0; column_index < terrain->x_resolution; column_index++) {
-            int32 top_left_face_index     = 3*get_array_index(row_index - 1, column_index - 1, num_faces_x, num_faces_y);
-            int32 top_right_face_index    = 3*get_array_index(row_index - 1, column_index,     num_faces_x, num_faces_y);
-            int32 bottom_left_face_index  = 3*get_array_index(row_index,     column_index - 1, num_faces_x, num_faces_y);
-            int32 bottom_right_face_index = 3*get_array_index(row_index,     column_index,     num_faces_x, num_faces_y);
-
-            glm::vec3 n1 = glm::vec3(face_normals[top_left_face_index],     face_normals[top_left_face_index+1],     face_normals[top_left_face_index+2]);
-            glm::vec3 n2 = glm::vec3(face_normals[top_right_face_index],    face_normals[top_right_face_index+1],    face_normals[top_right_face_index+2]);
-            glm::vec3 n3 = glm::vec3(face_normals[bottom_left_face_index],  face_normals[bottom_left_face_index+1],  face_normals[bottom_left_face_index+2]);
-            glm::vec3 n4 = glm::vec3(face_normals[bottom_right_face_index], face_normals[bottom_right_face_index+1], face_normals[bottom_right_face_index+2]);
-
-            glm::vec3 vertex_normal = (n1 + n2 + n3 + n4) / 4.0f;
-            int32 normal_index = 3*get_array_index(row_index, column_index, terrain->x_resolution, terrain->y_resolution);
-            terrain->normals[normal_index] =   vertex_normal.x;
-            terrain->normals[normal_index+1] = vertex_normal.y;
-            terrain->normals[normal_index+2] = vertex_normal.z;
-        }
-    }
-    printf("Generated vertex normals in %f seconds.\n", get_seconds() - start_time);
-
-    // NOTE: generate UVs
-    start_time = get_seconds();
-    terrain->num_uvs = terrain->num_vertices;
-    terrain->uvs = (real32 *) malloc(terrain->num_uvs * 2 * sizeof(real32));
-    for (int32 row_index = 0; row_index < terrain->y_resolution; row_index++) {
-        for (int32 column_index = 0; column_index < terrain->x_resolution; column_index++) {
-            real32 u = (real32) column_index / (terrain->x_resolution - 1);
-            real32 v = (real32) ((terrain->y_resolution - 1) - row_index) / (terrain->y_resolution - 1);
+    if (!terrain->vertex_writer) {
+        terrain->num_uvs = terrain->num_vertices;
+        terrain->uvs = (real32 *) malloc(terrain->num_uvs * 2 * sizeof(real32));
+    }
+    terrain->num_low_res_vertices = terrain->max_x * terrain->max_y;
+    terrain->low_res_vertices = (real32 *) malloc(terrain->num_low_res_vertices * 3 * sizeof(real32));
+    terrain->num_low_res_indices = (terrain->max_x - 1)*(terrain->max_y - 1)*6;
+    terrain->low_res_indices = (uint32 *) malloc(terrain->num_low_res_indices * sizeof(uint32));
+
+    Build_Mesh_Work work = {};
+    work.terrain = terrain;
 
-            int32 uv_index = 2*get_array_index(row_index, column_index, terrain->x_resolution, terrain->y_resolution);
-            terrain->uvs[uv_index]     = u;
-            terrain->uvs[uv_index + 1] = v;
+    Task_Graph *graph = new Task_Graph;
+    init_task_graph(graph);
+    int32 vertices_task = add_task(graph, "vertices", do_build_vertex_rows, &work, terrain->y_resolution);
+    int32 normals_task = add_task(graph, "normals", do_build_normal_rows, &work, terrain->y_resolution);
+    if (terrain->uvs) {
+        add_task(graph, "UVs", do_build_uv_rows, &work, terrain->y_resolution);
+    }
+    add_task(graph, "low-res vertices", do_build_low_res_vertex_rows, &work, terrain->max_y);
+    add_task(graph, "low-res indices", do_build_low_res_index_rows, &work, terrain->max_y - 1);
+    if (terrain->vertex_writer) {
+        work.vertex_buffer = terrain->vertex_writer->begin(terrain->vertex_writer,
+                                                           get_terrain_vertex_buffer_size(terrain));
+        assert(work.vertex_buffer);
+        int32 vertex_buffer_task = add_task(graph, "vertex buffer", do_write_vertex_buffer_rows, &work,
+                                            terrain->y_resolution);
+        add_task_dependency(graph, vertex_buffer_task, vertices_task);
+        add_task_dependency(graph, vertex_buffer_task, normals_task);
+    }
+    if (terrain->use_rtin && can_use_rtin(terrain)) {
+        terrain->rtin_errors = (real32 *) malloc(terrain->num_vertices * sizeof(real32));
+        int32 rtin_level_task = vertices_task;
+        for (int32 level_index = 0; level_index < RTIN_ROW_TASK_LEVELS && (2 << level_index) < terrain->x_resolution;
+             level_index++) {
+            Build_Level_Work *level_work = &work.rtin_levels[level_index];
+            level_work->terrain = terrain;
+            level_work->level_index = level_index;
+            int32 edges_task = add_task(graph, "RTIN edge errors", do_build_rtin_edge_error_rows, level_work,
+                                        terrain->y_resolution);
+            add_task_dependency(graph, edges_task, rtin_level_task);
+            rtin_level_task = add_task(graph, "RTIN center errors", do_build_rtin_center_error_rows, level_work,
+                                       terrain->y_resolution);
+            add_task_dependency(graph, rtin_level_task, edges_task);
+        }
+        int32 rtin_coarse_task = add_task(graph, "RTIN coarse errors", do_build_rtin_coarse_errors, &work, 1);
+        add_task_dependency(graph, rtin_coarse_task, rtin_level_task);
+        terrain->rtin_mesh_needs_update = true;
+    } else if (terrain->use_rtin) {
+        printf("RTIN needs a square (2^n+1)x(2^n+1) grid, drawing every cell instead.\n");
+    }
+    terrain->culling = make_terrain_culling(terrain);
+    int32 culling_leaves_task = add_task(graph, "culling leaves", do_build_terrain_culling_leaf_rows, &work,
+                                         terrain->culling->levels[0].nodes_per_column);
+    add_task_dependency(graph, culling_leaves_task, vertices_task);
+    int32 culling_levels_task = add_task(graph, "culling levels", do_build_terrain_culling_levels, &work, 1);
+    add_task_dependency(graph, culling_levels_task, culling_leaves_task);
+    if (terrain->use_lod) {
+        terrain->lod = make_terrain_lod(terrain);
+        int32 lod_level_task = vertices_task;
+        for (int32 level_index = 0; level_index < terrain->lod->num_levels; level_index++) {
+            Build_Level_Work *level_work = &work.lod_levels[level_index];
+            level_work->terrain = terrain;
+            level_work->level_index = level_index;
+            int32 task = add_task(graph, "LOD level", do_build_terrain_lod_rows, level_work,
+                                  terrain->lod->levels[level_index].nodes_per_column);
+            add_task_dependency(graph, task, lod_level_task);
+            lod_level_task = task;
         }
     }
-    printf("Generated UVs in %f seconds.\n", get_seconds() - start_time);
 
-    // NOTE: generate low-res vertices
-    start_time = get_seconds();
-    terrain->num_low_res_vertices = terrain->max_x * terrain->max_y;
-    terrain->low_res_vertices = (real32 *) malloc(terrain->num_low_res_vertices * 3 * sizeof(real32));
-    for (int32 row_index = 0; row_index < terrain->max_y; row_index++) {
-        for (int32 column_index = 0; column_index < terrain->max_x; column_index++) {
-            int32 square_index = get_array_index(row_index, column_index,
-                                                 terrain->max_x, terrain->max_y);
-            // NOTE: we do it in this order for the default GLM coordinate space, which is
-            //       +x = right, +y = up, +z = out of the screen
-            terrain->low_res_vertices[3*square_index]     = (real32) column_index;
-            terrain->low_res_vertices[3*square_index + 1] = terrain->low_res_height_data[square_index];
-            terrain->low_res_vertices[3*square_index + 2] = (real32) -terrain->max_y + row_index + 1;
+    run_task_graph(graph, work_queue);
+    if (terrain->vertex_writer) {
+        while (!terrain->vertex_writer->end(terrain->vertex_writer)) {
+            printf("Lost the vertex buffer while writing it, writing it again.\n");
+            void *vertex_buffer = terrain->vertex_writer->begin(terrain->vertex_writer,
+                                                                get_terrain_vertex_buffer_size(terrain));
+            assert(vertex_buffer);
+            write_terrain_vertex_buffer_rows(terrain, vertex_buffer, 0, terrain->y_resolution);
         }
     }
-    printf("Generated low-res vertices in %f seconds.\n", get_seconds() - start_time);
 
-    // NOTE: generate low-res indices
-    start_time = get_seconds();
-    terrain->num_low_res_indices = (terrain->max_x - 1)*(terrain->max_y - 1)*6;
-    terrain->low_res_indices = (uint32 *) malloc(terrain->num_low_res_indices * sizeof(uint32));
-    for (int32 row_index = 0; row_index < terrain->max_y - 1; row_index++) {
-        for (int32 column_index = 0; column_index < terrain->max_x - 1; column_index++) {
-            // triangle 1
-            uint32 p1, p2, p3;
-            p1 = get_array_index(row_index+1, column_index+1, terrain->max_x, terrain->max_y);
-            p2 = get_array_index(row_index,   column_index+1, terrain->max_x, terrain->max_y);
-            p3 = get_array_index(row_index,   column_index,   terrain->max_x, terrain->max_y);
-                
-            // triangle 2
-            uint32 p4, p5, p6;
-            p4 = p1;
-            p5 = p3;
-            p6 = get_array_index(row_index+1, column_index,   terrain->max_x, terrain->max_y);
+    if (print_terrain_timings) {
+        printf("Built mesh in %f seconds.\n", get_seconds() - start_time);
+        print_task_graph_timings(graph);
+        Mesh_Chunk_Layout *mesh_chunks = &terrain->mesh_chunks;
+        int64 num_grid_indices = ((int64) terrain->x_resolution - 1)*(terrain->y_resolution - 1)*6;
+        printf("Mesh is %d chunks of %dx%d vertices sharing %d 16-bit indices (%.1f KB, instead of %.1f MB of "
+               "32-bit indices for the whole grid).\n", mesh_chunks->num_chunks,
+               mesh_chunks->vertices_per_chunk_side, mesh_chunks->vertices_per_chunk_side, terrain->num_chunk_indices,
+               terrain->num_chunk_indices * sizeof(uint16) / 1024.0,
+               num_grid_indices * sizeof(uint32) / (1024.0*1024.0));
+        if (terrain->rtin_errors) {
+            int64 num_rtin_indices = extract_rtin_mesh(terrain->rtin_errors, terrain->x_resolution,
+                                                       terrain->rtin_max_error, NULL);
+            printf("RTIN mesh within %f of the heights is %lld triangles (%.2f%% of the grid's).\n",
+                   terrain->rtin_max_error, (long long) (num_rtin_indices / 3),
+                   100.0*num_rtin_indices / num_grid_indices);
+        }
+        if (terrain->lod) {
+            Terrain_Lod *lod = terrain->lod;
+            printf("LOD quadtree has %d levels (%dx%d leaves of %dx%d quads) and %d patches in %d 16-bit indices "
+                   "(%.1f KB).\n", lod->num_levels, lod->levels[0].nodes_per_row, lod->levels[0].nodes_per_column,
+                   lod->node_quads, lod->node_quads, lod->num_step_exponents*LOD_EDGE_MASKS, lod->num_indices,
+                   lod->num_indices * sizeof(uint16) / 1024.0);
+        }
+    }
+    delete graph;
+}
 
-            int32 triangle_index = 6*(row_index*(terrain->max_y - 1) + column_index);
-            terrain->low_res_indices[triangle_index]     = p1;
-            terrain->low_res_indices[triangle_index + 1] = p2;
-            terrain->low_res_indices[triangle_index + 2] = p3;
-            terrain->low_res_indices[triangle_index + 3] = p4;
-            terrain->low_res_indices[triangle_index + 4] = p5;
-            terrain->low_res_indices[triangle_index + 5] = p6;
+// NOTE: after the heights in rect of height_data changed, regenerates what depends on them: the vertices in
+//       rect, the normals in rect and the cells around it, the packed vertices, the RTIN errors and the culling
+//       and LOD bounds. the terrain has to have been through build_terrain_mesh().
+Terrain_Update update_terrain_mesh_rect(Terrain *terrain, Grid_Rect rect) {
+    Terrain_Update update = {};
+    update.heights = rect;
+
+    Grid_View<real32, Unchecked_Boundary> heights = make_grid_view<Unchecked_Boundary>(terrain->height_data,
+                                                                                      terrain->x_resolution,
+                                                                                      terrain->y_resolution);
+    Grid_View<glm::vec3, Unchecked_Boundary> vertices =
+        make_grid_view<Unchecked_Boundary>((glm::vec3 *) terrain->vertices, terrain->x_resolution, terrain->y_resolution);
+    for (int32 r = rect.min_row_index; r <= rect.max_row_index; r++) {
+        for (int32 c = rect.min_column_index; c <= rect.max_column_index; c++) {
+            vertices.at(r, c).y = heights.at(r, c);
         }
     }
-    printf("Generated low-res indices in %f seconds.\n", get_seconds() - start_time);
+
+    // NOTE: normals of every vertex next to a changed height
+    update.normals = clip_grid_rect(make_grid_rect(rect.min_row_index - 1, rect.max_row_index + 1,
+                                                   rect.min_column_index - 1, rect.max_column_index + 1),
+                                    terrain->x_resolution, terrain->y_resolution);
+    generate_normal_rect(terrain, update.normals);
+    if (terrain->rtin_errors) {
+        build_rtin_error_rect(terrain->rtin_errors, terrain->vertices + 1, 3, terrain->x_resolution, rect);
+        terrain->rtin_mesh_needs_update = true;
+    }
+    update_terrain_culling_bounds(terrain->culling, terrain, rect);
+    if (terrain->lod) {
+        update_terrain_lod_bounds(terrain->lod, terrain, rect);
+    }
+    return update;
+}
+
+// NOTE: sets one low-res control height and regenerates only what depends on it: the heights, vertices and
+//       normals around it. the terrain has to have been through build_terrain_mesh().
+//
+//       diamond-square writes every cell once, at the level it's generated in, and a cell at a level with
+//       step d only depends on cells less than d away. so the cells that depend on a control point are less
+//       than dx + dx/2 + ... + 2 < 2*dx away from it, and regenerating just those, from the coarsest level
+//       down, while reading everything else from height_data gives exactly the heights that regenerating the
+//       whole grid would.
+Terrain_Update update_control_height(Terrain *terrain, int32 low_res_row_index, int32 low_res_column_index,
+                                     real32 height, Work_Queue *work_queue) {
+    assert(terrain->height_layout == HEIGHT_LAYOUT_ROW_MAJOR && terrain->vertices && terrain->normals);
+    assert(low_res_row_index >= 0 && low_res_row_index < terrain->max_y);
+    assert(low_res_column_index >= 0 && low_res_column_index < terrain->max_x);
+    real64 start_time = get_seconds();
+
+    int64 low_res_height_index = get_grid_index<Unchecked_Boundary>(low_res_row_index, low_res_column_index,
+                                                                    terrain->max_x, terrain->max_y);
+    terrain->low_res_height_data[low_res_height_index] = height;
+    if (terrain->low_res_vertices) {
+        terrain->low_res_vertices[3*low_res_height_index + 1] = height;
+    }
+
+    int32 dx = (terrain->x_resolution - 1) / (terrain->max_x - 1);
+    int32 dy = (terrain->y_resolution - 1) / (terrain->max_y - 1);
+    int32 row_index = low_res_row_index*dy;
+    int32 column_index = low_res_column_index*dx;
+
+    Terrain_Update update = {};
+    update.heights = clip_grid_rect(make_grid_rect(row_index - 2*dy + 1, row_index + 2*dy - 1,
+                                                   column_index - 2*dx + 1, column_index + 2*dx - 1),
+                                    terrain->x_resolution, terrain->y_resolution);
+    Grid_Rect rect = update.heights;
+
+    Grid_View<real32, Unchecked_Boundary> heights = make_grid_view<Unchecked_Boundary>(terrain->height_data,
+                                                                                      terrain->x_resolution,
+                                                                                      terrain->y_resolution);
+    // NOTE: like in generate_height_data(), max_height is the max of the generated heights, which doesn't
+    //       include the control heights
+    real32 old_max_height = FLT_MIN;
+    for (int32 r = rect.min_row_index; r <= rect.max_row_index; r++) {
+        for (int32 c = rect.min_column_index; c <= rect.max_column_index; c++) {
+            if (r % dy != 0 || c % dx != 0) {
+                old_max_height = fmaxf(old_max_height, heights.at(r, c));
+            }
+        }
+    }
+
+    // NOTE: regenerate the heights
+    heights.at(row_index, column_index) = height;
+    if (dx > 1) {
+        real32 smoothing_factor = powf(2.0f, -terrain->h);
+        real32 *row_max_heights = (real32 *) malloc(terrain->y_resolution * sizeof(real32));
+        for (int32 r = 0; r < terrain->y_resolution; r++) {
+            row_max_heights[r] = FLT_MIN;
+        }
+
+        Diamond_Square_Pass pass = make_diamond_square_pass(terrain, row_max_heights, smoothing_factor,
+                                                            terrain->max_random_height, terrain->seed);
+        pass.rows = terrain->height_data;
+        pass.min_column_index = rect.min_column_index;
+        pass.max_column_index = rect.max_column_index;
+        while (pass.dx > 1) {
+            int32 first, end;
+
+            // NOTE: square
+            int32 num_square_rows = (terrain->y_resolution - 1) / pass.dy;
+            clip_index_sequence(pass.dy / 2, pass.dy, num_square_rows, rect.min_row_index, rect.max_row_index,
+                                &first, &end);
+            pass.first_pass_row = first;
+            parallel_for(work_queue, end - first, do_square_rows, &pass);
+
+            // NOTE: diamond
+            int32 num_diamond_rows = (terrain->y_resolution - 1) / (pass.dy / 2) + 1;
+            clip_index_sequence(0, pass.dy / 2, num_diamond_rows, rect.min_row_index, rect.max_row_index,
+                                &first, &end);
+            pass.first_pass_row = first;
+            parallel_for(work_queue, end - first, do_diamond_rows, &pass);
+
+            pass.level--;
+            pass.dx /= 2;
+            pass.dy /= 2;
+            pass.s *= smoothing_factor;
+        }
+        free(row_max_heights);
+    }
+
+    // NOTE: max_height
+    real32 new_max_height = FLT_MIN;
+    for (int32 r = rect.min_row_index; r <= rect.max_row_index; r++) {
+        for (int32 c = rect.min_column_index; c <= rect.max_column_index; c++) {
+            if (r % dy != 0 || c % dx != 0) {
+                new_max_height = fmaxf(new_max_height, heights.at(r, c));
+            }
+        }
+    }
+
+    // NOTE: the max can only be found from the changed heights if it didn't go down
+    if (new_max_height >= terrain->max_height) {
+        terrain->max_height = new_max_height;
+    } else if (old_max_height >= terrain->max_height) {
+        terrain->max_height = FLT_MIN;
+        for (int32 r = 0; r < terrain->y_resolution; r++) {
+            real32 *height_row = heights.get_row(r);
+            for (int32 c = 0; c < terrain->x_resolution; c++) {
+                if (r % dy != 0 || c % dx != 0) {
+                    terrain->max_height = fmaxf(terrain->max_height, height_row[c]);
+                }
+            }
+        }
+    }
+
+    update = update_terrain_mesh_rect(terrain, rect);
+
+    printf("Updated control height (%d, %d) to %f, regenerating %dx%d heights in %f seconds.\n",
+           low_res_row_index, low_res_column_index, height,
+           rect.max_column_index - rect.min_column_index + 1, rect.max_row_index - rect.min_row_index + 1,
+           get_seconds() - start_time);
+    return update;
+}
+
+void init_terrain(Terrain *terrain, char *initial_heights_file, real32 h, real32 max_random_height,
+                  uint64 seed, Work_Queue *work_queue) {
+    real64 terrain_start_time = get_seconds();
+    load_initial_heights(terrain, initial_heights_file);
+    generate_height_data(terrain, h, max_random_height, seed, work_queue);
+    build_terrain_mesh(terrain, work_queue);
     printf("Terrain generation total time: %f seconds\n", get_seconds() - terrain_start_time);
     printf("\n");
 }
@@ -1,5 +1,23 @@
 #ifndef TERRAIN_H
 
+#include "grid.h"
+#include "quantized_heights.h"
+#include "vertex_formats.h"
+#include "mesh_chunks.h"
+#include "terrain_culling.h"
+#include "rtin.h"
+#include "terrain_lod.h"
+#include "clipmap.h"
+#include "terrain_sculpt.h"
+
+enum Height_Layout {
+    // NOTE: height_data[row_index*x_resolution + column_index]
+    HEIGHT_LAYOUT_ROW_MAJOR,
+    // NOTE: HEIGHT_TILE_SIZE x HEIGHT_TILE_SIZE tiles in row-major order, with the heights inside a tile
+    //       in Morton (Z) order. see Tiled_Layout in grid.h.
+    HEIGHT_LAYOUT_TILED
+};
+
 struct Terrain {
     // NOTE: z is up in terrain's coordinate space
     // NOTE: points per side for low resolution terrain, in which all the points are specified by the user
@@ -10,21 +28,89 @@ struct Terrain {
     int32 x_resolution;
     int32 y_resolution;
 
+    // NOTE: max_x = 2^low_res_grid_size_exponent + 1, x_resolution = 2^resolution_exponent + 1
+    int32 low_res_grid_size_exponent;
+    int32 resolution_exponent;
+
+    // NOTE: set before generating to pick how height_data is stored. meshes are always built from
+    //       row-major heights, so a tiled terrain gets converted after diamond-square.
+    Height_Layout height_layout;
+
     real32 *low_res_height_data;
     real32 *height_data;
+    // NOTE: in real32s. generate_height_data() reuses height_data if it's at least this big.
+    int64 height_data_capacity;
+    // NOTE: set by quantize_terrain_heights(), which frees height_data. the mesh and the heightmap are
+    //       then decoded from these.
+    Quantized_Heights *quantized_heights;
     real32 *vertices;
     real32 *normals;
     real32 *uvs;
-    uint32 *indices;
+    // NOTE: the mesh is drawn in chunks that all use chunk_indices, which isn't the terrain's and mustn't be
+    //       freed (see mesh_chunks.h). the vertices above are still row-major, they're only put in chunk
+    //       order for the GL buffer.
+    Mesh_Chunk_Layout mesh_chunks;
+    uint16 *chunk_indices;
+    int32 num_chunk_indices;
 
     real32 max_height;
+
+    // NOTE: what the heights were generated with, kept for update_control_height()
+    real32 h;
+    real32 max_random_height;
+    uint64 seed;
     
-    int32 num_vertices;
-    int32 num_indices;
-    int32 num_normals;
-    int32 num_uvs;
+    int64 num_vertices;
+    int64 num_normals;
+    int64 num_uvs;
     
+    // NOTE: set before build_terrain_mesh() to pick what goes into vbo. the CPU-side vertices, normals and
+    //       UVs are always built (unless there's a vertex_writer, see below). the other formats are only
+    //       packed into the vertex buffer, and gl_update_terrain() packs what an edit changed again.
+    Vertex_Format vertex_format;
+    // NOTE: set before build_terrain_mesh() to have it write the chunk-major vertex buffer in vertex_format
+    //       (what goes into vbo) too, row by row as the rows are built, instead of leaving the copy to the
+    //       caller. the UVs are then only written there, not kept in uvs, since only the OBJ writer reads
+    //       those.
+    Mesh_Vertex_Writer *vertex_writer;
+    // NOTE: set use_rtin before build_terrain_mesh() to build rtin_errors with the mesh (see rtin.h), and
+    //       draw (or write) only the triangles needed to keep within rtin_max_error of the heights instead of
+    //       every cell. it's ignored for grids RTIN can't handle (see can_use_rtin()).
+    bool32 use_rtin;
+    real32 rtin_max_error;
+    real32 *rtin_errors;
+    // NOTE: set use_lod before build_terrain_mesh() to build lod with the mesh, for drawing nodes of a
+    //       quadtree at a detail that depends on how far away they are (see terrain_lod.h)
+    bool32 use_lod;
+    real32 lod_max_pixel_error;
+    Terrain_Lod *lod;
+    // NOTE: always built with the mesh, for drawing only the chunks in view (see terrain_culling.h)
+    Terrain_Culling *culling;
+    // NOTE: the viewer's alternative to a mesh: a geometry clipmap of the heights (see clipmap.h), which
+    //       only needs the heights, not build_terrain_mesh()
+    Terrain_Clipmap *clipmap;
+    // NOTE: the viewer's brush and undo history for sculpting the heights by hand (see terrain_sculpt.h)
+    Terrain_Sculpt *sculpt;
     uint32 vao;
+    uint32 vbo;
+    // NOTE: vbo as a texture buffer, for the shader to read neighbouring heights with VERTEX_FORMAT_HEIGHT
+    uint32 heights_texture_id;
+    // NOTE: for drawing every chunk of the mesh with one glMultiDrawElementsBaseVertex()
+    int32 *chunk_draw_counts;
+    int32 *chunk_draw_base_vertices;
+    void **chunk_draw_index_offsets;
+    // NOTE: how many of the draws to do, after culling
+    int32 num_chunk_draws;
+    // NOTE: the RTIN mesh, extracted again when rtin_mesh_needs_update is set. the indices are of vertices in
+    //       vbo, so the vertices are the same as for the chunks and only the triangles change.
+    uint32 rtin_ebo;
+    uint32 *rtin_indices;
+    int64 num_rtin_indices;
+    bool32 rtin_mesh_needs_update;
+    uint32 lod_ebo;
+    // NOTE: a texture array with a layer per clipmap level, and the clipmap's ring meshes
+    uint32 clipmap_texture_id;
+    uint32 clipmap_ebo;
     uint32 shader_id;
     uint32 grass_texture_id;
     uint32 stone_texture_id;
@@ -34,6 +120,7 @@ struct Terrain {
 
     // NOTE: for displaying the low-res wireframe
     uint32 low_res_wireframe_vao;
+    uint32 low_res_wireframe_vbo;
     uint32 low_res_wireframe_shader_id;
     int32 num_low_res_vertices;
     int32 num_low_res_indices;
@@ -46,5 +133,12 @@ struct Terrain {
     real32 world_y_size;
 };
 
+// NOTE: what update_control_height() changed: the vertices (and heights) in heights, and the normals in
+//       normals
+struct Terrain_Update {
+    Grid_Rect heights;
+    Grid_Rect normals;
+};
+
 #define TERRAIN_H
 #endif
@@ -0,0 +1,330 @@
+#include "main.h"
+#include "terrain.h"
+#include "work_queue.h"
+#include "vertex_cache.h"
+#include "terrain_chunks.h"
+
+// NOTE: mod that's never negative, so the low-res grid repeats the same way on both sides of 0
+inline int32 wrap_index(int32 index, int32 size) {
+    int32 result = index % size;
+    return (result < 0) ? result + size : result;
+}
+
+// NOTE: the control height at a corner of the chunk grid. the low-res grid's last row and column are
+//       dropped so that it tiles, since they'd be repeated by the first row and column of the next copy.
+real32 get_chunk_control_height(Terrain_Chunk_Manager *manager, int32 chunk_y, int32 chunk_x) {
+    Terrain *terrain = manager->terrain;
+    int32 low_res_row_index = wrap_index(chunk_y, terrain->max_y - 1);
+    int32 low_res_column_index = wrap_index(chunk_x, terrain->max_x - 1);
+    return terrain->low_res_height_data[get_grid_index<Unchecked_Boundary>(low_res_row_index, low_res_column_index,
+                                                                           terrain->max_x, terrain->max_y)];
+}
+
+inline uint32 get_chunk_hash_slot(int32 chunk_x, int32 chunk_y) {
+    uint32 hash = (uint32) chunk_x*73856093u ^ (uint32) chunk_y*19349663u;
+    return hash & (TERRAIN_CHUNK_HASH_SIZE - 1);
+}
+
+Terrain_Chunk *get_terrain_chunk(Terrain_Chunk_Manager *manager, int32 chunk_x, int32 chunk_y) {
+    Terrain_Chunk *chunk = manager->chunk_hash[get_chunk_hash_slot(chunk_x, chunk_y)];
+    while (chunk && (chunk->chunk_x != chunk_x || chunk->chunk_y != chunk_y)) {
+        chunk = chunk->next_in_hash;
+    }
+    return chunk;
+}
+
+inline int32 get_chunk_coordinate(Terrain_Chunk_Manager *manager, real32 world_position) {
+    return (int32) floorf(world_position / (manager->cell_size*manager->cells_per_chunk));
+}
+
+void init_terrain_chunk_manager(Terrain_Chunk_Manager *manager, Terrain *terrain, real32 h, real32 max_random_height,
+                                uint64 seed, int32 view_radius, Work_Queue *work_queue) {
+    assert(terrain->max_x > 1 && terrain->max_y > 1);
+    manager->terrain = terrain;
+    manager->work_queue = work_queue;
+    manager->h = h;
+    manager->max_random_height = max_random_height;
+    manager->seed = seed;
+
+    // NOTE: a chunk is as detailed as one low-res cell of the terrain would have been
+    manager->chunk_exponent = terrain->resolution_exponent - terrain->low_res_grid_size_exponent;
+    manager->cells_per_chunk = 1 << manager->chunk_exponent;
+    manager->vertices_per_side = manager->cells_per_chunk + 1;
+    manager->cell_size = terrain->world_x_size / (terrain->x_resolution - 1);
+
+    if (view_radius > MAX_TERRAIN_CHUNK_VIEW_RADIUS) {
+        view_radius = MAX_TERRAIN_CHUNK_VIEW_RADIUS;
+    }
+    manager->view_radius = view_radius;
+    manager->max_chunks_generating = 2*(work_queue->num_threads + 1);
+
+    manager->num_indices = manager->cells_per_chunk*manager->cells_per_chunk*6;
+    manager->indices = (uint32 *) malloc(manager->num_indices * sizeof(uint32));
+    if (mesh_chunk_vertex_cache_size > 0) {
+        optimize_grid_indices_for_vertex_cache(manager->indices, manager->vertices_per_side,
+                                               manager->vertices_per_side, mesh_chunk_vertex_cache_size);
+    } else {
+        generate_grid_indices(manager->indices, manager->vertices_per_side, manager->vertices_per_side);
+    }
+
+    manager->first_free_chunk = NULL;
+    for (int32 chunk_index = MAX_TERRAIN_CHUNKS - 1; chunk_index >= 0; chunk_index--) {
+        Terrain_Chunk *chunk = &manager->chunks[chunk_index];
+        chunk->manager = manager;
+        chunk->state = TERRAIN_CHUNK_STATE_FREE;
+        chunk->next_free = manager->first_free_chunk;
+        manager->first_free_chunk = chunk;
+    }
+
+    // NOTE: a fixed max height for shading, so that the colours don't shift as chunks come and go
+    terrain->max_height = FLT_MIN;
+    for (int32 index = 0; index < terrain->max_x*terrain->max_y; index++) {
+        terrain->max_height = fmaxf(terrain->max_height, terrain->low_res_height_data[index]);
+    }
+
+    // NOTE: the workers can't pick the kernels themselves without racing each other
+    if (!terrain_kernels.square_row) {
+        init_terrain_kernels(get_cpu_simd_level());
+    }
+}
+
+// NOTE: a height next to the chunk, which can be in one of the 4 neighbouring chunks. falls back to the
+//       closest height in the chunk itself if the neighbour hasn't been generated yet.
+real32 get_chunk_neighbourhood_height(Terrain_Chunk *chunk, int32 row_index, int32 column_index) {
+    Terrain_Chunk_Manager *manager = chunk->manager;
+    int32 last_index = manager->vertices_per_side - 1;
+
+    Terrain_Chunk *neighbour = NULL;
+    int32 neighbour_row_index = row_index;
+    int32 neighbour_column_index = column_index;
+    if (row_index < 0) {
+        neighbour = get_terrain_chunk(manager, chunk->chunk_x, chunk->chunk_y - 1);
+        neighbour_row_index = last_index - 1;
+    } else if (row_index > last_index) {
+        neighbour = get_terrain_chunk(manager, chunk->chunk_x, chunk->chunk_y + 1);
+        neighbour_row_index = 1;
+    } else if (column_index < 0) {
+        neighbour = get_terrain_chunk(manager, chunk->chunk_x - 1, chunk->chunk_y);
+        neighbour_column_index = last_index - 1;
+    } else if (column_index > last_index) {
+        neighbour = get_terrain_chunk(manager, chunk->chunk_x + 1, chunk->chunk_y);
+        neighbour_column_index = 1;
+    } else {
+        return chunk->heights[get_grid_index<Unchecked_Boundary>(row_index, column_index,
+                                                                 manager->vertices_per_side,
+                                                                 manager->vertices_per_side)];
+    }
+
+    if (neighbour && neighbour->state.load(std::memory_order_acquire) >= TERRAIN_CHUNK_STATE_GENERATED) {
+        return neighbour->heights[get_grid_index<Unchecked_Boundary>(neighbour_row_index, neighbour_column_index,
+                                                                     manager->vertices_per_side,
+                                                                     manager->vertices_per_side)];
+    }
+    return chunk->heights[get_grid_index<Clamp_Boundary>(row_index, column_index,
+                                                         manager->vertices_per_side,
+                                                         manager->vertices_per_side)];
+}
+
+// NOTE: normals from central differences of the heights. unlike the face normals of the single terrain,
+//       these only need the 4 direct neighbours of a vertex, so a chunk's edges only depend on the 4 chunks
+//       next to it.
+inline glm::vec3 get_chunk_normal(Terrain_Chunk *chunk, int32 row_index, int32 column_index) {
+    real32 left = get_chunk_neighbourhood_height(chunk, row_index, column_index - 1);
+    real32 right = get_chunk_neighbourhood_height(chunk, row_index, column_index + 1);
+    real32 top = get_chunk_neighbourhood_height(chunk, row_index - 1, column_index);
+    real32 bottom = get_chunk_neighbourhood_height(chunk, row_index + 1, column_index);
+    return glm::vec3(left - right, 2.0f, top - bottom);
+}
+
+// NOTE: redoes the normals on the 4 edges of the chunk, for when its neighbours have changed
+void update_terrain_chunk_edge_normals(Terrain_Chunk *chunk) {
+    int32 last_index = chunk->manager->vertices_per_side - 1;
+    Grid_View<glm::vec3, Unchecked_Boundary> normals =
+        make_grid_view<Unchecked_Boundary>((glm::vec3 *) chunk->normals, last_index + 1, last_index + 1);
+    for (int32 index = 0; index <= last_index; index++) {
+        normals.at(0, index) = get_chunk_normal(chunk, 0, index);
+        normals.at(last_index, index) = get_chunk_normal(chunk, last_index, index);
+        normals.at(index, 0) = get_chunk_normal(chunk, index, 0);
+        normals.at(index, last_index) = get_chunk_normal(chunk, index, last_index);
+    }
+}
+
+// NOTE: work queue callback
+void do_generate_terrain_chunk(void *data) {
+    Terrain_Chunk *chunk = (Terrain_Chunk *) data;
+    Terrain_Chunk_Manager *manager = chunk->manager;
+    int32 vertices_per_side = manager->vertices_per_side;
+    int32 num_vertices = vertices_per_side*vertices_per_side;
+
+    // NOTE: the chunk as a terrain with a 2x2 low-res grid of its corners
+    real32 corner_heights[4];
+    corner_heights[0] = get_chunk_control_height(manager, chunk->chunk_y, chunk->chunk_x);
+    corner_heights[1] = get_chunk_control_height(manager, chunk->chunk_y, chunk->chunk_x + 1);
+    corner_heights[2] = get_chunk_control_height(manager, chunk->chunk_y + 1, chunk->chunk_x);
+    corner_heights[3] = get_chunk_control_height(manager, chunk->chunk_y + 1, chunk->chunk_x + 1);
+
+    Terrain chunk_terrain = {};
+    chunk_terrain.max_x = 2;
+    chunk_terrain.max_y = 2;
+    chunk_terrain.low_res_grid_size_exponent = 0;
+    set_terrain_resolution_exponent(&chunk_terrain, manager->chunk_exponent);
+    chunk_terrain.low_res_height_data = corner_heights;
+    chunk_terrain.height_data = (real32 *) malloc(num_vertices * sizeof(real32));
+    overlay_low_res_heights<Row_Major_Layout>(&chunk_terrain);
+
+    chunk->max_height = fmaxf(fmaxf(corner_heights[0], corner_heights[1]), fmaxf(corner_heights[2], corner_heights[3]));
+    if (manager->chunk_exponent > 0) {
+        real32 smoothing_factor = powf(2.0f, -manager->h);
+        real32 *row_max_heights = (real32 *) malloc(vertices_per_side * sizeof(real32));
+        for (int32 row_index = 0; row_index < vertices_per_side; row_index++) {
+            row_max_heights[row_index] = FLT_MIN;
+        }
+
+        Diamond_Square_Pass pass = make_diamond_square_pass(&chunk_terrain, row_max_heights, smoothing_factor,
+                                                            manager->max_random_height, manager->seed);
+        pass.rows = chunk_terrain.height_data;
+        pass.global_row_offset = chunk->chunk_y*manager->cells_per_chunk;
+        pass.global_column_offset = chunk->chunk_x*manager->cells_per_chunk;
+        pass.has_shared_edges = true;
+        // NOTE: chunks are already generated in parallel, so each one is done on a single thread
+        run_diamond_square_passes(&pass, smoothing_factor, NULL);
+
+        for (int32 row_index = 0; row_index < vertices_per_side; row_index++) {
+            chunk->max_height = fmaxf(chunk->max_height, row_max_heights[row_index]);
+        }
+        free(row_max_heights);
+    }
+    chunk->heights = chunk_terrain.height_data;
+
+    // NOTE: vertices are relative to the chunk's first corner, in cells
+    Grid_View<real32, Unchecked_Boundary> heights = make_grid_view<Unchecked_Boundary>(chunk->heights,
+                                                                                      vertices_per_side,
+                                                                                      vertices_per_side);
+    chunk->vertices = (real32 *) malloc(num_vertices * 3 * sizeof(real32));
+    for (int32 row_index = 0; row_index < vertices_per_side; row_index++) {
+        real32 *height_row = heights.get_row(row_index);
+        real32 *vertex_row = chunk->vertices + 3*heights.get_index(row_index, 0);
+        for (int32 column_index = 0; column_index < vertices_per_side; column_index++) {
+            vertex_row[3*column_index]     = (real32) column_index;
+            vertex_row[3*column_index + 1] = height_row[column_index];
+            vertex_row[3*column_index + 2] = (real32) row_index;
+        }
+    }
+
+    // NOTE: the edges get redone on the main thread once the neighbours are there
+    chunk->normals = (real32 *) malloc(num_vertices * 3 * sizeof(real32));
+    Grid_View<glm::vec3, Unchecked_Boundary> normals =
+        make_grid_view<Unchecked_Boundary>((glm::vec3 *) chunk->normals, vertices_per_side, vertices_per_side);
+    for (int32 row_index = 0; row_index < vertices_per_side; row_index++) {
+        glm::vec3 *normal_row = normals.get_row(row_index);
+        for (int32 column_index = 0; column_index < vertices_per_side; column_index++) {
+            real32 left = heights.at(row_index, Clamp_Boundary::resolve(column_index - 1, vertices_per_side));
+            real32 right = heights.at(row_index, Clamp_Boundary::resolve(column_index + 1, vertices_per_side));
+            real32 top = heights.at(Clamp_Boundary::resolve(row_index - 1, vertices_per_side), column_index);
+            real32 bottom = heights.at(Clamp_Boundary::resolve(row_index + 1, vertices_per_side), column_index);
+            normal_row[column_index] = glm::vec3(left - right, 2.0f, top - bottom);
+        }
+    }
+
+    // NOTE: the textures repeat once per copy of the low-res grid, like they cover the single terrain once
+    Terrain *terrain = manager->terrain;
+    int32 cells_per_texture_x = (terrain->max_x - 1)*manager->cells_per_chunk;
+    int32 cells_per_texture_y = (terrain->max_y - 1)*manager->cells_per_chunk;
+    int32 first_texture_column = wrap_index(chunk->chunk_x, terrain->max_x - 1)*manager->cells_per_chunk;
+    int32 first_texture_row = wrap_index(chunk->chunk_y, terrain->max_y - 1)*manager->cells_per_chunk;
+    chunk->uvs = (real32 *) malloc(num_vertices * 2 * sizeof(real32));
+    for (int32 row_index = 0; row_index < vertices_per_side; row_index++) {
+        real32 *uv_row = chunk->uvs + 2*heights.get_index(row_index, 0);
+        real32 v = (real32) (cells_per_texture_y - (first_texture_row + row_index)) / cells_per_texture_y;
+        for (int32 column_index = 0; column_index < vertices_per_side; column_index++) {
+            real32 u = (real32) (first_texture_column + column_index) / cells_per_texture_x;
+            uv_row[2*column_index]     = u;
+            uv_row[2*column_index + 1] = v;
+        }
+    }
+
+    chunk->state.store(TERRAIN_CHUNK_STATE_GENERATED, std::memory_order_release);
+}
+
+// NOTE: queues the missing chunks within view_radius of the camera, closest ring first. never waits for
+//       anything; chunks that don't fit under max_chunks_generating are queued on a later frame.
+void request_terrain_chunks(Terrain_Chunk_Manager *manager, glm::vec3 camera_position) {
+    int32 num_chunks_generating = 0;
+    for (int32 chunk_index = 0; chunk_index < MAX_TERRAIN_CHUNKS; chunk_index++) {
+        if (manager->chunks[chunk_index].state.load(std::memory_order_acquire) == TERRAIN_CHUNK_STATE_GENERATING) {
+            num_chunks_generating++;
+        }
+    }
+
+    // NOTE: world z is the row direction
+    int32 camera_chunk_x = get_chunk_coordinate(manager, camera_position.x);
+    int32 camera_chunk_y = get_chunk_coordinate(manager, camera_position.z);
+    for (int32 ring = 0; ring <= manager->view_radius; ring++) {
+        for (int32 chunk_y = camera_chunk_y - ring; chunk_y <= camera_chunk_y + ring; chunk_y++) {
+            for (int32 chunk_x = camera_chunk_x - ring; chunk_x <= camera_chunk_x + ring; chunk_x++) {
+                bool32 is_on_ring = (abs(chunk_x - camera_chunk_x) == ring || abs(chunk_y - camera_chunk_y) == ring);
+                if (!is_on_ring || get_terrain_chunk(manager, chunk_x, chunk_y)) {
+                    continue;
+                }
+                if (num_chunks_generating >= manager->max_chunks_generating || !manager->first_free_chunk) {
+                    return;
+                }
+
+                Terrain_Chunk *chunk = manager->first_free_chunk;
+                manager->first_free_chunk = chunk->next_free;
+
+                chunk->chunk_x = chunk_x;
+                chunk->chunk_y = chunk_y;
+                chunk->heights = NULL;
+                chunk->vertices = NULL;
+                chunk->normals = NULL;
+                chunk->uvs = NULL;
+                chunk->vao = 0;
+                chunk->vbo = 0;
+                chunk->state.store(TERRAIN_CHUNK_STATE_GENERATING, std::memory_order_relaxed);
+
+                uint32 slot = get_chunk_hash_slot(chunk_x, chunk_y);
+                chunk->next_in_hash = manager->chunk_hash[slot];
+                manager->chunk_hash[slot] = chunk;
+
+                add_work_queue_entry(manager->work_queue, do_generate_terrain_chunk, chunk);
+                num_chunks_generating++;
+            }
+        }
+    }
+}
+
+// NOTE: chunks that are still generating are left alone, they get evicted after they're done
+bool32 should_evict_terrain_chunk(Terrain_Chunk_Manager *manager, Terrain_Chunk *chunk, glm::vec3 camera_position) {
+    int32 state = chunk->state.load(std::memory_order_acquire);
+    if (state == TERRAIN_CHUNK_STATE_FREE || state == TERRAIN_CHUNK_STATE_GENERATING) {
+        return false;
+    }
+
+    int32 distance_x = abs(chunk->chunk_x - get_chunk_coordinate(manager, camera_position.x));
+    int32 distance_y = abs(chunk->chunk_y - get_chunk_coordinate(manager, camera_position.z));
+    int32 eviction_radius = manager->view_radius + 2;
+    return (distance_x > eviction_radius || distance_y > eviction_radius);
+}
+
+// NOTE: the caller has to delete the chunk's GL objects first
+void free_terrain_chunk(Terrain_Chunk_Manager *manager, Terrain_Chunk *chunk) {
+    Terrain_Chunk **link = &manager->chunk_hash[get_chunk_hash_slot(chunk->chunk_x, chunk->chunk_y)];
+    while (*link != chunk) {
+        link = &(*link)->next_in_hash;
+    }
+    *link = chunk->next_in_hash;
+
+    free(chunk->heights);
+    free(chunk->vertices);
+    free(chunk->normals);
+    free(chunk->uvs);
+    chunk->heights = NULL;
+    chunk->vertices = NULL;
+    chunk->normals = NULL;
+    chunk->uvs = NULL;
+
+    chunk->state.store(TERRAIN_CHUNK_STATE_FREE, std::memory_order_relaxed);
+    chunk->next_free = manager->first_free_chunk;
+    manager->first_free_chunk = chunk;
+}
@@ -0,0 +1,73 @@
+#ifndef TERRAIN_CHUNKS_H
+
+// NOTE: an endless terrain made of square chunks that are generated around the camera as it moves. chunk
+//       (chunk_x, chunk_y) is one cell of the low-res grid, which repeats in both directions, and has
+//       2^chunk_exponent + 1 heights per side. neighbouring chunks share their edge heights exactly.
+
+#define MAX_TERRAIN_CHUNKS 512
+#define TERRAIN_CHUNK_HASH_SIZE 1024
+#define MAX_TERRAIN_CHUNK_VIEW_RADIUS 8
+
+enum Terrain_Chunk_State {
+    TERRAIN_CHUNK_STATE_FREE,
+    // NOTE: queued or being generated on a worker thread. nothing but the worker touches the chunk's data.
+    TERRAIN_CHUNK_STATE_GENERATING,
+    // NOTE: heights, vertices, normals and UVs are done, but it hasn't been uploaded yet
+    TERRAIN_CHUNK_STATE_GENERATED,
+    TERRAIN_CHUNK_STATE_READY
+};
+
+struct Terrain_Chunk_Manager;
+
+struct Terrain_Chunk {
+    Terrain_Chunk_Manager *manager;
+    int32 chunk_x;
+    int32 chunk_y;
+    // NOTE: the worker sets this to TERRAIN_CHUNK_STATE_GENERATED when it's done, everything else is
+    //       done on the main thread
+    std::atomic<int32> state;
+
+    real32 *heights;
+    real32 *vertices;
+    real32 *normals;
+    real32 *uvs;
+    real32 max_height;
+
+    uint32 vao;
+    uint32 vbo;
+
+    Terrain_Chunk *next_in_hash;
+    Terrain_Chunk *next_free;
+};
+
+struct Terrain_Chunk_Manager {
+    // NOTE: the low-res heights and the settings come from here, and chunks are drawn with its shader
+    //       and textures
+    Terrain *terrain;
+    Work_Queue *work_queue;
+    real32 h;
+    real32 max_random_height;
+    uint64 seed;
+
+    int32 chunk_exponent;
+    int32 cells_per_chunk;
+    int32 vertices_per_side;
+    // NOTE: world units per cell
+    real32 cell_size;
+
+    // NOTE: in chunks. chunks are kept until they're 2 chunks further out than this.
+    int32 view_radius;
+    int32 max_chunks_generating;
+
+    // NOTE: every chunk has the same index buffer
+    uint32 *indices;
+    int32 num_indices;
+    uint32 ebo;
+
+    Terrain_Chunk chunks[MAX_TERRAIN_CHUNKS];
+    Terrain_Chunk *first_free_chunk;
+    Terrain_Chunk *chunk_hash[TERRAIN_CHUNK_HASH_SIZE];
+};
+
+#define TERRAIN_CHUNKS_H
+#endif
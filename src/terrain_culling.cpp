@@ -0,0 +1,495 @@
+#include "main.h"
+#include "grid.h"
+#include "terrain.h"
+#include "terrain_culling.h"
+
+glm::mat4 get_camera_view_matrix(Camera *camera) {
+    return glm::lookAt(camera->position, camera->position + camera->forward, camera->up);
+}
+
+glm::mat4 get_camera_projection_matrix(Camera *camera) {
+    real32 aspect_ratio = (real32) camera->window_width / camera->window_height;
+    return glm::perspective(glm::radians(camera->fov_y_degrees), aspect_ratio, camera->near_y, camera->far_y);
+}
+
+// NOTE: the planes are sums and differences of the matrix's rows (Gribb and Hartmann): a point is inside when
+//       -w <= x, y, z <= w in clip space
+Frustum make_frustum(glm::mat4 view_projection_matrix) {
+    glm::mat4 m = view_projection_matrix;
+    glm::vec4 rows[4];
+    for (int32 row_index = 0; row_index < 4; row_index++) {
+        rows[row_index] = glm::vec4(m[0][row_index], m[1][row_index], m[2][row_index], m[3][row_index]);
+    }
+
+    Frustum frustum;
+    for (int32 axis = 0; axis < 3; axis++) {
+        frustum.planes[2*axis] = rows[3] + rows[axis];
+        frustum.planes[2*axis + 1] = rows[3] - rows[axis];
+    }
+    for (int32 plane_index = 0; plane_index < 6; plane_index++) {
+        frustum.planes[plane_index] /= glm::length(glm::vec3(frustum.planes[plane_index]));
+    }
+    return frustum;
+}
+
+// NOTE: for each plane, the corner of the box furthest along its normal is the one that decides whether the
+//       box is all outside it, and the closest corner whether the box is all inside it
+Frustum_Test test_frustum_box(Frustum *frustum, glm::vec3 box_min, glm::vec3 box_max) {
+    Frustum_Test result = FRUSTUM_INSIDE;
+    for (int32 plane_index = 0; plane_index < 6; plane_index++) {
+        glm::vec4 plane = frustum->planes[plane_index];
+        glm::vec3 furthest = glm::vec3((plane.x >= 0) ? box_max.x : box_min.x, (plane.y >= 0) ? box_max.y : box_min.y,
+                                       (plane.z >= 0) ? box_max.z : box_min.z);
+        if (glm::dot(glm::vec3(plane), furthest) + plane.w < 0) {
+            return FRUSTUM_OUTSIDE;
+        }
+        glm::vec3 closest = glm::vec3((plane.x >= 0) ? box_min.x : box_max.x, (plane.y >= 0) ? box_min.y : box_max.y,
+                                      (plane.z >= 0) ? box_min.z : box_max.z);
+        if (glm::dot(glm::vec3(plane), closest) + plane.w < 0) {
+            result = FRUSTUM_INTERSECTING;
+        }
+    }
+    return result;
+}
+
+// NOTE: only needs terrain->mesh_chunks. the bounds are left for update_terrain_culling_bounds(), or for
+//       update_terrain_culling_leaves() and then update_terrain_culling_levels() on all the leaves.
+Terrain_Culling *make_terrain_culling(Terrain *terrain) {
+    Terrain_Culling *culling = (Terrain_Culling *) calloc(1, sizeof(Terrain_Culling));
+    Mesh_Chunk_Layout *mesh_chunks = &terrain->mesh_chunks;
+    culling->mesh_chunks = mesh_chunks;
+
+    int32 leaf_size = (mesh_chunks->cells_per_chunk < CULLING_LEAF_CELLS) ? mesh_chunks->cells_per_chunk :
+                                                                          CULLING_LEAF_CELLS;
+    int32 grid_cells = (terrain->x_resolution > terrain->y_resolution) ? terrain->x_resolution - 1 :
+                                                                         terrain->y_resolution - 1;
+    culling->num_levels = 1;
+    while ((leaf_size << (culling->num_levels - 1)) < grid_cells) {
+        culling->num_levels++;
+    }
+    culling->levels = (Culling_Level *) malloc(culling->num_levels * sizeof(Culling_Level));
+    culling->occluder_level_index = -1;
+    for (int32 level_index = 0; level_index < culling->num_levels; level_index++) {
+        Culling_Level *level = &culling->levels[level_index];
+        level->node_size = leaf_size << level_index;
+        level->nodes_per_row = (terrain->x_resolution - 1 + level->node_size - 1) / level->node_size;
+        level->nodes_per_column = (terrain->y_resolution - 1 + level->node_size - 1) / level->node_size;
+        level->nodes = (Culling_Node_Bounds *) malloc(level->nodes_per_row*level->nodes_per_column *
+                                                      sizeof(Culling_Node_Bounds));
+        if (level->node_size == mesh_chunks->cells_per_chunk) {
+            culling->chunk_level_index = level_index;
+        }
+        if (culling->occluder_level_index < 0 && level->nodes_per_row <= MAX_OCCLUDERS_PER_SIDE &&
+            level->nodes_per_column <= MAX_OCCLUDERS_PER_SIDE) {
+            culling->occluder_level_index = level_index;
+        }
+    }
+    culling->visible_chunks = (int32 *) malloc(mesh_chunks->num_chunks * sizeof(int32));
+
+    Occlusion_Buffer *occlusion = &culling->occlusion;
+    occlusion->depths = (real32 *) malloc(OCCLUSION_BUFFER_WIDTH*OCCLUSION_BUFFER_WIDTH * sizeof(real32));
+    occlusion->eroded_depths = (real32 *) malloc(OCCLUSION_BUFFER_WIDTH*OCCLUSION_BUFFER_WIDTH * sizeof(real32));
+
+    return culling;
+}
+
+void free_terrain_culling(Terrain_Culling *culling) {
+    for (int32 level_index = 0; level_index < culling->num_levels; level_index++) {
+        free(culling->levels[level_index].nodes);
+    }
+    free(culling->levels);
+    free(culling->visible_chunks);
+    free(culling->occlusion.depths);
+    free(culling->occlusion.eroded_depths);
+    free(culling);
+}
+
+// NOTE: the bounds of the leaves in nodes (rows and columns of leaves). node i has the vertices
+//       [i*size, (i + 1)*size], so the ones on an edge are in two nodes.
+void update_terrain_culling_leaves(Terrain_Culling *culling, Terrain *terrain, Grid_Rect nodes) {
+    Culling_Level *leaves = &culling->levels[0];
+    int32 size = leaves->node_size;
+    for (int32 node_row_index = nodes.min_row_index; node_row_index <= nodes.max_row_index; node_row_index++) {
+        for (int32 node_column_index = nodes.min_column_index; node_column_index <= nodes.max_column_index;
+             node_column_index++) {
+            Culling_Node_Bounds *node = &leaves->nodes[node_row_index*leaves->nodes_per_row + node_column_index];
+            node->min_height = FLT_MAX;
+            node->max_height = -FLT_MAX;
+            int32 max_row_index = (node_row_index + 1)*size;
+            max_row_index = (max_row_index < terrain->y_resolution - 1) ? max_row_index : terrain->y_resolution - 1;
+            int32 max_column_index = (node_column_index + 1)*size;
+            max_column_index = (max_column_index < terrain->x_resolution - 1) ? max_column_index :
+                                                                                terrain->x_resolution - 1;
+            // NOTE: the heights are read from the vertices, since height_data might have been quantized
+            for (int32 row_index = node_row_index*size; row_index <= max_row_index; row_index++) {
+                real32 *vertex = terrain->vertices + 3*(((int64) row_index)*terrain->x_resolution +
+                                                        node_column_index*size);
+                for (int32 column_index = node_column_index*size; column_index <= max_column_index; column_index++) {
+                    node->min_height = fminf(node->min_height, vertex[1]);
+                    node->max_height = fmaxf(node->max_height, vertex[1]);
+                    vertex += 3;
+                }
+            }
+        }
+    }
+}
+
+// NOTE: the bounds of the nodes above the leaves in nodes, from their children
+void update_terrain_culling_levels(Terrain_Culling *culling, Grid_Rect nodes) {
+    for (int32 level_index = 1; level_index < culling->num_levels; level_index++) {
+        Culling_Level *level = &culling->levels[level_index];
+        Culling_Level *child_level = &culling->levels[level_index - 1];
+        for (int32 node_row_index = nodes.min_row_index >> level_index;
+             node_row_index <= (nodes.max_row_index >> level_index); node_row_index++) {
+            for (int32 node_column_index = nodes.min_column_index >> level_index;
+                 node_column_index <= (nodes.max_column_index >> level_index); node_column_index++) {
+                Culling_Node_Bounds *node = &level->nodes[node_row_index*level->nodes_per_row + node_column_index];
+                node->min_height = FLT_MAX;
+                node->max_height = -FLT_MAX;
+                for (int32 child_index = 0; child_index < 4; child_index++) {
+                    int32 child_row_index = 2*node_row_index + (child_index >> 1);
+                    int32 child_column_index = 2*node_column_index + (child_index & 1);
+                    if (child_row_index >= child_level->nodes_per_column ||
+                        child_column_index >= child_level->nodes_per_row) {
+                        continue;
+                    }
+                    Culling_Node_Bounds *child = &child_level->nodes[child_row_index*child_level->nodes_per_row +
+                                                                     child_column_index];
+                    node->min_height = fminf(node->min_height, child->min_height);
+                    node->max_height = fmaxf(node->max_height, child->max_height);
+                }
+            }
+        }
+    }
+}
+
+// NOTE: rebuilds the bounds of every leaf with a vertex in rect, and of the nodes above them
+void update_terrain_culling_bounds(Terrain_Culling *culling, Terrain *terrain, Grid_Rect rect) {
+    Culling_Level *leaves = &culling->levels[0];
+    int32 size = leaves->node_size;
+    Grid_Rect nodes;
+    nodes.min_row_index = (rect.min_row_index > 0) ? (rect.min_row_index - 1) / size : 0;
+    nodes.max_row_index = rect.max_row_index / size;
+    if (nodes.max_row_index >= leaves->nodes_per_column) {
+        nodes.max_row_index = leaves->nodes_per_column - 1;
+    }
+    nodes.min_column_index = (rect.min_column_index > 0) ? (rect.min_column_index - 1) / size : 0;
+    nodes.max_column_index = rect.max_column_index / size;
+    if (nodes.max_column_index >= leaves->nodes_per_row) {
+        nodes.max_column_index = leaves->nodes_per_row - 1;
+    }
+
+    update_terrain_culling_leaves(culling, terrain, nodes);
+    update_terrain_culling_levels(culling, nodes);
+}
+
+struct Culling_Query {
+    Terrain_Culling *culling;
+    glm::mat4 view_projection_matrix;
+    Frustum frustum;
+    glm::vec3 camera_position;
+    // NOTE: world units per cell and per height
+    glm::vec3 scale;
+    int32 last_row_index;
+    int32 last_column_index;
+};
+
+// NOTE: the box of a node from min_height to max_height, in the same space as gl_draw_terrain()'s model matrix
+//       puts the vertices in
+static void get_culling_node_box(Culling_Query *query, int32 level_index, int32 node_row_index,
+                                 int32 node_column_index, real32 min_height, real32 max_height, glm::vec3 *box_min,
+                                 glm::vec3 *box_max) {
+    int32 node_size = query->culling->levels[level_index].node_size;
+    int32 max_row_index = (node_row_index + 1)*node_size;
+    int32 max_column_index = (node_column_index + 1)*node_size;
+    max_row_index = (max_row_index < query->last_row_index) ? max_row_index : query->last_row_index;
+    max_column_index = (max_column_index < query->last_column_index) ? max_column_index : query->last_column_index;
+    *box_min = glm::vec3(node_column_index*node_size, min_height, node_row_index*node_size - query->last_row_index) *
+               query->scale;
+    *box_max = glm::vec3(max_column_index, max_height, max_row_index - query->last_row_index) * query->scale;
+}
+
+static void cull_terrain_node(Culling_Query *query, int32 level_index, int32 node_row_index, int32 node_column_index,
+                              bool32 is_inside) {
+    Terrain_Culling *culling = query->culling;
+    Culling_Level *level = &culling->levels[level_index];
+    if (!is_inside) {
+        Culling_Node_Bounds *node = &level->nodes[node_row_index*level->nodes_per_row + node_column_index];
+        glm::vec3 box_min, box_max;
+        get_culling_node_box(query, level_index, node_row_index, node_column_index, node->min_height,
+                             node->max_height, &box_min, &box_max);
+        Frustum_Test test = test_frustum_box(&query->frustum, box_min, box_max);
+        culling->num_box_tests++;
+        if (test == FRUSTUM_OUTSIDE) {
+            return;
+        }
+        is_inside = (test == FRUSTUM_INSIDE);
+    }
+
+    if (level_index == culling->chunk_level_index) {
+        culling->visible_chunks[culling->num_visible_chunks++] = node_row_index*level->nodes_per_row +
+                                                                 node_column_index;
+        return;
+    }
+    Culling_Level *child_level = &culling->levels[level_index - 1];
+    for (int32 child_index = 0; child_index < 4; child_index++) {
+        int32 child_row_index = 2*node_row_index + (child_index >> 1);
+        int32 child_column_index = 2*node_column_index + (child_index & 1);
+        if (child_row_index < child_level->nodes_per_column && child_column_index < child_level->nodes_per_row) {
+            cull_terrain_node(query, level_index - 1, child_row_index, child_column_index, is_inside);
+        }
+    }
+}
+
+// NOTE: p is (x, y) in pixels and z the depth. only the pixels whose centers are in the triangle are drawn.
+static void rasterize_occluder_triangle(Occlusion_Buffer *buffer, glm::vec3 a, glm::vec3 b, glm::vec3 c) {
+    real32 area = (b.x - a.x)*(c.y - a.y) - (b.y - a.y)*(c.x - a.x);
+    if (area == 0) {
+        return;
+    }
+    if (area < 0) {
+        glm::vec3 swap = b;
+        b = c;
+        c = swap;
+        area = -area;
+    }
+
+    int32 min_x = (int32) floorf(fminf(a.x, fminf(b.x, c.x)));
+    int32 max_x = (int32) ceilf(fmaxf(a.x, fmaxf(b.x, c.x)));
+    int32 min_y = (int32) floorf(fminf(a.y, fminf(b.y, c.y)));
+    int32 max_y = (int32) ceilf(fmaxf(a.y, fmaxf(b.y, c.y)));
+    min_x = (min_x > 0) ? min_x : 0;
+    min_y = (min_y > 0) ? min_y : 0;
+    max_x = (max_x < buffer->width - 1) ? max_x : buffer->width - 1;
+    max_y = (max_y < buffer->height - 1) ? max_y : buffer->height - 1;
+    // NOTE: the edge functions, and the depth, change by a constant amount from one pixel to the next
+    real32 pixel_x = min_x + 0.5f;
+    real32 depth_x_step = ((b.y - c.y)*a.z + (c.y - a.y)*b.z + (a.y - b.y)*c.z) / area;
+    for (int32 y = min_y; y <= max_y; y++) {
+        real32 pixel_y = y + 0.5f;
+        real32 weight_a = (c.x - b.x)*(pixel_y - b.y) - (c.y - b.y)*(pixel_x - b.x);
+        real32 weight_b = (a.x - c.x)*(pixel_y - c.y) - (a.y - c.y)*(pixel_x - c.x);
+        real32 weight_c = (b.x - a.x)*(pixel_y - a.y) - (b.y - a.y)*(pixel_x - a.x);
+        real32 depth = (weight_a*a.z + weight_b*b.z + weight_c*c.z) / area;
+        real32 *pixel_depth = &buffer->depths[y*buffer->width + min_x];
+        for (int32 x = min_x; x <= max_x; x++) {
+            if (weight_a >= 0 && weight_b >= 0 && weight_c >= 0) {
+                *pixel_depth = fminf(*pixel_depth, depth);
+            }
+            weight_a -= c.y - b.y;
+            weight_b -= a.y - c.y;
+            weight_c -= b.y - a.y;
+            depth += depth_x_step;
+            pixel_depth++;
+        }
+    }
+}
+
+inline glm::vec3 get_occlusion_buffer_position(Occlusion_Buffer *buffer, glm::vec4 clip_position) {
+    glm::vec3 ndc = glm::vec3(clip_position) / clip_position.w;
+    return glm::vec3((0.5f*ndc.x + 0.5f)*buffer->width, (0.5f*ndc.y + 0.5f)*buffer->height, ndc.z);
+}
+
+// NOTE: a quad of an occluder, clipped to the near plane (z >= -w in clip space), as a fan of triangles
+static int32 draw_occluder_quad(Culling_Query *query, glm::vec3 *corners) {
+    Occlusion_Buffer *buffer = &query->culling->occlusion;
+    glm::vec4 clip_positions[4];
+    for (int32 corner_index = 0; corner_index < 4; corner_index++) {
+        clip_positions[corner_index] = query->view_projection_matrix*glm::vec4(corners[corner_index], 1.0f);
+    }
+    glm::vec4 clipped[5];
+    int32 num_clipped = 0;
+    for (int32 corner_index = 0; corner_index < 4; corner_index++) {
+        glm::vec4 p = clip_positions[corner_index];
+        glm::vec4 q = clip_positions[(corner_index + 1) % 4];
+        real32 p_distance = p.z + p.w;
+        real32 q_distance = q.z + q.w;
+        if (p_distance >= 0) {
+            clipped[num_clipped++] = p;
+        }
+        if ((p_distance >= 0) != (q_distance >= 0)) {
+            clipped[num_clipped++] = p + (p_distance / (p_distance - q_distance))*(q - p);
+        }
+    }
+
+    int32 num_triangles = 0;
+    for (int32 vertex_index = 1; vertex_index + 1 < num_clipped; vertex_index++) {
+        rasterize_occluder_triangle(buffer, get_occlusion_buffer_position(buffer, clipped[0]),
+                                    get_occlusion_buffer_position(buffer, clipped[vertex_index]),
+                                    get_occlusion_buffer_position(buffer, clipped[vertex_index + 1]));
+        num_triangles++;
+    }
+    return num_triangles;
+}
+
+// NOTE: the column under every occluder node in the frustum, from the bottom of the terrain, without the faces
+//       that face away from the camera or are inside the columns around it
+static void draw_terrain_occluders(Culling_Query *query) {
+    Terrain_Culling *culling = query->culling;
+    Occlusion_Buffer *buffer = &culling->occlusion;
+    for (int32 pixel_index = 0; pixel_index < buffer->width*buffer->height; pixel_index++) {
+        buffer->depths[pixel_index] = FLT_MAX;
+    }
+
+    real32 bottom_height = culling->levels[culling->num_levels - 1].nodes[0].min_height;
+    Culling_Level *level = &culling->levels[culling->occluder_level_index];
+    glm::vec3 camera_position = query->camera_position;
+    culling->num_occluder_triangles = 0;
+    for (int32 node_row_index = 0; node_row_index < level->nodes_per_column; node_row_index++) {
+        for (int32 node_column_index = 0; node_column_index < level->nodes_per_row; node_column_index++) {
+            Culling_Node_Bounds *node = &level->nodes[node_row_index*level->nodes_per_row + node_column_index];
+            if (node->min_height <= bottom_height) {
+                continue;
+            }
+            glm::vec3 box_min, box_max;
+            get_culling_node_box(query, culling->occluder_level_index, node_row_index, node_column_index,
+                                 bottom_height, node->min_height, &box_min, &box_max);
+            if (test_frustum_box(&query->frustum, box_min, box_max) == FRUSTUM_OUTSIDE) {
+                continue;
+            }
+
+            glm::vec3 faces[5][4];
+            int32 num_faces = 0;
+            if (camera_position.y > box_max.y) {
+                faces[num_faces][0] = glm::vec3(box_min.x, box_max.y, box_min.z);
+                faces[num_faces][1] = glm::vec3(box_max.x, box_max.y, box_min.z);
+                faces[num_faces][2] = glm::vec3(box_max.x, box_max.y, box_max.z);
+                faces[num_faces][3] = glm::vec3(box_min.x, box_max.y, box_max.z);
+                num_faces++;
+            }
+            for (int32 side = 0; side < 4; side++) {
+                // NOTE: -x, +x, -z, +z
+                int32 axis = (side < 2) ? 0 : 2;
+                real32 face_position = (side & 1) ? box_max[axis] : box_min[axis];
+                bool32 is_facing_camera = (side & 1) ? (camera_position[axis] > face_position) :
+                                                       (camera_position[axis] < face_position);
+                if (!is_facing_camera) {
+                    continue;
+                }
+                // NOTE: the part of the face below the top of the column next to it is inside the two columns
+                real32 face_bottom = box_min.y;
+                int32 neighbour_row_index = node_row_index + ((side == 2) ? -1 : (side == 3) ? 1 : 0);
+                int32 neighbour_column_index = node_column_index + ((side == 0) ? -1 : (side == 1) ? 1 : 0);
+                if (neighbour_row_index >= 0 && neighbour_row_index < level->nodes_per_column &&
+                    neighbour_column_index >= 0 && neighbour_column_index < level->nodes_per_row) {
+                    Culling_Node_Bounds *neighbour = &level->nodes[neighbour_row_index*level->nodes_per_row +
+                                                                   neighbour_column_index];
+                    face_bottom = fmaxf(face_bottom, neighbour->min_height*query->scale.y);
+                }
+                if (face_bottom >= box_max.y) {
+                    continue;
+                }
+                int32 other_axis = 2 - axis;
+                for (int32 corner_index = 0; corner_index < 4; corner_index++) {
+                    glm::vec3 corner;
+                    corner[axis] = face_position;
+                    corner[other_axis] = (corner_index == 1 || corner_index == 2) ? box_max[other_axis] :
+                                                                                   box_min[other_axis];
+                    corner.y = (corner_index >= 2) ? box_max.y : face_bottom;
+                    faces[num_faces][corner_index] = corner;
+                }
+                num_faces++;
+            }
+            for (int32 face_index = 0; face_index < num_faces; face_index++) {
+                culling->num_occluder_triangles += draw_occluder_quad(query, faces[face_index]);
+            }
+        }
+    }
+
+    for (int32 y = 0; y < buffer->height; y++) {
+        for (int32 x = 0; x < buffer->width; x++) {
+            real32 depth = -FLT_MAX;
+            for (int32 neighbour_y = (y > 0) ? y - 1 : 0; neighbour_y <= y + 1 && neighbour_y < buffer->height;
+                 neighbour_y++) {
+                for (int32 neighbour_x = (x > 0) ? x - 1 : 0; neighbour_x <= x + 1 && neighbour_x < buffer->width;
+                     neighbour_x++) {
+                    depth = fmaxf(depth, buffer->depths[neighbour_y*buffer->width + neighbour_x]);
+                }
+            }
+            buffer->eroded_depths[y*buffer->width + x] = depth;
+        }
+    }
+}
+
+// NOTE: a box is occluded if it's behind the occluders at every pixel its corners' bounding rectangle touches.
+//       a box that crosses the near plane never is.
+static bool32 is_box_occluded(Culling_Query *query, glm::vec3 box_min, glm::vec3 box_max) {
+    Occlusion_Buffer *buffer = &query->culling->occlusion;
+    glm::vec3 rect_min = glm::vec3(FLT_MAX);
+    glm::vec3 rect_max = glm::vec3(-FLT_MAX);
+    for (int32 corner_index = 0; corner_index < 8; corner_index++) {
+        glm::vec3 corner = glm::vec3((corner_index & 1) ? box_max.x : box_min.x,
+                                     (corner_index & 2) ? box_max.y : box_min.y,
+                                     (corner_index & 4) ? box_max.z : box_min.z);
+        glm::vec4 clip_position = query->view_projection_matrix*glm::vec4(corner, 1.0f);
+        if (clip_position.w <= 0 || clip_position.z < -clip_position.w) {
+            return false;
+        }
+        glm::vec3 position = get_occlusion_buffer_position(buffer, clip_position);
+        rect_min = glm::min(rect_min, position);
+        rect_max = glm::max(rect_max, position);
+    }
+
+    int32 min_x = ((int32) floorf(rect_min.x) > 0) ? (int32) floorf(rect_min.x) : 0;
+    int32 min_y = ((int32) floorf(rect_min.y) > 0) ? (int32) floorf(rect_min.y) : 0;
+    int32 max_x = ((int32) floorf(rect_max.x) < buffer->width - 1) ? (int32) floorf(rect_max.x) : buffer->width - 1;
+    int32 max_y = ((int32) floorf(rect_max.y) < buffer->height - 1) ? (int32) floorf(rect_max.y) : buffer->height - 1;
+    if (min_x > max_x || min_y > max_y) {
+        return false;
+    }
+    for (int32 y = min_y; y <= max_y; y++) {
+        for (int32 x = min_x; x <= max_x; x++) {
+            if (buffer->eroded_depths[y*buffer->width + x] >= rect_min.z) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// NOTE: fills in visible_chunks with the chunks that might be in camera's view. the terrain is drawn with the
+//       model matrix from gl_draw_terrain().
+void cull_terrain_chunks(Terrain_Culling *culling, Terrain *terrain, Camera *camera) {
+    Culling_Query query = {};
+    query.culling = culling;
+    query.view_projection_matrix = get_camera_projection_matrix(camera)*get_camera_view_matrix(camera);
+    query.frustum = make_frustum(query.view_projection_matrix);
+    query.camera_position = camera->position;
+    query.scale = glm::vec3(terrain->world_x_size / (terrain->x_resolution - 1), terrain->vertical_scale_factor,
+                            terrain->world_y_size / (terrain->y_resolution - 1));
+    query.last_row_index = terrain->y_resolution - 1;
+    query.last_column_index = terrain->x_resolution - 1;
+
+    culling->num_visible_chunks = 0;
+    culling->num_box_tests = 0;
+    cull_terrain_node(&query, culling->num_levels - 1, 0, 0, false);
+    culling->num_frustum_visible_chunks = culling->num_visible_chunks;
+    if (!culling->use_occlusion) {
+        return;
+    }
+
+    real64 start_time = get_seconds();
+    Occlusion_Buffer *buffer = &culling->occlusion;
+    buffer->width = OCCLUSION_BUFFER_WIDTH;
+    buffer->height = (int32) ((real32) OCCLUSION_BUFFER_WIDTH*camera->window_height / camera->window_width);
+    buffer->height = (buffer->height < 1) ? 1 : buffer->height;
+    buffer->height = (buffer->height > OCCLUSION_BUFFER_WIDTH) ? OCCLUSION_BUFFER_WIDTH : buffer->height;
+    draw_terrain_occluders(&query);
+
+    Culling_Level *chunk_level = &culling->levels[culling->chunk_level_index];
+    int32 num_visible_chunks = 0;
+    for (int32 visible_index = 0; visible_index < culling->num_visible_chunks; visible_index++) {
+        int32 chunk_index = culling->visible_chunks[visible_index];
+        int32 chunk_row_index = chunk_index / chunk_level->nodes_per_row;
+        int32 chunk_column_index = chunk_index % chunk_level->nodes_per_row;
+        Culling_Node_Bounds *node = &chunk_level->nodes[chunk_index];
+        glm::vec3 box_min, box_max;
+        get_culling_node_box(&query, culling->chunk_level_index, chunk_row_index, chunk_column_index,
+                             node->min_height, node->max_height, &box_min, &box_max);
+        if (!is_box_occluded(&query, box_min, box_max)) {
+            culling->visible_chunks[num_visible_chunks++] = chunk_index;
+        }
+    }
+    culling->num_visible_chunks = num_visible_chunks;
+    culling->occlusion_seconds = get_seconds() - start_time;
+}
@@ -0,0 +1,93 @@
+#ifndef TERRAIN_CULLING_H
+
+// NOTE: culling of the mesh chunks (see mesh_chunks.h). build_terrain_mesh() builds a quadtree of
+//       bounding boxes over the grid, with the min and max height of the vertices in each node. the leaves are
+//       CULLING_LEAF_CELLS cells across, and the nodes on chunk_level_index are the chunks.
+//
+//       view frustum culling: every frame cull_terrain_chunks() walks the tree from the top down to the
+//       chunks with the camera's frustum. a node outside one of the frustum's planes is skipped with
+//       everything under it, and a node inside all of them is visible with everything under it, so only the
+//       nodes on the frustum's edges get split.
+//
+//       occlusion culling (if use_occlusion is set): the ground under each node's min height is solid, so a
+//       column from the bottom of the terrain up to a node's min height hides whatever is behind it. the
+//       columns of the nodes on occluder_level_index that are in the frustum are drawn into a small software
+//       depth buffer, and a chunk that's behind them at every pixel its box covers isn't drawn. the buffer is
+//       sampled at pixel centers, so before the chunks are tested, every pixel gets the furthest depth of the
+//       pixels around it, which keeps a chunk that might be seen past the edge of an occluder.
+
+#define CULLING_LEAF_CELLS 16
+// NOTE: the occluders are the nodes of the first level with at most this many per side
+#define MAX_OCCLUDERS_PER_SIDE 64
+#define OCCLUSION_BUFFER_WIDTH 256
+
+struct Culling_Node_Bounds {
+    real32 min_height;
+    real32 max_height;
+};
+
+struct Culling_Level {
+    // NOTE: in cells
+    int32 node_size;
+    int32 nodes_per_row;
+    int32 nodes_per_column;
+    Culling_Node_Bounds *nodes;
+};
+
+// NOTE: the planes are (normal, distance) with the normals pointing in, so a point p is inside the frustum
+//       when dot(normal, p) + distance >= 0 for all of them
+struct Frustum {
+    glm::vec4 planes[6];
+};
+
+enum Frustum_Test {
+    FRUSTUM_OUTSIDE,
+    FRUSTUM_INTERSECTING,
+    FRUSTUM_INSIDE
+};
+
+// NOTE: depths are NDC z, -1 at the near plane and 1 at the far plane
+struct Occlusion_Buffer {
+    int32 width;
+    int32 height;
+    real32 *depths;
+    // NOTE: the furthest of depths in the 3x3 pixels around each pixel
+    real32 *eroded_depths;
+};
+
+struct Terrain_Culling {
+    Mesh_Chunk_Layout *mesh_chunks;
+    // NOTE: levels[0] are the leaves, the last level the root
+    int32 num_levels;
+    Culling_Level *levels;
+    int32 chunk_level_index;
+    int32 occluder_level_index;
+
+    bool32 use_occlusion;
+    Occlusion_Buffer occlusion;
+
+    // NOTE: what cull_terrain_chunks() found. num_frustum_visible_chunks were in the frustum, and
+    //       num_visible_chunks of them weren't occluded.
+    int32 *visible_chunks;
+    int32 num_visible_chunks;
+    int32 num_frustum_visible_chunks;
+    int32 num_box_tests;
+    int32 num_occluder_triangles;
+    real64 occlusion_seconds;
+};
+
+struct Terrain;
+
+glm::mat4 get_camera_view_matrix(Camera *camera);
+glm::mat4 get_camera_projection_matrix(Camera *camera);
+Frustum make_frustum(glm::mat4 view_projection_matrix);
+Frustum_Test test_frustum_box(Frustum *frustum, glm::vec3 box_min, glm::vec3 box_max);
+Terrain_Culling *make_terrain_culling(Terrain *terrain);
+void update_terrain_culling_leaves(Terrain_Culling *culling, Terrain *terrain, Grid_Rect nodes);
+void update_terrain_culling_levels(Terrain_Culling *culling, Grid_Rect nodes);
+void update_terrain_culling_bounds(Terrain_Culling *culling, Terrain *terrain, Grid_Rect rect);
+void cull_terrain_chunks(Terrain_Culling *culling, Terrain *terrain, Camera *camera);
+void free_terrain_culling(Terrain_Culling *culling);
+
+#define TERRAIN_CULLING_H
+#endif
@@ -0,0 +1,276 @@
+// NOTE: generates a terrain and writes its heightmap and mesh, without a window or GL context
+#include "terrain_lib.cpp"
+
+static void print_usage() {
+    printf("usage: terrain_gen <initial heights file> <h> <max random height> <seed> <output path> [options]\n"
+           "       terrain_gen --batch <manifest> <output directory> [--threads <n>] [--simd <level>]\n"
+           "       terrain_gen --benchmark-gaussian\n"
+           "       terrain_gen --benchmark-kernels <initial heights file> [exponent, default 12]\n"
+           "       terrain_gen --benchmark-normals <initial heights file> [max exponent, default 12]\n"
+           "       terrain_gen --benchmark-vertex-cache [cells per chunk, default 128]\n"
+           "\n"
+           "writes <output path>.pfm (heights) and <output path>.obj (mesh)\n"
+           "\n"
+           "in batch mode every line of the manifest is a job,\n"
+           "    <initial heights file> <seed> <h> <max random height> <exponent>\n"
+           "and its heights are written to <output directory>/terrain_<job>.pfm\n"
+           "\n"
+           "options:\n"
+           "  --exponent <n>                 use a (2^n+1)x(2^n+1) grid instead of the one in the heights file\n"
+           "  --threads <n>                  worker threads (default: one less than the number of cores)\n"
+           "  --simd <scalar|sse4|avx2>      use slower diamond-square kernels than the CPU supports\n"
+           "  --tiled                        store the heights in tiles while generating\n"
+           "  --no-mesh                      only write the heightmap\n"
+           "  --quantize <max error>         keep the heights as 8/16-bit tiles instead of floats\n"
+           "  --benchmark-quantized <error>  compare quantized heights to floats, then exit\n"
+           "  --vertex-cache-size <n>        order the mesh chunk indices for a vertex cache this big\n"
+           "                                 (default 32, 0 for row order)\n"
+           "  --rtin <max error>             write only the triangles needed to stay within max error of the\n"
+           "                                 heights (a right-triangulated irregular network)\n"
+           "  --benchmark-rtin               time building RTIN error maps and meshes, then exit\n"
+           "  --benchmark-lod [max error]    fly a camera over the terrain and print the quadtree LOD's\n"
+           "                                 selection for a max error in pixels (default 2), then exit\n"
+           "  --benchmark-culling            fly a turning camera over the terrain and print how many mesh\n"
+           "                                 chunks view frustum culling skips, then exit\n"
+           "  --benchmark-occlusion          walk over the terrain at eye height and print how many of the\n"
+           "                                 chunks in view occlusion culling rejects, then exit\n"
+           "  --benchmark-clipmap [quads]    fly a camera over the terrain and print what a geometry clipmap\n"
+           "                                 with levels of quads x quads (default 128) uploads, then exit\n"
+           "  --benchmark-vertex-formats     compare the GL vertex formats' sizes and how accurately they\n"
+           "                                 decode, then exit\n"
+           "  --benchmark-vertex-writer      compare building the vertex buffer through a staging copy to\n"
+           "                                 writing it while the mesh is built, then exit\n"
+           "  --benchmark-sculpt             time strokes of every sculpting brush, check undo and redo, then\n"
+           "                                 exit\n");
+}
+
+int main(int argc, char **argv) {
+    if (argc == 2 && strcmp(argv[1], "--benchmark-gaussian") == 0) {
+        benchmark_gaussian_sampler();
+        return 0;
+    }
+    if ((argc == 3 || argc == 4) && strcmp(argv[1], "--benchmark-kernels") == 0) {
+        benchmark_terrain_kernels(argv[2], (argc == 4) ? atoi(argv[3]) : 12);
+        return 0;
+    }
+    if ((argc == 3 || argc == 4) && strcmp(argv[1], "--benchmark-normals") == 0) {
+        benchmark_normals(argv[2], (argc == 4) ? atoi(argv[3]) : 12);
+        return 0;
+    }
+
+    if ((argc == 2 || argc == 3) && strcmp(argv[1], "--benchmark-vertex-cache") == 0) {
+        benchmark_vertex_cache((argc == 3) ? atoi(argv[2]) : MESH_CHUNK_CELLS);
+        return 0;
+    }
+
+    bool32 is_batch = (argc >= 4 && strcmp(argv[1], "--batch") == 0);
+    if (!is_batch && argc < 6) {
+        print_usage();
+        return 1;
+    }
+
+    char *initial_heights_file = argv[1];
+    real32 h = 0;
+    real32 max_random_height = 0;
+    uint64 seed = 0;
+    char *output_path = argv[5];
+    int32 first_option_index = 6;
+    if (is_batch) {
+        output_path = argv[3];
+        first_option_index = 4;
+    } else {
+        h = (real32) atof(argv[2]);
+        max_random_height = (real32) atof(argv[3]);
+        seed = strtoull(argv[4], NULL, 10);
+    }
+
+    int32 resolution_exponent = -1;
+    int32 num_threads = get_default_num_worker_threads();
+    Simd_Level simd_level = get_cpu_simd_level();
+    Height_Layout height_layout = HEIGHT_LAYOUT_ROW_MAJOR;
+    bool32 write_mesh = true;
+    real32 quantized_max_error = 0;
+    bool32 should_quantize = false;
+    bool32 should_benchmark_quantized = false;
+    bool32 should_benchmark_vertex_formats = false;
+    bool32 should_benchmark_vertex_writer = false;
+    bool32 should_benchmark_sculpt = false;
+    bool32 use_rtin = false;
+    real32 rtin_max_error = 0;
+    bool32 should_benchmark_rtin = false;
+    bool32 should_benchmark_lod = false;
+    real32 lod_max_pixel_error = 2.0f;
+    bool32 should_benchmark_culling = false;
+    bool32 should_benchmark_occlusion = false;
+    bool32 should_benchmark_clipmap = false;
+    int32 clipmap_quads = 128;
+    for (int32 arg_index = first_option_index; arg_index < argc; arg_index++) {
+        if (strcmp(argv[arg_index], "--exponent") == 0 && arg_index + 1 < argc) {
+            resolution_exponent = atoi(argv[++arg_index]);
+        } else if (strcmp(argv[arg_index], "--threads") == 0 && arg_index + 1 < argc) {
+            num_threads = atoi(argv[++arg_index]);
+            if (num_threads < 0) {
+                num_threads = 0;
+            }
+        } else if (strcmp(argv[arg_index], "--simd") == 0 && arg_index + 1 < argc) {
+            char *simd_level_name = argv[++arg_index];
+            Simd_Level requested_simd_level = SIMD_LEVEL_SCALAR;
+            if (strcmp(simd_level_name, "avx2") == 0) {
+                requested_simd_level = SIMD_LEVEL_AVX2;
+            } else if (strcmp(simd_level_name, "sse4") == 0) {
+                requested_simd_level = SIMD_LEVEL_SSE4;
+            }
+            if (requested_simd_level < simd_level) {
+                simd_level = requested_simd_level;
+            }
+        } else if (strcmp(argv[arg_index], "--tiled") == 0) {
+            height_layout = HEIGHT_LAYOUT_TILED;
+        } else if (strcmp(argv[arg_index], "--no-mesh") == 0) {
+            write_mesh = false;
+        } else if (strcmp(argv[arg_index], "--quantize") == 0 && arg_index + 1 < argc) {
+            should_quantize = true;
+            quantized_max_error = (real32) atof(argv[++arg_index]);
+        } else if (strcmp(argv[arg_index], "--benchmark-quantized") == 0 && arg_index + 1 < argc) {
+            should_benchmark_quantized = true;
+            quantized_max_error = (real32) atof(argv[++arg_index]);
+        } else if (strcmp(argv[arg_index], "--vertex-cache-size") == 0 && arg_index + 1 < argc) {
+            mesh_chunk_vertex_cache_size = atoi(argv[++arg_index]);
+        } else if (strcmp(argv[arg_index], "--rtin") == 0 && arg_index + 1 < argc) {
+            use_rtin = true;
+            rtin_max_error = (real32) atof(argv[++arg_index]);
+        } else if (strcmp(argv[arg_index], "--benchmark-lod") == 0) {
+            should_benchmark_lod = true;
+            if (arg_index + 1 < argc && argv[arg_index + 1][0] != '-') {
+                lod_max_pixel_error = (real32) atof(argv[++arg_index]);
+            }
+        } else if (strcmp(argv[arg_index], "--benchmark-culling") == 0) {
+            should_benchmark_culling = true;
+        } else if (strcmp(argv[arg_index], "--benchmark-occlusion") == 0) {
+            should_benchmark_occlusion = true;
+        } else if (strcmp(argv[arg_index], "--benchmark-clipmap") == 0) {
+            should_benchmark_clipmap = true;
+            if (arg_index + 1 < argc && argv[arg_index + 1][0] != '-') {
+                clipmap_quads = atoi(argv[++arg_index]);
+            }
+            if (clipmap_quads < 4 || clipmap_quads > MAX_CLIPMAP_QUADS || clipmap_quads % 4 != 0) {
+                printf("The clipmap's quads have to be a multiple of 4 up to %d.\n", MAX_CLIPMAP_QUADS);
+                return 1;
+            }
+        } else if (strcmp(argv[arg_index], "--benchmark-rtin") == 0) {
+            should_benchmark_rtin = true;
+        } else if (strcmp(argv[arg_index], "--benchmark-vertex-formats") == 0) {
+            should_benchmark_vertex_formats = true;
+        } else if (strcmp(argv[arg_index], "--benchmark-vertex-writer") == 0) {
+            should_benchmark_vertex_writer = true;
+        } else if (strcmp(argv[arg_index], "--benchmark-sculpt") == 0) {
+            should_benchmark_sculpt = true;
+        } else {
+            printf("Unknown option %s.\n\n", argv[arg_index]);
+            print_usage();
+            return 1;
+        }
+    }
+    init_terrain_kernels(simd_level);
+
+    real64 start_time = get_seconds();
+    Work_Queue work_queue;
+    init_work_queue(&work_queue, num_threads);
+
+    if (is_batch) {
+        bool32 succeeded = run_terrain_batch(argv[2], output_path, &work_queue);
+        shutdown_work_queue(&work_queue);
+        return succeeded ? 0 : 1;
+    }
+
+    Terrain terrain = {};
+    terrain.vertical_scale_factor = 1.0f;
+    terrain.world_x_size = 100.0f;
+    terrain.world_y_size = 100.0f;
+    terrain.height_layout = height_layout;
+    terrain.use_rtin = use_rtin;
+    terrain.rtin_max_error = rtin_max_error;
+    terrain.use_lod = should_benchmark_lod;
+    terrain.lod_max_pixel_error = lod_max_pixel_error;
+    load_initial_heights(&terrain, initial_heights_file);
+    if (resolution_exponent >= 0) {
+        if (resolution_exponent < terrain.low_res_grid_size_exponent) {
+            printf("The exponent can't be less than the low-res grid's (%d).\n", terrain.low_res_grid_size_exponent);
+            return 1;
+        }
+        set_terrain_resolution_exponent(&terrain, resolution_exponent);
+    }
+
+    generate_height_data(&terrain, h, max_random_height, seed, &work_queue);
+    if (should_benchmark_quantized) {
+        convert_heights_to_row_major(&terrain);
+        benchmark_quantized_heights(&terrain, quantized_max_error, &work_queue);
+        shutdown_work_queue(&work_queue);
+        return 0;
+    }
+    if (should_quantize) {
+        quantize_terrain_heights(&terrain, quantized_max_error, &work_queue);
+    }
+    if (should_benchmark_clipmap) {
+        benchmark_terrain_clipmap(&terrain, clipmap_quads);
+        shutdown_work_queue(&work_queue);
+        return 0;
+    }
+    if (should_benchmark_vertex_writer) {
+        convert_heights_to_row_major(&terrain);
+        benchmark_vertex_writer(&terrain, &work_queue);
+        shutdown_work_queue(&work_queue);
+        return 0;
+    }
+    if (write_mesh || should_benchmark_vertex_formats || should_benchmark_rtin || should_benchmark_lod ||
+        should_benchmark_culling || should_benchmark_occlusion || should_benchmark_sculpt) {
+        build_terrain_mesh(&terrain, &work_queue);
+    }
+    if (should_benchmark_sculpt) {
+        benchmark_terrain_sculpt(&terrain);
+        shutdown_work_queue(&work_queue);
+        return 0;
+    }
+    if (should_benchmark_culling) {
+        benchmark_terrain_culling(&terrain);
+        shutdown_work_queue(&work_queue);
+        return 0;
+    }
+    if (should_benchmark_occlusion) {
+        benchmark_terrain_occlusion(&terrain);
+        shutdown_work_queue(&work_queue);
+        return 0;
+    }
+    if (should_benchmark_lod) {
+        benchmark_terrain_lod(&terrain, lod_max_pixel_error);
+        shutdown_work_queue(&work_queue);
+        return 0;
+    }
+    if (should_benchmark_rtin) {
+        benchmark_rtin(&terrain);
+        shutdown_work_queue(&work_queue);
+        return 0;
+    }
+    if (should_benchmark_vertex_formats) {
+        benchmark_vertex_formats(&terrain);
+        shutdown_work_queue(&work_queue);
+        return 0;
+    }
+    shutdown_work_queue(&work_queue);
+
+    // NOTE: room for the extension
+    size_t output_path_length = strlen(output_path);
+    char *file_path = (char *) malloc(output_path_length + 5);
+    bool32 succeeded = true;
+
+    sprintf(file_path, "%s.pfm", output_path);
+    succeeded = write_heightmap_pfm(&terrain, file_path) && succeeded;
+    if (write_mesh) {
+        sprintf(file_path, "%s.obj", output_path);
+        succeeded = write_terrain_obj(&terrain, file_path) && succeeded;
+    }
+    free(file_path);
+
+    printf("Generated %dx%d terrain (max height %f) in %f seconds.\n", terrain.x_resolution, terrain.y_resolution,
+           terrain.max_height, get_seconds() - start_time);
+    return succeeded ? 0 : 1;
+}
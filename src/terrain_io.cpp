@@ -0,0 +1,140 @@
+#include "main.h"
+#include "terrain.h"
+
+// NOTE: the heights as a greyscale PFM, which is "Pf", the width and height, -1.0 for little-endian, then
+//       the rows of real32s from the bottom up. row 0 of the terrain ends up at the top of the image.
+bool32 write_heightmap_pfm(Terrain *terrain, char *path) {
+    if (terrain->height_layout != HEIGHT_LAYOUT_ROW_MAJOR) {
+        convert_heights_to_row_major(terrain);
+    }
+
+    FILE *file = open_file(path, "wb");
+    if (!file) {
+        printf("Couldn't open %s for writing.\n", path);
+        return false;
+    }
+
+    real64 start_time = get_seconds();
+    fprintf(file, "Pf\n%d %d\n-1.0\n", terrain->x_resolution, terrain->y_resolution);
+    Grid_View<real32, Unchecked_Boundary> heights = make_grid_view<Unchecked_Boundary>(terrain->height_data,
+                                                                                      terrain->x_resolution,
+                                                                                      terrain->y_resolution);
+    if (terrain->quantized_heights) {
+        real32 *decoded_height_row = (real32 *) malloc(terrain->x_resolution * sizeof(real32));
+        for (int32 row_index = terrain->y_resolution - 1; row_index >= 0; row_index--) {
+            decode_quantized_height_row(terrain->quantized_heights, row_index, decoded_height_row);
+            fwrite(decoded_height_row, sizeof(real32), terrain->x_resolution, file);
+        }
+        free(decoded_height_row);
+    } else {
+        for (int32 row_index = terrain->y_resolution - 1; row_index >= 0; row_index--) {
+            fwrite(heights.get_row(row_index), sizeof(real32), terrain->x_resolution, file);
+        }
+    }
+    bool32 succeeded = !ferror(file);
+    fclose(file);
+
+    if (print_terrain_timings) {
+        printf("Wrote heightmap to %s in %f seconds.\n", path, get_seconds() - start_time);
+    }
+    return succeeded;
+}
+
+// NOTE: the RTIN mesh (see rtin.h) instead of every cell. only the vertices the triangles use are written,
+//       in grid order, so most of a flat terrain's vertices are left out.
+static void write_rtin_obj_body(Terrain *terrain, FILE *file) {
+    int32 size = terrain->x_resolution;
+    int64 num_indices = extract_rtin_mesh(terrain->rtin_errors, size, terrain->rtin_max_error, NULL);
+    uint32 *indices = (uint32 *) malloc(num_indices * sizeof(uint32));
+    extract_rtin_mesh(terrain->rtin_errors, size, terrain->rtin_max_error, indices);
+
+    // NOTE: the OBJ index of every grid vertex, 0 for the unused ones
+    uint32 *obj_indices = (uint32 *) calloc(terrain->num_vertices, sizeof(uint32));
+    for (int64 index = 0; index < num_indices; index++) {
+        obj_indices[indices[index]] = 1;
+    }
+    uint32 num_obj_vertices = 0;
+    for (int64 vertex_index = 0; vertex_index < terrain->num_vertices; vertex_index++) {
+        if (obj_indices[vertex_index]) {
+            obj_indices[vertex_index] = ++num_obj_vertices;
+            real32 *vertex = terrain->vertices + 3*vertex_index;
+            fprintf(file, "v %f %f %f\n", vertex[0], vertex[1], vertex[2]);
+        }
+    }
+    for (int64 vertex_index = 0; vertex_index < terrain->num_vertices; vertex_index++) {
+        if (obj_indices[vertex_index]) {
+            glm::vec3 normal = glm::normalize(((glm::vec3 *) terrain->normals)[vertex_index]);
+            fprintf(file, "vn %f %f %f\n", normal.x, normal.y, normal.z);
+        }
+    }
+    for (int64 vertex_index = 0; vertex_index < terrain->num_vertices; vertex_index++) {
+        if (obj_indices[vertex_index]) {
+            real32 *uv = terrain->uvs + 2*vertex_index;
+            fprintf(file, "vt %f %f\n", uv[0], uv[1]);
+        }
+    }
+    for (int64 index = 0; index + 2 < num_indices; index += 3) {
+        uint32 a = obj_indices[indices[index]];
+        uint32 b = obj_indices[indices[index + 1]];
+        uint32 c = obj_indices[indices[index + 2]];
+        fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, c, c, c);
+    }
+    free(obj_indices);
+    free(indices);
+}
+
+// NOTE: the mesh as a Wavefront OBJ, with the vertices in the same (grid) units as terrain->vertices. the
+//       normals are normalized, since not every reader does that itself.
+bool32 write_terrain_obj(Terrain *terrain, char *path) {
+    assert(terrain->vertices && terrain->normals && terrain->uvs);
+
+    FILE *file = open_file(path, "wb");
+    if (!file) {
+        printf("Couldn't open %s for writing.\n", path);
+        return false;
+    }
+    // NOTE: there's a lot of small writes
+    setvbuf(file, NULL, _IOFBF, 1 << 20);
+
+    real64 start_time = get_seconds();
+    fprintf(file, "# %dx%d terrain\n", terrain->x_resolution, terrain->y_resolution);
+    if (terrain->rtin_errors) {
+        write_rtin_obj_body(terrain, file);
+    } else {
+        for (int64 vertex_index = 0; vertex_index < terrain->num_vertices; vertex_index++) {
+            real32 *vertex = terrain->vertices + 3*vertex_index;
+            fprintf(file, "v %f %f %f\n", vertex[0], vertex[1], vertex[2]);
+        }
+        for (int64 normal_index = 0; normal_index < terrain->num_normals; normal_index++) {
+            glm::vec3 normal = glm::normalize(((glm::vec3 *) terrain->normals)[normal_index]);
+            fprintf(file, "vn %f %f %f\n", normal.x, normal.y, normal.z);
+        }
+        for (int64 uv_index = 0; uv_index < terrain->num_uvs; uv_index++) {
+            real32 *uv = terrain->uvs + 2*uv_index;
+            fprintf(file, "vt %f %f\n", uv[0], uv[1]);
+        }
+
+        // NOTE: OBJ indices start at 1, and every vertex has a normal and a UV with the same index. the terrain
+        //       has no index buffer of its own (see mesh_chunks.h), so the triangles are made a row of quads at
+        //       a time, the same way as generate_grid_indices().
+        int32 num_row_indices = 6*(terrain->x_resolution - 1);
+        uint32 *row_indices = (uint32 *) malloc(num_row_indices * sizeof(uint32));
+        // NOTE: the first row's, which the other rows' are offset from
+        generate_grid_index_rows(row_indices, terrain->x_resolution, 2, 0, 1);
+        for (int32 row_index = 0; row_index < terrain->y_resolution - 1; row_index++) {
+            uint64 row_offset = ((uint64) row_index)*terrain->x_resolution + 1;
+            for (int32 index = 0; index + 2 < num_row_indices; index += 3) {
+                unsigned long long a = row_indices[index] + row_offset;
+                unsigned long long b = row_indices[index + 1] + row_offset;
+                unsigned long long c = row_indices[index + 2] + row_offset;
+                fprintf(file, "f %llu/%llu/%llu %llu/%llu/%llu %llu/%llu/%llu\n", a, a, a, b, b, b, c, c, c);
+            }
+        }
+        free(row_indices);
+    }
+    bool32 succeeded = !ferror(file);
+    fclose(file);
+
+    printf("Wrote mesh to %s in %f seconds.\n", path, get_seconds() - start_time);
+    return succeeded;
+}
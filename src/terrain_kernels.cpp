@@ -0,0 +1,566 @@
+#include "main.h"
+#include "terrain_kernels.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define TERRAIN_KERNELS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define TERRAIN_KERNELS_X86 0
+#endif
+
+// NOTE: MSVC lets us use any intrinsic anywhere, but gcc and clang need to be told which functions are
+//       allowed to use which instruction sets.
+#if defined(_MSC_VER)
+#define TARGET_SSE4
+#define TARGET_AVX2
+#else
+#define TARGET_SSE4 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+// NOTE: all the kernels add the neighbours in the same order as the scalar code and divide by 4 by
+//       multiplying by 0.25 (which is exact), so every path generates bit-identical heights.
+
+real32 square_row_scalar(real32 *out, real32 *top, real32 *bottom, real32 *noise,
+                         int32 count, int32 stride, real32 max_height) {
+    for (int32 k = 0; k < count; k++) {
+        real32 top_left = top[k*stride];
+        real32 top_right = top[(k + 1)*stride];
+        real32 bottom_right = bottom[(k + 1)*stride];
+        real32 bottom_left = bottom[k*stride];
+        real32 generated_height = (top_left + top_right + bottom_right + bottom_left) / 4 + noise[k];
+        out[k*stride] = generated_height;
+        max_height = fmaxf(max_height, generated_height);
+    }
+    return max_height;
+}
+
+real32 diamond_row_scalar(real32 *out, real32 *top, real32 *bottom, real32 *noise,
+                          int32 count, int32 stride, int32 half_stride, real32 max_height) {
+    for (int32 k = 0; k < count; k++) {
+        int32 column_offset = k*stride;
+        real32 sum = 0;
+        sum += top[column_offset];
+        sum += out[column_offset + half_stride];
+        sum += bottom[column_offset];
+        sum += out[column_offset - half_stride];
+        real32 generated_height = (sum / 4) + noise[k];
+        out[column_offset] = generated_height;
+        max_height = fmaxf(max_height, generated_height);
+    }
+    return max_height;
+}
+
+// NOTE: like the row kernels, the SIMD versions multiply and then add, without fusing, so they decode
+//       exactly the same heights as get_quantized_height()
+void dequantize_8_scalar(real32 *out, uint8 *samples, int32 count, real32 min_height, real32 scale) {
+    for (int32 k = 0; k < count; k++) {
+        out[k] = min_height + scale*(real32) samples[k];
+    }
+}
+
+void dequantize_16_scalar(real32 *out, uint16 *samples, int32 count, real32 min_height, real32 scale) {
+    for (int32 k = 0; k < count; k++) {
+        out[k] = min_height + scale*(real32) samples[k];
+    }
+}
+
+void normal_row_scalar(real32 *out, real32 *top, real32 *row, real32 *bottom, int32 count) {
+    for (int32 k = 0; k < count; k++) {
+        out[3*k]     = row[k - 1] - row[k + 1];
+        out[3*k + 1] = 2.0f;
+        out[3*k + 2] = top[k] - bottom[k];
+    }
+}
+
+#if TERRAIN_KERNELS_X86
+
+// NOTE: SSE4
+
+TARGET_SSE4 inline __m128 load_strided_sse4(real32 *p, int32 stride) {
+    if (stride == 2) {
+        __m128 a = _mm_loadu_ps(p);
+        __m128 b = _mm_loadu_ps(p + 4);
+        return _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+    } else {
+        return _mm_setr_ps(p[0], p[stride], p[2*stride], p[3*stride]);
+    }
+}
+
+TARGET_SSE4 inline void store_strided_sse4(real32 *p, int32 stride, __m128 v) {
+    real32 values[4];
+    _mm_storeu_ps(values, v);
+    for (int32 lane = 0; lane < 4; lane++) {
+        p[lane*stride] = values[lane];
+    }
+}
+
+TARGET_SSE4 inline real32 horizontal_max_sse4(__m128 v) {
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(v);
+}
+
+TARGET_SSE4 real32 square_row_sse4(real32 *out, real32 *top, real32 *bottom, real32 *noise,
+                                   int32 count, int32 stride, real32 max_height) {
+    __m128 quarter = _mm_set1_ps(0.25f);
+    __m128 max_heights = _mm_set1_ps(max_height);
+
+    // NOTE: the stride 2 loads read one value past the last corner they need, so we make sure there's
+    //       always at least one cell left over for the scalar loop
+    int32 k = 0;
+    for (; k + 4 < count; k += 4) {
+        int32 column_offset = k*stride;
+        __m128 top_left = load_strided_sse4(top + column_offset, stride);
+        __m128 top_right = load_strided_sse4(top + column_offset + stride, stride);
+        __m128 bottom_right = load_strided_sse4(bottom + column_offset + stride, stride);
+        __m128 bottom_left = load_strided_sse4(bottom + column_offset, stride);
+
+        __m128 sum = _mm_add_ps(_mm_add_ps(_mm_add_ps(top_left, top_right), bottom_right), bottom_left);
+        __m128 generated_heights = _mm_add_ps(_mm_mul_ps(sum, quarter), _mm_loadu_ps(noise + k));
+        store_strided_sse4(out + column_offset, stride, generated_heights);
+        max_heights = _mm_max_ps(max_heights, generated_heights);
+    }
+    max_height = horizontal_max_sse4(max_heights);
+
+    return square_row_scalar(out + k*stride, top + k*stride, bottom + k*stride, noise + k,
+                             count - k, stride, max_height);
+}
+
+TARGET_SSE4 real32 diamond_row_sse4(real32 *out, real32 *top, real32 *bottom, real32 *noise,
+                                    int32 count, int32 stride, int32 half_stride, real32 max_height) {
+    __m128 quarter = _mm_set1_ps(0.25f);
+    __m128 zero = _mm_setzero_ps();
+    __m128 max_heights = _mm_set1_ps(max_height);
+
+    int32 k = 0;
+    for (; k + 4 < count; k += 4) {
+        int32 column_offset = k*stride;
+        __m128 top_values = load_strided_sse4(top + column_offset, stride);
+        __m128 right_values = load_strided_sse4(out + column_offset + half_stride, stride);
+        __m128 bottom_values = load_strided_sse4(bottom + column_offset, stride);
+        __m128 left_values = load_strided_sse4(out + column_offset - half_stride, stride);
+
+        // NOTE: start from 0 like the scalar code so that a -0 neighbour gives the same sum
+        __m128 sum = _mm_add_ps(zero, top_values);
+        sum = _mm_add_ps(sum, right_values);
+        sum = _mm_add_ps(sum, bottom_values);
+        sum = _mm_add_ps(sum, left_values);
+        __m128 generated_heights = _mm_add_ps(_mm_mul_ps(sum, quarter), _mm_loadu_ps(noise + k));
+        store_strided_sse4(out + column_offset, stride, generated_heights);
+        max_heights = _mm_max_ps(max_heights, generated_heights);
+    }
+    max_height = horizontal_max_sse4(max_heights);
+
+    return diamond_row_scalar(out + k*stride, top + k*stride, bottom + k*stride, noise + k,
+                              count - k, stride, half_stride, max_height);
+}
+
+TARGET_SSE4 void dequantize_8_sse4(real32 *out, uint8 *samples, int32 count, real32 min_height, real32 scale) {
+    __m128 min_heights = _mm_set1_ps(min_height);
+    __m128 scales = _mm_set1_ps(scale);
+    int32 k = 0;
+    for (; k + 4 <= count; k += 4) {
+        int32 packed_samples;
+        memcpy(&packed_samples, samples + k, sizeof(packed_samples));
+        __m128 values = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(packed_samples)));
+        _mm_storeu_ps(out + k, _mm_add_ps(min_heights, _mm_mul_ps(scales, values)));
+    }
+    dequantize_8_scalar(out + k, samples + k, count - k, min_height, scale);
+}
+
+TARGET_SSE4 void dequantize_16_sse4(real32 *out, uint16 *samples, int32 count, real32 min_height, real32 scale) {
+    __m128 min_heights = _mm_set1_ps(min_height);
+    __m128 scales = _mm_set1_ps(scale);
+    int32 k = 0;
+    for (; k + 4 <= count; k += 4) {
+        __m128i packed_samples = _mm_loadl_epi64((__m128i *) (samples + k));
+        __m128 values = _mm_cvtepi32_ps(_mm_cvtepu16_epi32(packed_samples));
+        _mm_storeu_ps(out + k, _mm_add_ps(min_heights, _mm_mul_ps(scales, values)));
+    }
+    dequantize_16_scalar(out + k, samples + k, count - k, min_height, scale);
+}
+
+// NOTE: Philox4x32-10 and Box-Muller on 4 (SSE4) or 8 (AVX2) cells at once. the 32x32 -> 64-bit multiplies
+//       only use the even 32-bit lanes, so the odd lanes are shifted down and multiplied separately.
+//       everything after that is the same operations as get_gaussian_from_bits(), in the same order.
+
+TARGET_SSE4 inline void multiply_high_low_sse4(__m128i a, __m128i multiplier, __m128i *high, __m128i *low) {
+    __m128i even_products = _mm_mul_epu32(a, multiplier);
+    __m128i odd_products = _mm_mul_epu32(_mm_srli_epi64(a, 32), multiplier);
+    *low = _mm_blend_epi16(even_products, _mm_slli_epi64(odd_products, 32), 0xCC);
+    *high = _mm_blend_epi16(_mm_srli_epi64(even_products, 32), odd_products, 0xCC);
+}
+
+TARGET_SSE4 inline __m128 get_uniform_real32_sse4(__m128i bits) {
+    __m128i numerators = _mm_add_epi32(_mm_srli_epi32(bits, 8), _mm_set1_epi32(1));
+    return _mm_mul_ps(_mm_cvtepi32_ps(numerators), _mm_set1_ps(1.0f / 16777216.0f));
+}
+
+TARGET_SSE4 inline __m128 get_gaussian_log_sse4(__m128 x) {
+    __m128i bits = _mm_castps_si128(x);
+    __m128i exponents = _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127));
+    __m128 mantissas = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)),
+                                                     _mm_set1_epi32(0x3F800000)));
+    __m128 is_large = _mm_cmpgt_ps(mantissas, _mm_set1_ps(1.41421356f));
+    mantissas = _mm_blendv_ps(mantissas, _mm_mul_ps(mantissas, _mm_set1_ps(0.5f)), is_large);
+    // NOTE: is_large is -1 in the lanes that need 1 added
+    exponents = _mm_sub_epi32(exponents, _mm_castps_si128(is_large));
+
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 t = _mm_div_ps(_mm_sub_ps(mantissas, one), _mm_add_ps(mantissas, one));
+    __m128 t2 = _mm_mul_ps(t, t);
+    __m128 polynomial = _mm_add_ps(_mm_set1_ps(0.142857143f), _mm_mul_ps(t2, _mm_set1_ps(0.111111111f)));
+    polynomial = _mm_add_ps(_mm_set1_ps(0.2f), _mm_mul_ps(t2, polynomial));
+    polynomial = _mm_add_ps(_mm_set1_ps(0.333333333f), _mm_mul_ps(t2, polynomial));
+    polynomial = _mm_add_ps(one, _mm_mul_ps(t2, polynomial));
+    return _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(exponents), _mm_set1_ps(0.693147181f)),
+                      _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(2.0f), t), polynomial));
+}
+
+TARGET_SSE4 inline __m128 get_gaussian_cos_2pi_sse4(__m128 u) {
+    __m128 sign_mask = _mm_set1_ps(-0.0f);
+    __m128 w = _mm_andnot_ps(sign_mask, _mm_sub_ps(u, _mm_set1_ps(0.5f)));
+    __m128 is_flipped = _mm_cmpgt_ps(w, _mm_set1_ps(0.25f));
+    w = _mm_blendv_ps(w, _mm_sub_ps(_mm_set1_ps(0.5f), w), is_flipped);
+
+    __m128 x = _mm_mul_ps(w, _mm_set1_ps(6.28318531f));
+    __m128 x2 = _mm_mul_ps(x, x);
+    __m128 cos_x = _mm_add_ps(_mm_set1_ps(-2.75573192e-07f), _mm_mul_ps(x2, _mm_set1_ps(2.08767570e-09f)));
+    cos_x = _mm_add_ps(_mm_set1_ps(2.48015873e-05f), _mm_mul_ps(x2, cos_x));
+    cos_x = _mm_add_ps(_mm_set1_ps(-0.00138888889f), _mm_mul_ps(x2, cos_x));
+    cos_x = _mm_add_ps(_mm_set1_ps(0.0416666667f), _mm_mul_ps(x2, cos_x));
+    cos_x = _mm_add_ps(_mm_set1_ps(-0.5f), _mm_mul_ps(x2, cos_x));
+    cos_x = _mm_add_ps(_mm_set1_ps(1.0f), _mm_mul_ps(x2, cos_x));
+    // NOTE: negate the lanes that aren't flipped
+    return _mm_xor_ps(cos_x, _mm_andnot_ps(is_flipped, sign_mask));
+}
+
+TARGET_SSE4 void gaussian_row_sse4(real32 *out, Philox_Key key, int32 level, int32 row_index,
+                                   int32 first_column_index, int32 column_step, int32 count) {
+    __m128i m0 = _mm_set1_epi32((int32) 0xD2511F53u);
+    __m128i m1 = _mm_set1_epi32((int32) 0xCD9E8D57u);
+    __m128i lane_columns = _mm_mullo_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32(column_step));
+
+    int32 k = 0;
+    for (; k + 4 <= count; k += 4) {
+        __m128i v0 = _mm_add_epi32(_mm_set1_epi32(first_column_index + k*column_step), lane_columns);
+        __m128i v1 = _mm_set1_epi32(row_index);
+        __m128i v2 = _mm_set1_epi32(level);
+        __m128i v3 = _mm_setzero_si128();
+        Philox_Key round_key = key;
+        for (int32 round_index = 0; round_index < 10; round_index++) {
+            __m128i high0, low0, high1, low1;
+            multiply_high_low_sse4(v0, m0, &high0, &low0);
+            multiply_high_low_sse4(v2, m1, &high1, &low1);
+            v0 = _mm_xor_si128(_mm_xor_si128(high1, v1), _mm_set1_epi32((int32) round_key.k0));
+            v1 = low1;
+            v2 = _mm_xor_si128(_mm_xor_si128(high0, v3), _mm_set1_epi32((int32) round_key.k1));
+            v3 = low0;
+            round_key.k0 += 0x9E3779B9u;
+            round_key.k1 += 0xBB67AE85u;
+        }
+
+        __m128 log_u1 = get_gaussian_log_sse4(get_uniform_real32_sse4(v0));
+        __m128 r = _mm_sqrt_ps(_mm_mul_ps(_mm_set1_ps(-2.0f), log_u1));
+        _mm_storeu_ps(out + k, _mm_mul_ps(r, get_gaussian_cos_2pi_sse4(get_uniform_real32_sse4(v1))));
+    }
+    fill_cell_gaussians_scalar(out + k, key, level, row_index, first_column_index + k*column_step, column_step,
+                               count - k);
+}
+
+// NOTE: the normals are stored xyz, so 4 of them are 3 vectors: (x0 y z0 x1) (y z1 x2 y) (z2 x3 y z3). AVX2
+//       uses this too, since with 12-byte normals the shuffling, not the math, is the work.
+TARGET_SSE4 void normal_row_sse4(real32 *out, real32 *top, real32 *row, real32 *bottom, int32 count) {
+    __m128 y = _mm_set1_ps(2.0f);
+    int32 k = 0;
+    for (; k + 4 <= count; k += 4) {
+        __m128 x = _mm_sub_ps(_mm_loadu_ps(row + k - 1), _mm_loadu_ps(row + k + 1));
+        __m128 z = _mm_sub_ps(_mm_loadu_ps(top + k), _mm_loadu_ps(bottom + k));
+        __m128 xz_low = _mm_unpacklo_ps(x, z);
+        __m128 xz_high = _mm_unpackhi_ps(x, z);
+        __m128 out0 = _mm_blend_ps(_mm_shuffle_ps(xz_low, xz_low, _MM_SHUFFLE(2, 1, 0, 0)), y, 0x2);
+        __m128 out1 = _mm_blend_ps(_mm_shuffle_ps(xz_low, xz_high, _MM_SHUFFLE(0, 0, 3, 3)), y, 0x9);
+        __m128 out2 = _mm_blend_ps(_mm_shuffle_ps(xz_high, xz_high, _MM_SHUFFLE(3, 2, 2, 1)), y, 0x4);
+        _mm_storeu_ps(out + 3*k, out0);
+        _mm_storeu_ps(out + 3*k + 4, out1);
+        _mm_storeu_ps(out + 3*k + 8, out2);
+    }
+    normal_row_scalar(out + 3*k, top + k, row + k, bottom + k, count - k);
+}
+
+// NOTE: AVX2
+
+TARGET_AVX2 inline __m256 load_strided_avx2(real32 *p, int32 stride, __m256i gather_offsets) {
+    if (stride == 2) {
+        __m256 a = _mm256_loadu_ps(p);
+        __m256 b = _mm256_loadu_ps(p + 8);
+        // NOTE: [a0 a2 b0 b2 | a4 a6 b4 b6] -> [a0 a2 a4 a6 | b0 b2 b4 b6]
+        __m256 evens = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(evens), _MM_SHUFFLE(3, 1, 2, 0)));
+    } else {
+        return _mm256_i32gather_ps(p, gather_offsets, 4);
+    }
+}
+
+TARGET_AVX2 inline void store_strided_avx2(real32 *p, int32 stride, __m256 v) {
+    real32 values[8];
+    _mm256_storeu_ps(values, v);
+    for (int32 lane = 0; lane < 8; lane++) {
+        p[lane*stride] = values[lane];
+    }
+}
+
+TARGET_AVX2 inline real32 horizontal_max_avx2(__m256 v) {
+    __m128 max_halves = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    max_halves = _mm_max_ps(max_halves, _mm_shuffle_ps(max_halves, max_halves, _MM_SHUFFLE(1, 0, 3, 2)));
+    max_halves = _mm_max_ps(max_halves, _mm_shuffle_ps(max_halves, max_halves, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(max_halves);
+}
+
+TARGET_AVX2 real32 square_row_avx2(real32 *out, real32 *top, real32 *bottom, real32 *noise,
+                                   int32 count, int32 stride, real32 max_height) {
+    __m256 quarter = _mm256_set1_ps(0.25f);
+    __m256 max_heights = _mm256_set1_ps(max_height);
+    __m256i gather_offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                                _mm256_set1_epi32(stride));
+
+    int32 k = 0;
+    for (; k + 8 < count; k += 8) {
+        int32 column_offset = k*stride;
+        __m256 top_left = load_strided_avx2(top + column_offset, stride, gather_offsets);
+        __m256 top_right = load_strided_avx2(top + column_offset + stride, stride, gather_offsets);
+        __m256 bottom_right = load_strided_avx2(bottom + column_offset + stride, stride, gather_offsets);
+        __m256 bottom_left = load_strided_avx2(bottom + column_offset, stride, gather_offsets);
+
+        __m256 sum = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(top_left, top_right), bottom_right), bottom_left);
+        __m256 generated_heights = _mm256_add_ps(_mm256_mul_ps(sum, quarter), _mm256_loadu_ps(noise + k));
+        store_strided_avx2(out + column_offset, stride, generated_heights);
+        max_heights = _mm256_max_ps(max_heights, generated_heights);
+    }
+    max_height = horizontal_max_avx2(max_heights);
+
+    return square_row_scalar(out + k*stride, top + k*stride, bottom + k*stride, noise + k,
+                             count - k, stride, max_height);
+}
+
+TARGET_AVX2 real32 diamond_row_avx2(real32 *out, real32 *top, real32 *bottom, real32 *noise,
+                                    int32 count, int32 stride, int32 half_stride, real32 max_height) {
+    __m256 quarter = _mm256_set1_ps(0.25f);
+    __m256 zero = _mm256_setzero_ps();
+    __m256 max_heights = _mm256_set1_ps(max_height);
+    __m256i gather_offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                                _mm256_set1_epi32(stride));
+
+    int32 k = 0;
+    for (; k + 8 < count; k += 8) {
+        int32 column_offset = k*stride;
+        __m256 top_values = load_strided_avx2(top + column_offset, stride, gather_offsets);
+        __m256 right_values = load_strided_avx2(out + column_offset + half_stride, stride, gather_offsets);
+        __m256 bottom_values = load_strided_avx2(bottom + column_offset, stride, gather_offsets);
+        __m256 left_values = load_strided_avx2(out + column_offset - half_stride, stride, gather_offsets);
+
+        __m256 sum = _mm256_add_ps(zero, top_values);
+        sum = _mm256_add_ps(sum, right_values);
+        sum = _mm256_add_ps(sum, bottom_values);
+        sum = _mm256_add_ps(sum, left_values);
+        __m256 generated_heights = _mm256_add_ps(_mm256_mul_ps(sum, quarter), _mm256_loadu_ps(noise + k));
+        store_strided_avx2(out + column_offset, stride, generated_heights);
+        max_heights = _mm256_max_ps(max_heights, generated_heights);
+    }
+    max_height = horizontal_max_avx2(max_heights);
+
+    return diamond_row_scalar(out + k*stride, top + k*stride, bottom + k*stride, noise + k,
+                              count - k, stride, half_stride, max_height);
+}
+
+TARGET_AVX2 void dequantize_8_avx2(real32 *out, uint8 *samples, int32 count, real32 min_height, real32 scale) {
+    __m256 min_heights = _mm256_set1_ps(min_height);
+    __m256 scales = _mm256_set1_ps(scale);
+    int32 k = 0;
+    for (; k + 8 <= count; k += 8) {
+        __m128i packed_samples = _mm_loadl_epi64((__m128i *) (samples + k));
+        __m256 values = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(packed_samples));
+        _mm256_storeu_ps(out + k, _mm256_add_ps(min_heights, _mm256_mul_ps(scales, values)));
+    }
+    dequantize_8_scalar(out + k, samples + k, count - k, min_height, scale);
+}
+
+TARGET_AVX2 void dequantize_16_avx2(real32 *out, uint16 *samples, int32 count, real32 min_height, real32 scale) {
+    __m256 min_heights = _mm256_set1_ps(min_height);
+    __m256 scales = _mm256_set1_ps(scale);
+    int32 k = 0;
+    for (; k + 8 <= count; k += 8) {
+        __m128i packed_samples = _mm_loadu_si128((__m128i *) (samples + k));
+        __m256 values = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(packed_samples));
+        _mm256_storeu_ps(out + k, _mm256_add_ps(min_heights, _mm256_mul_ps(scales, values)));
+    }
+    dequantize_16_scalar(out + k, samples + k, count - k, min_height, scale);
+}
+
+TARGET_AVX2 inline void multiply_high_low_avx2(__m256i a, __m256i multiplier, __m256i *high, __m256i *low) {
+    __m256i even_products = _mm256_mul_epu32(a, multiplier);
+    __m256i odd_products = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), multiplier);
+    *low = _mm256_blend_epi32(even_products, _mm256_slli_epi64(odd_products, 32), 0xAA);
+    *high = _mm256_blend_epi32(_mm256_srli_epi64(even_products, 32), odd_products, 0xAA);
+}
+
+TARGET_AVX2 inline __m256 get_uniform_real32_avx2(__m256i bits) {
+    __m256i numerators = _mm256_add_epi32(_mm256_srli_epi32(bits, 8), _mm256_set1_epi32(1));
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(numerators), _mm256_set1_ps(1.0f / 16777216.0f));
+}
+
+TARGET_AVX2 inline __m256 get_gaussian_log_avx2(__m256 x) {
+    __m256i bits = _mm256_castps_si256(x);
+    __m256i exponents = _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127));
+    __m256 mantissas = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)),
+                                                     _mm256_set1_epi32(0x3F800000)));
+    __m256 is_large = _mm256_cmp_ps(mantissas, _mm256_set1_ps(1.41421356f), _CMP_GT_OQ);
+    mantissas = _mm256_blendv_ps(mantissas, _mm256_mul_ps(mantissas, _mm256_set1_ps(0.5f)), is_large);
+    // NOTE: is_large is -1 in the lanes that need 1 added
+    exponents = _mm256_sub_epi32(exponents, _mm256_castps_si256(is_large));
+
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256 t = _mm256_div_ps(_mm256_sub_ps(mantissas, one), _mm256_add_ps(mantissas, one));
+    __m256 t2 = _mm256_mul_ps(t, t);
+    __m256 polynomial = _mm256_add_ps(_mm256_set1_ps(0.142857143f), _mm256_mul_ps(t2, _mm256_set1_ps(0.111111111f)));
+    polynomial = _mm256_add_ps(_mm256_set1_ps(0.2f), _mm256_mul_ps(t2, polynomial));
+    polynomial = _mm256_add_ps(_mm256_set1_ps(0.333333333f), _mm256_mul_ps(t2, polynomial));
+    polynomial = _mm256_add_ps(one, _mm256_mul_ps(t2, polynomial));
+    return _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(exponents), _mm256_set1_ps(0.693147181f)),
+                      _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(2.0f), t), polynomial));
+}
+
+TARGET_AVX2 inline __m256 get_gaussian_cos_2pi_avx2(__m256 u) {
+    __m256 sign_mask = _mm256_set1_ps(-0.0f);
+    __m256 w = _mm256_andnot_ps(sign_mask, _mm256_sub_ps(u, _mm256_set1_ps(0.5f)));
+    __m256 is_flipped = _mm256_cmp_ps(w, _mm256_set1_ps(0.25f), _CMP_GT_OQ);
+    w = _mm256_blendv_ps(w, _mm256_sub_ps(_mm256_set1_ps(0.5f), w), is_flipped);
+
+    __m256 x = _mm256_mul_ps(w, _mm256_set1_ps(6.28318531f));
+    __m256 x2 = _mm256_mul_ps(x, x);
+    __m256 cos_x = _mm256_add_ps(_mm256_set1_ps(-2.75573192e-07f),
+                                 _mm256_mul_ps(x2, _mm256_set1_ps(2.08767570e-09f)));
+    cos_x = _mm256_add_ps(_mm256_set1_ps(2.48015873e-05f), _mm256_mul_ps(x2, cos_x));
+    cos_x = _mm256_add_ps(_mm256_set1_ps(-0.00138888889f), _mm256_mul_ps(x2, cos_x));
+    cos_x = _mm256_add_ps(_mm256_set1_ps(0.0416666667f), _mm256_mul_ps(x2, cos_x));
+    cos_x = _mm256_add_ps(_mm256_set1_ps(-0.5f), _mm256_mul_ps(x2, cos_x));
+    cos_x = _mm256_add_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(x2, cos_x));
+    // NOTE: negate the lanes that aren't flipped
+    return _mm256_xor_ps(cos_x, _mm256_andnot_ps(is_flipped, sign_mask));
+}
+
+TARGET_AVX2 void gaussian_row_avx2(real32 *out, Philox_Key key, int32 level, int32 row_index,
+                                   int32 first_column_index, int32 column_step, int32 count) {
+    __m256i m0 = _mm256_set1_epi32((int32) 0xD2511F53u);
+    __m256i m1 = _mm256_set1_epi32((int32) 0xCD9E8D57u);
+    __m256i lane_columns = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                              _mm256_set1_epi32(column_step));
+
+    int32 k = 0;
+    for (; k + 8 <= count; k += 8) {
+        __m256i v0 = _mm256_add_epi32(_mm256_set1_epi32(first_column_index + k*column_step), lane_columns);
+        __m256i v1 = _mm256_set1_epi32(row_index);
+        __m256i v2 = _mm256_set1_epi32(level);
+        __m256i v3 = _mm256_setzero_si256();
+        Philox_Key round_key = key;
+        for (int32 round_index = 0; round_index < 10; round_index++) {
+            __m256i high0, low0, high1, low1;
+            multiply_high_low_avx2(v0, m0, &high0, &low0);
+            multiply_high_low_avx2(v2, m1, &high1, &low1);
+            v0 = _mm256_xor_si256(_mm256_xor_si256(high1, v1), _mm256_set1_epi32((int32) round_key.k0));
+            v1 = low1;
+            v2 = _mm256_xor_si256(_mm256_xor_si256(high0, v3), _mm256_set1_epi32((int32) round_key.k1));
+            v3 = low0;
+            round_key.k0 += 0x9E3779B9u;
+            round_key.k1 += 0xBB67AE85u;
+        }
+
+        __m256 log_u1 = get_gaussian_log_avx2(get_uniform_real32_avx2(v0));
+        __m256 r = _mm256_sqrt_ps(_mm256_mul_ps(_mm256_set1_ps(-2.0f), log_u1));
+        _mm256_storeu_ps(out + k, _mm256_mul_ps(r, get_gaussian_cos_2pi_avx2(get_uniform_real32_avx2(v1))));
+    }
+    fill_cell_gaussians_scalar(out + k, key, level, row_index, first_column_index + k*column_step, column_step,
+                               count - k);
+}
+
+#endif
+
+Simd_Level get_cpu_simd_level() {
+#if TERRAIN_KERNELS_X86
+#if defined(_MSC_VER)
+    int32 cpu_info[4];
+    __cpuid(cpu_info, 0);
+    int32 max_function_id = cpu_info[0];
+
+    __cpuid(cpu_info, 1);
+    bool32 has_sse4 = (cpu_info[2] & (1 << 19)) != 0;
+    bool32 has_osxsave = (cpu_info[2] & (1 << 27)) != 0;
+    bool32 has_avx = (cpu_info[2] & (1 << 28)) != 0;
+
+    bool32 has_avx2 = false;
+    if (max_function_id >= 7 && has_osxsave && has_avx) {
+        // NOTE: the OS also has to save the upper halves of the ymm registers
+        bool32 os_saves_ymm = (_xgetbv(0) & 6) == 6;
+        __cpuidex(cpu_info, 7, 0);
+        has_avx2 = os_saves_ymm && (cpu_info[1] & (1 << 5)) != 0;
+    }
+#else
+    __builtin_cpu_init();
+    bool32 has_sse4 = __builtin_cpu_supports("sse4.1");
+    bool32 has_avx2 = __builtin_cpu_supports("avx2");
+#endif
+
+    if (has_avx2) {
+        return SIMD_LEVEL_AVX2;
+    } else if (has_sse4) {
+        return SIMD_LEVEL_SSE4;
+    }
+#endif
+    return SIMD_LEVEL_SCALAR;
+}
+
+// NOTE: asking for a level that the CPU doesn't support is the caller's problem
+Terrain_Kernels get_terrain_kernels(Simd_Level simd_level) {
+    Terrain_Kernels kernels = {};
+    kernels.simd_level = SIMD_LEVEL_SCALAR;
+    kernels.square_row = square_row_scalar;
+    kernels.diamond_row = diamond_row_scalar;
+    kernels.dequantize_8 = dequantize_8_scalar;
+    kernels.dequantize_16 = dequantize_16_scalar;
+    kernels.gaussian_row = fill_cell_gaussians_scalar;
+    kernels.normal_row = normal_row_scalar;
+
+#if TERRAIN_KERNELS_X86
+    if (simd_level == SIMD_LEVEL_AVX2) {
+        kernels.simd_level = SIMD_LEVEL_AVX2;
+        kernels.square_row = square_row_avx2;
+        kernels.diamond_row = diamond_row_avx2;
+        kernels.dequantize_8 = dequantize_8_avx2;
+        kernels.dequantize_16 = dequantize_16_avx2;
+        kernels.gaussian_row = gaussian_row_avx2;
+        kernels.normal_row = normal_row_sse4;
+    } else if (simd_level == SIMD_LEVEL_SSE4) {
+        kernels.simd_level = SIMD_LEVEL_SSE4;
+        kernels.square_row = square_row_sse4;
+        kernels.diamond_row = diamond_row_sse4;
+        kernels.dequantize_8 = dequantize_8_sse4;
+        kernels.dequantize_16 = dequantize_16_sse4;
+        kernels.gaussian_row = gaussian_row_sse4;
+        kernels.normal_row = normal_row_sse4;
+    }
+#endif
+
+    return kernels;
+}
+
+char *get_simd_level_name(Simd_Level simd_level) {
+    switch (simd_level) {
+        case SIMD_LEVEL_AVX2: return "AVX2";
+        case SIMD_LEVEL_SSE4: return "SSE4";
+        default: return "scalar";
+    }
+}
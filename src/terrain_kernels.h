@@ -0,0 +1,51 @@
+#ifndef TERRAIN_KERNELS_H
+
+#include "rng.h"
+
+enum Simd_Level {
+    SIMD_LEVEL_SCALAR,
+    SIMD_LEVEL_SSE4,
+    SIMD_LEVEL_AVX2
+};
+
+// NOTE: square step for count cells of one row. out points to the first cell to generate, top and bottom
+//       point to the rows above and below it, at the column of the first cell's left corners. so cell k is
+//       out[k*stride] and its corners are top[k*stride], top[(k+1)*stride], bottom[(k+1)*stride] and
+//       bottom[k*stride]. returns the max of max_height and the generated heights.
+typedef real32 Square_Row_Kernel(real32 *out, real32 *top, real32 *bottom, real32 *noise,
+                                 int32 count, int32 stride, real32 max_height);
+
+// NOTE: diamond step for count cells of one row that all have 4 neighbours. out, top and bottom all point
+//       to the column of the first cell, so cell k is out[k*stride] and its neighbours are top[k*stride],
+//       out[k*stride + half_stride], bottom[k*stride] and out[k*stride - half_stride].
+typedef real32 Diamond_Row_Kernel(real32 *out, real32 *top, real32 *bottom, real32 *noise,
+                                  int32 count, int32 stride, int32 half_stride, real32 max_height);
+
+// NOTE: out[k] = min_height + scale*samples[k] for count quantized heights (see quantized_heights.h)
+typedef void Dequantize_8_Kernel(real32 *out, uint8 *samples, int32 count, real32 min_height, real32 scale);
+typedef void Dequantize_16_Kernel(real32 *out, uint16 *samples, int32 count, real32 min_height, real32 scale);
+
+// NOTE: get_cell_gaussian() for the count cells of a row at first_column_index + k*column_step
+typedef void Gaussian_Row_Kernel(real32 *out, Philox_Key key, int32 level, int32 row_index,
+                                 int32 first_column_index, int32 column_step, int32 count);
+
+// NOTE: normals (row[k - 1] - row[k + 1], 2, top[k] - bottom[k]) for count vertices of a row, written to out
+//       as xyz. row[-1] and row[count] have to exist.
+typedef void Normal_Row_Kernel(real32 *out, real32 *top, real32 *row, real32 *bottom, int32 count);
+
+struct Terrain_Kernels {
+    Simd_Level simd_level;
+    Square_Row_Kernel *square_row;
+    Diamond_Row_Kernel *diamond_row;
+    Dequantize_8_Kernel *dequantize_8;
+    Dequantize_16_Kernel *dequantize_16;
+    Gaussian_Row_Kernel *gaussian_row;
+    Normal_Row_Kernel *normal_row;
+};
+
+Simd_Level get_cpu_simd_level();
+Terrain_Kernels get_terrain_kernels(Simd_Level simd_level);
+char *get_simd_level_name(Simd_Level simd_level);
+
+#define TERRAIN_KERNELS_H
+#endif
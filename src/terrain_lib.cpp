@@ -0,0 +1,34 @@
+// NOTE: everything that generates terrains and builds their meshes, with no GL, GLFW or window. this gets
+//       #included into a unity build (main.cpp for the viewer, terrain_gen.cpp for the command-line tool),
+//       and the API it needs from the includer is just main.h.
+#ifndef GLM_FORCE_RADIANS
+#define GLM_FORCE_RADIANS
+#endif
+#include "include/glm/glm.hpp"
+#include "include/glm/gtc/matrix_transform.hpp"
+#include "platform.cpp"
+#include <math.h>
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "work_queue.cpp"
+#include "task_graph.cpp"
+#include "rng.cpp"
+#include "terrain_kernels.cpp"
+#include "terrain.cpp"
+#include "quantized_heights.cpp"
+#include "vertex_formats.cpp"
+#include "vertex_cache.cpp"
+#include "mesh_chunks.cpp"
+#include "terrain_culling.cpp"
+#include "rtin.cpp"
+#include "terrain_lod.cpp"
+#include "clipmap.cpp"
+#include "terrain_sculpt.cpp"
+#include "terrain_io.cpp"
+#include "batch.cpp"
+#include "mapped_file.cpp"
+#include "out_of_core.cpp"
+#include "terrain_chunks.cpp"
+#include "benchmarks.cpp"
@@ -0,0 +1,463 @@
+#include "main.h"
+#include "grid.h"
+#include "terrain.h"
+#include "terrain_lod.h"
+
+// NOTE: patch vertex (row_index, column_index), in steps from the patch's first vertex. on an edge that's
+//       next to a coarser node, the odd vertices are moved back onto the even one before them, which turns
+//       the two quads along the edge into a fan that only uses the coarser node's vertices.
+inline uint16 get_lod_patch_vertex(int32 row_index, int32 column_index, int32 quads, int32 step, int32 row_stride,
+                                   int32 edge_mask) {
+    if ((column_index & 1) && (((edge_mask & LOD_EDGE_TOP) && row_index == 0) ||
+                               ((edge_mask & LOD_EDGE_BOTTOM) && row_index == quads))) {
+        column_index--;
+    }
+    if ((row_index & 1) && (((edge_mask & LOD_EDGE_LEFT) && column_index == 0) ||
+                            ((edge_mask & LOD_EDGE_RIGHT) && column_index == quads))) {
+        row_index--;
+    }
+    return (uint16) (row_index*step*row_stride + column_index*step);
+}
+
+// NOTE: the triangles of a patch of quads x quads quads, step vertices apart, from a chunk whose rows are
+//       row_stride vertices long. the quads are split the same way as generate_grid_indices(), except along
+//       the edges in edge_mask (see get_lod_patch_vertex()), where the triangles that end up with no area
+//       are left out. returns the number of indices.
+int32 generate_lod_patch_indices(uint16 *indices, int32 quads, int32 step, int32 row_stride, int32 edge_mask) {
+    assert(quads % 2 == 0 || edge_mask == 0);
+    int32 num_indices = 0;
+    for (int32 row_index = 0; row_index < quads; row_index++) {
+        for (int32 column_index = 0; column_index < quads; column_index++) {
+            uint16 bottom_right = get_lod_patch_vertex(row_index + 1, column_index + 1, quads, step, row_stride,
+                                                       edge_mask);
+            uint16 top_right = get_lod_patch_vertex(row_index, column_index + 1, quads, step, row_stride, edge_mask);
+            uint16 top_left = get_lod_patch_vertex(row_index, column_index, quads, step, row_stride, edge_mask);
+            uint16 bottom_left = get_lod_patch_vertex(row_index + 1, column_index, quads, step, row_stride,
+                                                      edge_mask);
+            if (top_right != top_left && top_right != bottom_right) {
+                indices[num_indices++] = bottom_right;
+                indices[num_indices++] = top_right;
+                indices[num_indices++] = top_left;
+            }
+            if (bottom_left != top_left && bottom_left != bottom_right) {
+                indices[num_indices++] = bottom_right;
+                indices[num_indices++] = top_left;
+                indices[num_indices++] = bottom_left;
+            }
+        }
+    }
+    return num_indices;
+}
+
+inline real32 get_lod_height(Terrain *terrain, int32 row_index, int32 column_index) {
+    // NOTE: the heights are read from the vertices, since height_data might have been quantized
+    return terrain->vertices[3*(((int64) row_index)*terrain->x_resolution + column_index) + 1];
+}
+
+// NOTE: how far the vertices half a step apart are from the triangles of the node drawn at its step. those
+//       triangles are split by the finer level's, which makes the difference between the two meshes
+//       largest at a vertex, so this plus the children's error bounds the node's error.
+static real32 get_lod_node_step_error(Terrain *terrain, int32 first_row_index, int32 first_column_index,
+                                      int32 node_size, int32 step) {
+    int32 half_step = step / 2;
+    real32 error = 0;
+    for (int32 row_index = first_row_index; row_index <= first_row_index + node_size; row_index += half_step) {
+        bool32 is_odd_row = ((row_index - first_row_index) / half_step) & 1;
+        for (int32 column_index = first_column_index; column_index <= first_column_index + node_size;
+             column_index += half_step) {
+            bool32 is_odd_column = ((column_index - first_column_index) / half_step) & 1;
+            real32 interpolated_height;
+            if (is_odd_row && is_odd_column) {
+                // NOTE: on the diagonal the quad is split along
+                interpolated_height = 0.5f*(get_lod_height(terrain, row_index - half_step, column_index - half_step) +
+                                            get_lod_height(terrain, row_index + half_step, column_index + half_step));
+            } else if (is_odd_row) {
+                interpolated_height = 0.5f*(get_lod_height(terrain, row_index - half_step, column_index) +
+                                            get_lod_height(terrain, row_index + half_step, column_index));
+            } else if (is_odd_column) {
+                interpolated_height = 0.5f*(get_lod_height(terrain, row_index, column_index - half_step) +
+                                            get_lod_height(terrain, row_index, column_index + half_step));
+            } else {
+                continue;
+            }
+            error = fmaxf(error, fabsf(get_lod_height(terrain, row_index, column_index) - interpolated_height));
+        }
+    }
+    return error;
+}
+
+// NOTE: the bounds of the nodes in nodes (rows and columns of nodes) on one level. the levels above the
+//       leaves need the bounds of the level below.
+void update_terrain_lod_nodes(Terrain_Lod *lod, Terrain *terrain, int32 level_index, Grid_Rect nodes) {
+    Lod_Level *level = &lod->levels[level_index];
+    int32 size = level->node_size;
+    for (int32 node_row_index = nodes.min_row_index; node_row_index <= nodes.max_row_index; node_row_index++) {
+        for (int32 node_column_index = nodes.min_column_index; node_column_index <= nodes.max_column_index;
+             node_column_index++) {
+            Lod_Node_Bounds *node = &level->nodes[node_row_index*level->nodes_per_row + node_column_index];
+            int32 first_row_index = node_row_index*size;
+            int32 first_column_index = node_column_index*size;
+            if (level_index == 0) {
+                node->min_height = FLT_MAX;
+                node->max_height = -FLT_MAX;
+                for (int32 row_index = first_row_index; row_index <= first_row_index + size; row_index++) {
+                    for (int32 column_index = first_column_index; column_index <= first_column_index + size;
+                         column_index++) {
+                        real32 height = get_lod_height(terrain, row_index, column_index);
+                        node->min_height = fminf(node->min_height, height);
+                        node->max_height = fmaxf(node->max_height, height);
+                    }
+                }
+                node->error = 0;
+            } else {
+                Lod_Level *child_level = &lod->levels[level_index - 1];
+                node->min_height = FLT_MAX;
+                node->max_height = -FLT_MAX;
+                real32 child_error = 0;
+                for (int32 child_index = 0; child_index < 4; child_index++) {
+                    int32 child_row_index = 2*node_row_index + (child_index >> 1);
+                    int32 child_column_index = 2*node_column_index + (child_index & 1);
+                    Lod_Node_Bounds *child = &child_level->nodes[child_row_index*child_level->nodes_per_row +
+                                                                 child_column_index];
+                    node->min_height = fminf(node->min_height, child->min_height);
+                    node->max_height = fmaxf(node->max_height, child->max_height);
+                    child_error = fmaxf(child_error, child->error);
+                }
+                node->error = child_error + get_lod_node_step_error(terrain, first_row_index, first_column_index,
+                                                                     size, level->step);
+            }
+        }
+    }
+}
+
+// NOTE: rebuilds the bounds of every node with a vertex in rect, from the leaves up
+void update_terrain_lod_bounds(Terrain_Lod *lod, Terrain *terrain, Grid_Rect rect) {
+    for (int32 level_index = 0; level_index < lod->num_levels; level_index++) {
+        Lod_Level *level = &lod->levels[level_index];
+        int32 size = level->node_size;
+        // NOTE: node i has the vertices [i*size, (i + 1)*size], so the ones on an edge are in two nodes
+        Grid_Rect nodes;
+        nodes.min_row_index = (rect.min_row_index > 0) ? (rect.min_row_index - 1) / size : 0;
+        nodes.max_row_index = rect.max_row_index / size;
+        if (nodes.max_row_index >= level->nodes_per_column) {
+            nodes.max_row_index = level->nodes_per_column - 1;
+        }
+        nodes.min_column_index = (rect.min_column_index > 0) ? (rect.min_column_index - 1) / size : 0;
+        nodes.max_column_index = rect.max_column_index / size;
+        if (nodes.max_column_index >= level->nodes_per_row) {
+            nodes.max_column_index = level->nodes_per_row - 1;
+        }
+        update_terrain_lod_nodes(lod, terrain, level_index, nodes);
+    }
+}
+
+// NOTE: only needs terrain->mesh_chunks. the roots are as big as they can be while the pieces of a node
+//       that's bigger than a mesh chunk still have at least 2 quads per side, so their edges can be stitched.
+//       the bounds are left for update_terrain_lod_bounds(), or for update_terrain_lod_nodes() on every
+//       level from the leaves up.
+Terrain_Lod *make_terrain_lod(Terrain *terrain) {
+    Terrain_Lod *lod = (Terrain_Lod *) calloc(1, sizeof(Terrain_Lod));
+    Mesh_Chunk_Layout *mesh_chunks = &terrain->mesh_chunks;
+    lod->mesh_chunks = mesh_chunks;
+    int32 cells_per_chunk = mesh_chunks->cells_per_chunk;
+    lod->node_quads = (cells_per_chunk < LOD_NODE_QUADS) ? cells_per_chunk : LOD_NODE_QUADS;
+
+    int32 root_size = terrain->x_resolution - 1;
+    if (root_size > terrain->y_resolution - 1) {
+        root_size = terrain->y_resolution - 1;
+    }
+    int32 max_root_size = lod->node_quads*((cells_per_chunk > 1) ? cells_per_chunk / 2 : 1);
+    if (root_size > max_root_size) {
+        root_size = max_root_size;
+    }
+    lod->num_levels = 1;
+    while ((lod->node_quads << (lod->num_levels - 1)) < root_size) {
+        lod->num_levels++;
+    }
+    lod->levels = (Lod_Level *) malloc(lod->num_levels * sizeof(Lod_Level));
+    for (int32 level_index = 0; level_index < lod->num_levels; level_index++) {
+        Lod_Level *level = &lod->levels[level_index];
+        level->node_size = lod->node_quads << level_index;
+        level->step = 1 << level_index;
+        level->nodes_per_row = (terrain->x_resolution - 1) / level->node_size;
+        level->nodes_per_column = (terrain->y_resolution - 1) / level->node_size;
+        level->nodes = (Lod_Node_Bounds *) malloc(level->nodes_per_row*level->nodes_per_column *
+                                                  sizeof(Lod_Node_Bounds));
+    }
+
+    // NOTE: a patch with step 2^e is a whole node if the node fits in a chunk, and the piece of it in one
+    //       chunk if it doesn't
+    lod->num_step_exponents = lod->num_levels;
+    int32 num_patches = lod->num_step_exponents*LOD_EDGE_MASKS;
+    lod->patch_offsets = (int32 *) malloc(num_patches * sizeof(int32));
+    lod->patch_counts = (int32 *) malloc(num_patches * sizeof(int32));
+    int32 max_indices = 0;
+    for (int32 step_exponent = 0; step_exponent < lod->num_step_exponents; step_exponent++) {
+        int32 quads = cells_per_chunk >> step_exponent;
+        if (quads > lod->node_quads) {
+            quads = lod->node_quads;
+        }
+        max_indices += LOD_EDGE_MASKS*quads*quads*6;
+    }
+    lod->indices = (uint16 *) malloc(max_indices * sizeof(uint16));
+    for (int32 step_exponent = 0; step_exponent < lod->num_step_exponents; step_exponent++) {
+        int32 quads = cells_per_chunk >> step_exponent;
+        if (quads > lod->node_quads) {
+            quads = lod->node_quads;
+        }
+        for (int32 edge_mask = 0; edge_mask < LOD_EDGE_MASKS; edge_mask++) {
+            int32 patch_index = step_exponent*LOD_EDGE_MASKS + edge_mask;
+            lod->patch_offsets[patch_index] = lod->num_indices;
+            lod->patch_counts[patch_index] = generate_lod_patch_indices(lod->indices + lod->num_indices, quads,
+                                                                        1 << step_exponent,
+                                                                        mesh_chunks->vertices_per_chunk_side,
+                                                                        edge_mask);
+            lod->num_indices += lod->patch_counts[patch_index];
+        }
+    }
+
+    // NOTE: a selected node covers at least one leaf, and a node that's drawn as pieces covers at least one
+    //       leaf per piece
+    Lod_Level *leaves = &lod->levels[0];
+    lod->max_selected_nodes = leaves->nodes_per_row*leaves->nodes_per_column;
+    lod->selected_nodes = (Lod_Selected_Node *) malloc(lod->max_selected_nodes * sizeof(Lod_Selected_Node));
+    lod->leaf_levels = (int8 *) malloc(lod->max_selected_nodes * sizeof(int8));
+    lod->draw_counts = (int32 *) malloc(lod->max_selected_nodes * sizeof(int32));
+    lod->draw_base_vertices = (int32 *) malloc(lod->max_selected_nodes * sizeof(int32));
+    lod->draw_index_offsets = (void **) malloc(lod->max_selected_nodes * sizeof(void *));
+
+    return lod;
+}
+
+void free_terrain_lod(Terrain_Lod *lod) {
+    for (int32 level_index = 0; level_index < lod->num_levels; level_index++) {
+        free(lod->levels[level_index].nodes);
+    }
+    free(lod->levels);
+    free(lod->indices);
+    free(lod->patch_offsets);
+    free(lod->patch_counts);
+    free(lod->selected_nodes);
+    free(lod->leaf_levels);
+    free(lod->draw_counts);
+    free(lod->draw_base_vertices);
+    free(lod->draw_index_offsets);
+    free(lod);
+}
+
+struct Lod_Selection {
+    Terrain_Lod *lod;
+    Terrain *terrain;
+    glm::vec3 camera_position;
+    // NOTE: world units per cell and per height
+    glm::vec3 scale;
+    // NOTE: how many pixels a world unit covers at a distance of one world unit
+    real32 pixels_per_unit;
+    real32 max_pixel_error;
+};
+
+static void set_lod_leaf_levels(Terrain_Lod *lod, Lod_Selected_Node node) {
+    int32 leaves_per_side = 1 << node.level;
+    int32 leaves_per_row = lod->levels[0].nodes_per_row;
+    for (int32 row_index = node.row_index*leaves_per_side; row_index < (node.row_index + 1)*leaves_per_side;
+         row_index++) {
+        for (int32 column_index = node.column_index*leaves_per_side;
+             column_index < (node.column_index + 1)*leaves_per_side; column_index++) {
+            lod->leaf_levels[row_index*leaves_per_row + column_index] = (int8) node.level;
+        }
+    }
+}
+
+static void select_lod_node(Lod_Selection *selection, int32 level_index, int32 node_row_index,
+                            int32 node_column_index) {
+    Terrain_Lod *lod = selection->lod;
+    Lod_Level *level = &lod->levels[level_index];
+    Lod_Node_Bounds *node = &level->nodes[node_row_index*level->nodes_per_row + node_column_index];
+
+    bool32 is_detailed_enough = (level_index == 0);
+    if (!is_detailed_enough) {
+        // NOTE: the closest point of the node's bounding box, in the same space as gl_draw_terrain()'s model
+        //       matrix puts the vertices in
+        int32 last_row_index = selection->terrain->y_resolution - 1;
+        glm::vec3 box_min = glm::vec3(node_column_index*level->node_size, node->min_height,
+                                      node_row_index*level->node_size - last_row_index) * selection->scale;
+        glm::vec3 box_max = glm::vec3((node_column_index + 1)*level->node_size, node->max_height,
+                                      (node_row_index + 1)*level->node_size - last_row_index) * selection->scale;
+        glm::vec3 closest_point = glm::clamp(selection->camera_position, box_min, box_max);
+        real32 distance = glm::length(closest_point - selection->camera_position);
+        real32 pixel_error = node->error*selection->scale.y*selection->pixels_per_unit / fmaxf(distance, 1e-6f);
+        is_detailed_enough = (pixel_error <= selection->max_pixel_error);
+    }
+
+    if (is_detailed_enough) {
+        Lod_Selected_Node selected = {level_index, node_row_index, node_column_index};
+        lod->selected_nodes[lod->num_selected_nodes++] = selected;
+        set_lod_leaf_levels(lod, selected);
+    } else {
+        for (int32 child_index = 0; child_index < 4; child_index++) {
+            select_lod_node(selection, level_index - 1, 2*node_row_index + (child_index >> 1),
+                            2*node_column_index + (child_index & 1));
+        }
+    }
+}
+
+// NOTE: the finest and coarsest levels of the leaves just outside one edge of node. direction is the
+//       edge's LOD_EDGE_*. returns false if the edge is on the edge of the grid.
+static bool32 get_lod_neighbour_levels(Terrain_Lod *lod, Lod_Selected_Node node, int32 direction,
+                                       int32 *min_level, int32 *max_level) {
+    Lod_Level *leaves = &lod->levels[0];
+    int32 leaves_per_side = 1 << node.level;
+    int32 first_row_index = node.row_index*leaves_per_side;
+    int32 first_column_index = node.column_index*leaves_per_side;
+    int32 row_index = first_row_index;
+    int32 column_index = first_column_index;
+    int32 row_step = 0;
+    int32 column_step = 0;
+    if (direction == LOD_EDGE_TOP) {
+        row_index = first_row_index - 1;
+        column_step = 1;
+    } else if (direction == LOD_EDGE_BOTTOM) {
+        row_index = first_row_index + leaves_per_side;
+        column_step = 1;
+    } else if (direction == LOD_EDGE_LEFT) {
+        column_index = first_column_index - 1;
+        row_step = 1;
+    } else {
+        column_index = first_column_index + leaves_per_side;
+        row_step = 1;
+    }
+    if (row_index < 0 || row_index >= leaves->nodes_per_column ||
+        column_index < 0 || column_index >= leaves->nodes_per_row) {
+        return false;
+    }
+
+    *min_level = INT32_MAX;
+    *max_level = 0;
+    for (int32 leaf_index = 0; leaf_index < leaves_per_side; leaf_index++) {
+        int32 level = lod->leaf_levels[row_index*leaves->nodes_per_row + column_index];
+        *min_level = (level < *min_level) ? level : *min_level;
+        *max_level = (level > *max_level) ? level : *max_level;
+        row_index += row_step;
+        column_index += column_step;
+    }
+    return true;
+}
+
+// NOTE: picks the nodes to draw from camera, and fills in the draws. the terrain is drawn with the model
+//       matrix from gl_draw_terrain().
+void select_terrain_lod(Terrain_Lod *lod, Terrain *terrain, Camera *camera, real32 max_pixel_error) {
+    Lod_Selection selection = {};
+    selection.lod = lod;
+    selection.terrain = terrain;
+    selection.camera_position = camera->position;
+    selection.scale = glm::vec3(terrain->world_x_size / (terrain->x_resolution - 1), terrain->vertical_scale_factor,
+                                terrain->world_y_size / (terrain->y_resolution - 1));
+    selection.pixels_per_unit = camera->window_height / (2.0f*tanf(glm::radians(camera->fov_y_degrees) / 2.0f));
+    selection.max_pixel_error = max_pixel_error;
+
+    lod->num_selected_nodes = 0;
+    Lod_Level *roots = &lod->levels[lod->num_levels - 1];
+    for (int32 root_row_index = 0; root_row_index < roots->nodes_per_column; root_row_index++) {
+        for (int32 root_column_index = 0; root_column_index < roots->nodes_per_row; root_column_index++) {
+            select_lod_node(&selection, lod->num_levels - 1, root_row_index, root_column_index);
+        }
+    }
+
+    // NOTE: splits nodes until every node's neighbours are at most one level finer. splitting a node can
+    //       make one of its neighbours need splitting too, so this goes until nothing changes.
+    bool32 was_split = true;
+    while (was_split) {
+        was_split = false;
+        for (int32 node_index = 0; node_index < lod->num_selected_nodes; node_index++) {
+            Lod_Selected_Node node = lod->selected_nodes[node_index];
+            bool32 needs_split = false;
+            for (int32 direction = LOD_EDGE_TOP; direction <= LOD_EDGE_LEFT && !needs_split; direction *= 2) {
+                int32 min_level, max_level;
+                if (get_lod_neighbour_levels(lod, node, direction, &min_level, &max_level)) {
+                    needs_split = (min_level < node.level - 1);
+                }
+            }
+            if (needs_split) {
+                for (int32 child_index = 0; child_index < 4; child_index++) {
+                    Lod_Selected_Node child = {node.level - 1, 2*node.row_index + (child_index >> 1),
+                                               2*node.column_index + (child_index & 1)};
+                    if (child_index == 0) {
+                        lod->selected_nodes[node_index] = child;
+                    } else {
+                        lod->selected_nodes[lod->num_selected_nodes++] = child;
+                    }
+                    set_lod_leaf_levels(lod, child);
+                }
+                was_split = true;
+            }
+        }
+    }
+
+    // NOTE: the draws, without the pieces outside the view frustum. the stitching only depends on the
+    //       selection, so a culled piece doesn't change its neighbours.
+    Mesh_Chunk_Layout *mesh_chunks = lod->mesh_chunks;
+    int32 cells_per_chunk = mesh_chunks->cells_per_chunk;
+    Frustum frustum = make_frustum(get_camera_projection_matrix(camera)*get_camera_view_matrix(camera));
+    int32 last_row_index = terrain->y_resolution - 1;
+    lod->num_draws = 0;
+    lod->num_triangles = 0;
+    lod->num_culled_draws = 0;
+    for (int32 node_index = 0; node_index < lod->num_selected_nodes; node_index++) {
+        Lod_Selected_Node node = lod->selected_nodes[node_index];
+        int32 edge_mask = 0;
+        for (int32 direction = LOD_EDGE_TOP; direction <= LOD_EDGE_LEFT; direction *= 2) {
+            int32 min_level, max_level;
+            if (get_lod_neighbour_levels(lod, node, direction, &min_level, &max_level) && max_level > node.level) {
+                edge_mask |= direction;
+            }
+        }
+
+        Lod_Level *level = &lod->levels[node.level];
+        Lod_Node_Bounds *bounds = &level->nodes[node.row_index*level->nodes_per_row + node.column_index];
+        int32 node_size = level->node_size;
+        int32 first_row_index = node.row_index*node_size;
+        int32 first_column_index = node.column_index*node_size;
+        int32 chunks_per_side = (node_size > cells_per_chunk) ? node_size / cells_per_chunk : 1;
+        for (int32 piece_row_index = 0; piece_row_index < chunks_per_side; piece_row_index++) {
+            for (int32 piece_column_index = 0; piece_column_index < chunks_per_side; piece_column_index++) {
+                int32 row_index = first_row_index + piece_row_index*cells_per_chunk;
+                int32 column_index = first_column_index + piece_column_index*cells_per_chunk;
+                int32 piece_size = (node_size < cells_per_chunk) ? node_size : cells_per_chunk;
+                glm::vec3 box_min = glm::vec3(column_index, bounds->min_height, row_index - last_row_index) *
+                                    selection.scale;
+                glm::vec3 box_max = glm::vec3(column_index + piece_size, bounds->max_height,
+                                              row_index + piece_size - last_row_index) * selection.scale;
+                if (test_frustum_box(&frustum, box_min, box_max) == FRUSTUM_OUTSIDE) {
+                    lod->num_culled_draws++;
+                    continue;
+                }
+                int32 chunk_index = (row_index / cells_per_chunk)*mesh_chunks->chunks_per_row +
+                                    column_index / cells_per_chunk;
+                // NOTE: only the piece's edges on the edge of the node get stitched
+                int32 piece_edge_mask = edge_mask;
+                if (piece_row_index > 0) {
+                    piece_edge_mask &= ~LOD_EDGE_TOP;
+                }
+                if (piece_row_index < chunks_per_side - 1) {
+                    piece_edge_mask &= ~LOD_EDGE_BOTTOM;
+                }
+                if (piece_column_index > 0) {
+                    piece_edge_mask &= ~LOD_EDGE_LEFT;
+                }
+                if (piece_column_index < chunks_per_side - 1) {
+                    piece_edge_mask &= ~LOD_EDGE_RIGHT;
+                }
+
+                int32 patch_index = node.level*LOD_EDGE_MASKS + piece_edge_mask;
+                lod->draw_counts[lod->num_draws] = lod->patch_counts[patch_index];
+                // NOTE: make_mesh_chunk_layout() asserts that every vertex index fits in an int32
+                lod->draw_base_vertices[lod->num_draws] =
+                    (int32) get_mesh_chunk_vertex_index(mesh_chunks, chunk_index, row_index, column_index);
+                lod->draw_index_offsets[lod->num_draws] =
+                    (void *) (lod->patch_offsets[patch_index] * sizeof(uint16));
+                lod->num_triangles += lod->patch_counts[patch_index] / 3;
+                lod->num_draws++;
+            }
+        }
+    }
+}
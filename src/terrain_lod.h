@@ -0,0 +1,93 @@
+#ifndef TERRAIN_LOD_H
+
+// NOTE: level of detail for drawing big grids (geomipmapping over a quadtree). the grid is covered by a
+//       quadtree of square nodes, and every node is drawn as LOD_NODE_QUADS x LOD_NODE_QUADS quads, so a
+//       node twice as big skips every other vertex. the leaves are drawn at full resolution. every frame,
+//       select_terrain_lod() walks the tree from the top and splits a node while its error, projected onto
+//       the screen from the closest point of its bounding box, is more than max_pixel_error pixels.
+//
+//       the vertices are the ones already in the chunk-major vertex buffer (see mesh_chunks.h): a node
+//       that fits in a mesh chunk is drawn from that chunk's vertices with a base vertex, and a bigger one
+//       as a piece per chunk. so the index buffers only depend on the step between vertices and which
+//       edges are stitched, and there's few enough of them to all go into one buffer.
+//
+//       cracks: the selection is balanced so that nodes next to each other are at most one level apart,
+//       and a node next to a coarser one skips every other vertex on that edge too (see
+//       generate_lod_patch_indices()), so both sides of the edge have the same vertices.
+
+#define LOD_NODE_QUADS 32
+
+// NOTE: which edges of a patch are next to a coarser node
+enum Lod_Edge {
+    LOD_EDGE_TOP = 1,
+    LOD_EDGE_RIGHT = 2,
+    LOD_EDGE_BOTTOM = 4,
+    LOD_EDGE_LEFT = 8,
+    LOD_EDGE_MASKS = 16
+};
+
+struct Lod_Node_Bounds {
+    real32 min_height;
+    real32 max_height;
+    // NOTE: how far, in heights, the node drawn at its step can be from the full-resolution mesh
+    real32 error;
+};
+
+struct Lod_Level {
+    // NOTE: in cells
+    int32 node_size;
+    int32 step;
+    int32 nodes_per_row;
+    int32 nodes_per_column;
+    Lod_Node_Bounds *nodes;
+};
+
+struct Lod_Selected_Node {
+    int32 level;
+    int32 row_index;
+    int32 column_index;
+};
+
+struct Terrain_Lod {
+    Mesh_Chunk_Layout *mesh_chunks;
+    int32 node_quads;
+    // NOTE: levels[0] are the leaves, the last level the roots
+    int32 num_levels;
+    Lod_Level *levels;
+
+    // NOTE: all the patch index buffers, one after another. patch (step exponent e, edge mask m) is at
+    //       patch_offsets[e*LOD_EDGE_MASKS + m] (in indices) and has patch_counts[...] indices.
+    int32 num_step_exponents;
+    uint16 *indices;
+    int32 num_indices;
+    int32 *patch_offsets;
+    int32 *patch_counts;
+
+    // NOTE: what select_terrain_lod() picked
+    int32 max_selected_nodes;
+    Lod_Selected_Node *selected_nodes;
+    int32 num_selected_nodes;
+    // NOTE: the level of the selected node that covers each leaf, for balancing and stitching
+    int8 *leaf_levels;
+
+    // NOTE: for glMultiDrawElementsBaseVertex(), one draw per selected node and mesh chunk it covers
+    int32 *draw_counts;
+    int32 *draw_base_vertices;
+    void **draw_index_offsets;
+    int32 num_draws;
+    int64 num_triangles;
+    // NOTE: the pieces of selected nodes that weren't drawn because they're outside the view frustum
+    int32 num_culled_draws;
+};
+
+struct Terrain;
+
+int32 generate_lod_patch_indices(uint16 *indices, int32 quads, int32 step, int32 row_stride, int32 edge_mask);
+Terrain_Lod *make_terrain_lod(Terrain *terrain);
+void update_terrain_lod_nodes(Terrain_Lod *lod, Terrain *terrain, int32 level_index, Grid_Rect nodes);
+void update_terrain_lod_bounds(Terrain_Lod *lod, Terrain *terrain, Grid_Rect rect);
+void select_terrain_lod(Terrain_Lod *lod, Terrain *terrain, Camera *camera, real32 max_pixel_error);
+void free_terrain_lod(Terrain_Lod *lod);
+
+#define TERRAIN_LOD_H
+#endif
@@ -0,0 +1,332 @@
+#include "main.h"
+#include "grid.h"
+#include "terrain.h"
+#include "terrain_sculpt.h"
+
+// NOTE: the heights have to be floats in row-major order, which they are after build_terrain_mesh() unless
+//       they were quantized
+Terrain_Sculpt *make_terrain_sculpt(Terrain *terrain) {
+    assert(terrain->height_data && terrain->height_layout == HEIGHT_LAYOUT_ROW_MAJOR && terrain->vertices);
+    Terrain_Sculpt *sculpt = (Terrain_Sculpt *) calloc(1, sizeof(Terrain_Sculpt));
+    sculpt->tiles_per_row = (terrain->x_resolution + SCULPT_TILE_SIZE - 1) / SCULPT_TILE_SIZE;
+    sculpt->tiles_per_column = (terrain->y_resolution + SCULPT_TILE_SIZE - 1) / SCULPT_TILE_SIZE;
+    sculpt->tile_stroke_ids = (int32 *) calloc(sculpt->tiles_per_row*sculpt->tiles_per_column, sizeof(int32));
+    // NOTE: 0 is no stroke
+    sculpt->next_stroke_id = 1;
+    return sculpt;
+}
+
+// NOTE: the height of the mesh at a point of the grid, on the triangles generate_grid_indices() splits the cell
+//       into (the diagonal goes from the top left to the bottom right)
+real32 get_terrain_mesh_height(Terrain *terrain, real32 row, real32 column) {
+    int32 row_index = Clamp_Boundary::resolve((int32) floorf(row), terrain->y_resolution - 1);
+    int32 column_index = Clamp_Boundary::resolve((int32) floorf(column), terrain->x_resolution - 1);
+    real32 fy = fminf(fmaxf(row - row_index, 0.0f), 1.0f);
+    real32 fx = fminf(fmaxf(column - column_index, 0.0f), 1.0f);
+    real32 *top_left = terrain->vertices + 3*(((int64) row_index)*terrain->x_resolution + column_index) + 1;
+    real32 top_right = top_left[3];
+    real32 bottom_left = top_left[3*terrain->x_resolution];
+    real32 bottom_right = top_left[3*terrain->x_resolution + 3];
+    if (fx >= fy) {
+        return *top_left + fx*(top_right - *top_left) + fy*(bottom_right - top_right);
+    }
+    return *top_left + fy*(bottom_left - *top_left) + fx*(bottom_right - bottom_left);
+}
+
+// NOTE: where a ray in world space (the model matrix in gl_draw_terrain() applied) first goes under the mesh,
+//       as a point of the grid. it's marched half a cell at a time across the grid, and the step that goes under
+//       is then halved a few times.
+bool32 pick_terrain_point(Terrain *terrain, glm::vec3 origin, glm::vec3 direction, real32 *row, real32 *column) {
+    int32 last_row_index = terrain->y_resolution - 1;
+    int32 last_column_index = terrain->x_resolution - 1;
+    glm::vec3 scale = glm::vec3(terrain->world_x_size / last_column_index, terrain->vertical_scale_factor,
+                                terrain->world_y_size / last_row_index);
+    // NOTE: (column, height, row)
+    glm::vec3 position = origin / scale;
+    position.z += last_row_index;
+    glm::vec3 step = direction / scale;
+    real32 horizontal_length = sqrtf(step.x*step.x + step.z*step.z);
+    if (horizontal_length < 0.000001f) {
+        return false;
+    }
+    step *= 0.5f / horizontal_length;
+
+    int32 max_steps = 4*(terrain->x_resolution + terrain->y_resolution);
+    for (int32 step_index = 0; step_index < max_steps; step_index++) {
+        glm::vec3 next_position = position + step;
+        bool32 is_inside = next_position.x >= 0 && next_position.x <= last_column_index &&
+                           next_position.z >= 0 && next_position.z <= last_row_index;
+        if (is_inside && next_position.y <= get_terrain_mesh_height(terrain, next_position.z, next_position.x)) {
+            glm::vec3 above = position;
+            glm::vec3 below = next_position;
+            for (int32 iteration = 0; iteration < 8; iteration++) {
+                glm::vec3 middle = 0.5f*(above + below);
+                if (middle.y <= get_terrain_mesh_height(terrain, middle.z, middle.x)) {
+                    below = middle;
+                } else {
+                    above = middle;
+                }
+            }
+            *row = below.z;
+            *column = below.x;
+            return true;
+        }
+        position = next_position;
+    }
+    return false;
+}
+
+static Grid_Rect get_sculpt_tile_rect(Terrain_Sculpt *sculpt, Terrain *terrain, int32 tile_index) {
+    int32 min_row_index = (tile_index / sculpt->tiles_per_row)*SCULPT_TILE_SIZE;
+    int32 min_column_index = (tile_index % sculpt->tiles_per_row)*SCULPT_TILE_SIZE;
+    return clip_grid_rect(make_grid_rect(min_row_index, min_row_index + SCULPT_TILE_SIZE - 1,
+                                         min_column_index, min_column_index + SCULPT_TILE_SIZE - 1),
+                          terrain->x_resolution, terrain->y_resolution);
+}
+
+static void free_sculpt_stroke(Sculpt_Stroke *stroke) {
+    for (int32 tile_index = 0; tile_index < stroke->num_tiles; tile_index++) {
+        free(stroke->tiles[tile_index].heights);
+    }
+    free(stroke->tiles);
+    *stroke = {};
+}
+
+// NOTE: the undone strokes can't be redone once there's a new one, and the oldest stroke is forgotten when
+//       there's no room for another
+void begin_sculpt_stroke(Terrain_Sculpt *sculpt, Terrain *terrain, real32 row, real32 column) {
+    assert(!sculpt->is_stroking);
+    for (int32 stroke_index = sculpt->num_strokes; stroke_index < sculpt->num_strokes + sculpt->num_redo_strokes;
+         stroke_index++) {
+        free_sculpt_stroke(&sculpt->strokes[stroke_index]);
+    }
+    sculpt->num_redo_strokes = 0;
+    if (sculpt->num_strokes == MAX_SCULPT_STROKES) {
+        free_sculpt_stroke(&sculpt->strokes[0]);
+        memmove(sculpt->strokes, sculpt->strokes + 1, (MAX_SCULPT_STROKES - 1)*sizeof(Sculpt_Stroke));
+        sculpt->strokes[MAX_SCULPT_STROKES - 1] = {};
+        sculpt->num_strokes--;
+    }
+    // NOTE: an empty rect, until the first dab
+    sculpt->strokes[sculpt->num_strokes++].rect = make_grid_rect(0, -1, 0, -1);
+    sculpt->is_stroking = true;
+    sculpt->stroke_id = sculpt->next_stroke_id++;
+    sculpt->flatten_height = get_terrain_mesh_height(terrain, row, column);
+}
+
+// NOTE: copies the tiles in rect that the stroke hasn't copied yet
+static void snapshot_sculpt_tiles(Terrain_Sculpt *sculpt, Terrain *terrain, Grid_Rect rect) {
+    Sculpt_Stroke *stroke = &sculpt->strokes[sculpt->num_strokes - 1];
+    for (int32 tile_row_index = rect.min_row_index / SCULPT_TILE_SIZE;
+         tile_row_index <= rect.max_row_index / SCULPT_TILE_SIZE; tile_row_index++) {
+        for (int32 tile_column_index = rect.min_column_index / SCULPT_TILE_SIZE;
+             tile_column_index <= rect.max_column_index / SCULPT_TILE_SIZE; tile_column_index++) {
+            int32 tile_index = tile_row_index*sculpt->tiles_per_row + tile_column_index;
+            if (sculpt->tile_stroke_ids[tile_index] == sculpt->stroke_id) {
+                continue;
+            }
+            sculpt->tile_stroke_ids[tile_index] = sculpt->stroke_id;
+
+            if (stroke->num_tiles == stroke->max_tiles) {
+                stroke->max_tiles = (stroke->max_tiles > 0) ? 2*stroke->max_tiles : 16;
+                stroke->tiles = (Sculpt_Tile_Snapshot *) realloc(stroke->tiles,
+                                                                 stroke->max_tiles*sizeof(Sculpt_Tile_Snapshot));
+            }
+            Grid_Rect tile_rect = get_sculpt_tile_rect(sculpt, terrain, tile_index);
+            int32 tile_width = tile_rect.max_column_index - tile_rect.min_column_index + 1;
+            int32 tile_height = tile_rect.max_row_index - tile_rect.min_row_index + 1;
+            Sculpt_Tile_Snapshot *snapshot = &stroke->tiles[stroke->num_tiles++];
+            snapshot->tile_index = tile_index;
+            snapshot->heights = (real32 *) malloc(tile_width*tile_height*sizeof(real32));
+            for (int32 row_index = 0; row_index < tile_height; row_index++) {
+                int64 grid_index = ((int64) tile_rect.min_row_index + row_index)*terrain->x_resolution +
+                                   tile_rect.min_column_index;
+                memcpy(snapshot->heights + row_index*tile_width, terrain->height_data + grid_index,
+                       tile_width*sizeof(real32));
+            }
+        }
+    }
+}
+
+// NOTE: one dab of the brush at (row, column) of the grid, for seconds of the stroke. returns false if the brush
+//       doesn't reach any heights. max_height only ever goes up while sculpting, since finding it again after a
+//       dab that lowered it would mean going over the whole grid.
+bool32 apply_terrain_brush(Terrain_Sculpt *sculpt, Terrain *terrain, Terrain_Brush *brush, real32 row, real32 column,
+                           real32 seconds, Terrain_Update *update) {
+    assert(sculpt->is_stroking && brush->radius > 0);
+    int32 width = terrain->x_resolution;
+    int32 height = terrain->y_resolution;
+    Grid_Rect rect = clip_grid_rect(make_grid_rect((int32) ceilf(row - brush->radius),
+                                                   (int32) floorf(row + brush->radius),
+                                                   (int32) ceilf(column - brush->radius),
+                                                   (int32) floorf(column + brush->radius)),
+                                    width, height);
+    if (rect.min_row_index > rect.max_row_index || rect.min_column_index > rect.max_column_index) {
+        return false;
+    }
+    snapshot_sculpt_tiles(sculpt, terrain, rect);
+
+    // NOTE: smoothing reads the heights around each one as they were before the dab, including a cell past rect
+    Grid_Rect read_rect = clip_grid_rect(make_grid_rect(rect.min_row_index - 1, rect.max_row_index + 1,
+                                                        rect.min_column_index - 1, rect.max_column_index + 1),
+                                         width, height);
+    int32 read_width = read_rect.max_column_index - read_rect.min_column_index + 1;
+    int32 read_height = read_rect.max_row_index - read_rect.min_row_index + 1;
+    if (brush->mode == BRUSH_SMOOTH) {
+        int64 num_read_heights = ((int64) read_width)*read_height;
+        if (num_read_heights > sculpt->dab_heights_capacity) {
+            free(sculpt->dab_heights);
+            sculpt->dab_heights = (real32 *) malloc(num_read_heights*sizeof(real32));
+            sculpt->dab_heights_capacity = num_read_heights;
+        }
+        for (int32 row_index = 0; row_index < read_height; row_index++) {
+            memcpy(sculpt->dab_heights + ((int64) row_index)*read_width,
+                   terrain->height_data + ((int64) read_rect.min_row_index + row_index)*width +
+                   read_rect.min_column_index, read_width*sizeof(real32));
+        }
+    }
+
+    real32 max_height = terrain->max_height;
+    for (int32 row_index = rect.min_row_index; row_index <= rect.max_row_index; row_index++) {
+        real32 *height_row = terrain->height_data + ((int64) row_index)*width;
+        for (int32 column_index = rect.min_column_index; column_index <= rect.max_column_index; column_index++) {
+            real32 distance = sqrtf((row_index - row)*(row_index - row) +
+                                    (column_index - column)*(column_index - column));
+            if (distance >= brush->radius) {
+                continue;
+            }
+            real32 falloff = 0.5f*(1.0f + cosf(glm::pi<real32>()*distance / brush->radius));
+            real32 amount = brush->strength*seconds*falloff;
+            real32 *h = &height_row[column_index];
+            if (brush->mode == BRUSH_RAISE) {
+                *h += amount;
+            } else if (brush->mode == BRUSH_LOWER) {
+                *h -= amount;
+            } else if (brush->mode == BRUSH_SMOOTH) {
+                real32 sum = 0;
+                int32 count = 0;
+                for (int32 r = row_index - 1; r <= row_index + 1; r++) {
+                    for (int32 c = column_index - 1; c <= column_index + 1; c++) {
+                        if (r >= read_rect.min_row_index && r <= read_rect.max_row_index &&
+                            c >= read_rect.min_column_index && c <= read_rect.max_column_index) {
+                            sum += sculpt->dab_heights[((int64) r - read_rect.min_row_index)*read_width +
+                                                       (c - read_rect.min_column_index)];
+                            count++;
+                        }
+                    }
+                }
+                *h += (sum / count - *h)*fminf(amount, 1.0f);
+            } else if (brush->mode == BRUSH_FLATTEN) {
+                *h += (sculpt->flatten_height - *h)*fminf(amount, 1.0f);
+            }
+            max_height = fmaxf(max_height, *h);
+        }
+    }
+    terrain->max_height = max_height;
+
+    Sculpt_Stroke *stroke = &sculpt->strokes[sculpt->num_strokes - 1];
+    if (stroke->rect.min_row_index > stroke->rect.max_row_index) {
+        stroke->rect = rect;
+    } else {
+        stroke->rect.min_row_index = (rect.min_row_index < stroke->rect.min_row_index) ? rect.min_row_index :
+                                                                                         stroke->rect.min_row_index;
+        stroke->rect.max_row_index = (rect.max_row_index > stroke->rect.max_row_index) ? rect.max_row_index :
+                                                                                         stroke->rect.max_row_index;
+        stroke->rect.min_column_index = (rect.min_column_index < stroke->rect.min_column_index) ?
+                                        rect.min_column_index : stroke->rect.min_column_index;
+        stroke->rect.max_column_index = (rect.max_column_index > stroke->rect.max_column_index) ?
+                                        rect.max_column_index : stroke->rect.max_column_index;
+    }
+
+    *update = update_terrain_mesh_rect(terrain, rect);
+    return true;
+}
+
+// NOTE: a stroke that didn't change anything isn't kept
+void end_sculpt_stroke(Terrain_Sculpt *sculpt) {
+    assert(sculpt->is_stroking);
+    sculpt->is_stroking = false;
+    Sculpt_Stroke *stroke = &sculpt->strokes[sculpt->num_strokes - 1];
+    if (stroke->num_tiles == 0) {
+        free_sculpt_stroke(stroke);
+        sculpt->num_strokes--;
+    }
+}
+
+// NOTE: swaps the heights in the stroke's rect with its snapshots, which undoes it or redoes it. the rest of
+//       each tile is left alone, since the stroke didn't change it, and a control height edit since the stroke
+//       might have, without being in the history. so the grid only changes in stroke->rect, which is what
+//       gets regenerated.
+static void swap_sculpt_stroke_tiles(Terrain_Sculpt *sculpt, Terrain *terrain, Sculpt_Stroke *stroke) {
+    real32 *row_heights = (real32 *) malloc(SCULPT_TILE_SIZE*sizeof(real32));
+    for (int32 snapshot_index = 0; snapshot_index < stroke->num_tiles; snapshot_index++) {
+        Sculpt_Tile_Snapshot *snapshot = &stroke->tiles[snapshot_index];
+        Grid_Rect tile_rect = get_sculpt_tile_rect(sculpt, terrain, snapshot->tile_index);
+        int32 tile_width = tile_rect.max_column_index - tile_rect.min_column_index + 1;
+        Grid_Rect rect = tile_rect;
+        rect.min_row_index = (stroke->rect.min_row_index > rect.min_row_index) ? stroke->rect.min_row_index :
+                                                                                 rect.min_row_index;
+        rect.max_row_index = (stroke->rect.max_row_index < rect.max_row_index) ? stroke->rect.max_row_index :
+                                                                                 rect.max_row_index;
+        rect.min_column_index = (stroke->rect.min_column_index > rect.min_column_index) ?
+                                stroke->rect.min_column_index : rect.min_column_index;
+        rect.max_column_index = (stroke->rect.max_column_index < rect.max_column_index) ?
+                                stroke->rect.max_column_index : rect.max_column_index;
+        int32 rect_width = rect.max_column_index - rect.min_column_index + 1;
+        for (int32 row_index = rect.min_row_index; row_index <= rect.max_row_index; row_index++) {
+            real32 *grid_row = terrain->height_data + ((int64) row_index)*terrain->x_resolution +
+                               rect.min_column_index;
+            real32 *snapshot_row = snapshot->heights + (row_index - tile_rect.min_row_index)*tile_width +
+                                   (rect.min_column_index - tile_rect.min_column_index);
+            memcpy(row_heights, grid_row, rect_width*sizeof(real32));
+            memcpy(grid_row, snapshot_row, rect_width*sizeof(real32));
+            memcpy(snapshot_row, row_heights, rect_width*sizeof(real32));
+        }
+    }
+    free(row_heights);
+}
+
+// NOTE: the update is of the rect of everything the stroke changed
+bool32 undo_sculpt_stroke(Terrain_Sculpt *sculpt, Terrain *terrain, Terrain_Update *update) {
+    assert(!sculpt->is_stroking);
+    if (sculpt->num_strokes == 0) {
+        return false;
+    }
+    Sculpt_Stroke *stroke = &sculpt->strokes[--sculpt->num_strokes];
+    sculpt->num_redo_strokes++;
+    swap_sculpt_stroke_tiles(sculpt, terrain, stroke);
+    *update = update_terrain_mesh_rect(terrain, stroke->rect);
+    return true;
+}
+
+bool32 redo_sculpt_stroke(Terrain_Sculpt *sculpt, Terrain *terrain, Terrain_Update *update) {
+    assert(!sculpt->is_stroking);
+    if (sculpt->num_redo_strokes == 0) {
+        return false;
+    }
+    Sculpt_Stroke *stroke = &sculpt->strokes[sculpt->num_strokes++];
+    sculpt->num_redo_strokes--;
+    swap_sculpt_stroke_tiles(sculpt, terrain, stroke);
+    *update = update_terrain_mesh_rect(terrain, stroke->rect);
+    return true;
+}
+
+// NOTE: in bytes, of the snapshots of every stroke that can be undone or redone, counting the tiles on the edges
+//       of the grid as whole ones
+int64 get_terrain_sculpt_history_size(Terrain_Sculpt *sculpt) {
+    int64 size = 0;
+    for (int32 stroke_index = 0; stroke_index < sculpt->num_strokes + sculpt->num_redo_strokes; stroke_index++) {
+        Sculpt_Stroke *stroke = &sculpt->strokes[stroke_index];
+        size += stroke->num_tiles*(int64) (SCULPT_TILE_SIZE*SCULPT_TILE_SIZE*sizeof(real32));
+    }
+    return size;
+}
+
+void free_terrain_sculpt(Terrain_Sculpt *sculpt) {
+    for (int32 stroke_index = 0; stroke_index < sculpt->num_strokes + sculpt->num_redo_strokes; stroke_index++) {
+        free_sculpt_stroke(&sculpt->strokes[stroke_index]);
+    }
+    free(sculpt->tile_stroke_ids);
+    free(sculpt->dab_heights);
+    free(sculpt);
+}
@@ -0,0 +1,87 @@
+#ifndef TERRAIN_SCULPT_H
+
+// NOTE: sculpting the heights by hand. a stroke is the dabs of a brush between begin_sculpt_stroke() and
+//       end_sculpt_stroke(). every dab changes the heights within the brush's radius, and returns the rect it
+//       changed, after update_terrain_mesh_rect() has regenerated the vertices and normals there (and the
+//       normals one cell around it). so only those have to be uploaded again (see gl_update_terrain()).
+//
+//       undo: the grid is cut into SCULPT_TILE_SIZE x SCULPT_TILE_SIZE tiles, and the first time a stroke
+//       writes to a tile, the tile's heights are copied into the stroke's snapshots (copy-on-write). a stroke
+//       only keeps the tiles it touched, and undoing it swaps the heights in its rect back into the grid,
+//       which leaves the stroke holding what they were after it, for redoing it. control height edits
+//       (update_control_height()) aren't in the history, and regenerate whatever was sculpted around them.
+//       undoing a stroke after one puts back the heights from before the stroke inside the stroke's rect, and
+//       keeps the control edit everywhere else.
+
+#define SCULPT_TILE_SIZE 64
+#define MAX_SCULPT_STROKES 64
+
+enum Brush_Mode {
+    BRUSH_RAISE,
+    BRUSH_LOWER,
+    // NOTE: towards the average of the 3x3 heights around
+    BRUSH_SMOOTH,
+    // NOTE: towards the height under the brush when the stroke began
+    BRUSH_FLATTEN,
+    BRUSH_MODE_COUNT
+};
+
+struct Terrain_Brush {
+    Brush_Mode mode;
+    // NOTE: in cells. the brush falls off from its center to 0 at the radius.
+    real32 radius;
+    // NOTE: for raising and lowering, heights per second at the center. for smoothing and flattening, how much of
+    //       the way to go per second at the center.
+    real32 strength;
+};
+
+struct Sculpt_Tile_Snapshot {
+    int32 tile_index;
+    real32 *heights;
+};
+
+struct Sculpt_Stroke {
+    Sculpt_Tile_Snapshot *tiles;
+    int32 num_tiles;
+    int32 max_tiles;
+    // NOTE: of the heights the stroke changed
+    Grid_Rect rect;
+};
+
+struct Terrain_Sculpt {
+    int32 tiles_per_row;
+    int32 tiles_per_column;
+    // NOTE: the id of the last stroke that copied each tile, so a stroke copies a tile only once
+    int32 *tile_stroke_ids;
+    int32 next_stroke_id;
+    bool32 is_stroking;
+    int32 stroke_id;
+    real32 flatten_height;
+
+    // NOTE: strokes[0, num_strokes) can be undone, the ones after them up to num_redo_strokes redone
+    Sculpt_Stroke strokes[MAX_SCULPT_STROKES];
+    int32 num_strokes;
+    int32 num_redo_strokes;
+
+    // NOTE: the heights around a dab, for smoothing from the heights before it
+    real32 *dab_heights;
+    int64 dab_heights_capacity;
+};
+
+struct Terrain;
+struct Terrain_Update;
+
+Terrain_Sculpt *make_terrain_sculpt(Terrain *terrain);
+real32 get_terrain_mesh_height(Terrain *terrain, real32 row, real32 column);
+bool32 pick_terrain_point(Terrain *terrain, glm::vec3 origin, glm::vec3 direction, real32 *row, real32 *column);
+void begin_sculpt_stroke(Terrain_Sculpt *sculpt, Terrain *terrain, real32 row, real32 column);
+bool32 apply_terrain_brush(Terrain_Sculpt *sculpt, Terrain *terrain, Terrain_Brush *brush, real32 row, real32 column,
+                           real32 seconds, Terrain_Update *update);
+void end_sculpt_stroke(Terrain_Sculpt *sculpt);
+bool32 undo_sculpt_stroke(Terrain_Sculpt *sculpt, Terrain *terrain, Terrain_Update *update);
+bool32 redo_sculpt_stroke(Terrain_Sculpt *sculpt, Terrain *terrain, Terrain_Update *update);
+int64 get_terrain_sculpt_history_size(Terrain_Sculpt *sculpt);
+void free_terrain_sculpt(Terrain_Sculpt *sculpt);
+
+#define TERRAIN_SCULPT_H
+#endif
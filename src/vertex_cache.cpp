@@ -0,0 +1,221 @@
+#include "main.h"
+#include "vertex_cache.h"
+
+// NOTE: FIFO is how most of the GPUs the ACMR numbers in papers were measured on worked: a hit doesn't
+//       move the vertex, so it falls out cache_size misses after it went in. LRU moves it to the front.
+template <typename Index>
+Vertex_Cache_Stats simulate_vertex_cache(Index *indices, int64 num_indices, int64 num_vertices, int32 cache_size,
+                                         Vertex_Cache_Model model) {
+    Vertex_Cache_Stats stats = {};
+    stats.num_triangles = num_indices / 3;
+    stats.num_vertices = num_vertices;
+
+    if (model == VERTEX_CACHE_FIFO) {
+        // NOTE: the miss that put each vertex in the cache, or -1. a vertex is still in the cache if fewer than
+        //       cache_size misses came after it.
+        int64 *inserted_at = (int64 *) malloc(num_vertices * sizeof(int64));
+        for (int64 vertex_index = 0; vertex_index < num_vertices; vertex_index++) {
+            inserted_at[vertex_index] = -1;
+        }
+        for (int64 index = 0; index < num_indices; index++) {
+            Index vertex_index = indices[index];
+            int64 inserted = inserted_at[vertex_index];
+            if (inserted < 0 || stats.num_misses - inserted >= cache_size) {
+                inserted_at[vertex_index] = stats.num_misses;
+                stats.num_misses++;
+            }
+        }
+        free(inserted_at);
+    } else {
+        // NOTE: most recently used first
+        int64 *cache = (int64 *) malloc(cache_size * sizeof(int64));
+        int32 num_cached = 0;
+        for (int64 index = 0; index < num_indices; index++) {
+            int64 vertex_index = indices[index];
+            int32 cache_index = 0;
+            while (cache_index < num_cached && cache[cache_index] != vertex_index) {
+                cache_index++;
+            }
+            if (cache_index == num_cached) {
+                stats.num_misses++;
+                if (num_cached < cache_size) {
+                    num_cached++;
+                }
+                cache_index = num_cached - 1;
+            }
+            for (; cache_index > 0; cache_index--) {
+                cache[cache_index] = cache[cache_index - 1];
+            }
+            cache[0] = vertex_index;
+        }
+        free(cache);
+    }
+
+    stats.acmr = (real32) stats.num_misses / (stats.num_triangles ? stats.num_triangles : 1);
+    stats.atvr = (real32) stats.num_misses / (num_vertices ? num_vertices : 1);
+    return stats;
+}
+
+// NOTE: the same triangles as generate_grid_indices(), but in vertical strips strip_quads quads wide: every
+//       row of a strip, top to bottom, before the next strip. if a row of the strip fits in the cache along
+//       with the row under it, every vertex inside a strip is only transformed once, and only the vertices
+//       on the edges between strips twice.
+void generate_grid_strip_indices(uint32 *indices, int32 width, int32 height, int32 strip_quads) {
+    assert(strip_quads > 0);
+    uint32 *quad_indices = indices;
+    for (int32 first_column_index = 0; first_column_index < width - 1; first_column_index += strip_quads) {
+        int32 end_column_index = first_column_index + strip_quads;
+        if (end_column_index > width - 1) {
+            end_column_index = width - 1;
+        }
+        for (int32 row_index = 0; row_index < height - 1; row_index++) {
+            uint32 top_row_start = (uint32) (row_index*width);
+            uint32 bottom_row_start = top_row_start + width;
+            for (int32 column_index = first_column_index; column_index < end_column_index; column_index++) {
+                quad_indices[0] = bottom_row_start + column_index + 1;
+                quad_indices[1] = top_row_start + column_index + 1;
+                quad_indices[2] = top_row_start + column_index;
+                quad_indices[3] = bottom_row_start + column_index + 1;
+                quad_indices[4] = top_row_start + column_index;
+                quad_indices[5] = bottom_row_start + column_index;
+                quad_indices += 6;
+            }
+        }
+    }
+}
+
+// NOTE: rewrites the indices of a width x height grid as strips (see generate_grid_strip_indices()), as wide
+//       as does best in a FIFO cache of cache_size vertices. every width is simulated, since which one is best
+//       depends on how the rows line up with the cache, and that includes width - 1 (plain row order). returns
+//       the strip width.
+int32 optimize_grid_indices_for_vertex_cache(uint32 *indices, int32 width, int32 height, int32 cache_size) {
+    int64 num_indices = ((int64) width - 1)*(height - 1)*6;
+    int64 num_vertices = ((int64) width)*height;
+    int32 max_strip_quads = 2*cache_size;
+    if (max_strip_quads > width - 1) {
+        max_strip_quads = width - 1;
+    }
+
+    int32 best_strip_quads = width - 1;
+    generate_grid_strip_indices(indices, width, height, best_strip_quads);
+    int64 best_num_misses = simulate_vertex_cache(indices, num_indices, num_vertices, cache_size,
+                                                  VERTEX_CACHE_FIFO).num_misses;
+    for (int32 strip_quads = 1; strip_quads <= max_strip_quads; strip_quads++) {
+        generate_grid_strip_indices(indices, width, height, strip_quads);
+        int64 num_misses = simulate_vertex_cache(indices, num_indices, num_vertices, cache_size,
+                                                 VERTEX_CACHE_FIFO).num_misses;
+        if (num_misses < best_num_misses) {
+            best_num_misses = num_misses;
+            best_strip_quads = strip_quads;
+        }
+    }
+    generate_grid_strip_indices(indices, width, height, best_strip_quads);
+    return best_strip_quads;
+}
+
+// NOTE: Tipsify (Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced
+//       Overdraw", 2007), for meshes that aren't grids. it fans out around one vertex at a time, emitting all
+//       of its triangles that are left, then moves on to the neighbour that's most likely still in the cache
+//       and still has triangles, or back along the dead-end stack, or to the next vertex in order when both
+//       run out. writes the reordered indices to out, which can't be indices.
+void tipsify_indices(uint32 *indices, int64 num_indices, int64 num_vertices, int32 cache_size, uint32 *out) {
+    assert(num_indices >= 0 && num_vertices >= 0);
+    int64 num_triangles = num_indices / 3;
+
+    // NOTE: the triangles around every vertex, as ranges of vertex_triangles
+    int64 *first_vertex_triangle = (int64 *) calloc(num_vertices + 1, sizeof(int64));
+    for (int64 index = 0; index < num_indices; index++) {
+        first_vertex_triangle[indices[index] + 1]++;
+    }
+    for (int64 vertex_index = 0; vertex_index < num_vertices; vertex_index++) {
+        first_vertex_triangle[vertex_index + 1] += first_vertex_triangle[vertex_index];
+    }
+    int64 *vertex_triangles = (int64 *) malloc(num_indices * sizeof(int64));
+    int32 *num_live_triangles = (int32 *) calloc(num_vertices, sizeof(int32));
+    for (int64 index = 0; index < num_indices; index++) {
+        uint32 vertex_index = indices[index];
+        vertex_triangles[first_vertex_triangle[vertex_index] + num_live_triangles[vertex_index]] = index / 3;
+        num_live_triangles[vertex_index]++;
+    }
+
+    int64 *cache_time = (int64 *) calloc(num_vertices, sizeof(int64));
+    bool32 *emitted = (bool32 *) calloc(num_triangles, sizeof(bool32));
+    // NOTE: every emitted vertex is pushed, so this can't hold more than the indices
+    int64 *dead_end_stack = (int64 *) malloc(num_indices * sizeof(int64));
+    int64 dead_end_stack_size = 0;
+    // NOTE: the vertices that the last fan touched
+    int64 *candidates = (int64 *) malloc(num_indices * sizeof(int64));
+
+    int64 time = cache_size + 1;
+    int64 next_in_order = 0;
+    int64 fan_vertex = 0;
+    int64 num_out = 0;
+    while (fan_vertex >= 0) {
+        int64 num_candidates = 0;
+        for (int64 k = first_vertex_triangle[fan_vertex]; k < first_vertex_triangle[fan_vertex + 1]; k++) {
+            int64 triangle_index = vertex_triangles[k];
+            if (emitted[triangle_index]) {
+                continue;
+            }
+            emitted[triangle_index] = true;
+            for (int32 corner = 0; corner < 3; corner++) {
+                uint32 vertex_index = indices[3*triangle_index + corner];
+                out[num_out++] = vertex_index;
+                dead_end_stack[dead_end_stack_size++] = vertex_index;
+                candidates[num_candidates++] = vertex_index;
+                num_live_triangles[vertex_index]--;
+                if (time - cache_time[vertex_index] > cache_size) {
+                    cache_time[vertex_index] = time;
+                    time++;
+                }
+            }
+        }
+
+        // NOTE: the candidate that has been in the cache the longest but will still be there after its
+        //       remaining triangles are emitted
+        int64 best_vertex = -1;
+        int64 best_priority = -1;
+        for (int64 candidate_index = 0; candidate_index < num_candidates; candidate_index++) {
+            int64 vertex_index = candidates[candidate_index];
+            if (num_live_triangles[vertex_index] > 0) {
+                int64 priority = 0;
+                if (time - cache_time[vertex_index] + 2*num_live_triangles[vertex_index] <= cache_size) {
+                    priority = time - cache_time[vertex_index];
+                }
+                if (priority > best_priority) {
+                    best_priority = priority;
+                    best_vertex = vertex_index;
+                }
+            }
+        }
+
+        if (best_vertex < 0) {
+            while (dead_end_stack_size > 0) {
+                int64 vertex_index = dead_end_stack[--dead_end_stack_size];
+                if (num_live_triangles[vertex_index] > 0) {
+                    best_vertex = vertex_index;
+                    break;
+                }
+            }
+        }
+        if (best_vertex < 0) {
+            while (next_in_order < num_vertices) {
+                if (num_live_triangles[next_in_order] > 0) {
+                    best_vertex = next_in_order;
+                    break;
+                }
+                next_in_order++;
+            }
+        }
+        fan_vertex = best_vertex;
+    }
+    assert(num_out == num_triangles*3);
+
+    free(first_vertex_triangle);
+    free(vertex_triangles);
+    free(num_live_triangles);
+    free(cache_time);
+    free(emitted);
+    free(dead_end_stack);
+    free(candidates);
+}
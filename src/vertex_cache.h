@@ -0,0 +1,33 @@
+#ifndef VERTEX_CACHE_H
+
+// NOTE: the post-transform vertex cache: a GPU keeps the last few vertices it ran the vertex shader on, and
+//       a triangle whose vertices are still there doesn't run it again. how well an index order uses the
+//       cache is measured by
+//
+//           ACMR (average cache miss ratio) = vertex shader runs per triangle, 0.5 at best on a grid
+//           ATVR (average transformed vertex ratio) = vertex shader runs per vertex, 1.0 at best
+//
+//       simulate_vertex_cache() works these out for a FIFO or LRU cache of a given size.
+
+enum Vertex_Cache_Model {
+    VERTEX_CACHE_FIFO,
+    VERTEX_CACHE_LRU
+};
+
+struct Vertex_Cache_Stats {
+    int64 num_triangles;
+    int64 num_vertices;
+    int64 num_misses;
+    real32 acmr;
+    real32 atvr;
+};
+
+template <typename Index>
+Vertex_Cache_Stats simulate_vertex_cache(Index *indices, int64 num_indices, int64 num_vertices, int32 cache_size,
+                                         Vertex_Cache_Model model);
+void generate_grid_strip_indices(uint32 *indices, int32 width, int32 height, int32 strip_quads);
+int32 optimize_grid_indices_for_vertex_cache(uint32 *indices, int32 width, int32 height, int32 cache_size);
+void tipsify_indices(uint32 *indices, int64 num_indices, int64 num_vertices, int32 cache_size, uint32 *out);
+
+#define VERTEX_CACHE_H
+#endif
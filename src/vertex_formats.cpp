@@ -0,0 +1,207 @@
+#include "main.h"
+#include "terrain.h"
+#include "vertex_formats.h"
+
+char *get_vertex_format_name(Vertex_Format vertex_format) {
+    switch (vertex_format) {
+        case VERTEX_FORMAT_FULL: return "full";
+        case VERTEX_FORMAT_HEIGHT: return "height";
+        case VERTEX_FORMAT_HEIGHT_NORMAL: return "height-normal";
+        case VERTEX_FORMAT_COMPRESSED: return "compressed";
+        default: return "unknown";
+    }
+}
+
+// NOTE: in bytes
+int32 get_vertex_format_size(Vertex_Format vertex_format) {
+    switch (vertex_format) {
+        case VERTEX_FORMAT_FULL: return 8 * sizeof(real32);
+        case VERTEX_FORMAT_HEIGHT: return sizeof(real32);
+        case VERTEX_FORMAT_HEIGHT_NORMAL: return sizeof(Packed_Height_Normal);
+        case VERTEX_FORMAT_COMPRESSED: return sizeof(Compressed_Vertex);
+        default: return 0;
+    }
+}
+
+// NOTE: normalizes the normal and rounds every component to the nearest of -511..511
+uint32 pack_normal_10_10_10(glm::vec3 normal) {
+    normal = glm::normalize(normal);
+    uint32 packed_normal = 0;
+    for (int32 component_index = 0; component_index < 3; component_index++) {
+        real32 component = fminf(fmaxf(normal[component_index], -1.0f), 1.0f);
+        int32 value = (int32) floorf(component*511.0f + 0.5f);
+        packed_normal |= ((uint32) value & 0x3FF) << (10*component_index);
+    }
+    return packed_normal;
+}
+
+// NOTE: what GL 4.2 and up get for a normalized GL_INT_2_10_10_10_REV (value / 511). older GL uses
+//       (2*value + 1) / 1023, which is never more than 1/1023 off, and the normal gets normalized in the
+//       fragment shader anyway.
+glm::vec3 unpack_normal_10_10_10(uint32 packed_normal) {
+    glm::vec3 normal;
+    for (int32 component_index = 0; component_index < 3; component_index++) {
+        // NOTE: sign-extend the 10 bits
+        int32 value = ((int32) (packed_normal << (22 - 10*component_index))) >> 22;
+        normal[component_index] = fmaxf(value / 511.0f, -1.0f);
+    }
+    return normal;
+}
+
+// NOTE: maps the unit sphere onto an octahedron (|x| + |y| + |z| = 1) and unfolds that onto the square
+//       [-1, 1]^2: the upper half (y >= 0) is the diamond in the middle, and the lower half gets folded out
+//       into the corners. terrain normals are nearly all in the upper half, where the mapping is most even.
+//       x and z of the square are stored as signed normalized 16-bit integers.
+void encode_octahedral_normal(glm::vec3 normal, int16 *out) {
+    real32 length = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+    real32 x = normal.x / length;
+    real32 z = normal.z / length;
+    if (normal.y < 0.0f) {
+        real32 folded_x = (1.0f - fabsf(z)) * ((x >= 0.0f) ? 1.0f : -1.0f);
+        real32 folded_z = (1.0f - fabsf(x)) * ((z >= 0.0f) ? 1.0f : -1.0f);
+        x = folded_x;
+        z = folded_z;
+    }
+    out[0] = (int16) floorf(fminf(fmaxf(x, -1.0f), 1.0f)*32767.0f + 0.5f);
+    out[1] = (int16) floorf(fminf(fmaxf(z, -1.0f), 1.0f)*32767.0f + 0.5f);
+}
+
+// NOTE: the same as terrain_compressed.vs
+glm::vec3 decode_octahedral_normal(int16 *encoded_normal) {
+    real32 x = fmaxf(encoded_normal[0] / 32767.0f, -1.0f);
+    real32 z = fmaxf(encoded_normal[1] / 32767.0f, -1.0f);
+    real32 y = 1.0f - fabsf(x) - fabsf(z);
+    if (y < 0.0f) {
+        real32 unfolded_x = (1.0f - fabsf(z)) * ((x >= 0.0f) ? 1.0f : -1.0f);
+        real32 unfolded_z = (1.0f - fabsf(x)) * ((z >= 0.0f) ? 1.0f : -1.0f);
+        x = unfolded_x;
+        z = unfolded_z;
+    }
+    return glm::normalize(glm::vec3(x, y, z));
+}
+
+// NOTE: the same as generate_vertex_row() puts in terrain->vertices
+glm::vec3 get_grid_vertex_position(int32 vertex_index, real32 height, int32 width, int32 grid_height) {
+    int32 row_index = vertex_index / width;
+    int32 column_index = vertex_index % width;
+    return glm::vec3((real32) column_index, height, (real32) (row_index - grid_height + 1));
+}
+
+// NOTE: the same as build_terrain_mesh() puts in terrain->uvs
+glm::vec2 get_grid_vertex_uv(int32 vertex_index, int32 width, int32 grid_height) {
+    int32 row_index = vertex_index / width;
+    int32 column_index = vertex_index % width;
+    return glm::vec2((real32) column_index / (width - 1),
+                     (real32) ((grid_height - 1) - row_index) / (grid_height - 1));
+}
+
+// NOTE: the same as generate_normal_rect(), one vertex at a time, for row-major heights
+glm::vec3 get_grid_vertex_normal(real32 *heights, int32 vertex_index, int32 width, int32 grid_height) {
+    int32 row_index = vertex_index / width;
+    int32 column_index = vertex_index % width;
+    real32 center = heights[vertex_index];
+
+    real32 left = center;
+    real32 right = center;
+    if (width > 1) {
+        left = (column_index > 0) ? heights[vertex_index - 1] : 2.0f*center - heights[vertex_index + 1];
+        right = (column_index < width - 1) ? heights[vertex_index + 1] : 2.0f*center - heights[vertex_index - 1];
+    }
+    real32 top = center;
+    real32 bottom = center;
+    if (grid_height > 1) {
+        top = (row_index > 0) ? heights[vertex_index - width] : 2.0f*center - heights[vertex_index + width];
+        bottom = (row_index < grid_height - 1) ? heights[vertex_index + width] :
+                                                 2.0f*center - heights[vertex_index - width];
+    }
+    return glm::vec3(left - right, 2.0f, top - bottom);
+}
+
+// NOTE: writes count vertices of row row_index, from first_column_index on, in vertex_format (not
+//       VERTEX_FORMAT_FULL) to out. height_row has their heights. the formats with normals need the terrain's
+//       normals.
+void pack_terrain_vertex_row(Terrain *terrain, Vertex_Format vertex_format, real32 *height_row, int32 row_index,
+                             int32 first_column_index, int32 count, void *out) {
+    assert(vertex_format != VERTEX_FORMAT_FULL);
+    real32 *normal_row = terrain->normals + 3*(((int64) row_index)*terrain->x_resolution + first_column_index);
+    if (vertex_format == VERTEX_FORMAT_HEIGHT) {
+        memcpy(out, height_row, count * sizeof(real32));
+    } else if (vertex_format == VERTEX_FORMAT_HEIGHT_NORMAL) {
+        Packed_Height_Normal *packed_row = (Packed_Height_Normal *) out;
+        for (int32 column_index = 0; column_index < count; column_index++) {
+            packed_row[column_index].height = height_row[column_index];
+            packed_row[column_index].normal = pack_normal_10_10_10(glm::vec3(normal_row[3*column_index],
+                                                                             normal_row[3*column_index + 1],
+                                                                             normal_row[3*column_index + 2]));
+        }
+    } else {
+        assert(terrain->x_resolution <= MAX_COMPRESSED_VERTEX_GRID_SIZE &&
+               terrain->y_resolution <= MAX_COMPRESSED_VERTEX_GRID_SIZE);
+        Compressed_Vertex *compressed_row = (Compressed_Vertex *) out;
+        for (int32 column_index = 0; column_index < count; column_index++) {
+            Compressed_Vertex *vertex = &compressed_row[column_index];
+            vertex->column_index = (uint16) (first_column_index + column_index);
+            vertex->row_index = (uint16) row_index;
+            vertex->height = height_row[column_index];
+            encode_octahedral_normal(glm::vec3(normal_row[3*column_index], normal_row[3*column_index + 1],
+                                               normal_row[3*column_index + 2]), vertex->normal);
+        }
+    }
+}
+
+// NOTE: writes the vertices in rect in vertex_format (not VERTEX_FORMAT_FULL) to where they go in out, which
+//       has room for the whole grid, laid out like it
+void pack_terrain_vertex_rect(Terrain *terrain, Vertex_Format vertex_format, Grid_Rect rect, void *out) {
+    int32 width = terrain->x_resolution;
+    int32 value_size = get_vertex_format_size(vertex_format);
+    real32 *decoded_height_row = NULL;
+    if (terrain->quantized_heights) {
+        decoded_height_row = (real32 *) malloc(width * sizeof(real32));
+    }
+    for (int32 row_index = rect.min_row_index; row_index <= rect.max_row_index; row_index++) {
+        real32 *height_row = get_height_row(terrain, row_index, decoded_height_row) + rect.min_column_index;
+        int64 first_vertex_index = ((int64) row_index)*width + rect.min_column_index;
+        pack_terrain_vertex_row(terrain, vertex_format, height_row, row_index, rect.min_column_index,
+                                rect.max_column_index - rect.min_column_index + 1,
+                                (uint8 *) out + first_vertex_index*value_size);
+    }
+    free(decoded_height_row);
+}
+
+// NOTE: what the vertex shader gets out of vertex vertex_index of vertices, which are in vertex_format and
+//       laid out like the grid. VERTEX_FORMAT_FULL vertices are the positions, normals and UVs one after
+//       the other, like in the GL buffer. the normal isn't normalized for the formats that store floats.
+void decode_terrain_vertex(Vertex_Format vertex_format, void *vertices, int32 vertex_index, int32 width,
+                           int32 grid_height, glm::vec3 *position, glm::vec3 *normal, glm::vec2 *uv) {
+    int64 num_vertices = ((int64) width)*grid_height;
+    switch (vertex_format) {
+        case VERTEX_FORMAT_FULL: {
+            real32 *floats = (real32 *) vertices;
+            *position = ((glm::vec3 *) floats)[vertex_index];
+            *normal = ((glm::vec3 *) (floats + 3*num_vertices))[vertex_index];
+            *uv = ((glm::vec2 *) (floats + 6*num_vertices))[vertex_index];
+        } break;
+        case VERTEX_FORMAT_HEIGHT: {
+            real32 *heights = (real32 *) vertices;
+            *position = get_grid_vertex_position(vertex_index, heights[vertex_index], width, grid_height);
+            *normal = get_grid_vertex_normal(heights, vertex_index, width, grid_height);
+            *uv = get_grid_vertex_uv(vertex_index, width, grid_height);
+        } break;
+        case VERTEX_FORMAT_HEIGHT_NORMAL: {
+            Packed_Height_Normal *vertex = (Packed_Height_Normal *) vertices + vertex_index;
+            *position = get_grid_vertex_position(vertex_index, vertex->height, width, grid_height);
+            *normal = unpack_normal_10_10_10(vertex->normal);
+            *uv = get_grid_vertex_uv(vertex_index, width, grid_height);
+        } break;
+        case VERTEX_FORMAT_COMPRESSED: {
+            Compressed_Vertex *vertex = (Compressed_Vertex *) vertices + vertex_index;
+            int32 grid_index = vertex->row_index*width + vertex->column_index;
+            *position = get_grid_vertex_position(grid_index, vertex->height, width, grid_height);
+            *normal = decode_octahedral_normal(vertex->normal);
+            *uv = get_grid_vertex_uv(grid_index, width, grid_height);
+        } break;
+        default: {
+            assert(false);
+        } break;
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef VERTEX_FORMATS_H
+
+// NOTE: how a terrain's vertices are laid out in its GL vertex buffer. x and z of a grid vertex are just its
+//       column and row, and its UV is the same thing scaled to [0, 1], so the smaller formats leave them out
+//       and terrain_packed.vs rebuilds them from gl_VertexID (which is the vertex's index into the grid,
+//       row_index*width + column_index). get_grid_vertex_position(), get_grid_vertex_uv() and
+//       get_grid_vertex_normal() do the same math on the CPU, and decode_terrain_vertex() turns a vertex in any
+//       format back into what the shaders see.
+
+enum Vertex_Format {
+    // NOTE: all the positions, then all the normals, then all the UVs, as floats (32 bytes per vertex)
+    VERTEX_FORMAT_FULL,
+    // NOTE: just the height (4 bytes per vertex). the vertex shader also reads the buffer as a texture
+    //       buffer to get the neighbouring heights, and works out the normal from them.
+    VERTEX_FORMAT_HEIGHT,
+    // NOTE: a Packed_Height_Normal per vertex (8 bytes)
+    VERTEX_FORMAT_HEIGHT_NORMAL,
+    // NOTE: a Compressed_Vertex per vertex (12 bytes), drawn with terrain_compressed.vs. everything the
+    //       vertex shader needs is in the one interleaved stream, so it doesn't depend on gl_VertexID.
+    VERTEX_FORMAT_COMPRESSED,
+    VERTEX_FORMAT_COUNT
+};
+
+struct Packed_Height_Normal {
+    real32 height;
+    // NOTE: GL_INT_2_10_10_10_REV, x in the low 10 bits, then y, then z, each a signed normalized
+    //       integer. w is 0.
+    uint32 normal;
+};
+
+// NOTE: the column and row are whole numbers, so 16 bits are exact for grids up to 2^15 + 1 per side. the
+//       height stays a float. the normal is octahedral encoded (see encode_octahedral_normal()), and the UV
+//       is worked out from the column and row in the shader.
+struct Compressed_Vertex {
+    uint16 column_index;
+    uint16 row_index;
+    real32 height;
+    int16 normal[2];
+};
+
+#define MAX_COMPRESSED_VERTEX_GRID_SIZE 65536
+
+struct Terrain;
+
+char *get_vertex_format_name(Vertex_Format vertex_format);
+int32 get_vertex_format_size(Vertex_Format vertex_format);
+uint32 pack_normal_10_10_10(glm::vec3 normal);
+glm::vec3 unpack_normal_10_10_10(uint32 packed_normal);
+void encode_octahedral_normal(glm::vec3 normal, int16 *out);
+glm::vec3 decode_octahedral_normal(int16 *encoded_normal);
+glm::vec3 get_grid_vertex_position(int32 vertex_index, real32 height, int32 width, int32 grid_height);
+glm::vec2 get_grid_vertex_uv(int32 vertex_index, int32 width, int32 grid_height);
+glm::vec3 get_grid_vertex_normal(real32 *heights, int32 vertex_index, int32 width, int32 grid_height);
+void pack_terrain_vertex_row(Terrain *terrain, Vertex_Format vertex_format, real32 *height_row, int32 row_index,
+                             int32 first_column_index, int32 count, void *out);
+void pack_terrain_vertex_rect(Terrain *terrain, Vertex_Format vertex_format, Grid_Rect rect, void *out);
+void decode_terrain_vertex(Vertex_Format vertex_format, void *vertices, int32 vertex_index, int32 width,
+                           int32 grid_height, glm::vec3 *position, glm::vec3 *normal, glm::vec2 *uv);
+
+#define VERTEX_FORMATS_H
+#endif
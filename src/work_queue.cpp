@@ -0,0 +1,150 @@
+#include "main.h"
+#include "work_queue.h"
+
+static bool32 work_queue_is_empty(Work_Queue *queue) {
+    return queue->next_entry_to_read == queue->next_entry_to_write;
+}
+
+static void work_queue_thread_proc(Work_Queue *queue) {
+    while (true) {
+        Work_Queue_Entry entry;
+        {
+            std::unique_lock<std::mutex> lock(queue->mutex);
+            while (!queue->is_shutting_down && work_queue_is_empty(queue)) {
+                queue->work_available.wait(lock);
+            }
+
+            if (work_queue_is_empty(queue)) {
+                // NOTE: only get here when shutting down
+                return;
+            }
+
+            entry = queue->entries[queue->next_entry_to_read];
+            queue->next_entry_to_read = (queue->next_entry_to_read + 1) % MAX_WORK_QUEUE_ENTRIES;
+        }
+
+        entry.callback(entry.data);
+    }
+}
+
+int32 get_default_num_worker_threads() {
+    // NOTE: the thread that calls parallel_for() also does work, so we leave a core for it
+    int32 num_cores = (int32) std::thread::hardware_concurrency();
+    return (num_cores > 1) ? (num_cores - 1) : 0;
+}
+
+// NOTE: a queue with 0 threads is valid; work added to it is only done by threads that call
+//       do_next_work_queue_entry() or parallel_for()
+void init_work_queue(Work_Queue *queue, int32 num_threads) {
+    assert(num_threads >= 0);
+    queue->next_entry_to_read = 0;
+    queue->next_entry_to_write = 0;
+    queue->is_shutting_down = false;
+    queue->num_threads = num_threads;
+    queue->threads = NULL;
+
+    if (num_threads > 0) {
+        queue->threads = new std::thread[num_threads];
+        for (int32 thread_index = 0; thread_index < num_threads; thread_index++) {
+            queue->threads[thread_index] = std::thread(work_queue_thread_proc, queue);
+        }
+    }
+}
+
+// NOTE: finishes all the work that's already been added before joining the threads
+void shutdown_work_queue(Work_Queue *queue) {
+    {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->is_shutting_down = true;
+    }
+    queue->work_available.notify_all();
+
+    for (int32 thread_index = 0; thread_index < queue->num_threads; thread_index++) {
+        queue->threads[thread_index].join();
+    }
+    delete[] queue->threads;
+    queue->threads = NULL;
+    queue->num_threads = 0;
+}
+
+void add_work_queue_entry(Work_Queue *queue, Work_Queue_Callback *callback, void *data) {
+    {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        int32 new_next_entry_to_write = (queue->next_entry_to_write + 1) % MAX_WORK_QUEUE_ENTRIES;
+        assert(new_next_entry_to_write != queue->next_entry_to_read);
+
+        Work_Queue_Entry *entry = &queue->entries[queue->next_entry_to_write];
+        entry->callback = callback;
+        entry->data = data;
+        queue->next_entry_to_write = new_next_entry_to_write;
+    }
+    queue->work_available.notify_one();
+}
+
+// NOTE: lets the calling thread help out. returns false if there was nothing to do.
+bool32 do_next_work_queue_entry(Work_Queue *queue) {
+    Work_Queue_Entry entry;
+    {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        if (work_queue_is_empty(queue)) {
+            return false;
+        }
+        entry = queue->entries[queue->next_entry_to_read];
+        queue->next_entry_to_read = (queue->next_entry_to_read + 1) % MAX_WORK_QUEUE_ENTRIES;
+    }
+
+    entry.callback(entry.data);
+    return true;
+}
+
+#define MAX_PARALLEL_FOR_TASKS 256
+
+struct Parallel_For_Task {
+    Parallel_For_Callback *callback;
+    void *data;
+    int32 first;
+    int32 last;
+    std::atomic<int32> *num_remaining_tasks;
+};
+
+static void do_parallel_for_task(void *data) {
+    Parallel_For_Task *task = (Parallel_For_Task *) data;
+    task->callback(task->data, task->first, task->last);
+    task->num_remaining_tasks->fetch_sub(1);
+}
+
+// NOTE: splits [0, count) into contiguous ranges and blocks until all of them are done. the callback
+//       must not depend on how the range is split up, since that changes with the number of threads.
+void parallel_for(Work_Queue *queue, int32 count, Parallel_For_Callback *callback, void *data) {
+    if (count <= 0) {
+        return;
+    }
+
+    if (!queue || queue->num_threads == 0 || count == 1) {
+        callback(data, 0, count);
+        return;
+    }
+
+    // NOTE: a few tasks per thread so that threads that finish early can pick up the slack
+    int32 num_tasks = 4*(queue->num_threads + 1);
+    if (num_tasks > count) num_tasks = count;
+    if (num_tasks > MAX_PARALLEL_FOR_TASKS) num_tasks = MAX_PARALLEL_FOR_TASKS;
+
+    Parallel_For_Task tasks[MAX_PARALLEL_FOR_TASKS];
+    std::atomic<int32> num_remaining_tasks(num_tasks);
+    for (int32 task_index = 0; task_index < num_tasks; task_index++) {
+        Parallel_For_Task *task = &tasks[task_index];
+        task->callback = callback;
+        task->data = data;
+        task->first = (int32) (((int64) count * task_index) / num_tasks);
+        task->last = (int32) (((int64) count * (task_index + 1)) / num_tasks);
+        task->num_remaining_tasks = &num_remaining_tasks;
+        add_work_queue_entry(queue, do_parallel_for_task, task);
+    }
+
+    while (num_remaining_tasks.load() > 0) {
+        if (!do_next_work_queue_entry(queue)) {
+            std::this_thread::yield();
+        }
+    }
+}
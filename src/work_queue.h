@@ -0,0 +1,41 @@
+#ifndef WORK_QUEUE_H
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+typedef void Work_Queue_Callback(void *data);
+// NOTE: processes the items [first, last) of a parallel_for() range
+typedef void Parallel_For_Callback(void *data, int32 first, int32 last);
+
+struct Work_Queue_Entry {
+    Work_Queue_Callback *callback;
+    void *data;
+};
+
+#define MAX_WORK_QUEUE_ENTRIES 4096
+
+struct Work_Queue {
+    std::mutex mutex;
+    std::condition_variable work_available;
+
+    // NOTE: ring buffer of entries, protected by mutex
+    Work_Queue_Entry entries[MAX_WORK_QUEUE_ENTRIES];
+    int32 next_entry_to_read;
+    int32 next_entry_to_write;
+
+    int32 num_threads;
+    std::thread *threads;
+    bool32 is_shutting_down;
+};
+
+void init_work_queue(Work_Queue *queue, int32 num_threads);
+void shutdown_work_queue(Work_Queue *queue);
+void add_work_queue_entry(Work_Queue *queue, Work_Queue_Callback *callback, void *data);
+bool32 do_next_work_queue_entry(Work_Queue *queue);
+void parallel_for(Work_Queue *queue, int32 count, Parallel_For_Callback *callback, void *data);
+int32 get_default_num_worker_threads();
+
+#define WORK_QUEUE_H
+#endif